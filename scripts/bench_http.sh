@@ -0,0 +1,48 @@
+#!/bin/bash
+#
+# bench_http.sh - Load test the 09:00 release
+#
+# Seeds a throwaway database, starts the server on it and runs bench_http
+# against it. Extra arguments are passed to bench_http, e.g.
+#
+#   ./scripts/bench_http.sh --users 2000 --duration 30 --budget-scale 2
+#
+# Exit codes: 0 = within budgets, 1 = budget exceeded or errors
+
+set -e
+
+DB_PATH="bench_http.db"
+PORT="${BENCH_PORT:-18080}"
+USERS=500
+
+# --users must match between seeding and the run
+ARGS=("$@")
+for ((i = 0; i < ${#ARGS[@]}; i++)); do
+    if [ "${ARGS[$i]}" = "--users" ]; then
+        USERS="${ARGS[$((i + 1))]}"
+    fi
+done
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    rm -f "$DB_PATH" "$DB_PATH-journal"
+}
+
+trap cleanup EXIT
+
+./bench_http --seed "$DB_PATH" --users "$USERS"
+
+PUZZLE_DB_PATH="$DB_PATH" PORT="$PORT" ./puzzle_server > /dev/null &
+SERVER_PID=$!
+
+sleep 1
+
+if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+    echo "Failed to start server"
+    exit 1
+fi
+
+./bench_http --db "$DB_PATH" --url "http://127.0.0.1:$PORT" --users "$USERS" "$@"
@@ -0,0 +1,137 @@
+#!/bin/sh
+#
+# compile_templates.sh - Compile HTML templates into C part tables
+#
+# Usage:
+#   ./scripts/compile_templates.sh OUT.c OUT.h FILE...
+#
+# A template is literal HTML with holes:
+#
+#   {{name}}        string, HTML-escaped when rendered
+#   {{name:raw}}    string inserted as-is (markup built by the handler)
+#   {{name:int}}    integer
+#
+# Each FILE becomes a Template named TPL_<FILE> whose parts alternate
+# between constant segments, emitted as string literals so rendering can
+# point at them, and holes. Every distinct hole name gets a slot,
+# TPL_<FILE>_<NAME>; a name may appear more than once but with one type.
+#
+# POSIX sh and awk only: this runs inside the alpine builder image.
+
+set -e
+
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 OUT.c OUT.h FILE..." >&2
+    exit 1
+fi
+
+OUT_C="$1"
+OUT_H="$2"
+shift 2
+
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+{
+    echo "/* Generated by scripts/compile_templates.sh - do not edit */"
+    echo "#ifndef TEMPLATES_DATA_H"
+    echo "#define TEMPLATES_DATA_H"
+    echo ""
+    echo "#include \"template.h\""
+} > "$TMP_DIR/h"
+
+{
+    echo "/* Generated by scripts/compile_templates.sh - do not edit */"
+    echo "#include \"templates_data.h\""
+    echo ""
+    echo "#define S(literal) literal, sizeof(literal) - 1"
+} > "$TMP_DIR/c"
+
+for FILE in "$@"; do
+    BASE=$(basename "$FILE")
+    IDENT=$(echo "${BASE%.*}" | tr -c 'A-Za-z0-9\n' '_' | tr 'A-Z' 'a-z')
+    MACRO=$(echo "$IDENT" | tr 'a-z' 'A-Z')
+
+    LC_ALL=C awk -v file="$FILE" -v ident="$IDENT" -v macro="$MACRO" \
+        -v out_c="$TMP_DIR/c" -v out_h="$TMP_DIR/h" '
+    function fail(msg) {
+        printf "%s: %s\n", file, msg > "/dev/stderr"
+        failed = 1
+        exit 1
+    }
+
+    # A constant segment as adjacent string literals, one per source line
+    function text_part(s,    lines, n, i, line) {
+        if (s == "")
+            return
+        n = split(s, lines, "\n")
+        printf "    { TPL_PART_TEXT, S(" >> out_c
+        for (i = 1; i <= n; i++) {
+            line = lines[i]
+            gsub(/\\/, "\\\\", line)
+            gsub(/"/, "\\\"", line)
+            if (i < n)
+                line = line "\\n"
+            else if (line == "")
+                break
+            printf "%s\"%s\"", (i > 1 ? "\n        " : ""), line >> out_c
+        }
+        printf "), 0 },\n" >> out_c
+        parts++
+    }
+
+    function hole_part(spec,    name, type, colon) {
+        colon = index(spec, ":")
+        name = colon ? substr(spec, 1, colon - 1) : spec
+        type = colon ? substr(spec, colon + 1) : "html"
+        if (name !~ /^[a-z_][a-z0-9_]*$/)
+            fail("bad hole name \"" name "\"")
+        if (type != "html" && type != "raw" && type != "int")
+            fail("unknown hole type \"" type "\"")
+        if (name in slot_type) {
+            if (slot_type[name] != type)
+                fail("hole \"" name "\" used as both " slot_type[name] " and " type)
+        } else {
+            slot_type[name] = type
+            slot_names[slots++] = name
+        }
+        printf "    { TPL_PART_%s, NULL, 0, TPL_%s_%s },\n", toupper(type), macro, toupper(name) >> out_c
+        parts++
+    }
+
+    { text = text $0 "\n" }
+
+    END {
+        if (failed)
+            exit 1
+        printf "\nstatic const TemplatePart %s_parts[] = {\n", ident >> out_c
+        rest = text
+        while ((i = index(rest, "{{")) > 0) {
+            text_part(substr(rest, 1, i - 1))
+            rest = substr(rest, i + 2)
+            j = index(rest, "}}")
+            if (j == 0)
+                fail("unterminated hole")
+            hole_part(substr(rest, 1, j - 1))
+            rest = substr(rest, j + 2)
+        }
+        text_part(rest)
+        printf "};\n\n" >> out_c
+        printf "const Template TPL_%s = { \"%s\", %s_parts, %d, TPL_%s_SLOTS };\n",
+               macro, ident, ident, parts, macro >> out_c
+
+        printf "\nenum {\n" >> out_h
+        for (k = 0; k < slots; k++)
+            printf "    TPL_%s_%s,\n", macro, toupper(slot_names[k]) >> out_h
+        printf "    TPL_%s_SLOTS\n};\n\n", macro >> out_h
+        printf "extern const Template TPL_%s;\n", macro >> out_h
+    }' "$FILE"
+done
+
+{
+    echo ""
+    echo "#endif /* TEMPLATES_DATA_H */"
+} >> "$TMP_DIR/h"
+
+mv "$TMP_DIR/c" "$OUT_C"
+mv "$TMP_DIR/h" "$OUT_H"
@@ -0,0 +1,130 @@
+#!/bin/sh
+#
+# embed_assets.sh - Compile static files into C byte arrays
+#
+# Usage:
+#   ./scripts/embed_assets.sh OUT.c OUT.h FILE...
+#
+# For every FILE this emits the raw bytes plus gzip and (when the brotli
+# tool is installed) brotli variants, all computed at build time. Each asset
+# also gets a content-hashed URL, e.g. /static/style.1a2b3c4d.css, exposed to
+# the server as ASSET_<NAME>_URL so pages can link it with immutable caching.
+#
+# POSIX sh only: this runs inside the alpine builder image.
+
+set -e
+
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 OUT.c OUT.h FILE..." >&2
+    exit 1
+fi
+
+OUT_C="$1"
+OUT_H="$2"
+shift 2
+
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+sha256() {
+    if command -v sha256sum > /dev/null 2>&1; then
+        sha256sum "$1" | cut -c1-8
+    else
+        shasum -a 256 "$1" | cut -c1-8
+    fi
+}
+
+# Prints FILE as a comma-separated list of 0xNN bytes, 16 per line
+c_bytes() {
+    od -An -v -tx1 "$1" | sed -e 's/  */ /g' -e 's/^ //' -e '/^$/d' \
+        -e 's/\([0-9a-f][0-9a-f]\)/0x\1,/g' -e 's/^/    /'
+}
+
+content_type() {
+    case "$1" in
+        *.css)  echo "text/css; charset=utf-8" ;;
+        *.js)   echo "text/javascript; charset=utf-8" ;;
+        *.html) echo "text/html; charset=utf-8" ;;
+        *.svg)  echo "image/svg+xml" ;;
+        *.png)  echo "image/png" ;;
+        *.ico)  echo "image/x-icon" ;;
+        *)      echo "application/octet-stream" ;;
+    esac
+}
+
+HAVE_BROTLI=0
+if command -v brotli > /dev/null 2>&1; then
+    HAVE_BROTLI=1
+fi
+
+{
+    echo "/* Generated by scripts/embed_assets.sh - do not edit */"
+    echo "#ifndef ASSETS_DATA_H"
+    echo "#define ASSETS_DATA_H"
+    echo ""
+} > "$TMP_DIR/h"
+
+{
+    echo "/* Generated by scripts/embed_assets.sh - do not edit */"
+    echo "#include \"assets.h\""
+    echo ""
+} > "$TMP_DIR/c"
+
+TABLE=""
+
+for FILE in "$@"; do
+    BASE=$(basename "$FILE")
+    IDENT=$(echo "$BASE" | tr -c 'A-Za-z0-9\n' '_' | tr 'A-Z' 'a-z')
+    MACRO=$(echo "$IDENT" | tr 'a-z' 'A-Z')
+    HASH=$(sha256 "$FILE")
+    STEM="${BASE%.*}"
+    EXT="${BASE##*.}"
+    HASHED="$STEM.$HASH.$EXT"
+
+    echo "#define ASSET_${MACRO}_URL \"/static/$HASHED\"" >> "$TMP_DIR/h"
+
+    gzip -9 -n -c "$FILE" > "$TMP_DIR/$BASE.gz"
+
+    {
+        echo "static const unsigned char ${IDENT}[] = {"
+        c_bytes "$FILE"
+        echo "};"
+        echo ""
+        echo "static const unsigned char ${IDENT}_gz[] = {"
+        c_bytes "$TMP_DIR/$BASE.gz"
+        echo "};"
+        echo ""
+    } >> "$TMP_DIR/c"
+
+    BR="NULL, 0"
+    if [ "$HAVE_BROTLI" = "1" ]; then
+        brotli -q 11 -c "$FILE" > "$TMP_DIR/$BASE.br"
+        {
+            echo "static const unsigned char ${IDENT}_br[] = {"
+            c_bytes "$TMP_DIR/$BASE.br"
+            echo "};"
+            echo ""
+        } >> "$TMP_DIR/c"
+        BR="${IDENT}_br, sizeof(${IDENT}_br)"
+    fi
+
+    TABLE="$TABLE    { \"/static/$BASE\", \"/static/$HASHED\", \"$(content_type "$BASE")\", \"\\\"$HASH\\\"\",
+      ${IDENT}, sizeof(${IDENT}), ${IDENT}_gz, sizeof(${IDENT}_gz), $BR },
+"
+done
+
+{
+    echo "const Asset ASSETS[] = {"
+    printf "%s" "$TABLE"
+    echo "};"
+    echo ""
+    echo "const int ASSET_COUNT = (int)(sizeof(ASSETS) / sizeof(ASSETS[0]));"
+} >> "$TMP_DIR/c"
+
+{
+    echo ""
+    echo "#endif /* ASSETS_DATA_H */"
+} >> "$TMP_DIR/h"
+
+mv "$TMP_DIR/c" "$OUT_C"
+mv "$TMP_DIR/h" "$OUT_H"
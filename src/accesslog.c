@@ -0,0 +1,186 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "accesslog.h"
+
+/* head is written only by the event loop, tail only by the writer, each
+   on its own cache line so the two threads do not contend for it */
+static struct {
+    _Alignas(64) atomic_size_t head;    /* next slot to fill */
+    _Alignas(64) atomic_size_t tail;    /* next slot to write out */
+    _Alignas(64) AccessRecord *slots;
+    size_t mask;
+} ring;
+
+static AccessLogConfig config;
+static FILE *out = NULL;
+static long out_size = 0;
+static pthread_t writer;
+static atomic_int running = 0;
+
+static unsigned long dropped;           /* event loop only */
+static atomic_ulong written;
+static atomic_ulong rotations;
+static atomic_ulong write_errors;
+
+int accesslog_record(const AccessRecord *rec) {
+    if (!atomic_load_explicit(&running, memory_order_relaxed))
+        return -1;
+
+    size_t head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+    if (head - tail > ring.mask) {
+        dropped++;
+        return -1;
+    }
+
+    ring.slots[head & ring.mask] = *rec;
+    atomic_store_explicit(&ring.head, head + 1, memory_order_release);
+    return 0;
+}
+
+static int open_log(void) {
+    out = fopen(config.path, "a");
+    if (out == NULL)
+        return -1;
+    /* Not inherited by the binary a restart execs */
+    fcntl(fileno(out), F_SETFD, FD_CLOEXEC);
+    setvbuf(out, NULL, _IOFBF, 64 * 1024);
+    fseek(out, 0, SEEK_END);
+    out_size = ftell(out);
+    return 0;
+}
+
+/* path.N-1 becomes path.N, ..., path becomes path.1 */
+static void rotate(void) {
+    char from[1024], to[1024];
+    fclose(out);
+    for (int i = config.keep; i > 0; i--) {
+        if (i > 1)
+            snprintf(from, sizeof(from), "%s.%d", config.path, i - 1);
+        else
+            snprintf(from, sizeof(from), "%s", config.path);
+        snprintf(to, sizeof(to), "%s.%d", config.path, i);
+        rename(from, to);
+    }
+    if (config.keep <= 0)
+        remove(config.path);
+
+    if (open_log() != 0)
+        atomic_fetch_add(&write_errors, 1);
+    atomic_fetch_add(&rotations, 1);
+}
+
+static void write_record(const AccessRecord *r) {
+    time_t secs = (time_t)(r->time_ms / 1000);
+    struct tm tm;
+    gmtime_r(&secs, &tm);
+
+    int n = fprintf(out,
+        "{\"ts\":\"%04d-%02d-%02dT%02d:%02d:%02d.%03dZ\",\"route\":\"%s\","
+        "\"status\":%d,\"bytes\":%lu,\"us\":%lu,\"user\":%lld}\n",
+        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min,
+        tm.tm_sec, (int)(r->time_ms % 1000), r->route ? r->route : "unmatched",
+        r->status, (unsigned long)r->bytes, (unsigned long)r->latency_us,
+        (long long)r->user_id);
+    if (n < 0) {
+        atomic_fetch_add(&write_errors, 1);
+        return;
+    }
+    out_size += n;
+}
+
+/* Copies out everything queued so far. Slots are handed back to the
+   event loop only after they have been formatted. */
+static void drain(void) {
+    size_t tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring.head, memory_order_acquire);
+    if (tail == head)
+        return;
+
+    unsigned long n = 0;
+    for (; tail != head; tail++, n++) {
+        if (out != NULL)
+            write_record(&ring.slots[tail & ring.mask]);
+        atomic_store_explicit(&ring.tail, tail + 1, memory_order_release);
+    }
+    atomic_fetch_add(&written, n);
+
+    if (out != NULL && fflush(out) != 0)
+        atomic_fetch_add(&write_errors, 1);
+    if (out != NULL && out_size >= config.max_bytes)
+        rotate();
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct timespec interval = { 0, ACCESSLOG_FLUSH_MS * 1000000L };
+    while (atomic_load(&running)) {
+        drain();
+        nanosleep(&interval, NULL);
+    }
+    drain();
+    return NULL;
+}
+
+int accesslog_start(const AccessLogConfig *cfg) {
+    if (atomic_load(&running) || cfg->path == NULL)
+        return -1;
+
+    config = *cfg;
+    if (config.capacity == 0)
+        config.capacity = ACCESSLOG_DEFAULT_CAPACITY;
+    if (config.max_bytes <= 0)
+        config.max_bytes = ACCESSLOG_DEFAULT_MAX_BYTES;
+
+    /* Round up so slot indices can be masked */
+    size_t capacity = 1;
+    while (capacity < config.capacity)
+        capacity <<= 1;
+
+    ring.slots = calloc(capacity, sizeof(AccessRecord));
+    if (ring.slots == NULL)
+        return -1;
+    ring.mask = capacity - 1;
+    atomic_store(&ring.head, 0);
+    atomic_store(&ring.tail, 0);
+
+    if (open_log() != 0) {
+        free(ring.slots);
+        ring.slots = NULL;
+        return -1;
+    }
+
+    atomic_store(&running, 1);
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        atomic_store(&running, 0);
+        fclose(out);
+        out = NULL;
+        free(ring.slots);
+        ring.slots = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void accesslog_stop(void) {
+    if (!atomic_exchange(&running, 0))
+        return;
+
+    pthread_join(writer, NULL);
+    if (out != NULL)
+        fclose(out);
+    out = NULL;
+    free(ring.slots);
+    ring.slots = NULL;
+}
+
+void accesslog_get_stats(AccessLogStats *out_stats) {
+    out_stats->written = atomic_load(&written);
+    out_stats->dropped = dropped;
+    out_stats->rotations = atomic_load(&rotations);
+    out_stats->write_errors = atomic_load(&write_errors);
+}
@@ -0,0 +1,53 @@
+#ifndef ACCESSLOG_H
+#define ACCESSLOG_H
+
+#include <stdint.h>
+
+/* Access log off the event loop. Requests are recorded into a
+   single-producer single-consumer ring of fixed-size records without
+   locks or syscalls; a background thread formats them as JSON lines and
+   appends them to a file it rotates by size. A full ring drops records
+   instead of blocking, and counts them. */
+
+#define ACCESSLOG_DEFAULT_CAPACITY 8192             /* records, power of two */
+#define ACCESSLOG_DEFAULT_MAX_BYTES (64L << 20)     /* then rotate */
+#define ACCESSLOG_DEFAULT_KEEP 5                    /* rotated files kept */
+#define ACCESSLOG_FLUSH_MS 100                      /* drain interval */
+
+typedef struct {
+    int64_t time_ms;        /* Unix time */
+    const char *route;      /* static route pattern, NULL if unmatched */
+    int64_t user_id;        /* 0: anonymous */
+    int status;
+    uint32_t bytes;
+    uint32_t latency_us;
+} AccessRecord;
+
+typedef struct {
+    const char *path;       /* rotated files get .1, .2, ... */
+    unsigned capacity;
+    long max_bytes;
+    int keep;               /* rotated files kept, 0: none */
+} AccessLogConfig;
+
+typedef struct {
+    unsigned long written;
+    unsigned long dropped;      /* ring was full */
+    unsigned long rotations;
+    unsigned long write_errors;
+} AccessLogStats;
+
+/* Opens the log and starts the writer thread. The path must outlive it.
+   Returns 0 on success, -1 on error. */
+int accesslog_start(const AccessLogConfig *cfg);
+
+/* Event loop only. Returns 0, or -1 if the record was dropped (or the
+   log is not running). */
+int accesslog_record(const AccessRecord *rec);
+
+/* Writes what is queued, then stops the thread and closes the file */
+void accesslog_stop(void);
+
+void accesslog_get_stats(AccessLogStats *out);
+
+#endif /* ACCESSLOG_H */
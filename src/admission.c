@@ -0,0 +1,110 @@
+#include <string.h>
+#include <time.h>
+#include "admission.h"
+
+/* Time constant of the lag average: a second of overload to react */
+#define LAG_TAU_MS 1000.0
+
+/* Leaving a level needs the signals below this fraction of its threshold,
+   so the level does not flap around the boundary */
+#define RELAX_SCALE 0.75
+
+static AdmissionConfig config = {
+    .lag_low_ms = 100,
+    .lag_high_ms = 500,
+    .queue_low = 64,
+    .queue_high = 256,
+    .retry_after_secs = 5,
+};
+
+static AdmissionStats stats;
+
+static double request_start_ms = 0;
+static double busy_ms = 0;          /* handler time in this iteration */
+static double last_tick_ms = 0;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void admission_configure(const AdmissionConfig *cfg) {
+    config = *cfg;
+}
+
+void admission_get_config(AdmissionConfig *out) {
+    *out = config;
+}
+
+void admission_request_begin(void) {
+    request_start_ms = now_ms();
+}
+
+void admission_request_end(void) {
+    busy_ms += now_ms() - request_start_ms;
+}
+
+static AdmitLevel level_for(double lag, unsigned queued, double scale) {
+    if (lag >= config.lag_high_ms * scale || queued >= config.queue_high * scale)
+        return ADMIT_CRITICAL_ONLY;
+    if (lag >= config.lag_low_ms * scale || queued >= config.queue_low * scale)
+        return ADMIT_SHED_LOW;
+    return ADMIT_ALL;
+}
+
+int admission_tick(unsigned queued) {
+    double now = now_ms();
+    double dt = last_tick_ms > 0 ? now - last_tick_ms : LAG_TAU_MS;
+    last_tick_ms = now;
+
+    /* A request arriving during this iteration waited for all of its
+       handlers: that is the loop lag. Averaged over time, not iterations,
+       so idle wakeups and busy bursts weigh by how long they lasted. */
+    double alpha = dt / (dt + LAG_TAU_MS);
+    stats.lag_ms += alpha * (busy_ms - stats.lag_ms);
+    stats.queued = queued;
+    busy_ms = 0;
+
+    AdmitLevel up = level_for(stats.lag_ms, queued, 1.0);
+    AdmitLevel down = level_for(stats.lag_ms, queued, RELAX_SCALE);
+    AdmitLevel next = stats.level;
+    if (up > stats.level)
+        next = up;
+    else if (down < stats.level)
+        next = down;
+
+    if (next == stats.level)
+        return 0;
+
+    stats.level = next;
+    stats.level_changes++;
+    return 1;
+}
+
+int admission_admit(Priority priority) {
+    int admit;
+    switch (stats.level) {
+        case ADMIT_SHED_LOW:      admit = priority < PRIORITY_LOW; break;
+        case ADMIT_CRITICAL_ONLY: admit = priority == PRIORITY_CRITICAL; break;
+        default:                  admit = 1; break;
+    }
+
+    if (admit)
+        stats.admitted[priority]++;
+    else
+        stats.shed[priority]++;
+    return admit;
+}
+
+void admission_get_stats(AdmissionStats *out) {
+    *out = stats;
+}
+
+const char *admission_level_name(AdmitLevel level) {
+    switch (level) {
+        case ADMIT_SHED_LOW:      return "shedding low";
+        case ADMIT_CRITICAL_ONLY: return "critical only";
+        default:                  return "normal";
+    }
+}
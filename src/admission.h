@@ -0,0 +1,53 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+/* Route priorities, most important first. Overload sheds from the bottom. */
+typedef enum {
+    PRIORITY_CRITICAL,      /* guesses, login, health: always served */
+    PRIORITY_NORMAL,
+    PRIORITY_LOW,           /* admin, archive list, all-time leaderboard */
+    PRIORITY_COUNT
+} Priority;
+
+typedef enum {
+    ADMIT_ALL,              /* not overloaded */
+    ADMIT_SHED_LOW,         /* low priority routes get 503 */
+    ADMIT_CRITICAL_ONLY     /* only critical routes are served */
+} AdmitLevel;
+
+typedef struct {
+    unsigned lag_low_ms;        /* smoothed loop lag that starts shedding low */
+    unsigned lag_high_ms;       /* ... and normal */
+    unsigned queue_low;         /* connections with queued work, same tiers */
+    unsigned queue_high;
+    unsigned retry_after_secs;
+} AdmissionConfig;
+
+typedef struct {
+    AdmitLevel level;
+    double lag_ms;
+    unsigned queued;
+    unsigned long admitted[PRIORITY_COUNT];
+    unsigned long shed[PRIORITY_COUNT];
+    unsigned long level_changes;
+} AdmissionStats;
+
+void admission_configure(const AdmissionConfig *cfg);
+void admission_get_config(AdmissionConfig *out);
+
+/* Bracket each request so its handler time counts towards loop lag */
+void admission_request_begin(void);
+void admission_request_end(void);
+
+/* Call once per event loop iteration with the number of connections that
+   still have unparsed requests or unsent responses. Returns 1 if the
+   admit level changed. */
+int admission_tick(unsigned queued);
+
+/* Returns 1 if a request of this priority should be served, 0 to shed */
+int admission_admit(Priority priority);
+
+void admission_get_stats(AdmissionStats *out);
+const char *admission_level_name(AdmitLevel level);
+
+#endif /* ADMISSION_H */
@@ -0,0 +1,24 @@
+#include <string.h>
+#include "assets.h"
+
+static int path_eq(const char *a, const char *b, size_t b_len) {
+    return strlen(a) == b_len && memcmp(a, b, b_len) == 0;
+}
+
+const Asset *asset_find(const char *path, size_t path_len, int *immutable) {
+    if (path == NULL)
+        return NULL;
+
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        if (path_eq(ASSETS[i].hashed_path, path, path_len)) {
+            if (immutable) *immutable = 1;
+            return &ASSETS[i];
+        }
+        if (path_eq(ASSETS[i].path, path, path_len)) {
+            if (immutable) *immutable = 0;
+            return &ASSETS[i];
+        }
+    }
+
+    return NULL;
+}
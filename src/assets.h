@@ -0,0 +1,27 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stddef.h>
+
+/* A static file compiled into the binary by scripts/embed_assets.sh */
+typedef struct {
+    const char *path;           /* /static/style.css */
+    const char *hashed_path;    /* /static/style.1a2b3c4d.css */
+    const char *content_type;
+    const char *etag;           /* quoted content hash */
+    const unsigned char *data;
+    size_t len;
+    const unsigned char *gz;    /* gzip -9 variant */
+    size_t gz_len;
+    const unsigned char *br;    /* brotli variant, NULL if not built */
+    size_t br_len;
+} Asset;
+
+extern const Asset ASSETS[];
+extern const int ASSET_COUNT;
+
+/* Looks up by plain or fingerprinted path. Sets *immutable to 1 when the
+   fingerprinted path matched, so the caller can cache it forever. */
+const Asset *asset_find(const char *path, size_t path_len, int *immutable);
+
+#endif /* ASSETS_H */
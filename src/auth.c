@@ -4,6 +4,8 @@
 #include <strings.h>
 #include "auth.h"
 #include "db.h"
+#include "sha256.h"
+#include "writeback.h"
 #include "util.h"
 #include "sqlite3.h"
 
@@ -86,6 +88,251 @@ int auth_create_magic_link(const char *email, char *token_out, char *code_out) {
     return 0;
 }
 
+/* --- Signed sessions --- */
+
+/* "s1.<key id>.<user id>.<expires>.<nonce>.<mac>": the MAC is HMAC-SHA256
+   in hex over everything before its '.', so checking one needs no row.
+   The nonce keeps two logins in the same second apart, for revocation. */
+#define SIGNED_PREFIX "s1."
+
+typedef struct {
+    unsigned id;
+    HmacKey mac;
+} SessionKey;
+
+static SessionKey session_keys[SESSION_KEYS_MAX];      /* [0] signs */
+static int session_key_count = 0;
+
+/* Revoked MACs by their first 8 bytes, open addressing, 0: free. Rows in
+   revoked_sessions are the copy that outlives a restart. */
+typedef struct {
+    uint64_t fingerprint;
+    long expires_at;
+} Revoked;
+
+static Revoked *revoked = NULL;
+static size_t revoked_cap = 0;
+static unsigned revoked_count = 0;
+static int revoked_loaded = 0;
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+int auth_configure_session_keys(const char *spec) {
+    SessionKey parsed[SESSION_KEYS_MAX];
+    int count = 0;
+
+    for (const char *p = spec; p != NULL && *p != '\0'; ) {
+        while (*p == ' ' || *p == ',') p++;
+        if (*p == '\0')
+            break;
+
+        char *end;
+        unsigned long id = strtoul(p, &end, 10);
+        if (end == p || *end != ':' || id == 0 || id > 65535 || count == SESSION_KEYS_MAX)
+            return -1;
+        for (int i = 0; i < count; i++) {
+            if (parsed[i].id == id)
+                return -1;
+        }
+
+        unsigned char secret[64];
+        size_t len = 0;
+        for (p = end + 1; *p != '\0' && *p != ',' && *p != ' '; p += 2) {
+            int hi = hex_value(p[0]), lo = hi < 0 ? -1 : hex_value(p[1]);
+            if (lo < 0 || len == sizeof(secret))
+                return -1;
+            secret[len++] = (unsigned char)(hi << 4 | lo);
+        }
+        if (len < SESSION_KEY_MIN_BYTES)
+            return -1;
+
+        parsed[count].id = (unsigned)id;
+        hmac_sha256_key(&parsed[count].mac, secret, len);
+        memset(secret, 0, sizeof(secret));
+        count++;
+    }
+
+    memcpy(session_keys, parsed, sizeof(parsed[0]) * count);
+    session_key_count = count;
+    return 0;
+}
+
+static uint64_t mac_fingerprint(const unsigned char *mac) {
+    uint64_t fp = 0;
+    for (int i = 0; i < 8; i++)
+        fp = fp << 8 | mac[i];
+    return fp ? fp : 1;
+}
+
+static Revoked *revoked_slot(uint64_t fingerprint) {
+    size_t i = (size_t)fingerprint & (revoked_cap - 1);
+    while (revoked[i].fingerprint != 0 && revoked[i].fingerprint != fingerprint)
+        i = (i + 1) & (revoked_cap - 1);
+    return &revoked[i];
+}
+
+/* Keeps the load at half; if memory runs out the row is still there */
+static void revoked_add(uint64_t fingerprint, long expires_at) {
+    if ((revoked_count + 1) * 2 > revoked_cap) {
+        size_t cap = revoked_cap ? revoked_cap * 2 : 64;
+        Revoked *old = revoked;
+        size_t old_cap = revoked_cap;
+        Revoked *grown = calloc(cap, sizeof(Revoked));
+        if (grown == NULL)
+            return;
+        revoked = grown;
+        revoked_cap = cap;
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old[i].fingerprint != 0)
+                *revoked_slot(old[i].fingerprint) = old[i];
+        }
+        free(old);
+    }
+    Revoked *r = revoked_slot(fingerprint);
+    if (r->fingerprint == 0)
+        revoked_count++;
+    r->fingerprint = fingerprint;
+    r->expires_at = expires_at;
+}
+
+/* Rebuilds the set from revoked_sessions, which also holds what other
+   servers revoked and leaves out what has expired. If the table cannot
+   be read the old set stays. */
+static void revoked_load(void) {
+    sqlite3 *db = db_get();
+    sqlite3_stmt *stmt = NULL;
+    revoked_loaded = 1;
+    if (db == NULL || sqlite3_prepare_v2(db,
+            "SELECT fingerprint, expires_at FROM revoked_sessions WHERE expires_at > ?",
+            -1, &stmt, NULL) != SQLITE_OK)
+        return;
+
+    free(revoked);
+    revoked = NULL;
+    revoked_cap = 0;
+    revoked_count = 0;
+    sqlite3_bind_int64(stmt, 1, get_current_time());
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        revoked_add((uint64_t)sqlite3_column_int64(stmt, 0), (long)sqlite3_column_int64(stmt, 1));
+    sqlite3_finalize(stmt);
+}
+
+static int sign_session(int64_t user_id, long expires_at, char *out) {
+    const SessionKey *key = &session_keys[0];
+    char nonce[17];
+    if (generate_token_hex(nonce, sizeof(nonce), 8) != 0)
+        return -1;
+    int n = snprintf(out, SESSION_TOKEN_MAX, SIGNED_PREFIX "%u.%lld.%ld.%s",
+                     key->id, (long long)user_id, expires_at, nonce);
+    if (n < 0 || n + 1 + SHA256_BYTES * 2 >= SESSION_TOKEN_MAX)
+        return -1;
+
+    unsigned char mac[SHA256_BYTES];
+    hmac_sha256(&key->mac, out, (size_t)n, mac);
+    out[n++] = '.';
+    for (int i = 0; i < SHA256_BYTES; i++)
+        n += sprintf(out + n, "%02x", mac[i]);
+    return 0;
+}
+
+/* Checks the MAC and expiry, leaving the fingerprint for a revocation */
+static int verify_signed(const char *token, int64_t *user_id_out, long *expires_out,
+                         uint64_t *fingerprint_out) {
+    if (session_key_count == 0 || strncmp(token, SIGNED_PREFIX, 3) != 0)
+        return -1;
+
+    char *end;
+    const char *p = token + 3;
+    unsigned long id = strtoul(p, &end, 10);
+    if (end == p || *end != '.')
+        return -1;
+    p = end + 1;
+    long long user_id = strtoll(p, &end, 10);
+    if (end == p || *end != '.' || user_id <= 0)
+        return -1;
+    p = end + 1;
+    long expires_at = strtol(p, &end, 10);
+    if (end == p || *end != '.')
+        return -1;
+    end = strchr(end + 1, '.');
+    if (end == NULL || strlen(end + 1) != SHA256_BYTES * 2)
+        return -1;
+
+    const SessionKey *key = NULL;
+    for (int i = 0; i < session_key_count && key == NULL; i++) {
+        if (session_keys[i].id == id)
+            key = &session_keys[i];
+    }
+    if (key == NULL)
+        return -1;
+
+    /* Compared in full whatever differs, so timing says nothing */
+    unsigned char mac[SHA256_BYTES];
+    hmac_sha256(&key->mac, token, (size_t)(end - token), mac);
+    const char *hex = end + 1;
+    int diff = 0;
+    for (int i = 0; i < SHA256_BYTES; i++) {
+        int hi = hex_value(hex[i * 2]), lo = hex_value(hex[i * 2 + 1]);
+        diff |= (hi | lo) < 0 ? 1 : (hi << 4 | lo) ^ mac[i];
+    }
+    if (diff != 0 || expires_at <= get_current_time())
+        return -1;
+
+    *user_id_out = user_id;
+    *expires_out = expires_at;
+    *fingerprint_out = mac_fingerprint(mac);
+    return 0;
+}
+
+static int is_revoked(uint64_t fingerprint) {
+    if (!revoked_loaded)
+        revoked_load();
+    return revoked_cap > 0 && revoked_slot(fingerprint)->fingerprint != 0;
+}
+
+int auth_verify_signed_session(const char *token, int64_t *user_id_out, long *expires_out) {
+    uint64_t fingerprint;
+    if (token == NULL || verify_signed(token, user_id_out, expires_out, &fingerprint) != 0)
+        return -1;
+    return is_revoked(fingerprint) ? -1 : 0;
+}
+
+/* A signed token once keys are configured, otherwise a sessions row */
+static int create_session(int64_t user_id, char *session_out) {
+    long expiry = get_current_time() + SESSION_EXPIRY_SECS;
+    if (session_key_count > 0)
+        return sign_session(user_id, expiry, session_out);
+
+    sqlite3 *db = db_get();
+    sqlite3_stmt *stmt = NULL;
+    if (generate_token_hex(session_out, SESSION_TOKEN_MAX, SESSION_TOKEN_BYTES) != 0)
+        return -1;
+
+    char session_expires[32];
+    format_datetime(session_expires, sizeof(session_expires), expiry);
+
+    const char *session_sql =
+        "INSERT INTO sessions (user_id, token, expires_at) VALUES (?, ?, ?)";
+
+    int rc = sqlite3_prepare_v2(db, session_sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, user_id);
+    sqlite3_bind_text(stmt, 2, session_out, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, session_expires, -1, SQLITE_STATIC);
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_DONE) ? 0 : -1;
+}
+
 int auth_validate_magic_link(const char *token, char *session_out, int64_t *user_id_out) {
     sqlite3 *db = db_get();
     sqlite3_stmt *stmt = NULL;
@@ -147,28 +394,7 @@ int auth_validate_magic_link(const char *token, char *session_out, int64_t *user
         sqlite3_finalize(stmt);
     }
 
-    if (generate_token_hex(session_out, 65, SESSION_TOKEN_BYTES) != 0)
-        return -1;
-
-    char session_expires[32];
-    long expiry = get_current_time() + SESSION_EXPIRY_SECS;
-    format_datetime(session_expires, sizeof(session_expires), expiry);
-
-    const char *session_sql =
-        "INSERT INTO sessions (user_id, token, expires_at) VALUES (?, ?, ?)";
-
-    rc = sqlite3_prepare_v2(db, session_sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK)
-        return -1;
-
-    sqlite3_bind_int64(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, session_out, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, session_expires, -1, SQLITE_STATIC);
-
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-
-    if (rc != SQLITE_DONE)
+    if (create_session(user_id, session_out) != 0)
         return -1;
 
     *user_id_out = user_id;
@@ -274,32 +500,150 @@ int auth_validate_code(const char *email, const char *code, char *session_out, i
         user_id = sqlite3_last_insert_rowid(db);
     }
 
-    if (generate_token_hex(session_out, 65, SESSION_TOKEN_BYTES) != 0)
+    if (create_session(user_id, session_out) != 0)
         return -1;
 
-    char session_expires[32];
-    long expiry = get_current_time() + SESSION_EXPIRY_SECS;
-    format_datetime(session_expires, sizeof(session_expires), expiry);
+    *user_id_out = user_id;
+    return 0;
+}
 
-    const char *session_sql =
-        "INSERT INTO sessions (user_id, token, expires_at) VALUES (?, ?, ?)";
+/* Session cache: entries chained from a hash index and kept on an LRU
+   list, both by array position so nothing is allocated per lookup */
+typedef struct {
+    char token[SESSION_TOKEN_MAX];  /* "": free */
+    User user;
+    long expires_at;            /* the session's own expiry */
+    uint64_t fingerprint;       /* signed tokens only, rechecked on each hit */
+    long fetched_at;            /* refetched after SESSION_CACHE_TTL_SECS */
+    int chain;                  /* next in the index slot, -1: end */
+    int older, newer;           /* LRU list, -1: end */
+} CachedSession;
+
+static CachedSession cache[SESSION_CACHE_MAX];
+static int cache_index[SESSION_CACHE_SLOTS];
+static int cache_newest = -1, cache_oldest = -1, cache_free = -1;
+static int cache_ready = 0;
+static SessionCacheStats cache_stats;
+
+static unsigned token_slot(const char *token) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)token; *p; p++)
+        h = (h ^ *p) * 16777619u;
+    return h & (SESSION_CACHE_SLOTS - 1);
+}
 
-    rc = sqlite3_prepare_v2(db, session_sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK)
-        return -1;
+void auth_session_cache_flush(void) {
+    memset(cache, 0, sizeof(cache));
+    for (int i = 0; i < SESSION_CACHE_SLOTS; i++)
+        cache_index[i] = -1;
+    /* Free entries are chained through .chain */
+    for (int i = 0; i < SESSION_CACHE_MAX; i++)
+        cache[i].chain = i + 1 < SESSION_CACHE_MAX ? i + 1 : -1;
+    cache_free = 0;
+    cache_newest = cache_oldest = -1;
+    cache_stats.entries = 0;
+    cache_ready = 1;
+}
 
-    sqlite3_bind_int64(stmt, 1, user_id);
-    sqlite3_bind_text(stmt, 2, session_out, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, session_expires, -1, SQLITE_STATIC);
+static void lru_unlink(int i) {
+    CachedSession *e = &cache[i];
+    if (e->newer >= 0) cache[e->newer].older = e->older;
+    else cache_newest = e->older;
+    if (e->older >= 0) cache[e->older].newer = e->newer;
+    else cache_oldest = e->newer;
+}
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+static void lru_push(int i) {
+    cache[i].older = cache_newest;
+    cache[i].newer = -1;
+    if (cache_newest >= 0) cache[cache_newest].newer = i;
+    else cache_oldest = i;
+    cache_newest = i;
+}
 
-    if (rc != SQLITE_DONE)
+static int cache_find(const char *token) {
+    for (int i = cache_index[token_slot(token)]; i >= 0; i = cache[i].chain) {
+        if (strcmp(cache[i].token, token) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void cache_remove(int i) {
+    int *link = &cache_index[token_slot(cache[i].token)];
+    while (*link != i)
+        link = &cache[*link].chain;
+    *link = cache[i].chain;
+    lru_unlink(i);
+    cache[i].token[0] = '\0';
+    cache[i].chain = cache_free;
+    cache_free = i;
+    cache_stats.entries--;
+}
+
+static void cache_put(const char *token, const User *user, uint64_t fingerprint,
+                      long expires_at, long now) {
+    if (!cache_ready || strlen(token) >= sizeof(cache[0].token))
+        return;
+    if (cache_free < 0) {
+        cache_remove(cache_oldest);
+        cache_stats.evictions++;
+    }
+    int i = cache_free;
+    CachedSession *e = &cache[i];
+    cache_free = e->chain;
+    strcpy(e->token, token);
+    e->user = *user;
+    e->user.session_extended = 0;
+    e->expires_at = expires_at;
+    e->fingerprint = fingerprint;
+    e->fetched_at = now;
+    unsigned slot = token_slot(token);
+    e->chain = cache_index[slot];
+    cache_index[slot] = i;
+    lru_push(i);
+    cache_stats.entries++;
+}
+
+/* Finds a fresh entry and marks it most recently used. Expired, stale
+   and revoked entries are dropped so the caller goes to the database. */
+static int cache_get(const char *token, long now) {
+    if (!cache_ready)
+        auth_session_cache_flush();
+    int i = cache_find(token);
+    if (i < 0)
+        return -1;
+    CachedSession *e = &cache[i];
+    if (now >= e->expires_at || now - e->fetched_at >= SESSION_CACHE_TTL_SECS ||
+        (e->fingerprint != 0 && is_revoked(e->fingerprint))) {
+        cache_remove(i);
+        cache_stats.invalidations++;
         return -1;
+    }
+    if (cache_newest != i) {
+        lru_unlink(i);
+        lru_push(i);
+    }
+    return i;
+}
 
-    *user_id_out = user_id;
-    return 0;
+/* Sliding expiry for row sessions: use moves the end to
+   SESSION_EXPIRY_SECS from now, at most once per SESSION_SLIDE_SECS, and
+   the new time goes out with the next batch of deferred writes */
+static void slide_expiry(const char *token, long *expires_at, long now, User *user) {
+    long slid = now + SESSION_EXPIRY_SECS;
+    if (slid - *expires_at < SESSION_SLIDE_SECS)
+        return;
+    if (writeback_set(WRITEBACK_SESSION_EXPIRY, token, slid) != 0)
+        return;
+    *expires_at = slid;
+    user->session_extended = 1;
+}
+
+void auth_session_cache_stats(SessionCacheStats *out) {
+    *out = cache_stats;
+    out->bytes = sizeof(cache) + sizeof(cache_index);
+    out->revoked = revoked_count;
 }
 
 int auth_get_user_from_session(const char *session_token, User *user_out) {
@@ -311,17 +655,45 @@ int auth_get_user_from_session(const char *session_token, User *user_out) {
 
     memset(user_out, 0, sizeof(User));
 
+    long now = get_current_time();
+    int is_signed = strncmp(session_token, SIGNED_PREFIX, 3) == 0;
+    int cached = cache_get(session_token, now);
+    if (cached >= 0) {
+        cache_stats.hits++;
+        *user_out = cache[cached].user;
+        if (!is_signed)
+            slide_expiry(session_token, &cache[cached].expires_at, now, user_out);
+        return 0;
+    }
+    cache_stats.misses++;
+
     const char *sql =
-        "SELECT u.id, u.email, u.display_name "
+        "SELECT u.id, u.email, u.display_name, CAST(strftime('%s', s.expires_at) AS INTEGER) "
         "FROM sessions s "
         "JOIN users u ON s.user_id = u.id "
         "WHERE s.token = ? AND s.expires_at > datetime('now')";
 
+    /* A signed token names its user; only the profile comes from SQLite */
+    int64_t signed_user = 0;
+    long signed_expires = 0;
+    uint64_t fingerprint = 0;
+    if (is_signed) {
+        if (verify_signed(session_token, &signed_user, &signed_expires, &fingerprint) != 0 ||
+            is_revoked(fingerprint))
+            return -1;
+        sql = "SELECT id, email, display_name, ?2 FROM users WHERE id = ?1";
+    }
+
     int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
     if (rc != SQLITE_OK)
         return -1;
 
-    sqlite3_bind_text(stmt, 1, session_token, -1, SQLITE_STATIC);
+    if (is_signed) {
+        sqlite3_bind_int64(stmt, 1, signed_user);
+        sqlite3_bind_int64(stmt, 2, signed_expires);
+    } else {
+        sqlite3_bind_text(stmt, 1, session_token, -1, SQLITE_STATIC);
+    }
 
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
@@ -339,6 +711,18 @@ int auth_get_user_from_session(const char *session_token, User *user_out) {
     if (name)
         strncpy(user_out->display_name, name, sizeof(user_out->display_name) - 1);
 
+    user_out->roles = auth_roles_for(user_out->email);
+
+    /* The row may be behind an expiry still waiting to be written */
+    long expires_at = (long)sqlite3_column_int64(stmt, 3);
+    int64_t pending;
+    if (!is_signed) {
+        if (writeback_pending(WRITEBACK_SESSION_EXPIRY, session_token, &pending) &&
+            pending > expires_at)
+            expires_at = (long)pending;
+        slide_expiry(session_token, &expires_at, now, user_out);
+    }
+    cache_put(session_token, user_out, fingerprint, expires_at, now);
     sqlite3_finalize(stmt);
     return 0;
 }
@@ -350,6 +734,36 @@ int auth_logout(const char *session_token) {
     if (db == NULL || session_token == NULL)
         return -1;
 
+    int cached = cache_ready ? cache_find(session_token) : -1;
+    if (cached >= 0) {
+        cache_remove(cached);
+        cache_stats.invalidations++;
+    }
+
+    /* A signed token has no row to delete: its MAC goes on the list of
+       revoked ones until it would have expired anyway */
+    int64_t user_id;
+    long expires_at;
+    uint64_t fingerprint;
+    if (strncmp(session_token, SIGNED_PREFIX, 3) == 0) {
+        if (verify_signed(session_token, &user_id, &expires_at, &fingerprint) != 0)
+            return 0;
+        if (!revoked_loaded)
+            revoked_load();
+        revoked_add(fingerprint, expires_at);
+
+        int rc = sqlite3_prepare_v2(db,
+            "INSERT OR IGNORE INTO revoked_sessions (fingerprint, expires_at) VALUES (?, ?)",
+            -1, &stmt, NULL);
+        if (rc != SQLITE_OK)
+            return -1;
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)fingerprint);
+        sqlite3_bind_int64(stmt, 2, expires_at);
+        rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return (rc == SQLITE_DONE) ? 0 : -1;
+    }
+
     int rc = sqlite3_prepare_v2(db, "DELETE FROM sessions WHERE token = ?", -1, &stmt, NULL);
     if (rc != SQLITE_OK)
         return -1;
@@ -378,35 +792,163 @@ int auth_update_display_name(int64_t user_id, const char *display_name) {
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    /* Every cached session of the user sees the new name at once */
+    if (rc == SQLITE_DONE) {
+        for (int i = 0; cache_ready && i < SESSION_CACHE_MAX; i++) {
+            if (cache[i].token[0] != '\0' && cache[i].user.id == user_id)
+                snprintf(cache[i].user.display_name, sizeof(cache[i].user.display_name),
+                         "%s", display_name);
+        }
+    }
+
+    db_bump_version(DATA_USERS);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
-int auth_is_admin(const char *email) {
-    if (email == NULL || email[0] == '\0')
-        return 0;
+/* --- Roles --- */
+
+/* Emails with their roles, lowercased, open addressing by hash (0: free).
+   Built whole by auth_load_roles and swapped in. */
+typedef struct {
+    uint64_t hash;
+    char email[AUTH_MAX_EMAIL_LEN + 1];
+    unsigned roles;
+} RoleEntry;
+
+static RoleEntry *role_table = NULL;
+static size_t role_cap = 0;
+static unsigned role_count = 0;
+
+static const struct {
+    const char *name;
+    unsigned bit;
+} ROLE_NAMES[] = {
+    { "admin", ROLE_ADMIN },
+};
+
+static uint64_t email_key(const char *email, char *lower) {
+    uint64_t h = 14695981039346656037ULL;
+    size_t i = 0;
+    for (; email[i] != '\0' && i < AUTH_MAX_EMAIL_LEN; i++) {
+        char ch = email[i];
+        if (ch >= 'A' && ch <= 'Z') ch += 32;
+        lower[i] = ch;
+        h = (h ^ (unsigned char)ch) * 1099511628211ULL;
+    }
+    lower[i] = '\0';
+    return h ? h : 1;
+}
 
-    const char *env = getenv("ADMIN_EMAILS");
-    if (env == NULL || env[0] == '\0')
-        return 0;
+static RoleEntry *role_slot(RoleEntry *table, size_t cap, uint64_t hash, const char *lower) {
+    size_t i = (size_t)hash & (cap - 1);
+    while (table[i].hash != 0 &&
+           (table[i].hash != hash || strcmp(table[i].email, lower) != 0))
+        i = (i + 1) & (cap - 1);
+    return &table[i];
+}
 
-    char buf[1024];
-    strncpy(buf, env, sizeof(buf) - 1);
-    buf[sizeof(buf) - 1] = '\0';
+/* Adds roles to an email in a table being built, growing it at half full */
+static int role_grant(RoleEntry **table, size_t *cap, unsigned *count,
+                      const char *email, unsigned roles) {
+    if ((*count + 1) * 2 > *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 16;
+        RoleEntry *grown = calloc(grown_cap, sizeof(RoleEntry));
+        if (grown == NULL)
+            return -1;
+        for (size_t i = 0; i < *cap; i++) {
+            if ((*table)[i].hash != 0)
+                *role_slot(grown, grown_cap, (*table)[i].hash, (*table)[i].email) = (*table)[i];
+        }
+        free(*table);
+        *table = grown;
+        *cap = grown_cap;
+    }
 
-    char *saveptr;
-    char *tok = strtok_r(buf, ",", &saveptr);
-    while (tok) {
-        while (*tok == ' ') tok++;
-        char *end = tok + strlen(tok) - 1;
-        while (end > tok && *end == ' ') *end-- = '\0';
+    char lower[AUTH_MAX_EMAIL_LEN + 1];
+    uint64_t hash = email_key(email, lower);
+    RoleEntry *e = role_slot(*table, *cap, hash, lower);
+    if (e->hash == 0) {
+        e->hash = hash;
+        memcpy(e->email, lower, sizeof(lower));
+        (*count)++;
+    }
+    e->roles |= roles;
+    return 0;
+}
 
-        if (strcasecmp(tok, email) == 0)
-            return 1;
+unsigned auth_roles_for(const char *email) {
+    if (email == NULL || email[0] == '\0' || role_count == 0)
+        return 0;
+    char lower[AUTH_MAX_EMAIL_LEN + 1];
+    uint64_t hash = email_key(email, lower);
+    return role_slot(role_table, role_cap, hash, lower)->roles;
+}
+
+int auth_load_roles(void) {
+    RoleEntry *table = NULL;
+    size_t cap = 0;
+    unsigned count = 0;
+
+    /* ADMIN_EMAILS: comma separated, spaces around entries ignored */
+    const char *env = getenv("ADMIN_EMAILS");
+    for (const char *p = env; p != NULL && *p != '\0'; ) {
+        while (*p == ' ' || *p == ',') p++;
+        const char *start = p;
+        while (*p != '\0' && *p != ',') p++;
+        const char *end = p;
+        while (end > start && end[-1] == ' ') end--;
+
+        char email[AUTH_MAX_EMAIL_LEN + 1];
+        size_t len = (size_t)(end - start);
+        if (len == 0 || len > AUTH_MAX_EMAIL_LEN)
+            continue;
+        memcpy(email, start, len);
+        email[len] = '\0';
+        if (role_grant(&table, &cap, &count, email, ROLE_ADMIN) != 0)
+            goto fail;
+    }
 
-        tok = strtok_r(NULL, ",", &saveptr);
+    /* The user_roles table, by role name; names this build does not know
+       are skipped */
+    sqlite3 *db = db_get();
+    sqlite3_stmt *stmt = NULL;
+    if (db != NULL &&
+        sqlite3_prepare_v2(db, "SELECT email, role FROM user_roles", -1, &stmt, NULL) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *email = (const char *)sqlite3_column_text(stmt, 0);
+            const char *role = (const char *)sqlite3_column_text(stmt, 1);
+            if (email == NULL || role == NULL)
+                continue;
+            for (size_t i = 0; i < sizeof(ROLE_NAMES) / sizeof(ROLE_NAMES[0]); i++) {
+                if (strcasecmp(role, ROLE_NAMES[i].name) == 0 &&
+                    role_grant(&table, &cap, &count, email, ROLE_NAMES[i].bit) != 0) {
+                    sqlite3_finalize(stmt);
+                    goto fail;
+                }
+            }
+        }
+        sqlite3_finalize(stmt);
     }
 
+    free(role_table);
+    role_table = table;
+    role_cap = cap;
+    role_count = count;
+
+    /* Cached sessions carry roles too */
+    for (int i = 0; cache_ready && i < SESSION_CACHE_MAX; i++) {
+        if (cache[i].token[0] != '\0')
+            cache[i].user.roles = auth_roles_for(cache[i].user.email);
+    }
     return 0;
+
+fail:
+    free(table);
+    return -1;
+}
+
+int auth_is_admin(const char *email) {
+    return (auth_roles_for(email) & ROLE_ADMIN) != 0;
 }
 
 void auth_cleanup_expired(void) {
@@ -419,4 +961,33 @@ void auth_cleanup_expired(void) {
     sqlite3_exec(db,
         "DELETE FROM sessions WHERE expires_at < datetime('now')",
         NULL, NULL, NULL);
+
+    sqlite3_exec(db,
+        "DELETE FROM revoked_sessions WHERE expires_at < CAST(strftime('%s', 'now') AS INTEGER)",
+        NULL, NULL, NULL);
+    revoked_load();
+
+    long now = get_current_time();
+    for (int i = 0; cache_ready && i < SESSION_CACHE_MAX; i++) {
+        if (cache[i].token[0] != '\0' && now >= cache[i].expires_at) {
+            cache_remove(i);
+            cache_stats.invalidations++;
+        }
+    }
+}
+
+static long last_cleanup = 0;
+static long last_revoked_load = 0;
+
+void auth_tick(long now) {
+    if (last_cleanup == 0)
+        last_cleanup = last_revoked_load = now;
+    if (now - last_cleanup >= AUTH_CLEANUP_SECS) {
+        last_cleanup = last_revoked_load = now;
+        auth_cleanup_expired();
+    } else if (session_key_count > 0 && now - last_revoked_load >= REVOKED_RELOAD_SECS) {
+        /* Logouts on other servers reach this one within the interval */
+        last_revoked_load = now;
+        revoked_load();
+    }
 }
@@ -1,23 +1,48 @@
 #ifndef AUTH_H
 #define AUTH_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define AUTH_TOKEN_BYTES 32
 #define AUTH_TOKEN_EXPIRY_SECS 900     /* 15 minutes */
 #define SESSION_TOKEN_BYTES 32
-#define SESSION_EXPIRY_SECS 2592000    /* 30 days */
+#define SESSION_EXPIRY_SECS 2592000    /* 30 days since last used */
+#define SESSION_SLIDE_SECS 86400       /* how often use moves the expiry */
+#define AUTH_CLEANUP_SECS 3600         /* expired rows and cache entries */
+#define REVOKED_RELOAD_SECS 30         /* picks up other servers' logouts */
+#define SESSION_TOKEN_MAX 128          /* a cookie value, either format */
+#define SESSION_KEYS_MAX 8
+#define SESSION_KEY_MIN_BYTES 32
 #define AUTH_MAX_EMAIL_LEN 254         /* RFC 5321 */
 #define AUTH_CODE_LEN 6
 #define AUTH_MAX_CODE_ATTEMPTS 5
+#define SESSION_CACHE_SLOTS 4096       /* power of two */
+#define SESSION_CACHE_MAX 3072         /* cached sessions */
+#define SESSION_CACHE_TTL_SECS 300     /* rows changed behind our back show up by then */
 
 typedef struct {
     int64_t id;
     char email[256];
     char display_name[256];
+    unsigned roles;                 /* ROLE_* bits, set with the session */
+    int session_extended;           /* expiry moved: send the cookie again */
 } User;
 
-/* Returns 0 on success, -1 on failure for all functions below */
+#define ROLE_ADMIN (1u << 0)
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;        /* least recently used, to make room */
+    unsigned long invalidations;    /* logouts, expiry and stale entries */
+    unsigned entries;
+    size_t bytes;                   /* the fixed table, whatever is in it */
+    unsigned revoked;               /* signed sessions logged out early */
+} SessionCacheStats;
+
+/* Returns 0 on success, -1 on failure for all functions below.
+   session_out must hold SESSION_TOKEN_MAX bytes. */
 int auth_create_magic_link(const char *email, char *token_out, char *code_out);
 int auth_validate_magic_link(const char *token, char *session_out, int64_t *user_id_out);
 int auth_validate_code(const char *email, const char *code, char *session_out, int64_t *user_id_out);
@@ -25,6 +50,36 @@ int auth_get_user_from_session(const char *session_token, User *user_out);
 int auth_logout(const char *session_token);
 int auth_update_display_name(int64_t user_id, const char *display_name);
 void auth_cleanup_expired(void);
+
+/* Call once per event loop iteration; runs auth_cleanup_expired every
+   AUTH_CLEANUP_SECS and rereads revoked signed sessions every
+   REVOKED_RELOAD_SECS */
+void auth_tick(long now);
+
+/* Roles come from ADMIN_EMAILS and the user_roles table, read by
+   auth_load_roles into an in-memory set; call it at startup and again to
+   pick up changes. Sessions resolve with User.roles already set. Returns
+   -1, keeping the old set, if memory runs out. */
+int auth_load_roles(void);
+unsigned auth_roles_for(const char *email);
 int auth_is_admin(const char *email);
 
+/* Sessions are rows in the sessions table unless signing keys are set:
+   then a session is a cookie naming the user and its expiry, signed with
+   HMAC-SHA256, that any server with the key can check without I/O. spec
+   is "id:hexsecret,..." with secrets of at least SESSION_KEY_MIN_BYTES;
+   the first key signs and the others are still accepted, for rotation.
+   NULL or "" goes back to rows. Returns -1, changing nothing, if spec
+   does not parse. */
+int auth_configure_session_keys(const char *spec);
+
+/* Checks a signed session's MAC, expiry and revocation. The revocation
+   list is kept in memory and reread from the database by auth_tick. */
+int auth_verify_signed_session(const char *token, int64_t *user_id_out, long *expires_out);
+
+/* auth_get_user_from_session answers from an LRU cache of recent sessions,
+   so a page view rarely reaches SQLite. Event loop thread only. */
+void auth_session_cache_flush(void);
+void auth_session_cache_stats(SessionCacheStats *out);
+
 #endif /* AUTH_H */
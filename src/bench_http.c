@@ -0,0 +1,616 @@
+/*
+ * bench_http.c - HTTP Load Generator
+ *
+ * Replays the 09:00 puzzle release against a running server: synthetic
+ * users arrive in a burst that decays over the release window, log in or
+ * reuse a session, open the puzzle, guess (mostly wrong first), sometimes
+ * take a hint, solve it and then keep refreshing their league table.
+ * Reports throughput and p50/p99/p999 per route, and exits 1 when a
+ * latency budget is exceeded or requests fail.
+ *
+ * Usage:
+ *   bench_http --seed DB [--users N]     prepare a fresh database
+ *   bench_http --db DB [options]         run against a server using DB
+ *
+ * The run reads login codes and today's puzzle from the same database the
+ * server uses, so both must be on this machine. See scripts/bench_http.sh.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mongoose.h"
+#include "db.h"
+#include "puzzle.h"
+
+#define USERS_PER_LEAGUE 25
+#define REQUEST_TIMEOUT_MS 10000
+#define ANSWER "release"
+
+typedef enum {
+    R_LOGIN_PAGE,
+    R_LOGIN,
+    R_AUTH,
+    R_PUZZLE,
+    R_GUESS,
+    R_HINT,
+    R_RESULT,
+    R_LEAGUE,
+    R_COUNT
+} BenchRoute;
+
+typedef struct {
+    const char *name;
+    double p99_ms;          /* budgets */
+    double p999_ms;
+} RouteInfo;
+
+static const RouteInfo ROUTE_INFO[R_COUNT] = {
+    { "GET /login",           25, 100 },
+    { "POST /login",          50, 200 },
+    { "POST /auth",           50, 200 },
+    { "GET /puzzle",          25, 100 },
+    { "POST /puzzle/attempt", 50, 200 },
+    { "POST /puzzle/hint",    50, 200 },
+    { "GET /puzzle/result",   50, 200 },
+    { "GET /leagues/{id}",   100, 400 },
+};
+
+typedef struct {
+    unsigned *us;           /* latency of each successful request */
+    size_t count, cap;
+    unsigned long errors;
+} RouteSamples;
+
+/* One synthetic user walks these steps in order; wrong guesses, the
+   hint and league refreshes repeat or are skipped per user */
+typedef enum {
+    STEP_LOGIN_PAGE,
+    STEP_LOGIN,
+    STEP_AUTH,
+    STEP_PUZZLE,
+    STEP_WRONG_GUESS,
+    STEP_HINT,
+    STEP_GUESS,
+    STEP_RESULT,
+    STEP_LEAGUE,
+    STEP_DONE
+} Step;
+
+typedef struct {
+    int index;
+    Step step;
+    int wrong_guesses;
+    int wants_hint;
+    int refreshes;
+    uint64_t ready_ms;      /* when the next request may be sent */
+    uint64_t sent_ms;
+    double sent_s;
+    int in_flight;
+    BenchRoute route;
+    char cookie[128];
+    struct mg_connection *c;
+} VUser;
+
+static struct {
+    const char *url;
+    const char *db_path;
+    int users;
+    int duration_s;         /* release window that arrivals spread over */
+    int concurrency;        /* users with a request or think time pending */
+    int think_ms;           /* mean pause between a user's requests */
+    int login_pct;          /* users who log in rather than reuse a session */
+    double budget_scale;
+} opt = { "http://127.0.0.1:8080", NULL, 500, 20, 200, 300, 30, 1.0 };
+
+static RouteSamples samples[R_COUNT];
+static VUser *vusers;
+static char host[128];
+static int64_t puzzle_id;
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+/* xorshift64*: reproducible across runs and platforms */
+static double rnd(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ULL) >> 11) / (double)(1ULL << 53);
+}
+
+/* Exponentially distributed with the given mean */
+static double rnd_exp(double mean) {
+    return -mean * log(1.0 - rnd());
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void add_sample(BenchRoute r, double seconds) {
+    RouteSamples *s = &samples[r];
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->us = realloc(s->us, s->cap * sizeof(unsigned));
+    }
+    s->us[s->count++] = (unsigned)(seconds * 1e6);
+}
+
+static void session_token(int index, char *out, size_t size) {
+    snprintf(out, size, "%056x%08x", 0, index + 1);
+}
+
+/* ---------------------------------------------------------------------
+ * Seeding
+ * --------------------------------------------------------------------- */
+
+static int seed(const char *path) {
+    remove(path);
+    if (db_init(path) != 0)
+        return -1;
+    sqlite3 *db = db_get();
+
+    /* Today's puzzle as the server sees it: the date flips at 09:00 UTC */
+    Puzzle p = {0};
+    puzzle_current_date(p.puzzle_date, sizeof(p.puzzle_date));
+    snprintf(p.puzzle_type, sizeof(p.puzzle_type), "word");
+    snprintf(p.puzzle_name, sizeof(p.puzzle_name), "Release Day");
+    snprintf(p.question, sizeof(p.question), "What happens at 09:00?");
+    snprintf(p.answer, sizeof(p.answer), ANSWER);
+    snprintf(p.hint, sizeof(p.hint), "Starts with R");
+    if (puzzle_create(&p) != 0)
+        return -1;
+
+    sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+    sqlite3_stmt *user = NULL, *session = NULL, *league = NULL, *member = NULL;
+    sqlite3_prepare_v2(db, "INSERT INTO users (id, email, display_name) VALUES (?, ?, ?)",
+                       -1, &user, NULL);
+    sqlite3_prepare_v2(db, "INSERT INTO sessions (user_id, token, expires_at) "
+                           "VALUES (?, ?, datetime('now', '+1 day'))", -1, &session, NULL);
+    sqlite3_prepare_v2(db, "INSERT INTO leagues (id, name, invite_code, creator_id) "
+                           "VALUES (?, ?, ?, ?)", -1, &league, NULL);
+    sqlite3_prepare_v2(db, "INSERT INTO league_members (league_id, user_id) VALUES (?, ?)",
+                       -1, &member, NULL);
+
+    int rc = 0;
+    for (int i = 0; i < opt.users && rc == 0; i++) {
+        char email[64], name[32], token[65];
+        int64_t id = i + 1, league_id = i / USERS_PER_LEAGUE + 1;
+        snprintf(email, sizeof(email), "bench%d@example.com", i);
+        snprintf(name, sizeof(name), "Bench %d", i);
+        session_token(i, token, sizeof(token));
+
+        sqlite3_bind_int64(user, 1, id);
+        sqlite3_bind_text(user, 2, email, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(user, 3, name, -1, SQLITE_TRANSIENT);
+        rc |= sqlite3_step(user) != SQLITE_DONE;
+        sqlite3_reset(user);
+
+        sqlite3_bind_int64(session, 1, id);
+        sqlite3_bind_text(session, 2, token, -1, SQLITE_TRANSIENT);
+        rc |= sqlite3_step(session) != SQLITE_DONE;
+        sqlite3_reset(session);
+
+        if (i % USERS_PER_LEAGUE == 0) {
+            char lname[32], code[16];
+            snprintf(lname, sizeof(lname), "League %lld", (long long)league_id);
+            snprintf(code, sizeof(code), "B%07lld", (long long)league_id);
+            sqlite3_bind_int64(league, 1, league_id);
+            sqlite3_bind_text(league, 2, lname, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(league, 3, code, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(league, 4, id);
+            rc |= sqlite3_step(league) != SQLITE_DONE;
+            sqlite3_reset(league);
+        }
+
+        sqlite3_bind_int64(member, 1, league_id);
+        sqlite3_bind_int64(member, 2, id);
+        rc |= sqlite3_step(member) != SQLITE_DONE;
+        sqlite3_reset(member);
+    }
+    sqlite3_finalize(user);
+    sqlite3_finalize(session);
+    sqlite3_finalize(league);
+    sqlite3_finalize(member);
+    sqlite3_exec(db, rc == 0 ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+    db_close();
+    return rc == 0 ? 0 : -1;
+}
+
+/* The code the server would have emailed */
+static int login_code(int index, char *out, size_t size) {
+    char email[64];
+    snprintf(email, sizeof(email), "bench%d@example.com", index);
+
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db_get(),
+            "SELECT short_code FROM auth_tokens WHERE email = ? AND used = 0 "
+            "ORDER BY id DESC LIMIT 1", -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    sqlite3_bind_text(stmt, 1, email, -1, SQLITE_TRANSIENT);
+
+    int rc = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0) != NULL) {
+        snprintf(out, size, "%s", (const char *)sqlite3_column_text(stmt, 0));
+        rc = 0;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+/* ---------------------------------------------------------------------
+ * Traffic
+ * --------------------------------------------------------------------- */
+
+static void client_handler(struct mg_connection *c, int ev, void *ev_data);
+
+static BenchRoute step_route(Step step) {
+    switch (step) {
+        case STEP_LOGIN_PAGE:  return R_LOGIN_PAGE;
+        case STEP_LOGIN:       return R_LOGIN;
+        case STEP_AUTH:        return R_AUTH;
+        case STEP_PUZZLE:      return R_PUZZLE;
+        case STEP_WRONG_GUESS:
+        case STEP_GUESS:       return R_GUESS;
+        case STEP_HINT:        return R_HINT;
+        case STEP_RESULT:      return R_RESULT;
+        default:               return R_LEAGUE;
+    }
+}
+
+static void send_request(VUser *u) {
+    char path[64], body[128] = "";
+    const char *method = "GET";
+    int htmx = 0;
+
+    switch (u->step) {
+        case STEP_LOGIN_PAGE:
+            snprintf(path, sizeof(path), "/login");
+            break;
+        case STEP_LOGIN:
+            method = "POST";
+            snprintf(path, sizeof(path), "/login");
+            snprintf(body, sizeof(body), "email=bench%d%%40example.com", u->index);
+            break;
+        case STEP_AUTH: {
+            char code[16] = "";
+            login_code(u->index, code, sizeof(code));
+            method = "POST";
+            snprintf(path, sizeof(path), "/auth");
+            snprintf(body, sizeof(body), "email=bench%d%%40example.com&code=%s", u->index, code);
+            break;
+        }
+        case STEP_PUZZLE:
+            snprintf(path, sizeof(path), "/puzzle");
+            break;
+        case STEP_WRONG_GUESS:
+        case STEP_GUESS:
+            method = "POST";
+            htmx = 1;
+            snprintf(path, sizeof(path), "/puzzle/attempt");
+            snprintf(body, sizeof(body), "puzzle_id=%lld&guess=%s", (long long)puzzle_id,
+                     u->step == STEP_GUESS ? ANSWER : "wrong");
+            break;
+        case STEP_HINT:
+            method = "POST";
+            htmx = 1;
+            snprintf(path, sizeof(path), "/puzzle/hint");
+            snprintf(body, sizeof(body), "puzzle_id=0");
+            break;
+        case STEP_RESULT:
+            snprintf(path, sizeof(path), "/puzzle/result");
+            break;
+        default:
+            snprintf(path, sizeof(path), "/leagues/%d", u->index / USERS_PER_LEAGUE + 1);
+            break;
+    }
+
+    /* Distinct client addresses keep logins clear of the per-IP limit */
+    mg_printf(u->c,
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Accept-Encoding: gzip\r\n"
+        "X-Forwarded-For: 10.%d.%d.%d\r\n"
+        "%s%s%s"
+        "%s"
+        "Content-Length: %d\r\n\r\n%s",
+        method, path, host,
+        (u->index >> 16) & 255, (u->index >> 8) & 255, u->index & 255,
+        u->cookie[0] ? "Cookie: session=" : "", u->cookie, u->cookie[0] ? "\r\n" : "",
+        htmx ? "HX-Request: true\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+             : (body[0] ? "Content-Type: application/x-www-form-urlencoded\r\n" : ""),
+        (int)strlen(body), body);
+
+    u->in_flight = 1;
+    u->sent_ms = mg_millis();
+    u->sent_s = now_s();
+}
+
+static void start_request(struct mg_mgr *mgr, VUser *u) {
+    u->route = step_route(u->step);
+    if (u->c == NULL) {
+        u->c = mg_http_connect(mgr, opt.url, client_handler, u);
+        if (u->c == NULL) {
+            samples[u->route].errors++;
+            u->step = STEP_DONE;
+        }
+        u->in_flight = 1;           /* sent once connected */
+        u->sent_ms = mg_millis();
+        return;
+    }
+    send_request(u);
+}
+
+static Step next_step(VUser *u) {
+    switch (u->step) {
+        case STEP_LOGIN_PAGE: return STEP_LOGIN;
+        case STEP_LOGIN:      return STEP_AUTH;
+        case STEP_AUTH:       return STEP_PUZZLE;
+        case STEP_PUZZLE:
+            return u->wrong_guesses > 0 ? STEP_WRONG_GUESS
+                 : u->wants_hint ? STEP_HINT : STEP_GUESS;
+        case STEP_WRONG_GUESS:
+            if (--u->wrong_guesses > 0)
+                return STEP_WRONG_GUESS;
+            return u->wants_hint ? STEP_HINT : STEP_GUESS;
+        case STEP_HINT:       return STEP_GUESS;
+        case STEP_GUESS:      return STEP_RESULT;
+        case STEP_RESULT:     return u->refreshes > 0 ? STEP_LEAGUE : STEP_DONE;
+        case STEP_LEAGUE:     return --u->refreshes > 0 ? STEP_LEAGUE : STEP_DONE;
+        default:              return STEP_DONE;
+    }
+}
+
+static void handle_response(VUser *u, struct mg_http_message *hm) {
+    int status = mg_http_status(hm);
+    double elapsed = now_s() - u->sent_s;
+    u->in_flight = 0;
+
+    /* Redirects are the expected answer to a login and to /puzzle once solved */
+    if (status >= 200 && status < 400)
+        add_sample(u->route, elapsed);
+    else
+        samples[u->route].errors++;
+
+    if (u->step == STEP_AUTH) {
+        struct mg_str *set_cookie = mg_http_get_header(hm, "Set-Cookie");
+        if (set_cookie == NULL || set_cookie->len <= 8 || status != 302 ||
+            memcmp(set_cookie->buf, "session=", 8) != 0) {
+            samples[u->route].errors += status == 302;
+            u->step = STEP_DONE;
+            return;
+        }
+        size_t n = 8;
+        while (n < set_cookie->len && set_cookie->buf[n] != ';')
+            n++;
+        snprintf(u->cookie, sizeof(u->cookie), "%.*s", (int)(n - 8), set_cookie->buf + 8);
+    }
+
+    u->step = status >= 400 ? STEP_DONE : next_step(u);
+    u->ready_ms = mg_millis() + (uint64_t)rnd_exp(opt.think_ms);
+}
+
+static void client_handler(struct mg_connection *c, int ev, void *ev_data) {
+    VUser *u = (VUser *)c->fn_data;
+    if (ev == MG_EV_CONNECT) {
+        send_request(u);
+    } else if (ev == MG_EV_HTTP_MSG) {
+        handle_response(u, (struct mg_http_message *)ev_data);
+    } else if (ev == MG_EV_ERROR) {
+        if (u->in_flight)
+            samples[u->route].errors++;
+        u->in_flight = 0;
+        u->step = STEP_DONE;
+    } else if (ev == MG_EV_CLOSE) {
+        if (u->c == c)
+            u->c = NULL;
+        if (u->in_flight) {
+            samples[u->route].errors++;
+            u->in_flight = 0;
+            u->step = STEP_DONE;
+        }
+    }
+}
+
+static void init_user(VUser *u, int index, uint64_t start_ms) {
+    memset(u, 0, sizeof(*u));
+    u->index = index;
+
+    /* Arrivals peak at the release and decay over the window */
+    double offset = rnd_exp(opt.duration_s * 1000.0 / 5);
+    if (offset > opt.duration_s * 1000.0)
+        offset = rnd() * opt.duration_s * 1000.0;
+    u->ready_ms = start_ms + (uint64_t)offset;
+
+    if (rnd() * 100 < opt.login_pct) {
+        u->step = STEP_LOGIN_PAGE;
+    } else {
+        u->step = STEP_PUZZLE;
+        session_token(index, u->cookie, sizeof(u->cookie));
+    }
+
+    /* Most people miss at least once; some keep going for a while */
+    u->wrong_guesses = 0;
+    if (rnd() < 0.8) {
+        u->wrong_guesses = 1;
+        while (u->wrong_guesses < 5 && rnd() < 0.5)
+            u->wrong_guesses++;
+    }
+    u->wants_hint = rnd() < 0.25;
+    u->refreshes = 1 + (int)(rnd() * 5);
+}
+
+/* ---------------------------------------------------------------------
+ * Report
+ * --------------------------------------------------------------------- */
+
+static int cmp_unsigned(const void *a, const void *b) {
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(const RouteSamples *s, double p) {
+    if (s->count == 0)
+        return 0;
+    size_t i = (size_t)(p * s->count);
+    if (i >= s->count)
+        i = s->count - 1;
+    return s->us[i] / 1000.0;
+}
+
+static int report(double elapsed) {
+    unsigned long total = 0, errors = 0;
+    int over_budget = 0;
+
+    printf("\n%-22s %8s %7s %9s %9s %9s  %s\n",
+           "Route", "Requests", "Errors", "p50 ms", "p99 ms", "p999 ms", "Budget p99/p999");
+    for (int r = 0; r < R_COUNT; r++) {
+        RouteSamples *s = &samples[r];
+        qsort(s->us, s->count, sizeof(unsigned), cmp_unsigned);
+        double p99 = percentile_ms(s, 0.99), p999 = percentile_ms(s, 0.999);
+        double b99 = ROUTE_INFO[r].p99_ms * opt.budget_scale;
+        double b999 = ROUTE_INFO[r].p999_ms * opt.budget_scale;
+        int over = p99 > b99 || p999 > b999;
+        over_budget |= over;
+        total += s->count + s->errors;
+        errors += s->errors;
+
+        printf("%-22s %8zu %7lu %9.2f %9.2f %9.2f  %.0f/%.0f %s\n",
+               ROUTE_INFO[r].name, s->count, s->errors, percentile_ms(s, 0.5),
+               p99, p999, b99, b999, over ? "OVER" : "ok");
+    }
+
+    printf("\n%lu requests in %.1f s: %.0f req/s, %lu errors\n",
+           total, elapsed, total / elapsed, errors);
+
+    /* More than 1 in 1000 failing is a failure in itself */
+    int failed = over_budget || errors * 1000 > total;
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
+
+/* ---------------------------------------------------------------------
+ * Main
+ * --------------------------------------------------------------------- */
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: bench_http --seed DB [--users N]\n"
+        "       bench_http --db DB [--url URL] [--users N] [--duration S]\n"
+        "                  [--concurrency N] [--think-ms MS] [--login-pct P]\n"
+        "                  [--budget-scale F]\n");
+}
+
+int main(int argc, char **argv) {
+    const char *seed_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (v == NULL) { usage(); return 2; }
+        if (strcmp(a, "--seed") == 0) seed_path = v;
+        else if (strcmp(a, "--db") == 0) opt.db_path = v;
+        else if (strcmp(a, "--url") == 0) opt.url = v;
+        else if (strcmp(a, "--users") == 0) opt.users = atoi(v);
+        else if (strcmp(a, "--duration") == 0) opt.duration_s = atoi(v);
+        else if (strcmp(a, "--concurrency") == 0) opt.concurrency = atoi(v);
+        else if (strcmp(a, "--think-ms") == 0) opt.think_ms = atoi(v);
+        else if (strcmp(a, "--login-pct") == 0) opt.login_pct = atoi(v);
+        else if (strcmp(a, "--budget-scale") == 0) opt.budget_scale = atof(v);
+        else { usage(); return 2; }
+        i++;
+    }
+    if (opt.users <= 0 || opt.duration_s <= 0 || opt.concurrency <= 0) {
+        usage();
+        return 2;
+    }
+
+    if (seed_path != NULL) {
+        if (seed(seed_path) != 0) {
+            fprintf(stderr, "Failed to seed %s\n", seed_path);
+            return 1;
+        }
+        printf("Seeded %s: %d users in %d leagues\n", seed_path, opt.users,
+               (opt.users + USERS_PER_LEAGUE - 1) / USERS_PER_LEAGUE);
+        return 0;
+    }
+
+    if (opt.db_path == NULL || db_init(opt.db_path) != 0) {
+        usage();
+        return 2;
+    }
+    Puzzle today;
+    if (puzzle_get_today(&today) != 0) {
+        fprintf(stderr, "No puzzle for today in %s (run --seed first)\n", opt.db_path);
+        return 1;
+    }
+    puzzle_id = today.id;
+
+    printf("Release at %s: %d users over %d s, %d concurrent, %d ms think time, %d%% logging in\n",
+           opt.url, opt.users, opt.duration_s, opt.concurrency, opt.think_ms, opt.login_pct);
+
+    struct mg_str h = mg_url_host(opt.url);
+    snprintf(host, sizeof(host), "%.*s", (int)h.len, h.buf);
+
+    struct mg_mgr mgr;
+    mg_mgr_init(&mgr);
+    mg_log_set(MG_LL_NONE);
+
+    uint64_t start_ms = mg_millis();
+    double start = now_s();
+    vusers = calloc((size_t)opt.users, sizeof(VUser));
+    for (int i = 0; i < opt.users; i++)
+        init_user(&vusers[i], i, start_ms);
+
+    int remaining = opt.users;
+    while (remaining > 0) {
+        mg_mgr_poll(&mgr, 1);
+        uint64_t now = mg_millis();
+
+        int active = 0;
+        for (int i = 0; i < opt.users; i++)
+            active += vusers[i].c != NULL;
+
+        remaining = 0;
+        for (int i = 0; i < opt.users; i++) {
+            VUser *u = &vusers[i];
+            if (u->step == STEP_DONE) {
+                if (u->c != NULL && !u->in_flight) {
+                    u->c->is_closing = 1;
+                    u->c = NULL;
+                }
+                continue;
+            }
+            remaining++;
+
+            if (u->in_flight) {
+                if (now - u->sent_ms > REQUEST_TIMEOUT_MS) {
+                    samples[u->route].errors++;
+                    u->in_flight = 0;
+                    u->step = STEP_DONE;
+                    if (u->c != NULL)
+                        u->c->is_closing = 1;
+                }
+                continue;
+            }
+            if (now < u->ready_ms)
+                continue;
+            if (u->c == NULL && active >= opt.concurrency)
+                continue;
+            if (u->c == NULL)
+                active++;
+            start_request(&mgr, u);
+        }
+    }
+
+    double elapsed = now_s() - start;
+    mg_mgr_free(&mgr);
+    db_close();
+
+    int rc = report(elapsed);
+    for (int r = 0; r < R_COUNT; r++)
+        free(samples[r].us);
+    free(vusers);
+    return rc;
+}
@@ -0,0 +1,299 @@
+/*
+ * bench_micro.c - Microbenchmarks
+ *
+ * Times the CPU-bound work done on every request: answer normalization and
+ * matching, puzzle question parsing, escaping, scoring and cookie parsing,
+ * the puzzle page rendered with printf formats, from the compiled template
+ * and as a boosted navigation's body, an API leaderboard written as JSON,
+ * rate limit checks during a flood of new IPs, checking a signed session
+ * cookie and making a session token, from the ChaCha20 pool and as it was
+ * made by reading /dev/urandom. None of these touch the database. Run with `make bench`; set BENCH_JSON
+ * to a path to keep the results for comparison.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "test.h"
+#include "puzzle.h"
+#include "util.h"
+#include "mongoose.h"
+#include "template.h"
+#include "templates_data.h"
+#include "json.h"
+#include "ratelimit.h"
+#include "auth.h"
+#include "sha256.h"
+
+/* Inputs are globals so the compiler cannot fold the calls away */
+static const char *guess_plain = "  The Rolling STONES  ";
+static const char *answer_plain = "the rolling stones";
+static const char *answer_alternatives = "colour|color|hue";
+static const char *guess_unordered = "stones rolling the";
+static const char *answer_unordered = "~the rolling stones";
+static const char *ladder = "Dawn, ____, Noon, ____, Dusk, ____, Midnight";
+static const char *choice = "Which planet has the most moons?|Mercury|Jupiter|Saturn|Neptune";
+static const char *escape_input =
+    "<p class=\"hint\">Tom & Jerry's \"Cat\" <em>vs</em> Mouse</p> and some plain text after it";
+static const char *cookie_header =
+    "theme=dark; _ga=GA1.2.1234567890.1700000000; "
+    "session=0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef; lang=en";
+static time_t solve_time;
+
+/* Puzzle page inputs, sized like a real day */
+static char page_css[256];
+static const char *page_nav =
+    "    <a href=\"/puzzle\">Today</a>\n    <a href=\"/archive\">Archive</a>\n"
+    "    <a href=\"/leagues\">Leagues</a>\n    <a href=\"/logout\">Log out</a>\n";
+static const char *page_question =
+    "<div class=\"puzzle-box\"><p>Which planet has the most moons?</p></div>\n";
+static const char *page_inputs =
+    "  <label><input type=\"radio\" name=\"answer\" value=\"Mercury\"> Mercury</label><br>\n"
+    "  <label><input type=\"radio\" name=\"answer\" value=\"Jupiter\"> Jupiter</label><br>\n"
+    "  <label><input type=\"radio\" name=\"answer\" value=\"Saturn\"> Saturn</label><br>\n"
+    "  <label><input type=\"radio\" name=\"answer\" value=\"Neptune\"> Neptune</label><br>\n";
+static struct mg_iobuf page_out;
+
+/* More client IPs than the rate limiter has buckets */
+#define FLOOD_IPS 100000
+static char flood_ips[FLOOD_IPS][16];
+static TemplateRender page_render;
+static char signed_session[SESSION_TOKEN_MAX];
+
+BENCH(bench_normalize_answer) {
+    char buf[64];
+    strcpy(buf, guess_plain);
+    BENCH_KEEP(puzzle_normalize_answer(buf)[0]);
+}
+
+BENCH(bench_answer_exact) {
+    BENCH_KEEP(puzzle_answer_matches(guess_plain, answer_plain));
+}
+
+BENCH(bench_answer_alternatives) {
+    BENCH_KEEP(puzzle_answer_matches("hue", answer_alternatives));
+}
+
+BENCH(bench_answer_unordered) {
+    BENCH_KEEP(puzzle_answer_matches(guess_unordered, answer_unordered));
+}
+
+BENCH(bench_parse_ladder) {
+    LadderStep steps[MAX_LADDER_STEPS];
+    BENCH_KEEP(puzzle_parse_ladder(ladder, steps, MAX_LADDER_STEPS));
+}
+
+BENCH(bench_parse_choice) {
+    ChoicePuzzle cp;
+    BENCH_KEEP(puzzle_parse_choice(choice, &cp));
+}
+
+BENCH(bench_html_escape) {
+    char out[512];
+    BENCH_KEEP(html_escape(escape_input, out, sizeof(out)));
+}
+
+BENCH(bench_json_escape) {
+    char out[512];
+    BENCH_KEEP(json_escape(escape_input, out, sizeof(out)));
+}
+
+BENCH(bench_calculate_score) {
+    BENCH_KEEP(puzzle_calculate_score(solve_time, "2026-01-26", 2, 1));
+}
+
+BENCH(bench_session_cookie) {
+    char token[128];
+    BENCH_KEEP(cookie_value(cookie_header, strlen(cookie_header), "session",
+                            token, sizeof(token)));
+}
+
+/* The puzzle page as handle_puzzle_page wrote it before templates/ */
+BENCH(bench_page_printf) {
+    char safe_name[256];
+    html_escape("Moons & Rings", safe_name, sizeof(safe_name));
+    page_out.len = 0;
+    mg_xprintf(mg_pfn_iobuf, &page_out,
+        "<!DOCTYPE html>\n<html><head>\n<title>#%d. %s</title>\n%s"
+        "<script src=\"/htmx.min.js\" defer></script>\n</head>\n<body>\n"
+        "<div class=\"page-header\">\n"
+        "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>#%d. %s</div>\n"
+        "  <nav class=\"nav\">\n%s  </nav>\n  <hr class=\"nav-line\">\n</div>\n"
+        "<div class=\"content-meta\">\n  %s<br>\n"
+        "  Score: 100 pts base, -5 per wrong guess%s\n%s</div>\n",
+        412, safe_name, page_css, 412, safe_name, page_nav, "2026-01-26",
+        ", -10 for hint", "");
+    mg_xprintf(mg_pfn_iobuf, &page_out, "%s", page_question);
+    mg_xprintf(mg_pfn_iobuf, &page_out, "<div id=\"hint-area\">%s%s%s</div>\n", "", "", "");
+    mg_xprintf(mg_pfn_iobuf, &page_out,
+        "<form action=\"/puzzle/attempt\" method=\"POST\" hx-post=\"/puzzle/attempt\" "
+        "hx-target=\"#feedback\" hx-swap=\"innerHTML\">\n"
+        "  <input type=\"hidden\" name=\"puzzle_id\" value=\"%lld\">\n", 412LL);
+    mg_xprintf(mg_pfn_iobuf, &page_out, "%s", page_inputs);
+    mg_xprintf(mg_pfn_iobuf, &page_out,
+        "  <button data-testid=\"submit-button\" type=\"submit\" class=\"action-btn\">\n"
+        "    <span class=\"gt\">&gt;</span>Submit\n  </button>\n</form>\n"
+        "<div id=\"feedback\" style=\"margin-top:15px;\">%s</div>\n</body></html>\n", "");
+    BENCH_KEEP(page_out.len);
+}
+
+/* The same page from templates/puzzle_page.html, gathered into the
+   buffer: the whole document, or the body of a boosted navigation */
+static size_t render_page(int boosted) {
+    char head[8192];
+    if (boosted)
+        snprintf(head, sizeof(head), "<title>#%d. %s</title>\n", 412, "Moons &amp; Rings");
+    else
+        snprintf(head, sizeof(head),
+                 "<!DOCTYPE html>\n<html><head>\n<title>#%d. %s</title>\n%s"
+                 "<script src=\"/htmx.min.js\" defer></script>\n</head>\n"
+                 "<body hx-boost=\"true\">\n",
+                 412, "Moons &amp; Rings", page_css);
+
+    TemplateRender *r = &page_render;
+    tpl_begin(r, &TPL_PUZZLE_PAGE);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HEAD, head);
+    tpl_set_int(r, TPL_PUZZLE_PAGE_NUMBER, 412);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_NAME, "Moons & Rings");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_NAV, page_nav);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_DATE, "2026-01-26");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HINT_COST, ", -10 for hint");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_LOGIN_PROMPT, "");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_QUESTION, page_question);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HINT_AREA, "");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HINT_FORM, "");
+    tpl_set_int(r, TPL_PUZZLE_PAGE_PUZZLE_ID, 412);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_INPUTS, page_inputs);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_FEEDBACK, "");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_TAIL, boosted ? "" : "</body></html>\n");
+    tpl_render(r);
+    page_out.len = 0;
+    for (int i = 0; i < r->iovcnt; i++)
+        mg_iobuf_add(&page_out, page_out.len, r->iov[i].iov_base, r->iov[i].iov_len);
+    return page_out.len;
+}
+
+BENCH(bench_page_template) {
+    BENCH_KEEP(render_page(0));
+}
+
+BENCH(bench_page_boosted) {
+    BENCH_KEEP(render_page(1));
+}
+
+/* A 40-row league leaderboard as /api/v1/leagues/{id} writes it */
+BENCH(bench_json_leaderboard) {
+    static char buf[8192];
+    JsonWriter w;
+    json_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_int(&w, "id", 1);
+    json_string(&w, "name", "Office");
+    json_string(&w, "view", "weekly");
+    json_array_begin(&w, "rows");
+    for (int i = 0; i < 40; i++) {
+        json_object_begin(&w, NULL);
+        json_int(&w, "rank", i + 1);
+        json_int(&w, "user_id", 1000 + i);
+        json_string(&w, "name", "Ada \"the\" Lovelace");
+        json_int(&w, "score", 700 - i * 7);
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+    size_t len;
+    BENCH_KEEP(json_finish(&w, &len) == 0 ? len : 0);
+}
+
+/* Every call is a new client, so every call evicts */
+BENCH(bench_ratelimit_flood) {
+    static unsigned n = 0;
+    BENCH_KEEP(ratelimit_take(RATELIMIT_LOGIN, flood_ips[n++ % FLOOD_IPS], 1000000, NULL));
+}
+
+/* What a request costs with SESSION_KEYS set and a cold session cache */
+BENCH(bench_signed_session) {
+    int64_t user_id;
+    long expires;
+    BENCH_KEEP(auth_verify_signed_session(signed_session, &user_id, &expires));
+}
+
+/* A session token as generate_token_hex made it before the random pool */
+BENCH(bench_token_urandom) {
+    unsigned char bytes[32];
+    char token[65];
+    FILE *f = fopen("/dev/urandom", "rb");
+    size_t n = f ? fread(bytes, 1, sizeof(bytes), f) : 0;
+    if (f) fclose(f);
+    for (size_t i = 0; i < n; i++)
+        sprintf(token + i * 2, "%02x", bytes[i]);
+    BENCH_KEEP(token[0]);
+}
+
+BENCH(bench_token_pool) {
+    char token[65];
+    BENCH_KEEP(generate_token_hex(token, sizeof(token), 32));
+}
+
+int main() {
+    printf("Microbenchmarks\n");
+    printf("===============\n\n");
+
+    /* 09:14 UTC on release day */
+    struct tm tm = {0};
+    tm.tm_year = 2026 - 1900;
+    tm.tm_mon = 0;
+    tm.tm_mday = 26;
+    tm.tm_hour = 9;
+    tm.tm_min = 14;
+    solve_time = timegm(&tm);
+
+    /* The stylesheet link and viewport tag from TERMINAL_CSS */
+    snprintf(page_css, sizeof(page_css),
+             "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">\n"
+             "<link rel=\"stylesheet\" href=\"/static/style.0123456789abcdef.css\">\n");
+
+    for (int i = 0; i < FLOOD_IPS; i++)
+        snprintf(flood_ips[i], sizeof(flood_ips[i]), "10.%d.%d.%d",
+                 i >> 16, (i >> 8) & 255, i & 255);
+
+    /* A session as auth.c signs it, under a key given like SESSION_KEYS */
+    const char *secret = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f";
+    unsigned char key_bytes[32], mac[SHA256_BYTES];
+    char spec[80];
+    for (int i = 0; i < 32; i++)
+        sscanf(secret + i * 2, "%2hhx", &key_bytes[i]);
+    snprintf(spec, sizeof(spec), "1:%s", secret);
+    auth_configure_session_keys(spec);
+    HmacKey key;
+    hmac_sha256_key(&key, key_bytes, sizeof(key_bytes));
+    int n = snprintf(signed_session, sizeof(signed_session), "s1.1.42.%ld.0123456789abcdef",
+                     (long)time(NULL) + SESSION_EXPIRY_SECS);
+    hmac_sha256(&key, signed_session, (size_t)n, mac);
+    signed_session[n++] = '.';
+    for (int i = 0; i < SHA256_BYTES; i++)
+        n += sprintf(signed_session + n, "%02x", mac[i]);
+
+    BENCH_RUN(bench_normalize_answer, 200000);
+    BENCH_RUN(bench_answer_exact, 200000);
+    BENCH_RUN(bench_answer_alternatives, 200000);
+    BENCH_RUN(bench_answer_unordered, 100000);
+    BENCH_RUN(bench_parse_ladder, 100000);
+    BENCH_RUN(bench_parse_choice, 100000);
+    BENCH_RUN(bench_html_escape, 200000);
+    BENCH_RUN(bench_json_escape, 200000);
+    BENCH_RUN(bench_calculate_score, 100000);
+    BENCH_RUN(bench_session_cookie, 200000);
+    BENCH_RUN(bench_page_printf, 20000);
+    BENCH_RUN(bench_page_template, 20000);
+    BENCH_RUN(bench_page_boosted, 20000);
+    BENCH_RUN(bench_json_leaderboard, 20000);
+    BENCH_RUN(bench_ratelimit_flood, 200000);
+    BENCH_RUN(bench_signed_session, 200000);
+    BENCH_RUN(bench_token_urandom, 20000);
+    BENCH_RUN(bench_token_pool, 200000);
+
+    mg_iobuf_free(&page_out);
+
+    return bench_summary();
+}
@@ -0,0 +1,153 @@
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "compress.h"
+
+static int gzip_level = COMPRESS_DEFAULT_LEVEL;
+static size_t gzip_min_size = COMPRESS_DEFAULT_MIN_SIZE;
+
+static z_stream zs;
+static int zs_ready = 0;
+static unsigned char zs_out[16384];
+
+static size_t stream_in = 0;
+static size_t stream_out = 0;
+static uint64_t stream_cpu_ns = 0;
+
+static CompressStats stats[COMPRESS_MAX_ROUTES];
+static int stats_count = 0;
+
+void compress_configure(int level, size_t min_size) {
+    if (level < 0) level = 0;
+    if (level > 9) level = 9;
+
+    if (zs_ready && level != gzip_level) {
+        deflateEnd(&zs);
+        zs_ready = 0;
+    }
+
+    gzip_level = level;
+    gzip_min_size = min_size;
+}
+
+int compress_level(void) {
+    return gzip_level;
+}
+
+size_t compress_min_size(void) {
+    return gzip_min_size;
+}
+
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int gzip_stream_begin(void) {
+    if (gzip_level == 0)
+        return -1;
+
+    if (!zs_ready) {
+        memset(&zs, 0, sizeof(zs));
+        /* windowBits 15 + 16 selects the gzip wrapper */
+        if (deflateInit2(&zs, gzip_level, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+            return -1;
+        zs_ready = 1;
+    } else if (deflateReset(&zs) != Z_OK) {
+        return -1;
+    }
+
+    stream_in = 0;
+    stream_out = 0;
+    stream_cpu_ns = 0;
+    return 0;
+}
+
+static int deflate_run(int flush, compress_out_fn out, void *arg) {
+    uint64_t start = thread_cpu_ns();
+    int rc;
+
+    do {
+        zs.next_out = zs_out;
+        zs.avail_out = sizeof(zs_out);
+        rc = deflate(&zs, flush);
+        if (rc == Z_STREAM_ERROR)
+            return -1;
+
+        size_t have = sizeof(zs_out) - zs.avail_out;
+        if (have > 0) {
+            stream_out += have;
+            out(zs_out, have, arg);
+        }
+    } while (zs.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+
+    stream_cpu_ns += thread_cpu_ns() - start;
+    return 0;
+}
+
+int gzip_stream_write(const void *data, size_t len, compress_out_fn out, void *arg) {
+    if (!zs_ready)
+        return -1;
+    if (len == 0)
+        return 0;
+
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = (uInt)len;
+    stream_in += len;
+    return deflate_run(Z_NO_FLUSH, out, arg);
+}
+
+int gzip_stream_finish(compress_out_fn out, void *arg) {
+    if (!zs_ready)
+        return -1;
+
+    zs.next_in = NULL;
+    zs.avail_in = 0;
+    return deflate_run(Z_FINISH, out, arg);
+}
+
+static CompressStats *stats_for(const char *route) {
+    if (route == NULL)
+        route = "other";
+
+    for (int i = 0; i < stats_count; i++) {
+        if (strcmp(stats[i].route, route) == 0)
+            return &stats[i];
+    }
+
+    if (stats_count >= COMPRESS_MAX_ROUTES)
+        return NULL;
+
+    CompressStats *s = &stats[stats_count++];
+    memset(s, 0, sizeof(*s));
+    s->route = route;
+    return s;
+}
+
+void gzip_stream_end(const char *route) {
+    CompressStats *s = stats_for(route);
+    if (s == NULL)
+        return;
+
+    s->responses++;
+    s->compressed++;
+    s->bytes_in += stream_in;
+    s->bytes_out += stream_out;
+    s->cpu_ns += stream_cpu_ns;
+}
+
+void compress_record_plain(const char *route) {
+    CompressStats *s = stats_for(route);
+    if (s == NULL)
+        return;
+
+    s->responses++;
+}
+
+int compress_get_stats(CompressStats *out, int max) {
+    int n = stats_count < max ? stats_count : max;
+    memcpy(out, stats, (size_t)n * sizeof(CompressStats));
+    return n;
+}
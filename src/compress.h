@@ -0,0 +1,45 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COMPRESS_DEFAULT_LEVEL    6
+#define COMPRESS_DEFAULT_MIN_SIZE 1024
+#define COMPRESS_MAX_ROUTES       64
+
+/* Per-route counters, keyed by the route pattern string */
+typedef struct {
+    const char *route;
+    unsigned long responses;        /* compressible responses sent */
+    unsigned long compressed;       /* of those, how many were gzipped */
+    unsigned long long bytes_in;    /* body bytes before gzip */
+    unsigned long long bytes_out;   /* body bytes after gzip */
+    unsigned long long cpu_ns;      /* thread CPU time spent in deflate */
+} CompressStats;
+
+/* Level 0 disables compression. Bodies smaller than min_size are sent as-is. */
+void compress_configure(int level, size_t min_size);
+int compress_level(void);
+size_t compress_min_size(void);
+
+/* Receives compressed output as it is produced */
+typedef void (*compress_out_fn)(const void *data, size_t len, void *arg);
+
+/* One gzip stream at a time: the event loop finishes each response before
+   starting the next, so the deflate state is reset and reused rather than
+   reallocated per response. Returns 0 on success, -1 on failure. */
+int gzip_stream_begin(void);
+int gzip_stream_write(const void *data, size_t len, compress_out_fn out, void *arg);
+int gzip_stream_finish(compress_out_fn out, void *arg);
+
+/* Records the finished stream against route */
+void gzip_stream_end(const char *route);
+
+/* Records a compressible response that went out uncompressed */
+void compress_record_plain(const char *route);
+
+/* Copies up to max entries into out, returns the number copied */
+int compress_get_stats(CompressStats *out, int max);
+
+#endif /* COMPRESS_H */
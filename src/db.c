@@ -1,8 +1,16 @@
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 #include "db.h"
 
+#define USER_VERSION_SLOTS 4096
+
 static sqlite3 *db = NULL;
 
+static unsigned long data_versions[DATA_KIND_COUNT];
+static unsigned long user_versions[USER_VERSION_SLOTS];
+static unsigned long boot_id = 0;
+
 static const char *SCHEMA =
     "CREATE TABLE IF NOT EXISTS users ("
     "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
@@ -29,6 +37,17 @@ static const char *SCHEMA =
     "    expires_at DATETIME NOT NULL"
     ");"
 
+    "CREATE TABLE IF NOT EXISTS user_roles ("
+    "    email TEXT NOT NULL COLLATE NOCASE,"
+    "    role TEXT NOT NULL,"
+    "    PRIMARY KEY (email, role)"
+    ");"
+
+    "CREATE TABLE IF NOT EXISTS revoked_sessions ("
+    "    fingerprint INTEGER PRIMARY KEY,"
+    "    expires_at INTEGER NOT NULL"
+    ");"
+
     "CREATE TABLE IF NOT EXISTS puzzles ("
     "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
     "    puzzle_date DATE UNIQUE NOT NULL,"
@@ -68,6 +87,17 @@ static const char *SCHEMA =
     "    UNIQUE(league_id, user_id)"
     ");"
 
+    "CREATE TABLE IF NOT EXISTS outbox ("
+    "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "    recipient TEXT NOT NULL,"
+    "    subject TEXT NOT NULL,"
+    "    html TEXT NOT NULL,"
+    "    attempts INTEGER NOT NULL DEFAULT 0,"
+    "    next_attempt_at INTEGER NOT NULL,"
+    "    last_error TEXT,"
+    "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+    ");"
+
     "CREATE INDEX IF NOT EXISTS idx_sessions_token ON sessions(token);"
     "CREATE INDEX IF NOT EXISTS idx_auth_tokens_token ON auth_tokens(token);"
     "CREATE INDEX IF NOT EXISTS idx_puzzles_date ON puzzles(puzzle_date);"
@@ -75,6 +105,7 @@ static const char *SCHEMA =
     "CREATE INDEX IF NOT EXISTS idx_leagues_invite_code ON leagues(invite_code);"
     "CREATE INDEX IF NOT EXISTS idx_league_members_league ON league_members(league_id);"
     "CREATE INDEX IF NOT EXISTS idx_league_members_user ON league_members(user_id);"
+    "CREATE INDEX IF NOT EXISTS idx_outbox_next_attempt ON outbox(next_attempt_at);"
 ;
 
 int db_init(const char *db_path) {
@@ -83,12 +114,18 @@ int db_init(const char *db_path) {
     if (db_path == NULL)
         return -1;
 
+    boot_id = ((unsigned long)time(NULL) << 16) ^ (unsigned long)getpid();
+
     int rc = sqlite3_open(db_path, &db);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
         return -1;
     }
 
+    /* The email sender thread writes through its own connection; wait
+       briefly for its lock instead of failing with SQLITE_BUSY */
+    sqlite3_busy_timeout(db, 250);
+
     /* SQLite has foreign keys OFF by default */
     rc = sqlite3_exec(db, "PRAGMA foreign_keys = ON;", NULL, NULL, &err_msg);
     if (rc != SQLITE_OK) {
@@ -121,3 +158,26 @@ void db_close(void) {
 sqlite3 *db_get(void) {
     return db;
 }
+
+void db_bump_version(DataKind kind) {
+    if ((unsigned)kind < DATA_KIND_COUNT)
+        data_versions[kind]++;
+}
+
+unsigned long db_data_version(DataKind kind) {
+    if ((unsigned)kind >= DATA_KIND_COUNT)
+        return 0;
+    return data_versions[kind];
+}
+
+void db_bump_user_version(int64_t user_id) {
+    user_versions[(uint64_t)user_id % USER_VERSION_SLOTS]++;
+}
+
+unsigned long db_user_version(int64_t user_id) {
+    return user_versions[(uint64_t)user_id % USER_VERSION_SLOTS];
+}
+
+unsigned long db_boot_id(void) {
+    return boot_id;
+}
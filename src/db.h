@@ -1,10 +1,33 @@
 #ifndef DB_H
 #define DB_H
 
+#include <stdint.h>
 #include "sqlite3.h"
 
 int db_init(const char *db_path);
 void db_close(void);
 sqlite3 *db_get(void);
 
+/* In-memory change counters, bumped by the write paths in puzzle.c,
+   league.c and auth.c. Pages build cheap HTTP validators from them
+   instead of re-running their queries. */
+typedef enum {
+    DATA_PUZZLES,
+    DATA_ATTEMPTS,
+    DATA_LEAGUES,
+    DATA_USERS,
+    DATA_KIND_COUNT
+} DataKind;
+
+void db_bump_version(DataKind kind);
+unsigned long db_data_version(DataKind kind);
+
+/* Per-user attempts counter. Users share slots of a fixed table, so a
+   collision can only cause a spurious change, never a missed one. */
+void db_bump_user_version(int64_t user_id);
+unsigned long db_user_version(int64_t user_id);
+
+/* Differs on every start, so validators from a previous run never match */
+unsigned long db_boot_id(void);
+
 #endif /* DB_H */
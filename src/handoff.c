@@ -0,0 +1,245 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "handoff.h"
+
+#define HANDOFF_MAGIC 'H'
+#define NAME_SIZE 32
+
+typedef struct {
+    char name[NAME_SIZE];
+    void *data;
+    size_t size;
+} Region;
+
+/* Wire header for each region, followed by size bytes of data */
+typedef struct {
+    char name[NAME_SIZE];
+    uint64_t size;
+} RegionHeader;
+
+static Region regions[HANDOFF_MAX_REGIONS];
+static int region_count = 0;
+
+void handoff_register(const char *name, void *data, size_t size) {
+    if (region_count >= HANDOFF_MAX_REGIONS)
+        return;
+
+    Region *r = &regions[region_count++];
+    strncpy(r->name, name, NAME_SIZE - 1);
+    r->name[NAME_SIZE - 1] = '\0';
+    r->data = data;
+    r->size = size;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Waits for events on fd until deadline (monotonic ms); -1 on timeout */
+static int wait_until(int fd, short events, long long deadline) {
+    for (;;) {
+        long long left = deadline - monotonic_ms();
+        if (left <= 0)
+            return -1;
+        struct pollfd pfd = { fd, events, 0 };
+        int rc = poll(&pfd, 1, (int)left);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        return rc == 1 ? 0 : -1;
+    }
+}
+
+/* Like write_full, but never blocks past deadline: the old process is
+   still serving while it sends */
+static int send_until(int fd, const void *buf, size_t len, long long deadline) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_until(fd, POLLOUT, deadline) != 0)
+                return -1;
+            continue;
+        }
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int skip_bytes(int fd, uint64_t len) {
+    char discard[4096];
+    while (len > 0) {
+        size_t n = len < sizeof(discard) ? (size_t)len : sizeof(discard);
+        if (read_full(fd, discard, n) != 0)
+            return -1;
+        len -= n;
+    }
+    return 0;
+}
+
+static const Region *find_region(const RegionHeader *hdr) {
+    for (int i = 0; i < region_count; i++) {
+        if (strncmp(regions[i].name, hdr->name, NAME_SIZE) == 0 &&
+            regions[i].size == hdr->size)
+            return &regions[i];
+    }
+    return NULL;
+}
+
+int handoff_send(int sock, int listen_fd, int timeout_ms) {
+    long long deadline = monotonic_ms() + timeout_ms;
+    char magic = HANDOFF_MAGIC;
+    struct iovec iov = { &magic, 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &listen_fd, sizeof(int));
+
+    for (;;) {
+        ssize_t n = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == 1)
+            break;
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+            wait_until(sock, POLLOUT, deadline) == 0)
+            continue;
+        return -1;
+    }
+
+    uint32_t count = (uint32_t)region_count;
+    if (send_until(sock, &count, sizeof(count), deadline) != 0)
+        return -1;
+
+    for (int i = 0; i < region_count; i++) {
+        RegionHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.name, regions[i].name, NAME_SIZE);
+        hdr.size = regions[i].size;
+        if (send_until(sock, &hdr, sizeof(hdr), deadline) != 0 ||
+            send_until(sock, regions[i].data, regions[i].size, deadline) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int handoff_recv(int sock, int *listen_fd) {
+    char magic = 0;
+    struct iovec iov = { &magic, 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n != 1 || magic != HANDOFF_MAGIC || cmsg == NULL ||
+        cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        return -1;
+    memcpy(listen_fd, CMSG_DATA(cmsg), sizeof(int));
+
+    /* The listener is in hand: a truncated state stream only costs warmth */
+    uint32_t count;
+    if (read_full(sock, &count, sizeof(count)) != 0)
+        return 0;
+
+    int restored = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        RegionHeader hdr;
+        if (read_full(sock, &hdr, sizeof(hdr)) != 0)
+            break;
+
+        const Region *r = find_region(&hdr);
+        if (r == NULL) {
+            if (skip_bytes(sock, hdr.size) != 0)
+                break;
+            continue;
+        }
+        if (read_full(sock, r->data, r->size) != 0)
+            break;
+        restored++;
+    }
+    return restored;
+}
+
+int handoff_ack(int sock) {
+    char ack = HANDOFF_MAGIC;
+    return write_full(sock, &ack, 1);
+}
+
+int handoff_wait_ack(int sock, int timeout_ms) {
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    int rc;
+    do {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+
+    char ack = 0;
+    if (rc != 1 || read(sock, &ack, 1) != 1 || ack != HANDOFF_MAGIC)
+        return -1;
+    return 0;
+}
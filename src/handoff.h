@@ -0,0 +1,35 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stddef.h>
+
+/* Zero-downtime restarts. On SIGUSR2 the running server execs the binary
+   on disk, passes it the listening socket over a Unix socket with
+   SCM_RIGHTS, waits for it to take it, then drains and exits. Registered
+   memory regions travel along so the new process starts warm. */
+
+/* Set in the new process's environment: the fd of its end of the Unix
+   socket the listener arrives on */
+#define HANDOFF_ENV "PUZZLE_HANDOFF_FD"
+
+#define HANDOFF_MAX_REGIONS 16
+
+/* Copies size bytes at data across a handoff. Regions are matched by name
+   and size, so a region whose layout changed in the new binary is left at
+   its initial value. data must not contain pointers. */
+void handoff_register(const char *name, void *data, size_t size);
+
+/* Old process: sends listen_fd and all registered regions, giving up
+   with -1 if the new process has not read them within timeout_ms */
+int handoff_send(int sock, int listen_fd, int timeout_ms);
+
+/* New process: receives the listener into *listen_fd and restores the
+   regions it also registered. Returns the number restored, or -1. */
+int handoff_recv(int sock, int *listen_fd);
+
+/* New process tells the old one it holds the listener; the old one waits
+   up to timeout_ms for that before it stops listening */
+int handoff_ack(int sock);
+int handoff_wait_ack(int sock, int timeout_ms);
+
+#endif /* HANDOFF_H */
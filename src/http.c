@@ -0,0 +1,309 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "http.h"
+#include "compress.h"
+#include "timing.h"
+#include "util.h"
+
+enum { MODE_PLAIN, MODE_PENDING, MODE_GZIP };
+
+/* How the body of a response is sent */
+enum { BODY_RAW, BODY_IDENTITY, BODY_GZIP };
+
+/* State of the response being written. The event loop is single threaded
+   and handlers finish their response before returning, so one is enough. */
+static struct {
+    const char *route;
+    int accept_gzip;
+    int mode;
+    int status;
+    char headers[512];
+    char etag[32];              /* quoted, empty if the route has none */
+    struct mg_iobuf pending;    /* body held back until min size is known */
+    struct mg_iobuf scratch;    /* formatted chunk */
+} resp;
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+    }
+}
+
+static int is_compressible(const char *headers) {
+    return headers != NULL &&
+           (strstr(headers, "text/html") != NULL ||
+            strstr(headers, "text/plain") != NULL ||
+            strstr(headers, "application/json") != NULL);
+}
+
+void http_begin(struct mg_http_message *hm, const char *route) {
+    struct mg_str *ae = mg_http_get_header(hm, "Accept-Encoding");
+
+    resp.route = route;
+    resp.accept_gzip = compress_level() > 0 && ae != NULL &&
+                       accepts_encoding(ae->buf, ae->len, "gzip");
+    resp.mode = MODE_PLAIN;
+    resp.etag[0] = '\0';
+}
+
+int http_gzip_accepted(void) {
+    return resp.accept_gzip;
+}
+
+void http_set_etag(const char *key) {
+    /* FNV-1a: validators only need to change when the key does */
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    snprintf(resp.etag, sizeof(resp.etag), "\"%016llx\"", (unsigned long long)h);
+}
+
+int http_not_modified(struct mg_connection *c, struct mg_http_message *hm) {
+    struct mg_str *inm = mg_http_get_header(hm, "If-None-Match");
+    if (inm == NULL || resp.etag[0] == '\0')
+        return 0;
+
+    char gz_etag[40];
+    snprintf(gz_etag, sizeof(gz_etag), "%.*s-gz\"",
+             (int)strlen(resp.etag) - 1, resp.etag);
+
+    /* Echo back whichever representation the client has */
+    const char *match = NULL;
+    if (etag_matches(inm->buf, inm->len, resp.etag))
+        match = resp.etag;
+    else if (etag_matches(inm->buf, inm->len, gz_etag))
+        match = gz_etag;
+    if (match == NULL)
+        return 0;
+
+    TimingPhase prev = timing_enter(TIMING_WRITE);
+    mg_printf(c,
+        "HTTP/1.1 304 Not Modified\r\n"
+        "ETag: %s\r\n"
+        "Cache-Control: private, no-cache\r\n"
+        "Vary: Accept-Encoding\r\n"
+        "Content-Length: 0\r\n\r\n",
+        match);
+    c->is_resp = 0;
+    timing_enter(prev);
+    return 1;
+}
+
+static void send_iobuf(const void *data, size_t len, void *arg) {
+    struct mg_iobuf *io = (struct mg_iobuf *)arg;
+    mg_iobuf_add(io, io->len, data, len);
+}
+
+static void send_chunk(const void *data, size_t len, void *arg) {
+    struct mg_connection *c = (struct mg_connection *)arg;
+    mg_printf(c, "%lx\r\n", (unsigned long)len);
+    mg_send(c, data, len);
+    mg_send(c, "\r\n", 2);
+}
+
+/* Writes the status line and headers up to, not including, the framing
+   header. Compressible bodies get Vary and, if set, the route's ETag:
+   gzip and identity are different representations, so gzip gets its own. */
+static void send_head(struct mg_connection *c, int status, const char *headers,
+                      int body) {
+    mg_printf(c, "HTTP/1.1 %d %s\r\n%s", status, status_text(status),
+              headers ? headers : "");
+    if (body == BODY_RAW)
+        return;
+
+    if (body == BODY_GZIP)
+        mg_printf(c, "Content-Encoding: gzip\r\n");
+    mg_printf(c, "Vary: Accept-Encoding\r\n");
+
+    if (status == 200 && resp.etag[0] != '\0') {
+        int len = (int)strlen(resp.etag) - 1;
+        mg_printf(c, "ETag: %.*s%s\"\r\nCache-Control: private, no-cache\r\n",
+                  len, resp.etag, body == BODY_GZIP ? "-gz" : "");
+    }
+}
+
+static void send_iov(struct mg_connection *c, const struct iovec *iov, int iovcnt) {
+    for (int i = 0; i < iovcnt; i++)
+        mg_send(c, iov[i].iov_base, iov[i].iov_len);
+}
+
+static void send_reply(struct mg_connection *c, int status, const char *headers,
+                       const struct iovec *iov, int iovcnt) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++)
+        len += iov[i].iov_len;
+
+    if (!is_compressible(headers)) {
+        send_head(c, status, headers, BODY_RAW);
+        mg_printf(c, "Content-Length: %lu\r\n\r\n", (unsigned long)len);
+        send_iov(c, iov, iovcnt);
+        c->is_resp = 0;
+        return;
+    }
+
+    if (!resp.accept_gzip || len < compress_min_size() || gzip_stream_begin() != 0) {
+        compress_record_plain(resp.route);
+        send_head(c, status, headers, BODY_IDENTITY);
+        mg_printf(c, "Content-Length: %lu\r\n\r\n", (unsigned long)len);
+        send_iov(c, iov, iovcnt);
+        c->is_resp = 0;
+        return;
+    }
+
+    resp.scratch.len = 0;
+    for (int i = 0; i < iovcnt; i++)
+        gzip_stream_write(iov[i].iov_base, iov[i].iov_len, send_iobuf, &resp.scratch);
+    gzip_stream_finish(send_iobuf, &resp.scratch);
+    gzip_stream_end(resp.route);
+
+    send_head(c, status, headers, BODY_GZIP);
+    mg_printf(c, "Content-Length: %lu\r\n\r\n", (unsigned long)resp.scratch.len);
+    mg_send(c, resp.scratch.buf, resp.scratch.len);
+    c->is_resp = 0;
+}
+
+void http_reply(struct mg_connection *c, int status, const char *headers,
+                const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    char *body = mg_vmprintf(fmt, &ap);
+    va_end(ap);
+
+    struct iovec iov = { body, strlen(body) };
+    TimingPhase prev = timing_enter(TIMING_WRITE);
+    send_reply(c, status, headers, &iov, 1);
+    timing_enter(prev);
+    free(body);
+}
+
+void http_reply_iov(struct mg_connection *c, int status, const char *headers,
+                    const struct iovec *iov, int iovcnt) {
+    TimingPhase prev = timing_enter(TIMING_WRITE);
+    send_reply(c, status, headers, iov, iovcnt);
+    timing_enter(prev);
+}
+
+void http_chunked_begin(struct mg_connection *c, int status, const char *headers) {
+    if (!resp.accept_gzip || !is_compressible(headers)) {
+        int body = BODY_RAW;
+        if (is_compressible(headers)) {
+            compress_record_plain(resp.route);
+            body = BODY_IDENTITY;
+        }
+        TimingPhase prev = timing_enter(TIMING_WRITE);
+        resp.mode = MODE_PLAIN;
+        send_head(c, status, headers, body);
+        mg_printf(c, "Transfer-Encoding: chunked\r\n\r\n");
+        timing_enter(prev);
+        return;
+    }
+
+    /* Hold the body back until it is clear whether it is worth compressing */
+    resp.mode = MODE_PENDING;
+    resp.status = status;
+    snprintf(resp.headers, sizeof(resp.headers), "%s", headers);
+    resp.pending.len = 0;
+}
+
+static void start_gzip(struct mg_connection *c) {
+    if (gzip_stream_begin() != 0) {
+        resp.mode = MODE_PLAIN;
+        compress_record_plain(resp.route);
+        send_head(c, resp.status, resp.headers, BODY_IDENTITY);
+        mg_printf(c, "Transfer-Encoding: chunked\r\n\r\n");
+        send_chunk(resp.pending.buf, resp.pending.len, c);
+        return;
+    }
+
+    resp.mode = MODE_GZIP;
+    send_head(c, resp.status, resp.headers, BODY_GZIP);
+    mg_printf(c, "Transfer-Encoding: chunked\r\n\r\n");
+    gzip_stream_write(resp.pending.buf, resp.pending.len, send_chunk, c);
+}
+
+void http_chunk(struct mg_connection *c, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    resp.scratch.len = 0;
+    mg_vxprintf(mg_pfn_iobuf, &resp.scratch, fmt, &ap);
+    va_end(ap);
+
+    /* A zero-length chunk would terminate the response early */
+    if (resp.scratch.len == 0)
+        return;
+
+    TimingPhase prev = timing_enter(TIMING_WRITE);
+    switch (resp.mode) {
+        case MODE_PLAIN:
+            send_chunk(resp.scratch.buf, resp.scratch.len, c);
+            break;
+        case MODE_PENDING:
+            mg_iobuf_add(&resp.pending, resp.pending.len, resp.scratch.buf, resp.scratch.len);
+            if (resp.pending.len >= compress_min_size())
+                start_gzip(c);
+            break;
+        case MODE_GZIP:
+            gzip_stream_write(resp.scratch.buf, resp.scratch.len, send_chunk, c);
+            break;
+    }
+    timing_enter(prev);
+}
+
+void http_chunked_end(struct mg_connection *c) {
+    TimingPhase prev = timing_enter(TIMING_WRITE);
+    switch (resp.mode) {
+        case MODE_PENDING:
+            /* Never reached the threshold: send it whole */
+            compress_record_plain(resp.route);
+            send_head(c, resp.status, resp.headers, BODY_IDENTITY);
+            mg_printf(c, "Content-Length: %lu\r\n\r\n", (unsigned long)resp.pending.len);
+            mg_send(c, resp.pending.buf, resp.pending.len);
+            c->is_resp = 0;
+            break;
+        case MODE_GZIP:
+            gzip_stream_finish(send_chunk, c);
+            gzip_stream_end(resp.route);
+            mg_http_write_chunk(c, "", 0);
+            break;
+        default:
+            mg_http_write_chunk(c, "", 0);
+            break;
+    }
+
+    resp.mode = MODE_PLAIN;
+    if (resp.pending.size > 65536)
+        mg_iobuf_free(&resp.pending);
+    if (resp.scratch.size > 65536)
+        mg_iobuf_free(&resp.scratch);
+    timing_enter(prev);
+}
+
+int http_insert_header(struct mg_connection *c, size_t start, const char *header) {
+    const char *buf = (const char *)c->send.buf;
+    size_t i = start;
+    if (c->send.len < start + 7 || memcmp(buf + start, "HTTP/1.", 7) != 0)
+        return -1;
+    while (i + 1 < c->send.len && !(buf[i] == '\r' && buf[i + 1] == '\n'))
+        i++;
+    if (i + 1 >= c->send.len)
+        return -1;
+
+    size_t len = strlen(header);
+    return mg_iobuf_add(&c->send, i + 2, header, len) == len ? 0 : -1;
+}
@@ -0,0 +1,42 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <sys/uio.h>
+#include "mongoose.h"
+
+/* Response helpers used by every page handler. They behave like
+   mg_http_reply / mg_http_printf_chunk, but gzip text bodies when the
+   client accepts it and the body reaches compress_min_size(). */
+
+/* Call once per request before dispatching. route labels the stats. */
+void http_begin(struct mg_http_message *hm, const char *route);
+
+/* 1 if this request's compressible responses will be gzipped */
+int http_gzip_accepted(void);
+
+/* Sets a strong ETag for this request's 200 response, hashed from a key
+   describing everything the page depends on. */
+void http_set_etag(const char *key);
+
+/* Answers 304 and returns 1 if If-None-Match lists the ETag set above */
+int http_not_modified(struct mg_connection *c, struct mg_http_message *hm);
+
+void http_reply(struct mg_connection *c, int status, const char *headers,
+                const char *fmt, ...);
+
+/* The body is gathered from iov, e.g. a rendered template */
+void http_reply_iov(struct mg_connection *c, int status, const char *headers,
+                    const struct iovec *iov, int iovcnt);
+
+/* Chunked responses: begin, any number of http_chunk, then end.
+   Small bodies are held back and sent with a Content-Length instead. */
+void http_chunked_begin(struct mg_connection *c, int status, const char *headers);
+void http_chunk(struct mg_connection *c, const char *fmt, ...);
+void http_chunked_end(struct mg_connection *c);
+
+/* Adds a header line, CRLF included, to the response queued at offset
+   start of c->send: for values only known once the response is written.
+   Returns 0 on success, -1 if no status line starts there. */
+int http_insert_header(struct mg_connection *c, size_t start, const char *header);
+
+#endif /* HTTP_H */
@@ -0,0 +1,126 @@
+#include <string.h>
+#include "json.h"
+#include "util.h"
+
+void json_init(JsonWriter *w, char *buf, size_t size) {
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->depth = 0;
+    w->has_items = 0;
+    w->failed = size == 0;
+}
+
+/* Leaves room for the terminating NUL */
+static void put(JsonWriter *w, const char *s, size_t n) {
+    if (w->failed)
+        return;
+    if (w->len + n >= w->size) {
+        w->failed = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+/* The comma and key that come before every member */
+static void member(JsonWriter *w, const char *key) {
+    unsigned bit = 1u << w->depth;
+    if (w->has_items & bit)
+        put(w, ",", 1);
+    w->has_items |= bit;
+    if (key) {
+        put(w, "\"", 1);
+        put(w, key, strlen(key));
+        put(w, "\":", 2);
+    }
+}
+
+static void open_level(JsonWriter *w, const char *key, char bracket) {
+    member(w, key);
+    put(w, &bracket, 1);
+    if (w->depth + 1 >= JSON_MAX_DEPTH) {
+        w->failed = 1;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_level(JsonWriter *w, char bracket) {
+    if (w->depth == 0) {
+        w->failed = 1;
+        return;
+    }
+    w->depth--;
+    put(w, &bracket, 1);
+}
+
+void json_object_begin(JsonWriter *w, const char *key) { open_level(w, key, '{'); }
+void json_object_end(JsonWriter *w) { close_level(w, '}'); }
+void json_array_begin(JsonWriter *w, const char *key) { open_level(w, key, '['); }
+void json_array_end(JsonWriter *w) { close_level(w, ']'); }
+
+void json_string(JsonWriter *w, const char *key, const char *value) {
+    if (value == NULL) {
+        json_null(w, key);
+        return;
+    }
+    member(w, key);
+    put(w, "\"", 1);
+    if (w->failed)
+        return;
+
+    /* Escape in place; json_escape reports the length it needed, so a
+       value that did not fit fails the document */
+    size_t room = w->size - w->len;
+    size_t n = json_escape(value, w->buf + w->len, room);
+    if (n >= room) {
+        w->failed = 1;
+        return;
+    }
+    w->len += n;
+    put(w, "\"", 1);
+}
+
+void json_int(JsonWriter *w, const char *key, long long value) {
+    member(w, key);
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value
+                                     : (unsigned long long)value;
+    do {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (value < 0)
+        *--p = '-';
+    put(w, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+void json_bool(JsonWriter *w, const char *key, int value) {
+    member(w, key);
+    if (value)
+        put(w, "true", 4);
+    else
+        put(w, "false", 5);
+}
+
+void json_null(JsonWriter *w, const char *key) {
+    member(w, key);
+    put(w, "null", 4);
+}
+
+void json_raw(JsonWriter *w, const char *key, const char *value) {
+    member(w, key);
+    put(w, value, strlen(value));
+}
+
+int json_finish(JsonWriter *w, size_t *len) {
+    if (w->failed || w->depth != 0)
+        return -1;
+    w->buf[w->len] = '\0';
+    if (len)
+        *len = w->len;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+/* Compact JSON written straight into a caller's buffer: no allocation,
+   no format strings, and commas placed by the writer. Members take a
+   key inside objects and NULL inside arrays. Keys are written as given,
+   so they must be plain literals; string values go through json_escape.
+
+   Errors are sticky: once the buffer is full every later call does
+   nothing and json_finish reports the failure. */
+
+#define JSON_MAX_DEPTH 16
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    int depth;
+    unsigned has_items;     /* bit per open level: a comma is due */
+    int failed;
+} JsonWriter;
+
+void json_init(JsonWriter *w, char *buf, size_t size);
+
+void json_object_begin(JsonWriter *w, const char *key);
+void json_object_end(JsonWriter *w);
+void json_array_begin(JsonWriter *w, const char *key);
+void json_array_end(JsonWriter *w);
+
+/* A NULL value is written as null */
+void json_string(JsonWriter *w, const char *key, const char *value);
+void json_int(JsonWriter *w, const char *key, long long value);
+void json_bool(JsonWriter *w, const char *key, int value);
+void json_null(JsonWriter *w, const char *key);
+
+/* value is a finished JSON document, written as is */
+void json_raw(JsonWriter *w, const char *key, const char *value);
+
+/* NUL-terminates the document. Returns 0 and sets *len on success, -1 if
+   it did not fit or a container is still open. */
+int json_finish(JsonWriter *w, size_t *len);
+
+#endif /* JSON_H */
@@ -94,6 +94,7 @@ int64_t league_create(int64_t creator_id, const char *name, char *invite_code_ou
     strncpy(invite_code_out, invite_code, 7);
     invite_code_out[6] = '\0';
 
+    db_bump_version(DATA_LEAGUES);
     return league_id;
 }
 
@@ -219,6 +220,7 @@ int league_join(int64_t league_id, int64_t user_id) {
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    db_bump_version(DATA_LEAGUES);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -289,6 +291,7 @@ int league_leave(int64_t league_id, int64_t user_id) {
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    db_bump_version(DATA_LEAGUES);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -330,6 +333,7 @@ int league_delete(int64_t league_id, int64_t user_id) {
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    db_bump_version(DATA_LEAGUES);
     return (rc == SQLITE_DONE) ? 0 : -1;
 }
 
@@ -544,3 +548,82 @@ int league_get_leaderboard_alltime(int64_t league_id, LeaderboardEntry *entries,
         "ORDER BY total_score DESC, COALESCE(u.display_name, u.email) ASC",
         entries, max, count);
 }
+
+int league_get_standings(int64_t user_id, const int64_t *league_ids, int count,
+                         LeagueStanding *standings) {
+    sqlite3 *db = db_get();
+    sqlite3_stmt *stmt;
+
+    if (db == NULL || standings == NULL || count < 0 || count > LEAGUE_MAX_BATCH)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        memset(&standings[i], 0, sizeof(LeagueStanding));
+        standings[i].league_id = league_ids[i];
+        standings[i].score[LEAGUE_DAILY] = -1;
+    }
+    if (count == 0)
+        return 0;
+
+    /* ?1 is the user, ?2.. the leagues */
+    char in_list[LEAGUE_MAX_BATCH * 5];
+    size_t pos = 0;
+    for (int i = 0; i < count; i++)
+        pos += (size_t)snprintf(in_list + pos, sizeof(in_list) - pos,
+                                "%s?%d", i ? "," : "", i + 2);
+
+    /* Each member's three totals are summed once, however many of the
+       leagues they share; window functions then rank every league in
+       the same pass, with ties sharing a rank as in assign_ranks() */
+    char sql[2048];
+    snprintf(sql, sizeof(sql),
+        "WITH members AS ("
+        "  SELECT league_id, user_id FROM league_members WHERE league_id IN (%s)), "
+        "totals AS ("
+        "  SELECT a.user_id, "
+        "    MAX(CASE WHEN p.puzzle_date = date('now') THEN a.score END) AS daily, "
+        "    SUM(CASE WHEN p.puzzle_date >= date('now', 'weekday 0', '-6 days') "
+        "        AND p.puzzle_date <= date('now') THEN a.score ELSE 0 END) AS weekly, "
+        "    SUM(a.score) AS alltime "
+        "  FROM attempts a JOIN puzzles p ON p.id = a.puzzle_id "
+        "  WHERE a.solved = 1 AND a.user_id IN (SELECT user_id FROM members) "
+        "  GROUP BY a.user_id), "
+        "ranked AS ("
+        "  SELECT m.league_id, m.user_id, "
+        "    COALESCE(t.daily, -1) AS daily, "
+        "    COALESCE(t.weekly, 0) AS weekly, "
+        "    COALESCE(t.alltime, 0) AS alltime, "
+        "    RANK() OVER (PARTITION BY m.league_id ORDER BY COALESCE(t.daily, -1) DESC) AS daily_rank, "
+        "    RANK() OVER (PARTITION BY m.league_id ORDER BY COALESCE(t.weekly, 0) DESC) AS weekly_rank, "
+        "    RANK() OVER (PARTITION BY m.league_id ORDER BY COALESCE(t.alltime, 0) DESC) AS alltime_rank, "
+        "    COUNT(*) OVER (PARTITION BY m.league_id) AS member_count "
+        "  FROM members m LEFT JOIN totals t ON t.user_id = m.user_id) "
+        "SELECT league_id, member_count, daily, daily_rank, weekly, weekly_rank, "
+        "       alltime, alltime_rank "
+        "FROM ranked WHERE user_id = ?1",
+        in_list);
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, user_id);
+    for (int i = 0; i < count; i++)
+        sqlite3_bind_int64(stmt, i + 2, league_ids[i]);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int64_t league_id = sqlite3_column_int64(stmt, 0);
+        for (int i = 0; i < count; i++) {
+            if (standings[i].league_id != league_id)
+                continue;
+            standings[i].member_count = sqlite3_column_int(stmt, 1);
+            for (int v = 0; v < LEAGUE_VIEW_COUNT; v++) {
+                standings[i].score[v] = sqlite3_column_int(stmt, 2 + v * 2);
+                standings[i].rank[v] = sqlite3_column_int(stmt, 3 + v * 2);
+            }
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
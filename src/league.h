@@ -50,4 +50,28 @@ int league_get_leaderboard_weekly(int64_t league_id, LeaderboardEntry *entries,
 int league_get_leaderboard_alltime(int64_t league_id, LeaderboardEntry *entries,
                                     int max, int *count);
 
+typedef enum {
+    LEAGUE_DAILY,
+    LEAGUE_WEEKLY,
+    LEAGUE_ALLTIME,
+    LEAGUE_VIEW_COUNT
+} LeagueView;
+
+/* One user's place in one league, in every view */
+typedef struct {
+    int64_t league_id;
+    int member_count;
+    int rank[LEAGUE_VIEW_COUNT];    /* 0 = not a member */
+    int score[LEAGUE_VIEW_COUNT];   /* daily: -1 = not solved */
+} LeagueStanding;
+
+#define LEAGUE_MAX_BATCH 64
+
+/* Fills standings[i] for league_ids[i] with user_id's rank and score,
+   ranked as the leaderboards above, using one grouped query for all the
+   leagues and views. Returns 0 on success, -1 on failure or more than
+   LEAGUE_MAX_BATCH leagues. */
+int league_get_standings(int64_t user_id, const int64_t *league_ids, int count,
+                         LeagueStanding *standings);
+
 #endif /* LEAGUE_H */
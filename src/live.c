@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+#include "live.h"
+#include "league.h"
+
+/* What subscribers have been sent: enough to tell which rows changed */
+typedef struct {
+    int64_t user_id;
+    int rank;
+    int score;
+} Row;
+
+typedef struct {
+    int64_t league_id;
+    LiveView view;
+    unsigned subscribers;       /* 0: slot free */
+    int dirty;
+    uint64_t refreshed_ms;
+    int row_count;
+    Row rows[LIVE_MAX_ROWS];
+    struct mg_iobuf event;      /* rendered once per flush, sent to all */
+} Channel;
+
+typedef struct {
+    struct mg_connection *c;    /* NULL: slot free */
+    int channel;
+} Subscriber;
+
+static Channel channels[LIVE_MAX_CHANNELS];
+static Subscriber subs[LIVE_MAX_SUBSCRIBERS];
+static int sub_end = 0;         /* one past the highest used slot */
+static uint64_t heartbeat_ms = 0;
+static LiveStats stats;
+
+static int load_rows(const Channel *ch, Row *rows) {
+    LeaderboardEntry entries[LIVE_MAX_ROWS];
+    int count = 0, rc;
+    switch (ch->view) {
+        case LIVE_DAILY:
+            rc = league_get_leaderboard_today(ch->league_id, entries, LIVE_MAX_ROWS, &count);
+            break;
+        case LIVE_ALLTIME:
+            rc = league_get_leaderboard_alltime(ch->league_id, entries, LIVE_MAX_ROWS, &count);
+            break;
+        default:
+            rc = league_get_leaderboard_weekly(ch->league_id, entries, LIVE_MAX_ROWS, &count);
+            break;
+    }
+    stats.refreshes++;
+    if (rc != 0)
+        return -1;
+
+    for (int i = 0; i < count; i++) {
+        rows[i].user_id = entries[i].user_id;
+        rows[i].rank = entries[i].rank;
+        rows[i].score = entries[i].score;
+    }
+    return count;
+}
+
+static void render_row(struct mg_iobuf *out, const Row *r, int first) {
+    mg_xprintf(mg_pfn_iobuf, out, "%s{\"id\":%lld,\"rank\":%d,\"score\":%d}",
+               first ? "" : ",", (long long)r->user_id, r->rank, r->score);
+}
+
+static void render_all(struct mg_iobuf *out, const Row *rows, int count) {
+    mg_xprintf(mg_pfn_iobuf, out, "event: rows\ndata: [");
+    for (int i = 0; i < count; i++)
+        render_row(out, &rows[i], i == 0);
+    mg_xprintf(mg_pfn_iobuf, out, "]\n\n");
+}
+
+static const Row *find_row(const Row *rows, int count, int64_t user_id) {
+    for (int i = 0; i < count; i++) {
+        if (rows[i].user_id == user_id)
+            return &rows[i];
+    }
+    return NULL;
+}
+
+/* Requeries the leaderboard and renders the rows that moved. A member who
+   left cannot be expressed as a row update, so clients are told to reset. */
+static void refresh(Channel *ch, uint64_t now) {
+    Row rows[LIVE_MAX_ROWS];
+    int count = load_rows(ch, rows);
+    ch->dirty = 0;
+    ch->refreshed_ms = now;
+    if (count < 0)
+        return;
+
+    int removed = 0;
+    for (int i = 0; i < ch->row_count && !removed; i++)
+        removed = find_row(rows, count, ch->rows[i].user_id) == NULL;
+
+    ch->event.len = 0;
+    if (removed) {
+        mg_xprintf(mg_pfn_iobuf, &ch->event, "event: reset\ndata: {}\n\n");
+    } else {
+        int changed = 0;
+        for (int i = 0; i < count; i++) {
+            const Row *old = find_row(ch->rows, ch->row_count, rows[i].user_id);
+            if (old != NULL && old->rank == rows[i].rank && old->score == rows[i].score)
+                continue;
+            if (changed == 0)
+                mg_xprintf(mg_pfn_iobuf, &ch->event, "event: rows\ndata: [");
+            render_row(&ch->event, &rows[i], changed == 0);
+            changed++;
+        }
+        if (changed > 0)
+            mg_xprintf(mg_pfn_iobuf, &ch->event, "]\n\n");
+    }
+
+    memcpy(ch->rows, rows, sizeof(Row) * (size_t)count);
+    ch->row_count = count;
+}
+
+static int find_channel(int64_t league_id, LiveView view) {
+    int free_slot = -1;
+    for (int i = 0; i < LIVE_MAX_CHANNELS; i++) {
+        if (channels[i].subscribers == 0) {
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (channels[i].league_id == league_id && channels[i].view == view) {
+            return i;
+        }
+    }
+    if (free_slot < 0)
+        return -1;
+
+    Channel *ch = &channels[free_slot];
+    ch->league_id = league_id;
+    ch->view = view;
+    ch->dirty = 0;
+    ch->event.len = 0;
+    int count = load_rows(ch, ch->rows);
+    ch->row_count = count > 0 ? count : 0;
+    ch->refreshed_ms = mg_millis();
+    stats.channels++;
+    return free_slot;
+}
+
+int live_subscribe(struct mg_connection *c, int64_t league_id, LiveView view) {
+    int slot = -1;
+    for (int i = 0; i < LIVE_MAX_SUBSCRIBERS && slot < 0; i++) {
+        if (subs[i].c == NULL)
+            slot = i;
+    }
+    if (slot < 0)
+        return -1;
+
+    int channel = find_channel(league_id, view);
+    if (channel < 0)
+        return -1;
+
+    Channel *ch = &channels[channel];
+    ch->subscribers++;
+    subs[slot].c = c;
+    subs[slot].channel = channel;
+    if (slot >= sub_end)
+        sub_end = slot + 1;
+    stats.subscribers++;
+
+    mg_printf(c,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "X-Accel-Buffering: no\r\n\r\n"
+        "retry: 5000\n\n");
+
+    /* Current standings from the channel's snapshot, no extra query */
+    struct mg_iobuf all = {0};
+    render_all(&all, ch->rows, ch->row_count);
+    mg_send(c, all.buf, all.len);
+    mg_iobuf_free(&all);
+    return 0;
+}
+
+void live_unsubscribe(struct mg_connection *c) {
+    for (int i = 0; i < sub_end; i++) {
+        if (subs[i].c != c)
+            continue;
+
+        Channel *ch = &channels[subs[i].channel];
+        if (--ch->subscribers == 0) {
+            mg_iobuf_free(&ch->event);
+            stats.channels--;
+        }
+        subs[i].c = NULL;
+        stats.subscribers--;
+        while (sub_end > 0 && subs[sub_end - 1].c == NULL)
+            sub_end--;
+        return;
+    }
+}
+
+void live_league_changed(int64_t league_id) {
+    for (int i = 0; i < LIVE_MAX_CHANNELS; i++) {
+        if (channels[i].subscribers > 0 && channels[i].league_id == league_id)
+            channels[i].dirty = 1;
+    }
+}
+
+void live_user_solved(int64_t user_id) {
+    if (stats.channels == 0)
+        return;
+
+    League leagues[50];
+    int count = 0;
+    if (league_get_user_leagues(user_id, leagues, 50, &count) != 0)
+        return;
+    for (int i = 0; i < count; i++)
+        live_league_changed(leagues[i].id);
+}
+
+/* A subscriber that cannot keep up is dropped rather than buffered
+   without bound; EventSource reconnects and gets fresh standings */
+static void send_event(struct mg_connection *c, const void *buf, size_t len) {
+    if (c->is_closing)
+        return;
+    if (c->send.len > LIVE_MAX_BACKLOG) {
+        c->is_closing = 1;
+        stats.overflows++;
+        return;
+    }
+    mg_send(c, buf, len);
+    stats.events++;
+}
+
+void live_flush(void) {
+    if (stats.subscribers == 0)
+        return;
+
+    uint64_t now = mg_millis();
+    int pending = 0;
+    for (int i = 0; i < LIVE_MAX_CHANNELS; i++) {
+        Channel *ch = &channels[i];
+        if (ch->subscribers > 0 && ch->dirty &&
+            now - ch->refreshed_ms >= LIVE_MIN_INTERVAL_MS) {
+            refresh(ch, now);
+            pending |= ch->event.len > 0;
+        }
+    }
+
+    /* Comments keep idle streams open through proxies */
+    int heartbeat = now - heartbeat_ms >= LIVE_HEARTBEAT_MS;
+    if (!pending && !heartbeat)
+        return;
+
+    for (int i = 0; i < sub_end; i++) {
+        if (subs[i].c == NULL)
+            continue;
+        Channel *ch = &channels[subs[i].channel];
+        if (ch->event.len > 0)
+            send_event(subs[i].c, ch->event.buf, ch->event.len);
+        else if (heartbeat)
+            send_event(subs[i].c, ": ping\n\n", 8);
+    }
+
+    for (int i = 0; i < LIVE_MAX_CHANNELS; i++)
+        channels[i].event.len = 0;
+    if (heartbeat)
+        heartbeat_ms = now;
+}
+
+void live_get_stats(LiveStats *out) {
+    *out = stats;
+}
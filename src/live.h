@@ -0,0 +1,44 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <stdint.h>
+#include "mongoose.h"
+
+/* Server-Sent Events for league leaderboards. Subscribers to the same
+   league and view share a channel: a change recomputes the leaderboard
+   once and sends only the rows that changed to everyone on it. */
+
+#define LIVE_MAX_CHANNELS 256
+#define LIVE_MAX_SUBSCRIBERS 2048
+#define LIVE_MAX_ROWS 100
+#define LIVE_MAX_BACKLOG (64 * 1024)    /* unsent bytes before we disconnect */
+#define LIVE_MIN_INTERVAL_MS 500        /* coalesces bursts of solves */
+#define LIVE_HEARTBEAT_MS 25000
+
+typedef enum { LIVE_DAILY, LIVE_WEEKLY, LIVE_ALLTIME } LiveView;
+
+typedef struct {
+    unsigned subscribers;
+    unsigned channels;
+    unsigned long refreshes;        /* leaderboard queries run */
+    unsigned long events;           /* events written, summed over subscribers */
+    unsigned long overflows;        /* subscribers dropped for backpressure */
+} LiveStats;
+
+/* Turns c into an event stream and sends the current standings.
+   Returns 0 on success, -1 if no subscriber slot is free. */
+int live_subscribe(struct mg_connection *c, int64_t league_id, LiveView view);
+
+/* Call on MG_EV_CLOSE for every connection */
+void live_unsubscribe(struct mg_connection *c);
+
+/* Marks the leaderboards that may have changed; sent by live_flush() */
+void live_user_solved(int64_t user_id);
+void live_league_changed(int64_t league_id);
+
+/* Call once per event loop iteration */
+void live_flush(void);
+
+void live_get_stats(LiveStats *out);
+
+#endif /* LIVE_H */
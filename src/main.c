@@ -4,228 +4,41 @@
 #include <time.h>
 #include <unistd.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
 #include "mongoose.h"
 #include "db.h"
 #include "auth.h"
 #include "puzzle.h"
 #include "league.h"
 #include "util.h"
-
-/* Rate limiting: 5 login attempts per minute per IP */
-#define RATE_LIMIT_WINDOW_SECS 60
-#define RATE_LIMIT_MAX_ATTEMPTS 5
-#define RATE_LIMIT_MAX_IPS 1000
-
-typedef struct {
-    char ip[64];
-    time_t window_start;
-    int attempts;
-} RateLimitEntry;
-
-static RateLimitEntry rate_limit_table[RATE_LIMIT_MAX_IPS];
-static int rate_limit_count = 0;
+#include "http.h"
+#include "compress.h"
+#include "admission.h"
+#include "handoff.h"
+#include "outbox.h"
+#include "live.h"
+#include "metrics.h"
+#include "timing.h"
+#include "accesslog.h"
+#include "release.h"
+#include "pagecache.h"
+#include "assets.h"
+#include "assets_data.h"
+#include "template.h"
+#include "templates_data.h"
+#include "json.h"
+#include "ratelimit.h"
+#include "race.h"
+#include "writeback.h"
 
 static int dev_mode = 0;
 
-static void rate_limit_evict_expired(time_t now) {
-    int i = 0;
-    while (i < rate_limit_count) {
-        if (now - rate_limit_table[i].window_start >= RATE_LIMIT_WINDOW_SECS) {
-            rate_limit_table[i] = rate_limit_table[rate_limit_count - 1];
-            rate_limit_count--;
-        } else {
-            i++;
-        }
-    }
-}
-
-/* Returns 1 if allowed, 0 if rate limited. Increments counter. */
-static int rate_limit_check(const char *ip) {
-    time_t now = time(NULL);
-
-    for (int i = 0; i < rate_limit_count; i++) {
-        if (strcmp(rate_limit_table[i].ip, ip) == 0) {
-            if (now - rate_limit_table[i].window_start >= RATE_LIMIT_WINDOW_SECS) {
-                rate_limit_table[i].window_start = now;
-                rate_limit_table[i].attempts = 1;
-                return 1;
-            }
-            if (rate_limit_table[i].attempts >= RATE_LIMIT_MAX_ATTEMPTS)
-                return 0;
-            rate_limit_table[i].attempts++;
-            return 1;
-        }
-    }
-
-    if (rate_limit_count >= RATE_LIMIT_MAX_IPS)
-        rate_limit_evict_expired(now);
-
-    if (rate_limit_count < RATE_LIMIT_MAX_IPS) {
-        strncpy(rate_limit_table[rate_limit_count].ip, ip,
-                sizeof(rate_limit_table[rate_limit_count].ip) - 1);
-        rate_limit_table[rate_limit_count].window_start = now;
-        rate_limit_table[rate_limit_count].attempts = 1;
-        rate_limit_count++;
-        return 1;
-    }
-
-    return 0;
-}
-
+/* Shared <head> block. The stylesheet lives in static/style.css and is
+   embedded at build time under a content-hashed URL (see assets.h). */
 static const char *TERMINAL_CSS =
     "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">\n"
-    "<style>\n"
-    "  * { box-sizing: border-box; }\n"
-    "  body {\n"
-    "    background: #15191e;\n"
-    "    color: #e0e0e0;\n"
-    "    font-family: Monaco, 'Cascadia Code', 'Fira Code', Consolas, monospace;\n"
-    "    font-size: 14px;\n"
-    "    line-height: 1.7;\n"
-    "    max-width: 600px;\n"
-    "    margin: 0 auto;\n"
-    "    padding: 20px;\n"
-    "    min-height: 100vh;\n"
-    "  }\n"
-    /* Header */
-    "  .page-header {\n"
-    "    margin-bottom: 10px;\n"
-    "  }\n"
-    "  .page-title {\n"
-    "    font-size: 1.5em;\n"
-    "    color: #e0e0e0;\n"
-    "    margin: 0 0 10px 0;\n"
-    "  }\n"
-    "  .page-title .gt { color: #4ecca3; }\n"
-    /* Nav */
-    "  .nav {\n"
-    "    margin-bottom: 15px;\n"
-    "  }\n"
-    "  .nav a {\n"
-    "    color: #e0e0e0;\n"
-    "    text-decoration: none;\n"
-    "    margin-right: 20px;\n"
-    "  }\n"
-    "  .nav a:hover { color: #ffffff; }\n"
-    "  .nav a.active { color: #4ecca3; }\n"
-    "  .nav .gt { color: #ff9f43; }\n"
-    "  .nav a.active .gt { color: #4ecca3; }\n"
-    "  .nav-line {\n"
-    "    border: none;\n"
-    "    border-top: 1px solid #3a3a3a;\n"
-    "    margin: 15px 0;\n"
-    "  }\n"
-    /* Content */
-    "  .content-meta {\n"
-    "    color: #808080;\n"
-    "    margin-bottom: 15px;\n"
-    "  }\n"
-    /* Puzzle box */
-    "  .puzzle-box {\n"
-    "    border: 2px solid #3a3a3a;\n"
-    "    border-radius: 15px;\n"
-    "    padding: 40px 30px;\n"
-    "    margin: 20px 0;\n"
-    "    min-height: 200px;\n"
-    "    display: flex;\n"
-    "    align-items: center;\n"
-    "    justify-content: center;\n"
-    "    text-align: center;\n"
-    "  }\n"
-    /* Buttons */
-    "  .action-btn {\n"
-    "    display: block;\n"
-    "    width: 100%;\n"
-    "    background: transparent;\n"
-    "    border: 2px solid #3a3a3a;\n"
-    "    border-radius: 10px;\n"
-    "    padding: 15px 20px;\n"
-    "    margin: 10px 0;\n"
-    "    color: #e0e0e0;\n"
-    "    font-family: inherit;\n"
-    "    font-size: inherit;\n"
-    "    text-align: left;\n"
-    "    cursor: pointer;\n"
-    "    text-decoration: none;\n"
-    "  }\n"
-    "  .action-btn:hover {\n"
-    "    border-color: #4ecca3;\n"
-    "  }\n"
-    "  .action-btn .gt { color: #4ecca3; margin-right: 15px; }\n"
-    "  .action-btn.secondary .gt { color: #ff9f43; }\n"
-    "  .action-btn input {\n"
-    "    background: transparent;\n"
-    "    border: none;\n"
-    "    color: #e0e0e0;\n"
-    "    font-family: inherit;\n"
-    "    font-size: inherit;\n"
-    "    width: calc(100% - 30px);\n"
-    "    padding: 0;\n"
-    "    margin: 0;\n"
-    "  }\n"
-    "  .action-btn input:focus { outline: none; }\n"
-    "  .action-btn input::placeholder { color: #606060; }\n"
-    /* Typography */
-    "  h1, h2, h3 {\n"
-    "    color: #e0e0e0;\n"
-    "    font-family: inherit;\n"
-    "    font-weight: normal;\n"
-    "    margin-top: 0;\n"
-    "  }\n"
-    "  h1 .gt, h2 .gt { color: #4ecca3; }\n"
-    "  a {\n"
-    "    color: #e0e0e0;\n"
-    "    text-decoration: none;\n"
-    "  }\n"
-    "  a:hover { color: #ffffff; }\n"
-    "  a .gt { color: #ff9f43; }\n"
-    "  .back-link { margin-bottom: 15px; display: block; }\n"
-    "  .back-link .gt { color: #ff9f43; }\n"
-    /* Forms */
-    "  input, button {\n"
-    "    background: #15191e;\n"
-    "    color: #e0e0e0;\n"
-    "    border: 1px solid #3a3a3a;\n"
-    "    padding: 10px 15px;\n"
-    "    font-family: inherit;\n"
-    "    font-size: inherit;\n"
-    "    margin: 5px 5px 5px 0;\n"
-    "  }\n"
-    "  input:focus {\n"
-    "    outline: none;\n"
-    "    border-color: #4ecca3;\n"
-    "  }\n"
-    "  input::placeholder { color: #505050; }\n"
-    "  button {\n"
-    "    cursor: pointer;\n"
-    "  }\n"
-    "  button:hover {\n"
-    "    border-color: #4ecca3;\n"
-    "  }\n"
-    /* Status */
-    "  .success { color: #4ecca3; }\n"
-    "  .error { color: #ff6b6b; }\n"
-    "  .muted { color: #606060; }\n"
-    /* Tables */
-    "  table {\n"
-    "    width: 100%;\n"
-    "    border-collapse: collapse;\n"
-    "    margin: 20px 0;\n"
-    "  }\n"
-    "  th, td {\n"
-    "    padding: 10px;\n"
-    "    text-align: left;\n"
-    "  }\n"
-    "  th { color: #808080; }\n"
-    "  td .gt { color: #4ecca3; }\n"
-    /* List rows */
-    "  .list-row {\n"
-    "    padding: 8px 0;\n"
-    "  }\n"
-    "  .list-row .gt { color: #4ecca3; }\n"
-    "  .list-row a { color: #e0e0e0; }\n"
-    "  .list-row a:hover { color: #ffffff; }\n"
-    "</style>\n";
+    "<link rel=\"stylesheet\" href=\"" ASSET_STYLE_CSS_URL "\">\n";
 
 static int method_is(struct mg_http_message *hm, const char *method) {
     return mg_strcmp(hm->method, mg_str(method)) == 0;
@@ -241,43 +54,64 @@ static int get_query_var(struct mg_http_message *hm, const char *name,
     return mg_http_get_var(&hm->query, name, buf, buf_size);
 }
 
+/* Boosted navigation: pages carry hx-boost, so htmx fetches the next
+   page with HX-Request and swaps its body into the current document,
+   whose head (stylesheet, htmx) is already loaded. Those requests get
+   only the body. A history restore rebuilds the page and needs it all. */
+static int is_boosted(struct mg_http_message *hm) {
+    struct mg_str *hx = mg_http_get_header(hm, "HX-Request");
+    return method_is(hm, "GET") && hx != NULL && mg_strcmp(*hx, mg_str("true")) == 0 &&
+           mg_http_get_header(hm, "HX-History-Restore-Request") == NULL;
+}
+
+/* Response headers for a navigable page. The URL is pushed explicitly
+   so the address bar follows redirects as well. */
+static const char *page_headers(struct mg_http_message *hm) {
+    static char headers[512];
+    if (!is_boosted(hm))
+        return "Content-Type: text/html\r\nVary: HX-Request\r\n";
+    snprintf(headers, sizeof(headers),
+             "Content-Type: text/html\r\nVary: HX-Request\r\nHX-Push-Url: %.*s%s%.*s\r\n",
+             (int)hm->uri.len, hm->uri.buf, hm->query.len ? "?" : "",
+             (int)hm->query.len, hm->query.buf);
+    return headers;
+}
+
+/* Everything before a navigable page's content: the document head, or
+   for a boosted request just the title, which htmx applies. title must
+   already be escaped. */
+static const char *page_head(struct mg_http_message *hm, const char *title) {
+    static char head[2048];
+    if (is_boosted(hm))
+        snprintf(head, sizeof(head), "<title>%s</title>\n", title);
+    else
+        snprintf(head, sizeof(head),
+                 "<!DOCTYPE html>\n"
+                 "<html><head>\n"
+                 "<title>%s</title>\n"
+                 "%s"
+                 "<script src=\"" ASSET_HTMX_MIN_JS_URL "\" defer></script>\n"
+                 "</head>\n"
+                 "<body hx-boost=\"true\">\n",
+                 title, TERMINAL_CSS);
+    return head;
+}
+
+static const char *page_tail(struct mg_http_message *hm) {
+    return is_boosted(hm) ? "" : "</body></html>\n";
+}
+
 /* Returns 1 if session cookie found, 0 otherwise */
 static int get_session_cookie(struct mg_http_message *hm, char *buf, size_t buf_size) {
     struct mg_str *cookie_header = mg_http_get_header(hm, "Cookie");
     if (cookie_header == NULL)
         return 0;
-
-    const char *p = cookie_header->buf;
-    const char *end = p + cookie_header->len;
-    const char *prefix = "session=";
-    size_t prefix_len = 8;
-
-    while (p < end) {
-        while (p < end && (*p == ' ' || *p == ';')) p++;
-
-        if (p + prefix_len <= end && memcmp(p, prefix, prefix_len) == 0) {
-            p += prefix_len;
-            const char *value_start = p;
-            while (p < end && *p != ';' && *p != ' ') p++;
-            size_t value_len = p - value_start;
-
-            if (value_len >= buf_size)
-                value_len = buf_size - 1;
-
-            memcpy(buf, value_start, value_len);
-            buf[value_len] = '\0';
-            return 1;
-        }
-
-        while (p < end && *p != ';') p++;
-    }
-
-    return 0;
+    return cookie_value(cookie_header->buf, cookie_header->len, "session", buf, buf_size);
 }
 
 /* Returns 1 if logged in, 0 otherwise */
 static int get_current_user(struct mg_http_message *hm, User *user) {
-    char session_token[65];
+    char session_token[SESSION_TOKEN_MAX];
 
     if (!get_session_cookie(hm, session_token, sizeof(session_token)))
         return 0;
@@ -286,7 +120,7 @@ static int get_current_user(struct mg_http_message *hm, User *user) {
 }
 
 static void handle_login_page(struct mg_connection *c) {
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+    http_reply(c, 200, "Content-Type: text/html\r\n",
         "<!DOCTYPE html>\n"
         "<html><head>\n"
         "<title>Login - Daily Puzzle</title>\n"
@@ -317,48 +151,6 @@ static void handle_login_page(struct mg_connection *c) {
         TERMINAL_CSS);
 }
 
-/* Sends email via Resend API in a forked child process so the event loop is
-   never blocked. Returns 0 (fire-and-forget). */
-static int send_email(const char *to, const char *subject, const char *html) {
-    const char *api_key = getenv("RESEND_API_KEY");
-    const char *from = getenv("RESEND_FROM_EMAIL");
-
-    if (!api_key || !from)
-        return -1;
-
-    char safe_from[512], safe_to[512], safe_subject[512], safe_html[4096];
-    json_escape(from, safe_from, sizeof(safe_from));
-    json_escape(to, safe_to, sizeof(safe_to));
-    json_escape(subject, safe_subject, sizeof(safe_subject));
-    json_escape(html, safe_html, sizeof(safe_html));
-
-    char json[6144];
-    snprintf(json, sizeof(json),
-        "{\"from\":\"%s\",\"to\":[\"%s\"],\"subject\":\"%s\",\"html\":\"%s\"}",
-        safe_from, safe_to, safe_subject, safe_html);
-
-    pid_t pid = fork();
-    if (pid < 0)
-        return -1;
-
-    if (pid == 0) {
-        /* Child process: send email via curl, then exit */
-        char auth_header[256];
-        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", api_key);
-
-        execlp("curl", "curl", "-sf", "-m", "10",
-               "-X", "POST", "https://api.resend.com/emails",
-               "-H", auth_header,
-               "-H", "Content-Type: application/json",
-               "-d", json,
-               (char *)NULL);
-        _exit(1);
-    }
-
-    /* Parent: don't wait — SIGCHLD handler reaps */
-    return 0;
-}
-
 static void get_client_ip(struct mg_connection *c, struct mg_http_message *hm,
                           char *ip, size_t ip_size) {
     struct mg_str *xff = mg_http_get_header(hm, "X-Forwarded-For");
@@ -378,33 +170,11 @@ static void get_client_ip(struct mg_connection *c, struct mg_http_message *hm,
 }
 
 static void handle_login_submit(struct mg_connection *c, struct mg_http_message *hm) {
-    char ip[64] = {0};
-    get_client_ip(c, hm, ip, sizeof(ip));
-
-    if (!rate_limit_check(ip)) {
-        mg_http_reply(c, 429, "Content-Type: text/html\r\n",
-            "<!DOCTYPE html>\n<html><head><title>Rate Limited</title>%s</head>\n"
-            "<body>\n"
-            "<div class=\"page-header\">\n"
-            "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Too Many Requests</div>\n"
-            "  <hr class=\"nav-line\">\n"
-            "</div>\n"
-            "<div class=\"puzzle-box\">\n"
-            "  <div>Too many login attempts.<br>Please wait a minute and try again.</div>\n"
-            "</div>\n"
-            "<a href=\"/login\" class=\"action-btn\">\n"
-            "  <span class=\"gt\">&gt;</span>Back to login\n"
-            "</a>\n"
-            "</body></html>\n",
-            TERMINAL_CSS);
-        return;
-    }
-
     char email[256] = {0};
     char safe_email[1536] = {0};
 
     if (get_form_var(hm, "email", email, sizeof(email)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n<html><head><title>Error</title>%s</head>\n"
             "<body><h1>Error</h1><p class=\"error\">Email is required.</p>\n"
             "<p><a href=\"/login\">&lt; Back to login</a></p></body></html>\n",
@@ -415,7 +185,7 @@ static void handle_login_submit(struct mg_connection *c, struct mg_http_message
     char token[65];
     char code[AUTH_CODE_LEN + 1];
     if (auth_create_magic_link(email, token, code) != 0) {
-        mg_http_reply(c, 500, "Content-Type: text/html\r\n",
+        http_reply(c, 500, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n<html><head><title>Error</title>%s</head>\n"
             "<body><h1>Error</h1><p class=\"error\">Failed to create login code.</p>\n"
             "<p><a href=\"/login\">&lt; Back to login</a></p></body></html>\n",
@@ -423,6 +193,7 @@ static void handle_login_submit(struct mg_connection *c, struct mg_http_message
         return;
     }
 
+    metrics_inc(METRIC_LOGIN_CODES);
     html_escape(email, safe_email, sizeof(safe_email));
 
     const char *resend_key = getenv("RESEND_API_KEY");
@@ -432,12 +203,13 @@ static void handle_login_submit(struct mg_connection *c, struct mg_http_message
         char html[1024];
         snprintf(html, sizeof(html),
             "<p>Your login code for Puzzle Pause is:</p>"
-            "<p style=\\\"font-size:24px;font-weight:bold;letter-spacing:4px;\\\">%s</p>"
+            "<p style=\"font-size:24px;font-weight:bold;letter-spacing:4px;\">%s</p>"
             "<p>This code expires in 15 minutes.</p>",
             code);
 
-        if (send_email(email, "Your Puzzle Pause login code", html) != 0) {
-            mg_http_reply(c, 500, "Content-Type: text/html\r\n",
+        /* Queued: the outbox thread delivers it and retries on failure */
+        if (outbox_enqueue(email, "Your Puzzle Pause login code", html) != 0) {
+            http_reply(c, 500, "Content-Type: text/html\r\n",
                 "<!DOCTYPE html>\n<html><head><title>Error</title>%s</head>\n"
                 "<body><div class=\"page-header\">\n"
                 "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Error</div>\n"
@@ -459,7 +231,7 @@ static void handle_login_submit(struct mg_connection *c, struct mg_http_message
         fflush(stdout);
     }
 
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+    http_reply(c, 200, "Content-Type: text/html\r\n",
         "<!DOCTYPE html>\n"
         "<html><head><title>Enter Code</title>%s</head>\n"
         "<body>\n"
@@ -496,6 +268,8 @@ static void handle_login_submit(struct mg_connection *c, struct mg_http_message
 }
 
 static void set_session_and_redirect(struct mg_connection *c, const char *session_token) {
+    metrics_inc(METRIC_LOGINS);
+
     char headers[512];
     snprintf(headers, sizeof(headers),
         "Set-Cookie: session=%s; HttpOnly; Secure; SameSite=Strict; Path=/; Max-Age=%d\r\n"
@@ -503,7 +277,7 @@ static void set_session_and_redirect(struct mg_connection *c, const char *sessio
         "Content-Type: text/html\r\n",
         session_token, SESSION_EXPIRY_SECS);
 
-    mg_http_reply(c, 302, headers,
+    http_reply(c, 302, headers,
         "<!DOCTYPE html>\n"
         "<html><head><title>Redirecting...</title></head>\n"
         "<body><p>Redirecting to <a href=\"/\">home page</a>...</p></body></html>\n");
@@ -511,11 +285,11 @@ static void set_session_and_redirect(struct mg_connection *c, const char *sessio
 
 static void handle_auth(struct mg_connection *c, struct mg_http_message *hm) {
     char token[65];
-    char session_token[65];
+    char session_token[SESSION_TOKEN_MAX];
     int64_t user_id;
 
     if (get_query_var(hm, "token", token, sizeof(token)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n<html><head><title>Error</title>%s</head>\n"
             "<body><h1>Error</h1><p class=\"error\">Missing token.</p></body></html>\n",
             TERMINAL_CSS);
@@ -523,7 +297,7 @@ static void handle_auth(struct mg_connection *c, struct mg_http_message *hm) {
     }
 
     if (auth_validate_magic_link(token, session_token, &user_id) != 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n"
             "<html><head><title>Invalid Link</title>%s</head>\n"
             "<body>\n"
@@ -542,12 +316,12 @@ static void handle_auth_code(struct mg_connection *c, struct mg_http_message *hm
     char email[256] = {0};
     char code[16] = {0};
     char safe_email[1536] = {0};
-    char session_token[65];
+    char session_token[SESSION_TOKEN_MAX];
     int64_t user_id;
 
     if (get_form_var(hm, "email", email, sizeof(email)) <= 0 ||
         get_form_var(hm, "code", code, sizeof(code)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n<html><head>%s</head>\n"
             "<body><h1>Error</h1><p class=\"error\">Email and code are required.</p>\n"
             "<p><a href=\"/login\">&lt; Back to login</a></p></body></html>\n",
@@ -558,7 +332,7 @@ static void handle_auth_code(struct mg_connection *c, struct mg_http_message *hm
     html_escape(email, safe_email, sizeof(safe_email));
 
     if (auth_validate_code(email, code, session_token, &user_id) != 0) {
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+        http_reply(c, 200, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n"
             "<html><head><title>Invalid Code</title>%s</head>\n"
             "<body>\n"
@@ -593,13 +367,13 @@ static void handle_auth_code(struct mg_connection *c, struct mg_http_message *hm
 }
 
 static void handle_logout(struct mg_connection *c, struct mg_http_message *hm) {
-    char session_token[65];
+    char session_token[SESSION_TOKEN_MAX];
 
     if (get_session_cookie(hm, session_token, sizeof(session_token)))
         auth_logout(session_token);
 
     /* Max-Age=0 tells browser to delete the cookie */
-    mg_http_reply(c, 302,
+    http_reply(c, 302,
         "Set-Cookie: session=; HttpOnly; Secure; SameSite=Strict; Path=/; Max-Age=0\r\n"
         "Location: /\r\n"
         "Content-Type: text/html\r\n",
@@ -608,9 +382,18 @@ static void handle_logout(struct mg_connection *c, struct mg_http_message *hm) {
         "<body><p>Redirecting to <a href=\"/\">home page</a>...</p></body></html>\n");
 }
 
-static void handle_puzzle_page(struct mg_connection *c, struct mg_http_message *hm, User *user) {
-    Puzzle puzzle;
+/* Pages render one at a time on the event loop; this is too big for the stack */
+static TemplateRender page_render;
 
+#define HINT_FORM(cost) \
+    "<form action=\"/puzzle/hint\" method=\"POST\" hx-post=\"/puzzle/hint\" hx-target=\"#hint-area\" hx-swap=\"innerHTML\">\n" \
+    "  <input type=\"hidden\" name=\"puzzle_id\" value=\"0\">\n" \
+    "  <button data-testid=\"hint-button\" type=\"submit\" class=\"action-btn secondary\">\n" \
+    "    <span class=\"gt\">&gt;</span>Hint?" cost "\n" \
+    "  </button>\n" \
+    "</form>\n"
+
+static void handle_puzzle_page(struct mg_connection *c, struct mg_http_message *hm, User *user) {
     char wrong_param[8] = {0};
     struct mg_str query = hm->query;
     mg_http_get_var(&query, "wrong", wrong_param, sizeof(wrong_param));
@@ -623,11 +406,10 @@ static void handle_puzzle_page(struct mg_connection *c, struct mg_http_message *
         : "    <a href=\"/archive\"><span class=\"gt\">&gt;</span>Archive</a>\n"
           "    <a href=\"/login\"><span class=\"gt\">&gt;</span>Login</a>\n";
 
-    if (puzzle_get_today(&puzzle) != 0) {
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
-            "<!DOCTYPE html>\n"
-            "<html><head><title>Daily Puzzle</title>%s</head>\n"
-            "<body>\n"
+    const ReleaseDay *day = release_today(time(NULL));
+    if (!day->found) {
+        http_reply(c, 200, page_headers(hm),
+            "%s"
             "<div class=\"page-header\">\n"
             "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Daily Puzzle</div>\n"
             "  <nav class=\"nav\">\n"
@@ -638,174 +420,61 @@ static void handle_puzzle_page(struct mg_connection *c, struct mg_http_message *
             "<div class=\"puzzle-box\">\n"
             "  <div>No puzzle available yet.<br>Check back after 09:00 UTC!</div>\n"
             "</div>\n"
-            "</body></html>\n",
-            TERMINAL_CSS, nav);
+            "%s",
+            page_head(hm, "Daily Puzzle"), nav, page_tail(hm));
         return;
     }
+    const Puzzle *puzzle = &day->puzzle;
 
     int hint_shown = 0;
     if (user) {
         Attempt attempt;
-        if (puzzle_get_attempt(user->id, puzzle.id, &attempt) == 0 && attempt.solved) {
-            mg_http_reply(c, 302, "Location: /puzzle/result\r\n", "");
+        if (puzzle_get_attempt(user->id, puzzle->id, &attempt) == 0 && attempt.solved) {
+            http_reply(c, 302, "Location: /puzzle/result\r\n", "");
             return;
         }
-        hint_shown = (puzzle_get_attempt(user->id, puzzle.id, &attempt) == 0)
+        hint_shown = (puzzle_get_attempt(user->id, puzzle->id, &attempt) == 0)
                      ? attempt.hint_used : 0;
     }
 
-    int show_hint_button = puzzle.has_hint && !hint_shown;
-
-    mg_printf(c,
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/html\r\n"
-        "Transfer-Encoding: chunked\r\n\r\n");
-
-    int pnum = puzzle_get_number(puzzle.id);
-    char safe_pname[1024] = {0};
-    html_escape(puzzle.puzzle_name, safe_pname, sizeof(safe_pname));
-
-    mg_http_printf_chunk(c,
-        "<!DOCTYPE html>\n"
-        "<html><head>\n"
-        "<title>#%d. %s</title>\n"
-        "%s"
-        "<script src=\"/static/htmx.min.js\" defer></script>\n"
-        "</head>\n"
-        "<body>\n"
-        "<div class=\"page-header\">\n"
-        "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>#%d. %s</div>\n"
-        "  <nav class=\"nav\">\n"
-        "%s"
-        "  </nav>\n"
-        "  <hr class=\"nav-line\">\n"
-        "</div>\n"
-        "<div class=\"content-meta\">\n"
-        "  %s<br>\n"
-        "  Score: 100 pts base, -5 per wrong guess%s\n"
-        "%s"
-        "</div>\n",
-        pnum, safe_pname,
-        TERMINAL_CSS,
-        pnum, safe_pname,
-        nav,
-        puzzle.puzzle_date,
-        puzzle.has_hint ? ", -10 for hint" : "",
-        user ? "" : "  <br><a href=\"/login\">Log in</a> to save your score and compete in leagues.\n");
-
-    if (strcmp(puzzle.puzzle_type, "ladder") == 0) {
-        LadderStep steps[MAX_LADDER_STEPS];
-        int step_count = puzzle_parse_ladder(puzzle.question, steps, MAX_LADDER_STEPS);
-
-        mg_http_printf_chunk(c,
-            "<div data-testid=\"puzzle-container\" class=\"puzzle-box\" style=\"text-align:left;display:block;\">\n"
-            "  <div>\n");
-        for (int i = 0; i < step_count; i++) {
-            if (steps[i].is_blank) {
-                mg_http_printf_chunk(c, "    <div>%d. ____</div>\n", i + 1);
-            } else {
-                char safe_word[256] = {0};
-                html_escape(steps[i].word, safe_word, sizeof(safe_word));
-                mg_http_printf_chunk(c, "    <div>%d. %s</div>\n", i + 1, safe_word);
-            }
-        }
-        mg_http_printf_chunk(c, "  </div>\n</div>\n");
-    } else if (strcmp(puzzle.puzzle_type, "choice") == 0) {
-        ChoicePuzzle cp;
-        if (puzzle_parse_choice(puzzle.question, &cp) == 0) {
-            char safe_prompt[2048] = {0};
-            html_escape(cp.prompt, safe_prompt, sizeof(safe_prompt));
-            mg_http_printf_chunk(c,
-                "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">\n"
-                "  <div>%s</div>\n"
-                "</div>\n",
-                safe_prompt);
-        }
-    } else {
-        mg_http_printf_chunk(c,
-            "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">\n"
-            "  <div>%s</div>\n"
-            "</div>\n",
-            puzzle.question);
-    }
-
-    mg_http_printf_chunk(c,
-        "<div id=\"hint-area\">%s%s%s</div>\n",
-        (puzzle.has_hint && hint_shown)
-            ? "<div class=\"action-btn secondary\"><span class=\"gt\">&gt;</span>Hint: "
-            : "",
-        (puzzle.has_hint && hint_shown) ? puzzle.hint : "",
-        (puzzle.has_hint && hint_shown) ? "</div>" : "");
-    if (show_hint_button) {
-        mg_http_printf_chunk(c,
-            "<form action=\"/puzzle/hint\" method=\"POST\" hx-post=\"/puzzle/hint\" hx-target=\"#hint-area\" hx-swap=\"innerHTML\">\n"
-            "  <input type=\"hidden\" name=\"puzzle_id\" value=\"0\">\n"
-            "  <button data-testid=\"hint-button\" type=\"submit\" class=\"action-btn secondary\">\n"
-            "    <span class=\"gt\">&gt;</span>Hint?%s\n"
-            "  </button>\n"
-            "</form>\n",
-            user ? " (-10 pts)" : "");
-    }
-
-    mg_http_printf_chunk(c,
-        "<form action=\"/puzzle/attempt\" method=\"POST\" hx-post=\"/puzzle/attempt\" hx-target=\"#feedback\" hx-swap=\"innerHTML\">\n"
-        "  <input type=\"hidden\" name=\"puzzle_id\" value=\"%lld\">\n",
-        (long long)puzzle.id);
-
-    if (strcmp(puzzle.puzzle_type, "ladder") == 0) {
-        LadderStep steps[MAX_LADDER_STEPS];
-        int step_count = puzzle_parse_ladder(puzzle.question, steps, MAX_LADDER_STEPS);
-        int blank_idx = 0;
-
-        for (int i = 0; i < step_count; i++) {
-            if (steps[i].is_blank) {
-                mg_http_printf_chunk(c,
-                    "  <label class=\"action-btn\">\n"
-                    "    <span class=\"gt\">&gt;</span>\n"
-                    "    <input type=\"text\" name=\"step_%d\" placeholder=\"Step %d\" autocomplete=\"off\" required>\n"
-                    "  </label>\n",
-                    blank_idx, i + 1);
-                blank_idx++;
-            }
-        }
-    } else if (strcmp(puzzle.puzzle_type, "choice") == 0) {
-        ChoicePuzzle cp;
-        if (puzzle_parse_choice(puzzle.question, &cp) == 0) {
-            for (int i = 0; i < cp.num_options; i++) {
-                char safe_opt[512] = {0};
-                html_escape(cp.options[i], safe_opt, sizeof(safe_opt));
-                mg_http_printf_chunk(c,
-                    "  <label class=\"action-btn\">\n"
-                    "    <span class=\"gt\">&gt;</span>\n"
-                    "    <input type=\"radio\" name=\"guess\" value=\"%c\" required "
-                    "style=\"margin-right:10px;\"> %c. %s\n"
-                    "  </label>\n",
-                    'a' + i, 'A' + i, safe_opt);
-            }
-        }
-    } else if (strcmp(puzzle.puzzle_type, "math") == 0) {
-        mg_http_printf_chunk(c,
-            "  <label class=\"action-btn\">\n"
-            "    <span class=\"gt\">&gt;</span>\n"
-            "    <input data-testid=\"answer-input\" type=\"number\" step=\"any\" name=\"guess\" placeholder=\"Enter your answer\" autocomplete=\"off\" required>\n"
-            "  </label>\n");
-    } else {
-        mg_http_printf_chunk(c,
-            "  <label class=\"action-btn\">\n"
-            "    <span class=\"gt\">&gt;</span>\n"
-            "    <input data-testid=\"answer-input\" type=\"text\" name=\"guess\" placeholder=\"Enter your answer\" autocomplete=\"off\" required>\n"
-            "  </label>\n");
+    int show_hint_button = puzzle->has_hint && !hint_shown;
+
+    char hint_area[sizeof(puzzle->hint) + 128] = "";
+    if (puzzle->has_hint && hint_shown)
+        snprintf(hint_area, sizeof(hint_area),
+                 "<div class=\"action-btn secondary\"><span class=\"gt\">&gt;</span>Hint: %s</div>",
+                 puzzle->hint);
+
+    char safe_pname[1024], title[1100];
+    html_escape(puzzle->puzzle_name, safe_pname, sizeof(safe_pname));
+    snprintf(title, sizeof(title), "#%d. %s", day->number, safe_pname);
+
+    /* Question and inputs are parsed and rendered once per day by release.c */
+    TemplateRender *r = &page_render;
+    tpl_begin(r, &TPL_PUZZLE_PAGE);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HEAD, page_head(hm, title));
+    tpl_set_int(r, TPL_PUZZLE_PAGE_NUMBER, day->number);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_NAME, puzzle->puzzle_name);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_NAV, nav);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_DATE, puzzle->puzzle_date);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HINT_COST, puzzle->has_hint ? ", -10 for hint" : "");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_LOGIN_PROMPT, user ? "" :
+        "  <br><a href=\"/login\">Log in</a> to save your score and compete in leagues.\n");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_QUESTION, day->question_html);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HINT_AREA, hint_area);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_HINT_FORM, !show_hint_button ? ""
+        : user ? HINT_FORM(" (-10 pts)") : HINT_FORM(""));
+    tpl_set_int(r, TPL_PUZZLE_PAGE_PUZZLE_ID, puzzle->id);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_INPUTS, day->inputs_html);
+    tpl_set_str(r, TPL_PUZZLE_PAGE_FEEDBACK, show_wrong_feedback
+        ? "<div style=\"color:#ff6b6b;\">Incorrect. Try again!</div>" : "");
+    tpl_set_str(r, TPL_PUZZLE_PAGE_TAIL, page_tail(hm));
+
+    if (tpl_render(r) != 0) {
+        http_reply(c, 500, "Content-Type: text/plain\r\n", "Internal Server Error\n");
+        return;
     }
-
-    mg_http_printf_chunk(c,
-        "  <button data-testid=\"submit-button\" type=\"submit\" class=\"action-btn\">\n"
-        "    <span class=\"gt\">&gt;</span>Submit\n"
-        "  </button>\n"
-        "</form>\n"
-        "<div id=\"feedback\" style=\"margin-top:15px;\">%s</div>\n"
-        "</body></html>\n",
-        show_wrong_feedback ? "<div style=\"color:#ff6b6b;\">Incorrect. Try again!</div>" : "");
-    mg_http_printf_chunk(c, "");
+    http_reply_iov(c, 200, page_headers(hm), r->iov, r->iovcnt);
 }
 
 /* Build full answer from ladder step form fields merged with the question template */
@@ -849,6 +518,26 @@ static int reconstruct_ladder_guess(struct mg_http_message *hm, const char *ques
     return 0;
 }
 
+/* Reads the guess for puzzle from the form fields its type uses. Returns
+   NULL on success, or the message to show when they are missing or invalid. */
+static const char *read_guess(struct mg_http_message *hm, const Puzzle *puzzle,
+                              char *guess, size_t guess_size) {
+    if (strcmp(puzzle->puzzle_type, "ladder") == 0) {
+        if (reconstruct_ladder_guess(hm, puzzle->question, guess, guess_size) != 0)
+            return "Please fill in all blanks.";
+    } else if (strcmp(puzzle->puzzle_type, "choice") == 0) {
+        if (get_form_var(hm, "guess", guess, guess_size) <= 0)
+            return "Please select an option.";
+        ChoicePuzzle cp;
+        if (puzzle_parse_choice(puzzle->question, &cp) != 0 ||
+            strlen(guess) != 1 || guess[0] < 'a' || guess[0] > 'a' + cp.num_options - 1)
+            return "Invalid selection.";
+    } else if (get_form_var(hm, "guess", guess, guess_size) <= 0) {
+        return "Please enter an answer.";
+    }
+    return NULL;
+}
+
 static void handle_puzzle_attempt(struct mg_connection *c, struct mg_http_message *hm,
                                   User *user) {
     char guess[256] = {0};
@@ -859,10 +548,10 @@ static void handle_puzzle_attempt(struct mg_connection *c, struct mg_http_messag
 
     if (get_form_var(hm, "puzzle_id", puzzle_id_str, sizeof(puzzle_id_str)) <= 0) {
         if (is_htmx) {
-            mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+            http_reply(c, 200, "Content-Type: text/html\r\n",
                 "<div style=\"color:#ff6b6b;\">Invalid request.</div>\n");
         } else {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+            http_reply(c, 302, "Location: /puzzle\r\n", "");
         }
         return;
     }
@@ -870,81 +559,62 @@ static void handle_puzzle_attempt(struct mg_connection *c, struct mg_http_messag
     int64_t puzzle_id = atoll(puzzle_id_str);
 
     Puzzle puzzle;
-    if (puzzle_get_by_id(puzzle_id, &puzzle) != 0) {
+    const ReleaseDay *day = release_today(time(NULL));
+    if (day->found && day->puzzle.id == puzzle_id) {
+        puzzle = day->puzzle;
+    } else if (puzzle_get_by_id(puzzle_id, &puzzle) != 0) {
         if (is_htmx) {
-            mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+            http_reply(c, 200, "Content-Type: text/html\r\n",
                 "<div style=\"color:#ff6b6b;\">Puzzle not found.</div>\n");
         } else {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+            http_reply(c, 302, "Location: /puzzle\r\n", "");
         }
         return;
     }
 
-    if (strcmp(puzzle.puzzle_type, "ladder") == 0) {
-        if (reconstruct_ladder_guess(hm, puzzle.question, guess, sizeof(guess)) != 0) {
-            if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
-                    "<div style=\"color:#ff6b6b;\">Please fill in all blanks.</div>\n");
-            } else {
-                mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
-            }
-            return;
-        }
-    } else if (strcmp(puzzle.puzzle_type, "choice") == 0) {
-        if (get_form_var(hm, "guess", guess, sizeof(guess)) <= 0) {
-            if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
-                    "<div style=\"color:#ff6b6b;\">Please select an option.</div>\n");
-            } else {
-                mg_http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
-            }
-            return;
-        }
-        ChoicePuzzle cp;
-        if (puzzle_parse_choice(puzzle.question, &cp) != 0 ||
-            strlen(guess) != 1 || guess[0] < 'a' || guess[0] > 'a' + cp.num_options - 1) {
-            if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
-                    "<div style=\"color:#ff6b6b;\">Invalid selection.</div>\n");
-            } else {
-                mg_http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
-            }
-            return;
-        }
-    } else if (get_form_var(hm, "guess", guess, sizeof(guess)) <= 0) {
+    const char *invalid = read_guess(hm, &puzzle, guess, sizeof(guess));
+    if (invalid) {
         if (is_htmx) {
-            mg_http_reply(c, 200, "Content-Type: text/html\r\n",
-                "<div style=\"color:#ff6b6b;\">Please enter an answer.</div>\n");
+            http_reply(c, 200, "Content-Type: text/html\r\n",
+                "<div style=\"color:#ff6b6b;\">%s</div>\n", invalid);
+        } else if (strcmp(puzzle.puzzle_type, "choice") == 0) {
+            http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
         } else {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+            http_reply(c, 302, "Location: /puzzle\r\n", "");
         }
         return;
     }
     if (user) {
         int score = 0;
         int result = puzzle_submit_guess(user->id, puzzle_id, guess, &score);
+        if (result >= 0)
+            metrics_inc(METRIC_GUESSES);
+        if (result == 1) {
+            metrics_inc(METRIC_SOLVES);
+            live_user_solved(user->id);
+        }
 
         if (result == 1) {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div style=\"color:#4ecca3;\">Correct! Redirecting...</div>\n"
                     "<script>setTimeout(function() { window.location.href = '/puzzle/result'; }, 500);</script>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle/result\r\n", "");
+                http_reply(c, 302, "Location: /puzzle/result\r\n", "");
             }
         } else if (result == 0) {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div style=\"color:#ff6b6b;\">Incorrect. Try again!</div>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
+                http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
             }
         } else {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div style=\"color:#ff6b6b;\">Something went wrong. Please try again.</div>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+                http_reply(c, 302, "Location: /puzzle\r\n", "");
             }
         }
     } else {
@@ -957,26 +627,26 @@ static void handle_puzzle_attempt(struct mg_connection *c, struct mg_http_messag
             snprintf(location, sizeof(location), "Location: /puzzle/result?score=%d\r\n", score);
 
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div style=\"color:#4ecca3;\">Correct! Redirecting...</div>\n"
                     "<script>setTimeout(function() { window.location.href = '/puzzle/result?score=%d'; }, 500);</script>\n",
                     score);
             } else {
-                mg_http_reply(c, 302, location, "");
+                http_reply(c, 302, location, "");
             }
         } else if (result == 0) {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div style=\"color:#ff6b6b;\">Incorrect. Try again!</div>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
+                http_reply(c, 302, "Location: /puzzle?wrong=1\r\n", "");
             }
         } else {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div style=\"color:#ff6b6b;\">Something went wrong. Please try again.</div>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+                http_reply(c, 302, "Location: /puzzle\r\n", "");
             }
         }
     }
@@ -986,39 +656,40 @@ static void handle_puzzle_hint(struct mg_connection *c, struct mg_http_message *
     struct mg_str *hx_request = mg_http_get_header(hm, "HX-Request");
     int is_htmx = (hx_request != NULL && hx_request->len > 0);
 
-    Puzzle puzzle;
-
-    if (puzzle_get_today(&puzzle) != 0) {
+    const ReleaseDay *day = release_today(time(NULL));
+    if (!day->found) {
         if (is_htmx) {
-            mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+            http_reply(c, 200, "Content-Type: text/html\r\n",
                 "<div class=\"action-btn\" style=\"border-color:#ff6b6b;\">"
                 "<span class=\"gt\" style=\"color:#ff6b6b;\">&gt;</span>No puzzle available</div>\n");
         } else {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+            http_reply(c, 302, "Location: /puzzle\r\n", "");
         }
         return;
     }
+    Puzzle puzzle = day->puzzle;
 
     char hint[512] = {0};
     if (user) {
         if (puzzle_reveal_hint(user->id, puzzle.id, hint, sizeof(hint)) != 0) {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div class=\"action-btn secondary\">"
                     "<span class=\"gt\">&gt;</span>No hint available</div>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+                http_reply(c, 302, "Location: /puzzle\r\n", "");
             }
             return;
         }
+        metrics_inc(METRIC_HINTS);
     } else {
         if (!puzzle.has_hint || puzzle.hint[0] == '\0') {
             if (is_htmx) {
-                mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+                http_reply(c, 200, "Content-Type: text/html\r\n",
                     "<div class=\"action-btn secondary\">"
                     "<span class=\"gt\">&gt;</span>No hint available</div>\n");
             } else {
-                mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+                http_reply(c, 302, "Location: /puzzle\r\n", "");
             }
             return;
         }
@@ -1026,22 +697,22 @@ static void handle_puzzle_hint(struct mg_connection *c, struct mg_http_message *
     }
 
     if (is_htmx) {
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+        http_reply(c, 200, "Content-Type: text/html\r\n",
             "<div class=\"action-btn secondary\">"
             "<span class=\"gt\">&gt;</span>Hint: %s</div>\n", hint);
     } else {
-        mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+        http_reply(c, 302, "Location: /puzzle\r\n", "");
     }
 }
 
 static void handle_puzzle_result(struct mg_connection *c, struct mg_http_message *hm,
                                   User *user) {
-    Puzzle puzzle;
-
-    if (puzzle_get_today(&puzzle) != 0) {
-        mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+    const ReleaseDay *day = release_today(time(NULL));
+    if (!day->found) {
+        http_reply(c, 302, "Location: /puzzle\r\n", "");
         return;
     }
+    Puzzle puzzle = day->puzzle;
 
     char display_answer[256] = {0};
     const char *ans_src = puzzle.answer[0] == '~' ? puzzle.answer + 1 : puzzle.answer;
@@ -1054,7 +725,7 @@ static void handle_puzzle_result(struct mg_connection *c, struct mg_http_message
     if (user) {
         Attempt attempt;
         if (puzzle_get_attempt(user->id, puzzle.id, &attempt) != 0 || !attempt.solved) {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+            http_reply(c, 302, "Location: /puzzle\r\n", "");
             return;
         }
 
@@ -1086,7 +757,7 @@ static void handle_puzzle_result(struct mg_connection *c, struct mg_http_message
             hints, hints == 1 ? "hint" : "hints",
             base_url);
 
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+        http_reply(c, 200, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n"
             "<html><head><title>Puzzle Complete!</title>%s</head>\n"
             "<body>\n"
@@ -1143,7 +814,7 @@ static void handle_puzzle_result(struct mg_connection *c, struct mg_http_message
         mg_http_get_var(&query, "score", score_str, sizeof(score_str));
 
         if (score_str[0] == '\0') {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
+            http_reply(c, 302, "Location: /puzzle\r\n", "");
             return;
         }
 
@@ -1162,7 +833,7 @@ static void handle_puzzle_result(struct mg_connection *c, struct mg_http_message
             "Check out the puzzle here: %s/puzzle",
             time_hhmm, base_url);
 
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+        http_reply(c, 200, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n"
             "<html><head><title>Puzzle Complete!</title>%s</head>\n"
             "<body>\n"
@@ -1205,29 +876,23 @@ static void handle_puzzle_result(struct mg_connection *c, struct mg_http_message
     }
 }
 
-static void handle_leagues_list(struct mg_connection *c, User *user) {
+static void handle_leagues_list(struct mg_connection *c, struct mg_http_message *hm,
+                               User *user) {
     League leagues[50];
     int count;
 
     if (league_get_user_leagues(user->id, leagues, 50, &count) != 0) {
-        mg_http_reply(c, 500, "Content-Type: text/html\r\n",
+        http_reply(c, 500, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body><h1>Error</h1>"
             "<p class=\"error\">Failed to load leagues.</p></body></html>\n",
             TERMINAL_CSS);
         return;
     }
 
-    mg_printf(c,
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/html\r\n"
-        "Transfer-Encoding: chunked\r\n\r\n");
+    http_chunked_begin(c, 200, page_headers(hm));
 
-    mg_http_printf_chunk(c,
-        "<!DOCTYPE html>\n"
-        "<html><head>\n"
-        "<title>Leagues - Daily Puzzle</title>\n"
+    http_chunk(c,
         "%s"
-        "</head><body>\n"
         "<div class=\"page-header\">\n"
         "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Leagues</div>\n"
         "  <nav class=\"nav\">\n"
@@ -1237,35 +902,31 @@ static void handle_leagues_list(struct mg_connection *c, User *user) {
         "  </nav>\n"
         "  <hr class=\"nav-line\">\n"
         "</div>\n",
-        TERMINAL_CSS);
+        page_head(hm, "Leagues - Daily Puzzle"));
 
     if (count == 0) {
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<div class=\"content-meta\">You're not in any leagues yet.</div>\n");
     } else {
-        mg_http_printf_chunk(c,
+        /* Every league's weekly position from one query */
+        int64_t ids[50];
+        LeagueStanding standings[50];
+        for (int i = 0; i < count; i++)
+            ids[i] = leagues[i].id;
+        if (league_get_standings(user->id, ids, count, standings) != 0)
+            memset(standings, 0, sizeof(standings));
+
+        http_chunk(c,
             "<table>\n"
             "<tr><th>Name</th><th style=\"width:60px;\">Pos</th><th style=\"width:80px; text-align:right;\">Pts</th></tr>\n");
 
         for (int i = 0; i < count; i++) {
-            LeaderboardEntry entries[100];
-            int entry_count;
-            int user_pos = 0;
-            int user_pts = 0;
-
-            if (league_get_leaderboard_weekly(leagues[i].id, entries, 100, &entry_count) == 0) {
-                for (int j = 0; j < entry_count; j++) {
-                    if (entries[j].user_id == user->id) {
-                        user_pos = entries[j].rank;
-                        user_pts = entries[j].score;
-                        break;
-                    }
-                }
-            }
+            int user_pos = standings[i].rank[LEAGUE_WEEKLY];
+            int user_pts = standings[i].score[LEAGUE_WEEKLY];
 
             char safe_name[1536] = {0};
             html_escape(leagues[i].name, safe_name, sizeof(safe_name));
-            mg_http_printf_chunk(c,
+            http_chunk(c,
                 "<tr>\n"
                 "  <td><a href=\"/leagues/%lld\"><span class=\"gt\">&gt;</span> %s</a></td>\n"
                 "  <td>%d</td>\n"
@@ -1277,10 +938,10 @@ static void handle_leagues_list(struct mg_connection *c, User *user) {
                 user_pts);
         }
 
-        mg_http_printf_chunk(c, "</table>\n");
+        http_chunk(c, "</table>\n");
     }
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<div style=\"margin-top:30px;\">\n"
         "<form method=\"POST\" action=\"/leagues\" style=\"margin-bottom:15px;\">\n"
         "  <div class=\"action-btn\">\n"
@@ -1297,8 +958,8 @@ static void handle_leagues_list(struct mg_connection *c, User *user) {
         "</form>\n"
         "</div>\n");
 
-    mg_http_printf_chunk(c, "</body></html>\n");
-    mg_http_printf_chunk(c, "");
+    http_chunk(c, "%s", page_tail(hm));
+    http_chunked_end(c);
 }
 
 static void handle_league_create(struct mg_connection *c, struct mg_http_message *hm,
@@ -1306,7 +967,7 @@ static void handle_league_create(struct mg_connection *c, struct mg_http_message
     char name[256] = {0};
 
     if (get_form_var(hm, "name", name, sizeof(name)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Error</h1><p class=\"error\">League name is required.</p>\n"
             "<p><a href=\"/leagues\">&lt; Back to leagues</a></p>\n"
@@ -1319,7 +980,7 @@ static void handle_league_create(struct mg_connection *c, struct mg_http_message
     int64_t league_id = league_create(user->id, name, invite_code);
 
     if (league_id < 0) {
-        mg_http_reply(c, 500, "Content-Type: text/html\r\n",
+        http_reply(c, 500, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Error</h1><p class=\"error\">Failed to create league.</p>\n"
             "<p><a href=\"/leagues\">&lt; Back to leagues</a></p>\n"
@@ -1330,7 +991,7 @@ static void handle_league_create(struct mg_connection *c, struct mg_http_message
 
     char location[64];
     snprintf(location, sizeof(location), "Location: /leagues/%lld\r\n", (long long)league_id);
-    mg_http_reply(c, 302, location, "");
+    http_reply(c, 302, location, "");
 }
 
 static void handle_league_view(struct mg_connection *c, struct mg_http_message *hm,
@@ -1341,7 +1002,7 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
 
     /* Extract ID after "/leagues/" (9 chars) */
     if (path_len <= 9) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
         return;
     }
 
@@ -1352,13 +1013,13 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
 
     int64_t league_id = atoll(id_str);
     if (league_id <= 0) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
         return;
     }
 
     League league;
     if (league_get(league_id, &league) != 0) {
-        mg_http_reply(c, 404, "Content-Type: text/html\r\n",
+        http_reply(c, 404, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>League Not Found</h1>\n"
             "<p><a href=\"/leagues\">&lt; Back to leagues</a></p>\n"
@@ -1368,7 +1029,7 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
     }
 
     if (!league_is_member(league_id, user->id)) {
-        mg_http_reply(c, 403, "Content-Type: text/html\r\n",
+        http_reply(c, 403, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Access Denied</h1>\n"
             "<p class=\"error\">You're not a member of this league.</p>\n"
@@ -1401,17 +1062,12 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
     char safe_name[1536] = {0};
     html_escape(league.name, safe_name, sizeof(safe_name));
 
-    mg_printf(c,
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/html\r\n"
-        "Transfer-Encoding: chunked\r\n\r\n");
+    http_chunked_begin(c, 200, page_headers(hm));
 
-    mg_http_printf_chunk(c,
-        "<!DOCTYPE html>\n"
-        "<html><head>\n"
-        "<title>%s - Daily Puzzle</title>\n"
+    char title[1600];
+    snprintf(title, sizeof(title), "%s - Daily Puzzle", safe_name);
+    http_chunk(c,
         "%s"
-        "</head><body>\n"
         "<div class=\"page-header\">\n"
         "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>%s</div>\n"
         "  <nav class=\"nav\">\n"
@@ -1421,14 +1077,13 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
         "  </nav>\n"
         "  <hr class=\"nav-line\">\n"
         "</div>\n",
-        safe_name,
-        TERMINAL_CSS,
+        page_head(hm, title),
         safe_name);
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<a href=\"/leagues\" class=\"back-link\"><span class=\"gt\">&gt;</span>Back to leagues</a>\n");
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<div style=\"margin:15px 0;\">\n"
         "  <a href=\"/leagues/%lld?view=daily\" style=\"color:%s;margin-right:15px;\">Daily</a>\n"
         "  <a href=\"/leagues/%lld?view=weekly\" style=\"color:%s;margin-right:15px;\">Weekly</a>\n"
@@ -1438,7 +1093,7 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
         (long long)league_id, (!is_daily && !is_alltime) ? "#4ecca3" : "#808080",
         (long long)league_id, is_alltime ? "#4ecca3" : "#808080");
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<table>\n"
         "<tr><th style=\"width:50px;\">Pos</th><th>Name</th><th style=\"width:80px; text-align:right;\">Pts</th></tr>\n");
 
@@ -1467,24 +1122,51 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
             pos += snprintf(tag_html + pos, sizeof(tag_html) - pos,
                 "<br><i style=\"color:#808080;font-size:0.85em;\">The Hint Lover</i>");
 
-        mg_http_printf_chunk(c,
-            "<tr>\n"
+        http_chunk(c,
+            "<tr id=\"lb-%lld\">\n"
             "  <td>%d</td>\n"
             "  <td>%s%s</td>\n"
             "  <td style=\"text-align:right;\">%s</td>\n"
             "</tr>\n",
+            (long long)uid,
             entries[i].rank,
             safe_display,
             tag_html,
             score_str);
     }
 
-    mg_http_printf_chunk(c, "</table>\n");
+    http_chunk(c, "</table>\n");
+
+    /* Live standings: rows pushed as others solve; unknown rows reload.
+       A boosted navigation swaps the page without unloading it, so the
+       stream is closed before htmx fetches the next one. */
+    http_chunk(c,
+        "<script>\n"
+        "(function(){if(!window.EventSource)return;\n"
+        "var es=new EventSource('/leagues/%lld/events?view=%s');\n"
+        "es.addEventListener('rows',function(e){JSON.parse(e.data).forEach(function(r){\n"
+        "  var tr=document.getElementById('lb-'+r.id);\n"
+        "  if(!tr){es.close();location.reload();return;}\n"
+        "  tr.cells[0].textContent=r.rank;\n"
+        "  tr.cells[2].textContent=(r.score<0)?'-':r.score;});\n"
+        "  var rows=Array.prototype.slice.call(document.querySelectorAll('tr[id^=lb-]'));\n"
+        "  rows.sort(function(a,b){return a.cells[0].textContent-b.cells[0].textContent;});\n"
+        "  rows.forEach(function(tr){tr.parentNode.appendChild(tr);});});\n"
+        "es.addEventListener('reset',function(){es.close();location.reload();});\n"
+        "document.body.addEventListener('htmx:beforeRequest',function(){es.close();},{once:true});})();\n"
+        "</script>\n",
+        (long long)league_id, is_daily ? "daily" : is_alltime ? "alltime" : "weekly");
+
+    http_chunk(c,
+        "<a href=\"/leagues/%lld/race\" class=\"action-btn\" style=\"margin-top:20px;\">\n"
+        "  <span class=\"gt\">&gt;</span>Race league members\n"
+        "</a>\n",
+        (long long)league_id);
 
     const char *base_url = getenv("BASE_URL");
     if (!base_url) base_url = "http://localhost:8080";
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<div class=\"content-meta\" style=\"margin-top:30px;\">\n"
         "  Invite code: <span style=\"color:#e0e0e0;\">%s</span><br>\n"
         "  <span id=\"join-link\" style=\"color:#e0e0e0;\">%s/leagues/join?code=%s</span>\n"
@@ -1501,7 +1183,7 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
         league.invite_code, base_url, league.invite_code);
 
     if (league.creator_id == user->id) {
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<form action=\"/leagues/delete\" method=\"POST\" "
             "onsubmit=\"return confirm('Delete this league? This cannot be undone.');\">\n"
             "  <input type=\"hidden\" name=\"league_id\" value=\"%lld\">\n"
@@ -1511,7 +1193,7 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
             "</form>\n",
             (long long)league_id);
     } else {
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<form action=\"/leagues/leave\" method=\"POST\" "
             "onsubmit=\"return confirm('Leave this league?');\">\n"
             "  <input type=\"hidden\" name=\"league_id\" value=\"%lld\">\n"
@@ -1522,8 +1204,31 @@ static void handle_league_view(struct mg_connection *c, struct mg_http_message *
             (long long)league_id);
     }
 
-    mg_http_printf_chunk(c, "</body></html>\n");
-    mg_http_printf_chunk(c, "");
+    http_chunk(c, "%s", page_tail(hm));
+    http_chunked_end(c);
+}
+
+/* GET /leagues/{id}/events?view=daily|weekly|alltime: standings as SSE */
+static void handle_league_events(struct mg_connection *c, struct mg_http_message *hm,
+                                 User *user) {
+    /* atoll stops at the '/' before "events" */
+    int64_t league_id = hm->uri.len > 9 ? atoll(hm->uri.buf + 9) : 0;
+    if (league_id <= 0 || !league_is_member(league_id, user->id)) {
+        http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+        return;
+    }
+
+    char view_param[16] = {0};
+    get_query_var(hm, "view", view_param, sizeof(view_param));
+    LiveView view = LIVE_WEEKLY;
+    if (strcmp(view_param, "daily") == 0)
+        view = LIVE_DAILY;
+    else if (strcmp(view_param, "alltime") == 0)
+        view = LIVE_ALLTIME;
+
+    if (live_subscribe(c, league_id, view) != 0)
+        http_reply(c, 503, "Content-Type: text/plain\r\nRetry-After: 30\r\n",
+                   "Too many live subscribers\n");
 }
 
 static void handle_league_join_link(struct mg_connection *c, struct mg_http_message *hm,
@@ -1531,13 +1236,13 @@ static void handle_league_join_link(struct mg_connection *c, struct mg_http_mess
     char code[16] = {0};
 
     if (get_query_var(hm, "code", code, sizeof(code)) <= 0) {
-        mg_http_reply(c, 302, "Location: /leagues\r\n", "");
+        http_reply(c, 302, "Location: /leagues\r\n", "");
         return;
     }
 
     League league;
     if (league_get_by_code(code, &league) != 0) {
-        mg_http_reply(c, 404, "Content-Type: text/html\r\n",
+        http_reply(c, 404, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Invalid Link</h1>\n"
             "<p class=\"error\">No league found with that invite code.</p>\n"
@@ -1550,14 +1255,14 @@ static void handle_league_join_link(struct mg_connection *c, struct mg_http_mess
     if (league_is_member(league.id, user->id)) {
         char location[64];
         snprintf(location, sizeof(location), "Location: /leagues/%lld\r\n", (long long)league.id);
-        mg_http_reply(c, 302, location, "");
+        http_reply(c, 302, location, "");
         return;
     }
 
     char safe_name[1536] = {0};
     html_escape(league.name, safe_name, sizeof(safe_name));
 
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+    http_reply(c, 200, "Content-Type: text/html\r\n",
         "<!DOCTYPE html><html><head>\n"
         "<title>Join League - Daily Puzzle</title>\n"
         "%s"
@@ -1580,7 +1285,7 @@ static void handle_league_join(struct mg_connection *c, struct mg_http_message *
     char code[16] = {0};
 
     if (get_form_var(hm, "code", code, sizeof(code)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Error</h1><p class=\"error\">Invite code is required.</p>\n"
             "<p><a href=\"/leagues\">&lt; Back to leagues</a></p>\n"
@@ -1594,7 +1299,7 @@ static void handle_league_join(struct mg_connection *c, struct mg_http_message *
 
     League league;
     if (league_get_by_code(code, &league) != 0) {
-        mg_http_reply(c, 404, "Content-Type: text/html\r\n",
+        http_reply(c, 404, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Invalid Code</h1>\n"
             "<p class=\"error\">No league found with invite code: %s</p>\n"
@@ -1605,7 +1310,7 @@ static void handle_league_join(struct mg_connection *c, struct mg_http_message *
     }
 
     if (league_join(league.id, user->id) != 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Cannot Join</h1>\n"
             "<p class=\"error\">You may already be a member of this league.</p>\n"
@@ -1615,9 +1320,11 @@ static void handle_league_join(struct mg_connection *c, struct mg_http_message *
         return;
     }
 
+    live_league_changed(league.id);
+
     char location[64];
     snprintf(location, sizeof(location), "Location: /leagues/%lld\r\n", (long long)league.id);
-    mg_http_reply(c, 302, location, "");
+    http_reply(c, 302, location, "");
 }
 
 static void handle_league_leave(struct mg_connection *c, struct mg_http_message *hm,
@@ -1625,7 +1332,7 @@ static void handle_league_leave(struct mg_connection *c, struct mg_http_message
     char league_id_str[32] = {0};
 
     if (get_form_var(hm, "league_id", league_id_str, sizeof(league_id_str)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Error</h1><p class=\"error\">League ID is required.</p>\n"
             "</body></html>\n",
@@ -1636,7 +1343,7 @@ static void handle_league_leave(struct mg_connection *c, struct mg_http_message
     int64_t league_id = atoll(league_id_str);
 
     if (league_leave(league_id, user->id) != 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Error</h1>\n"
             "<p class=\"error\">Could not leave the league. You may not be a member.</p>\n"
@@ -1646,7 +1353,9 @@ static void handle_league_leave(struct mg_connection *c, struct mg_http_message
         return;
     }
 
-    mg_http_reply(c, 302, "Location: /leagues\r\n", "");
+    live_league_changed(league_id);
+
+    http_reply(c, 302, "Location: /leagues\r\n", "");
 }
 
 static void handle_league_delete(struct mg_connection *c, struct mg_http_message *hm,
@@ -1654,7 +1363,7 @@ static void handle_league_delete(struct mg_connection *c, struct mg_http_message
     char league_id_str[32] = {0};
 
     if (get_form_var(hm, "league_id", league_id_str, sizeof(league_id_str)) <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/html\r\n",
+        http_reply(c, 400, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Error</h1><p class=\"error\">League ID is required.</p>\n"
             "</body></html>\n",
@@ -1665,7 +1374,7 @@ static void handle_league_delete(struct mg_connection *c, struct mg_http_message
     int64_t league_id = atoll(league_id_str);
 
     if (league_delete(league_id, user->id) != 0) {
-        mg_http_reply(c, 403, "Content-Type: text/html\r\n",
+        http_reply(c, 403, "Content-Type: text/html\r\n",
             "<!DOCTYPE html><html><head>%s</head><body>\n"
             "<h1>Cannot Delete</h1>\n"
             "<p class=\"error\">Only the league creator can delete the league.</p>\n"
@@ -1675,7 +1384,9 @@ static void handle_league_delete(struct mg_connection *c, struct mg_http_message
         return;
     }
 
-    mg_http_reply(c, 302, "Location: /leagues\r\n", "");
+    live_league_changed(league_id);
+
+    http_reply(c, 302, "Location: /leagues\r\n", "");
 }
 
 static void handle_account_page(struct mg_connection *c, struct mg_http_message *hm,
@@ -1700,15 +1411,10 @@ static void handle_account_page(struct mg_connection *c, struct mg_http_message
     else
         snprintf(daily_str, sizeof(daily_str), "-");
 
-    mg_printf(c,
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/html\r\n"
-        "Transfer-Encoding: chunked\r\n\r\n");
+    http_chunked_begin(c, 200, page_headers(hm));
 
-    mg_http_printf_chunk(c,
-        "<!DOCTYPE html>\n"
-        "<html><head><title>Account</title>%s</head>\n"
-        "<body>\n"
+    http_chunk(c,
+        "%s"
         "<div class=\"page-header\">\n"
         "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Account</div>\n"
         "  <nav class=\"nav\">\n"
@@ -1719,10 +1425,10 @@ static void handle_account_page(struct mg_connection *c, struct mg_http_message
         "  <hr class=\"nav-line\">\n"
         "</div>\n"
         "%s",
-        TERMINAL_CSS,
+        page_head(hm, "Account"),
         show_saved ? "<div style=\"color:#4ecca3;margin-bottom:15px;\">Display name updated.</div>\n" : "");
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<div style=\"margin-bottom:25px;\">\n"
         "  <p style=\"color:#808080;margin-bottom:5px;\">Your Stats</p>\n"
         "  <table>\n"
@@ -1742,14 +1448,14 @@ static void handle_account_page(struct mg_connection *c, struct mg_http_message
         stats.average_score, stats.puzzles_solved);
 
     if (stats.puzzles_solved > 0) {
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "  <p style=\"color:#4ecca3;\">Top %d%% of players</p>\n",
             stats.percentile);
     }
 
-    mg_http_printf_chunk(c, "</div>\n");
+    http_chunk(c, "</div>\n");
 
-    mg_http_printf_chunk(c,
+    http_chunk(c,
         "<p style=\"color:#808080;margin-bottom:5px;\">Display Name</p>\n"
         "<form action=\"/account\" method=\"POST\">\n"
         "  <label class=\"action-btn\">\n"
@@ -1767,11 +1473,12 @@ static void handle_account_page(struct mg_connection *c, struct mg_http_message
         "    <span class=\"gt\">&gt;</span>Logout\n"
         "  </button>\n"
         "</form>\n"
-        "</body></html>\n",
+        "%s",
         safe_display,
-        safe_email);
+        safe_email,
+        page_tail(hm));
 
-    mg_http_printf_chunk(c, "");
+    http_chunked_end(c);
 }
 
 static void handle_account_update(struct mg_connection *c, struct mg_http_message *hm,
@@ -1779,7 +1486,7 @@ static void handle_account_update(struct mg_connection *c, struct mg_http_messag
     char name[256] = {0};
     get_form_var(hm, "display_name", name, sizeof(name));
     auth_update_display_name(user->id, name);
-    mg_http_reply(c, 302, "Location: /account?saved=1\r\n", "");
+    http_reply(c, 302, "Location: /account?saved=1\r\n", "");
 }
 
 static void handle_archive_result(struct mg_connection *c, struct mg_http_message *hm,
@@ -1789,7 +1496,7 @@ static void handle_archive_result(struct mg_connection *c, struct mg_http_messag
     const char *id_start = uri + 9;  /* skip "/archive/" */
     const char *id_end = strstr(id_start, "/result");
     if (!id_end) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Not found\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Not found\n");
         return;
     }
     size_t id_len = id_end - id_start;
@@ -1798,13 +1505,13 @@ static void handle_archive_result(struct mg_connection *c, struct mg_http_messag
 
     int64_t puzzle_id = atoll(id_str);
     if (puzzle_id <= 0) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Invalid puzzle ID\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Invalid puzzle ID\n");
         return;
     }
 
     Puzzle puzzle;
     if (puzzle_get_by_id(puzzle_id, &puzzle) != 0) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
         return;
     }
 
@@ -1838,7 +1545,7 @@ static void handle_archive_result(struct mg_connection *c, struct mg_http_messag
         if (puzzle_get_attempt(user->id, puzzle_id, &attempt) != 0 || !attempt.solved) {
             char loc[64];
             snprintf(loc, sizeof(loc), "Location: /archive/%lld\r\n", (long long)puzzle_id);
-            mg_http_reply(c, 302, loc, "");
+            http_reply(c, 302, loc, "");
             return;
         }
 
@@ -1856,7 +1563,7 @@ static void handle_archive_result(struct mg_connection *c, struct mg_http_messag
             hints, hints == 1 ? "hint" : "hints",
             base_url, (long long)puzzle_id);
 
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+        http_reply(c, 200, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n"
             "<html><head><title>Puzzle #%d Complete!</title>%s</head>\n"
             "<body>\n"
@@ -1895,7 +1602,7 @@ static void handle_archive_result(struct mg_connection *c, struct mg_http_messag
             "Check out the puzzle here: %s/archive/%lld",
             pnum, time_hhmm, base_url, (long long)puzzle_id);
 
-        mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+        http_reply(c, 200, "Content-Type: text/html\r\n",
             "<!DOCTYPE html>\n"
             "<html><head><title>Puzzle #%d Complete!</title>%s</head>\n"
             "<body>\n"
@@ -1925,12 +1632,13 @@ static void handle_archive_result(struct mg_connection *c, struct mg_http_messag
     }
 }
 
-static void handle_archive_list(struct mg_connection *c, User *user) {
+static void handle_archive_list(struct mg_connection *c, struct mg_http_message *hm,
+                                User *user) {
     Puzzle puzzles[100];
     int count = 0;
 
     if (puzzle_get_archive(puzzles, 100, &count, dev_mode) != 0) {
-        mg_http_reply(c, 500, "Content-Type: text/plain\r\n", "Database error\n");
+        http_reply(c, 500, "Content-Type: text/plain\r\n", "Database error\n");
         return;
     }
 
@@ -1939,15 +1647,10 @@ static void handle_archive_list(struct mg_connection *c, User *user) {
           "    <a href=\"/account\"><span class=\"gt\">&gt;</span>Account</a>\n"
         : "    <a href=\"/login\"><span class=\"gt\">&gt;</span>Login</a>\n";
 
-    mg_printf(c,
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/html\r\n"
-        "Transfer-Encoding: chunked\r\n\r\n");
+    http_chunked_begin(c, 200, page_headers(hm));
 
-    mg_http_printf_chunk(c,
-        "<!DOCTYPE html>\n"
-        "<html><head><title>Archive</title>%s</head>\n"
-        "<body>\n"
+    http_chunk(c,
+        "%s"
         "<div class=\"page-header\">\n"
         "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Archive</div>\n"
         "  <nav class=\"nav\">\n"
@@ -1956,10 +1659,10 @@ static void handle_archive_list(struct mg_connection *c, User *user) {
         "  </nav>\n"
         "  <hr class=\"nav-line\">\n"
         "</div>\n",
-        TERMINAL_CSS, nav);
+        page_head(hm, "Archive"), nav);
 
     if (count == 0) {
-        mg_http_printf_chunk(c, "<p style=\"color:#808080;\">No archived puzzles yet.</p>\n");
+        http_chunk(c, "<p style=\"color:#808080;\">No archived puzzles yet.</p>\n");
     } else {
         for (int i = 0; i < count; i++) {
             Puzzle *p = &puzzles[i];
@@ -1974,7 +1677,7 @@ static void handle_archive_list(struct mg_connection *c, User *user) {
             char safe_pname[1024] = {0};
             html_escape(p->puzzle_name, safe_pname, sizeof(safe_pname));
             int pnum = puzzle_get_number(p->id);
-            mg_http_printf_chunk(c,
+            http_chunk(c,
                 "<p style=\"display:flex;justify-content:space-between;\">"
                 "<a href=\"/archive/%lld\" style=\"text-decoration:none;\">"
                 "<span class=\"gt\" style=\"color:%s;\">&gt;</span> #%d. %s"
@@ -1986,8 +1689,8 @@ static void handle_archive_list(struct mg_connection *c, User *user) {
         }
     }
 
-    mg_http_printf_chunk(c, "</body></html>\n");
-    mg_http_printf_chunk(c, "");
+    http_chunk(c, "%s", page_tail(hm));
+    http_chunked_end(c);
 }
 
 static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_message *hm,
@@ -2001,7 +1704,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
 
     int64_t puzzle_id = atoll(id_str);
     if (puzzle_id <= 0) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Invalid puzzle ID\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Invalid puzzle ID\n");
         return;
     }
 
@@ -2015,7 +1718,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
 
     Puzzle puzzle;
     if (puzzle_get_by_id(puzzle_id, &puzzle) != 0) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
         return;
     }
 
@@ -2036,10 +1739,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
     if (pipe) *pipe = '\0';
     html_escape(display_answer, safe_answer, sizeof(safe_answer));
 
-    mg_printf(c,
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: text/html\r\n"
-        "Transfer-Encoding: chunked\r\n\r\n");
+    http_chunked_begin(c, 200, page_headers(hm));
 
     const char *nav = user
         ? "    <a href=\"/leagues\"><span class=\"gt\">&gt;</span>Leagues</a>\n"
@@ -2047,10 +1747,10 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
         : "    <a href=\"/login\"><span class=\"gt\">&gt;</span>Login</a>\n";
 
     int pnum = puzzle_get_number(puzzle_id);
-    mg_http_printf_chunk(c,
-        "<!DOCTYPE html>\n"
-        "<html><head><title>#%d. %s</title>%s</head>\n"
-        "<body>\n"
+    char title[1100];
+    snprintf(title, sizeof(title), "#%d. %s", pnum, safe_pname);
+    http_chunk(c,
+        "%s"
         "<div class=\"page-header\">\n"
         "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>#%d. %s</div>\n"
         "  <nav class=\"nav\">\n"
@@ -2062,7 +1762,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
         "<p><a href=\"/archive\" class=\"back-link\"><span class=\"gt\">&gt;</span>Back to archive</a></p>\n"
         "<p style=\"color:#808080;\">%02d/%02d/%02d</p>\n"
         "<p style=\"color:#808080;\">Archived puzzles are for practice only. No points awarded.</p>\n",
-        pnum, safe_pname, TERMINAL_CSS,
+        page_head(hm, title),
         pnum, safe_pname,
         nav,
         day, month, year % 100);
@@ -2071,36 +1771,36 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
         LadderStep steps[MAX_LADDER_STEPS];
         int step_count = puzzle_parse_ladder(puzzle.question, steps, MAX_LADDER_STEPS);
 
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<div data-testid=\"puzzle-container\" class=\"puzzle-box\" style=\"text-align:left;display:block;\">\n"
             "  <div>\n");
         for (int i = 0; i < step_count; i++) {
             if (steps[i].is_blank) {
-                mg_http_printf_chunk(c, "    <div>%d. ____</div>\n", i + 1);
+                http_chunk(c, "    <div>%d. ____</div>\n", i + 1);
             } else {
                 char safe_word[256] = {0};
                 html_escape(steps[i].word, safe_word, sizeof(safe_word));
-                mg_http_printf_chunk(c, "    <div>%d. %s</div>\n", i + 1, safe_word);
+                http_chunk(c, "    <div>%d. %s</div>\n", i + 1, safe_word);
             }
         }
-        mg_http_printf_chunk(c, "  </div>\n</div>\n");
+        http_chunk(c, "  </div>\n</div>\n");
     } else if (strcmp(puzzle.puzzle_type, "choice") == 0) {
         ChoicePuzzle cp;
         if (puzzle_parse_choice(puzzle.question, &cp) == 0) {
             char safe_prompt[2048] = {0};
             html_escape(cp.prompt, safe_prompt, sizeof(safe_prompt));
-            mg_http_printf_chunk(c,
+            http_chunk(c,
                 "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">\n"
                 "  <div>%s</div>\n"
                 "</div>\n",
                 safe_prompt);
         }
     } else {
-        mg_http_printf_chunk(c, "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">%s</div>\n", puzzle.question);
+        http_chunk(c, "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">%s</div>\n", puzzle.question);
     }
 
     if (solved) {
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<div class=\"action-btn\" style=\"text-align:center;color:#4ecca3;\">"
             "Solved! Answer: %s — <a href=\"/archive/%lld/result\">View result</a>"
             "</div>\n",
@@ -2108,13 +1808,13 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
     } else {
         if (puzzle.has_hint) {
             if ((has_attempt && attempt.hint_used) || guest_hint_shown) {
-                mg_http_printf_chunk(c,
+                http_chunk(c,
                     "<div class=\"action-btn\">"
                     "<span class=\"gt\">&gt;</span>Hint: %s"
                     "</div>\n",
                     puzzle.hint);
             } else if (user) {
-                mg_http_printf_chunk(c,
+                http_chunk(c,
                     "<form action=\"/archive/%lld/hint\" method=\"POST\">\n"
                     "<button data-testid=\"hint-button\" type=\"submit\" class=\"action-btn\">"
                     "<span class=\"gt\">&gt;</span>Hint?"
@@ -2122,7 +1822,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
                     "</form>\n",
                     (long long)puzzle_id);
             } else {
-                mg_http_printf_chunk(c,
+                http_chunk(c,
                     "<a data-testid=\"hint-button\" href=\"/archive/%lld?hint=1%s\" class=\"action-btn\">"
                     "<span class=\"gt\">&gt;</span>Hint?"
                     "</a>\n",
@@ -2131,12 +1831,12 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
             }
         }
 
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<form action=\"/archive/%lld/attempt\" method=\"POST\">\n",
             (long long)puzzle_id);
 
         if (!user && guest_hint_shown) {
-            mg_http_printf_chunk(c, "<input type=\"hidden\" name=\"hint_shown\" value=\"1\">\n");
+            http_chunk(c, "<input type=\"hidden\" name=\"hint_shown\" value=\"1\">\n");
         }
 
         if (strcmp(puzzle.puzzle_type, "ladder") == 0) {
@@ -2146,7 +1846,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
 
             for (int i = 0; i < step_count; i++) {
                 if (steps[i].is_blank) {
-                    mg_http_printf_chunk(c,
+                    http_chunk(c,
                         "<label class=\"action-btn\">\n"
                         "  <span class=\"gt\">&gt;</span>\n"
                         "  <input type=\"text\" name=\"step_%d\" placeholder=\"Step %d\" autocomplete=\"off\" required>\n"
@@ -2161,7 +1861,7 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
                 for (int i = 0; i < cp.num_options; i++) {
                     char safe_opt[512] = {0};
                     html_escape(cp.options[i], safe_opt, sizeof(safe_opt));
-                    mg_http_printf_chunk(c,
+                    http_chunk(c,
                         "<label class=\"action-btn\">\n"
                         "  <span class=\"gt\">&gt;</span>\n"
                         "  <input type=\"radio\" name=\"answer\" value=\"%c\" required "
@@ -2171,20 +1871,20 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
                 }
             }
         } else if (strcmp(puzzle.puzzle_type, "math") == 0) {
-            mg_http_printf_chunk(c,
+            http_chunk(c,
                 "<label class=\"action-btn\">\n"
                 "  <span class=\"gt\">&gt;</span>\n"
                 "  <input data-testid=\"answer-input\" type=\"number\" step=\"any\" name=\"answer\" placeholder=\"Your answer...\" autocomplete=\"off\">\n"
                 "</label>\n");
         } else {
-            mg_http_printf_chunk(c,
+            http_chunk(c,
                 "<label class=\"action-btn\">\n"
                 "  <span class=\"gt\">&gt;</span>\n"
                 "  <input data-testid=\"answer-input\" type=\"text\" name=\"answer\" placeholder=\"Your answer...\" autocomplete=\"off\">\n"
                 "</label>\n");
         }
 
-        mg_http_printf_chunk(c,
+        http_chunk(c,
             "<button data-testid=\"submit-button\" type=\"submit\" class=\"action-btn\">"
             "<span class=\"gt\">&gt;</span>Submit"
             "</button>\n"
@@ -2193,8 +1893,8 @@ static void handle_archive_puzzle(struct mg_connection *c, struct mg_http_messag
             show_wrong_feedback ? "<div style=\"color:#ff6b6b;\">Incorrect. Try again!</div>" : "");
     }
 
-    mg_http_printf_chunk(c, "</body></html>\n");
-    mg_http_printf_chunk(c, "");
+    http_chunk(c, "%s", page_tail(hm));
+    http_chunked_end(c);
 }
 
 static void handle_archive_attempt(struct mg_connection *c, struct mg_http_message *hm,
@@ -2205,7 +1905,7 @@ static void handle_archive_attempt(struct mg_connection *c, struct mg_http_messa
 
     const char *id_end = strstr(id_start, "/attempt");
     if (!id_end) {
-        mg_http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid request\n");
+        http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid request\n");
         return;
     }
     size_t id_len = id_end - id_start;
@@ -2225,45 +1925,50 @@ static void handle_archive_attempt(struct mg_connection *c, struct mg_http_messa
 
     if (have_puzzle && strcmp(puzzle.puzzle_type, "ladder") == 0) {
         if (reconstruct_ladder_guess(hm, puzzle.question, answer, sizeof(answer)) != 0) {
-            mg_http_reply(c, 302, loc, "");
+            http_reply(c, 302, loc, "");
             return;
         }
     } else if (have_puzzle && strcmp(puzzle.puzzle_type, "choice") == 0) {
         if (get_form_var(hm, "answer", answer, sizeof(answer)) <= 0) {
-            mg_http_reply(c, 302, loc, "");
+            http_reply(c, 302, loc, "");
             return;
         }
         ChoicePuzzle cp;
         if (puzzle_parse_choice(puzzle.question, &cp) != 0 ||
             strlen(answer) != 1 || answer[0] < 'a' || answer[0] > 'a' + cp.num_options - 1) {
-            mg_http_reply(c, 302, loc_wrong, "");
+            http_reply(c, 302, loc_wrong, "");
             return;
         }
     } else if (get_form_var(hm, "answer", answer, sizeof(answer)) <= 0) {
-        mg_http_reply(c, 302, loc, "");
+        http_reply(c, 302, loc, "");
         return;
     }
 
     if (user) {
         int result = puzzle_submit_guess(user->id, puzzle_id, answer, NULL);
-        if (result == 1)
-            mg_http_reply(c, 302, loc_result, "");
-        else
-            mg_http_reply(c, 302, loc_wrong, "");
+        if (result >= 0)
+            metrics_inc(METRIC_GUESSES);
+        if (result == 1) {
+            metrics_inc(METRIC_SOLVES);
+            live_user_solved(user->id);
+            http_reply(c, 302, loc_result, "");
+        } else {
+            http_reply(c, 302, loc_wrong, "");
+        }
     } else {
         char hint_shown_str[4] = {0};
         get_form_var(hm, "hint_shown", hint_shown_str, sizeof(hint_shown_str));
 
         int result = puzzle_check_answer(puzzle_id, answer);
         if (result == 1) {
-            mg_http_reply(c, 302, loc_result, "");
+            http_reply(c, 302, loc_result, "");
         } else if (hint_shown_str[0] == '1') {
             char loc_wrong_hint[96];
             snprintf(loc_wrong_hint, sizeof(loc_wrong_hint),
                 "Location: /archive/%lld?wrong=1&hint=1\r\n", (long long)puzzle_id);
-            mg_http_reply(c, 302, loc_wrong_hint, "");
+            http_reply(c, 302, loc_wrong_hint, "");
         } else {
-            mg_http_reply(c, 302, loc_wrong, "");
+            http_reply(c, 302, loc_wrong, "");
         }
     }
 }
@@ -2276,7 +1981,7 @@ static void handle_archive_hint(struct mg_connection *c, struct mg_http_message
 
     const char *id_end = strstr(id_start, "/hint");
     if (!id_end) {
-        mg_http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid request\n");
+        http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid request\n");
         return;
     }
     size_t id_len = id_end - id_start;
@@ -2286,11 +1991,12 @@ static void handle_archive_hint(struct mg_connection *c, struct mg_http_message
     int64_t puzzle_id = atoll(id_str);
 
     char hint[512];
-    puzzle_reveal_hint(user->id, puzzle_id, hint, sizeof(hint));
+    if (puzzle_reveal_hint(user->id, puzzle_id, hint, sizeof(hint)) == 0)
+        metrics_inc(METRIC_HINTS);
 
     char loc[64];
     snprintf(loc, sizeof(loc), "Location: /archive/%lld\r\n", (long long)puzzle_id);
-    mg_http_reply(c, 302, loc, "");
+    http_reply(c, 302, loc, "");
 }
 
 /* --- Admin handlers --- */
@@ -2337,7 +2043,7 @@ static int validate_puzzle_form(const char *date, const char *type,
 
 static void handle_admin_dashboard(struct mg_connection *c) {
     sqlite3 *db = db_get();
-    int puzzle_count = 0, user_count = 0, attempt_count = 0;
+    int puzzle_count = 0, user_count = 0, attempt_count = 0, outbox_count = 0;
     sqlite3_stmt *stmt = NULL;
 
     if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM puzzles", -1, &stmt, NULL) == SQLITE_OK) {
@@ -2352,8 +2058,71 @@ static void handle_admin_dashboard(struct mg_connection *c) {
         if (sqlite3_step(stmt) == SQLITE_ROW) attempt_count = sqlite3_column_int(stmt, 0);
         sqlite3_finalize(stmt);
     }
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM outbox", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) outbox_count = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+
+    OutboxStats outbox;
+    outbox_get_stats(&outbox);
+
+    LiveStats live;
+    live_get_stats(&live);
+
+    AccessLogStats alog;
+    accesslog_get_stats(&alog);
+
+    ReleaseStats release;
+    release_get_stats(&release);
+
+    PageCacheStats pages;
+    pagecache_get_stats(&pages);
+
+    RateLimitStats limits;
+    ratelimit_get_stats(&limits);
+    RaceStats races;
+    race_get_stats(&races);
+    SessionCacheStats sessions;
+    auth_session_cache_stats(&sessions);
+    unsigned long session_lookups = sessions.hits + sessions.misses;
+    WritebackStats deferred;
+    writeback_get_stats(&deferred);
+
+    /* Per-route gzip ratio and deflate CPU, for tuning GZIP_LEVEL */
+    CompressStats stats[COMPRESS_MAX_ROUTES];
+    int stats_count = compress_get_stats(stats, COMPRESS_MAX_ROUTES);
+
+    char rows[8192];
+    int off = 0;
+    rows[0] = '\0';
+    for (int i = 0; i < stats_count && off < (int)sizeof(rows) - 256; i++) {
+        CompressStats *st = &stats[i];
+        double ratio = st->bytes_out > 0 ? (double)st->bytes_in / st->bytes_out : 0.0;
+        double cpu_us = st->compressed > 0 ? st->cpu_ns / 1000.0 / st->compressed : 0.0;
+        off += snprintf(rows + off, sizeof(rows) - off,
+            "<tr><td>%s</td><td>%lu/%lu</td><td>%llu &gt; %llu</td>"
+            "<td>%.1fx</td><td>%.0fus</td></tr>\n",
+            st->route, st->compressed, st->responses,
+            st->bytes_in, st->bytes_out, ratio, cpu_us);
+    }
+
+    /* Overload shedding: current level, thresholds and per-priority counts */
+    static const char *PRIORITY_NAMES[PRIORITY_COUNT] = { "critical", "normal", "low" };
+    AdmissionConfig admit;
+    AdmissionStats admit_stats;
+    admission_get_config(&admit);
+    admission_get_stats(&admit_stats);
+
+    char admit_rows[1024];
+    int admit_off = 0;
+    admit_rows[0] = '\0';
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        admit_off += snprintf(admit_rows + admit_off, sizeof(admit_rows) - admit_off,
+            "<tr><td>%s</td><td>%lu</td><td>%lu</td></tr>\n",
+            PRIORITY_NAMES[p], admit_stats.admitted[p], admit_stats.shed[p]);
+    }
 
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+    http_reply(c, 200, "Content-Type: text/html\r\n",
         "<!DOCTYPE html>\n<html><head><title>Admin</title>%s</head>\n"
         "<body>\n"
         "<div class=\"page-header\">\n"
@@ -2367,17 +2136,92 @@ static void handle_admin_dashboard(struct mg_connection *c) {
         "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Puzzles: %d</div>\n"
         "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Users: %d</div>\n"
         "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Attempts: %d</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Emails queued: %d "
+        "(%lu sent in %lu requests, %lu retried, %lu dropped)</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Live leaderboards: "
+        "%u subscribers on %u channels (%lu queries, %lu events, %lu dropped slow)</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Access log: "
+        "%lu written, %lu dropped, %lu rotations, %lu write errors</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Release: "
+        "%lu days prepared (last %.1fms), %lu switched warm, %lu cold loads</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Page cache: "
+        "%u pages, %lu KB (%lu hits, %lu misses, %lu evicted, %lu flushes)</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Rate limits: "
+        "%u clients, %lu evicted (limited %lu logins, %lu guesses, %lu joins)</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Races: "
+        "%u racers in %u leagues (%lu started, %lu frames, %lu dropped slow)</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Session cache: "
+        "%u sessions, %lu KB, %.1f%% hits (%lu misses, %lu evicted, %lu invalidated), "
+        "%u signed sessions revoked</div>\n"
+        "<div class=\"list-row\"><span class=\"gt\">&gt;</span> Write-behind: "
+        "%u pending, %lu queued, %lu coalesced, %lu written in %lu flushes "
+        "(%lu failed, %lu dropped)</div>\n"
         "<a href=\"/admin/puzzles\" class=\"action-btn\" style=\"margin-top:20px;\">\n"
         "  <span class=\"gt\">&gt;</span>Manage Puzzles\n"
         "</a>\n"
+        "<div class=\"content-meta\" style=\"margin-top:20px;\">Compression: level %d, min %lu bytes</div>\n"
+        "<table><tr><th>Route</th><th>Gzipped</th><th>Bytes</th>"
+        "<th>Ratio</th><th>CPU/resp</th></tr>\n"
+        "%s"
+        "</table>\n"
+        "<div class=\"content-meta\" style=\"margin-top:20px;\">Admission: %s, "
+        "lag %.0fms, %u queued, %lu level changes<br>"
+        "shed low at %ums / %u queued, all but critical at %ums / %u queued</div>\n"
+        "<table><tr><th>Priority</th><th>Admitted</th><th>Shed</th></tr>\n"
+        "%s"
+        "</table>\n"
         "</body></html>\n",
-        TERMINAL_CSS, puzzle_count, user_count, attempt_count);
+        TERMINAL_CSS, puzzle_count, user_count, attempt_count,
+        outbox_count, outbox.sent, outbox.requests, outbox.retried, outbox.dropped,
+        live.subscribers, live.channels, live.refreshes, live.events, live.overflows,
+        alog.written, alog.dropped, alog.rotations, alog.write_errors,
+        release.prepared, release.prepare_ms, release.switches, release.cold_loads,
+        pages.entries, (unsigned long)(pages.bytes / 1024), pages.hits, pages.misses,
+        pages.evictions, pages.flushes,
+        limits.buckets, limits.evictions, limits.limited[RATELIMIT_LOGIN],
+        limits.limited[RATELIMIT_GUESS], limits.limited[RATELIMIT_JOIN],
+        races.racers, races.races, races.started, races.frames, races.overflows,
+        sessions.entries, (unsigned long)(sessions.bytes / 1024),
+        session_lookups ? 100.0 * sessions.hits / session_lookups : 0.0,
+        sessions.misses, sessions.evictions, sessions.invalidations, sessions.revoked,
+        deferred.pending, deferred.queued, deferred.coalesced, deferred.written,
+        deferred.flushes, deferred.failures, deferred.dropped,
+        compress_level(), (unsigned long)compress_min_size(), rows,
+        admission_level_name(admit_stats.level), admit_stats.lag_ms,
+        admit_stats.queued, admit_stats.level_changes,
+        admit.lag_low_ms, admit.queue_low, admit.lag_high_ms, admit.queue_high,
+        admit_rows);
 }
 
-static void handle_admin_puzzles_list(struct mg_connection *c) {
-    Puzzle puzzles[200];
-    int count = 0;
-    puzzle_get_archive(puzzles, 200, &count, 1);
+static void metrics_chunk(const char *text, size_t len, void *arg) {
+    http_chunk((struct mg_connection *)arg, "%.*s", (int)len, text);
+}
+
+/* Admins, or a scraper presenting METRICS_TOKEN as a bearer token */
+static int metrics_authorized(struct mg_http_message *hm, const User *user) {
+    if (user != NULL && (user->roles & ROLE_ADMIN))
+        return 1;
+
+    const char *token = getenv("METRICS_TOKEN");
+    struct mg_str *auth = mg_http_get_header(hm, "Authorization");
+    if (token == NULL || token[0] == '\0' || auth == NULL)
+        return 0;
+
+    if (auth->len < 7 || memcmp(auth->buf, "Bearer ", 7) != 0)
+        return 0;
+    return secret_equal(auth->buf + 7, auth->len - 7, token, strlen(token));
+}
+
+static void handle_metrics(struct mg_connection *c) {
+    http_chunked_begin(c, 200, "Content-Type: text/plain; version=0.0.4\r\n");
+    metrics_render(metrics_chunk, c);
+    http_chunked_end(c);
+}
+
+static void handle_admin_puzzles_list(struct mg_connection *c) {
+    Puzzle puzzles[200];
+    int count = 0;
+    puzzle_get_archive(puzzles, 200, &count, 1);
 
     char body[65536];
     int off = snprintf(body, sizeof(body),
@@ -2424,7 +2268,7 @@ static void handle_admin_puzzles_list(struct mg_connection *c) {
     off += snprintf(body + off, sizeof(body) - off,
         "</table>\n</body></html>\n");
 
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n", "%s", body);
+    http_reply(c, 200, "Content-Type: text/html\r\n", "%s", body);
 }
 
 static void render_puzzle_form(struct mg_connection *c, const char *title,
@@ -2463,7 +2307,7 @@ static void render_puzzle_form(struct mg_connection *c, const char *title,
             "style=\"margin-top:15px;\"><span class=\"gt\">&gt;</span>Preview</a>\n",
             (long long)p->id);
 
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n",
+    http_reply(c, 200, "Content-Type: text/html\r\n",
         "<!DOCTYPE html>\n<html><head><title>Admin - %s</title>%s\n"
         "<style>textarea,select{background:#15191e;color:#e0e0e0;border:1px solid #3a3a3a;"
         "padding:10px 15px;font-family:inherit;font-size:inherit;margin:5px 5px 5px 0;width:100%%;}"
@@ -2513,13 +2357,13 @@ static void handle_admin_puzzle_preview(struct mg_connection *c,
     get_query_var(hm, "id", id_str, sizeof(id_str));
     int64_t id = atoll(id_str);
     if (id <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid ID\n");
+        http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid ID\n");
         return;
     }
 
     Puzzle p = {0};
     if (puzzle_get_by_id(id, &p) != 0) {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
         return;
     }
 
@@ -2630,7 +2474,7 @@ static void handle_admin_puzzle_preview(struct mg_connection *c,
         p.hint[0] ? esc_hint : "None",
         (long long)p.id);
 
-    mg_http_reply(c, 200, "Content-Type: text/html\r\n", "%s", body);
+    http_reply(c, 200, "Content-Type: text/html\r\n", "%s", body);
 }
 
 static void handle_admin_puzzle_new(struct mg_connection *c) {
@@ -2660,8 +2504,9 @@ static void handle_admin_puzzle_create(struct mg_connection *c,
                            "Failed to create puzzle. Date may already exist.");
         return;
     }
+    release_invalidate();
 
-    mg_http_reply(c, 302, "Location: /admin/puzzles\r\n", "");
+    http_reply(c, 302, "Location: /admin/puzzles\r\n", "");
 }
 
 static void handle_admin_puzzle_edit(struct mg_connection *c,
@@ -2676,7 +2521,7 @@ static void handle_admin_puzzle_edit(struct mg_connection *c,
 
     int64_t id = atoll(id_str);
     if (id <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid ID\n");
+        http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid ID\n");
         return;
     }
 
@@ -2702,12 +2547,13 @@ static void handle_admin_puzzle_edit(struct mg_connection *c,
                                "Failed to update puzzle.");
             return;
         }
+        release_invalidate();
 
-        mg_http_reply(c, 302, "Location: /admin/puzzles\r\n", "");
+        http_reply(c, 302, "Location: /admin/puzzles\r\n", "");
     } else {
         Puzzle p = {0};
         if (puzzle_get_by_id(id, &p) != 0) {
-            mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
+            http_reply(c, 404, "Content-Type: text/plain\r\n", "Puzzle not found\n");
             return;
         }
         render_puzzle_form(c, "Edit Puzzle", "/admin/puzzles/edit", &p, NULL);
@@ -2721,234 +2567,1502 @@ static void handle_admin_puzzle_delete(struct mg_connection *c,
 
     int64_t id = atoll(id_str);
     if (id <= 0) {
-        mg_http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid ID\n");
+        http_reply(c, 400, "Content-Type: text/plain\r\n", "Invalid ID\n");
         return;
     }
 
     puzzle_delete(id);
-    mg_http_reply(c, 302, "Location: /admin/puzzles\r\n", "");
+    release_invalidate();
+    http_reply(c, 302, "Location: /admin/puzzles\r\n", "");
 }
 
-static void event_handler(struct mg_connection *c, int ev, void *ev_data) {
-    if (ev != MG_EV_HTTP_MSG) return;
+/* --- API handlers (/api/v1) --- */
 
-    struct mg_http_message *hm = (struct mg_http_message *) ev_data;
+/* Compact JSON for the mobile wrapper and widgets: the same data as the
+   pages without the markup. Requests use the pages' session cookie and
+   form fields; every response is a JSON object, errors included. */
 
-    User user = {0};
-    int logged_in = get_current_user(hm, &user);
+#define API_JSON "Content-Type: application/json\r\n"
 
-    /* Health check */
-    if (mg_match(hm->uri, mg_str("/health"), NULL)) {
-        mg_http_reply(c, 200, "Content-Type: text/plain\r\n", "OK\n");
+/* Large enough for a full leaderboard of escaped names */
+static char api_buf[64 * 1024];
 
-    } else if (mg_match(hm->uri, mg_str("/auth"), NULL)) {
-        if (method_is(hm, "POST"))
-            handle_auth_code(c, hm);
-        else
-            handle_auth(c, hm);
+static void api_error(struct mg_connection *c, int status, const char *error) {
+    http_reply(c, status, API_JSON, "{\"error\":\"%s\"}", error);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/login"), NULL)) {
-        if (logged_in) {
-            mg_http_reply(c, 302, "Location: /\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_login_submit(c, hm);
-        } else {
-            handle_login_page(c);
-        }
+/* Queues the finished document, or a 500 if it did not fit */
+static void api_reply(struct mg_connection *c, JsonWriter *w) {
+    size_t len;
+    if (json_finish(w, &len) != 0) {
+        api_error(c, 500, "internal");
+        return;
+    }
+    struct iovec iov = { w->buf, len };
+    http_reply_iov(c, 200, API_JSON, &iov, 1);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/logout"), NULL)) {
-        if (method_is(hm, "POST")) {
-            handle_logout(c, hm);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+/* The question as structured data for ladder and choice puzzles, so
+   clients never parse the storage format */
+static void api_write_question(JsonWriter *w, const Puzzle *puzzle) {
+    if (strcmp(puzzle->puzzle_type, "ladder") == 0) {
+        LadderStep steps[MAX_LADDER_STEPS];
+        int n = puzzle_parse_ladder(puzzle->question, steps, MAX_LADDER_STEPS);
+        if (n > 0) {
+            json_array_begin(w, "ladder");
+            for (int i = 0; i < n; i++) {
+                json_object_begin(w, NULL);
+                json_string(w, "word", steps[i].is_blank ? NULL : steps[i].word);
+                json_object_end(w);
+            }
+            json_array_end(w);
+            return;
         }
+    } else if (strcmp(puzzle->puzzle_type, "choice") == 0) {
+        ChoicePuzzle cp;
+        if (puzzle_parse_choice(puzzle->question, &cp) == 0) {
+            json_object_begin(w, "choice");
+            json_string(w, "prompt", cp.prompt);
+            json_array_begin(w, "options");
+            for (int i = 0; i < cp.num_options; i++)
+                json_string(w, NULL, cp.options[i]);
+            json_array_end(w);
+            json_object_end(w);
+            return;
+        }
+    }
+    json_string(w, "question", puzzle->question);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/puzzle"), NULL)) {
-        handle_puzzle_page(c, hm, logged_in ? &user : NULL);
+static void api_puzzle(struct mg_connection *c, User *user) {
+    time_t now = time(NULL);
+    const ReleaseDay *day = release_today(now);
+    if (!day->found) {
+        api_error(c, 404, "no_puzzle");
+        return;
+    }
+    const Puzzle *puzzle = &day->puzzle;
+
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_int(&w, "id", puzzle->id);
+    json_int(&w, "number", day->number);
+    json_string(&w, "date", puzzle->puzzle_date);
+    json_string(&w, "type", puzzle->puzzle_type);
+    json_string(&w, "name", puzzle->puzzle_name);
+    json_bool(&w, "has_hint", puzzle->has_hint);
+    api_write_question(&w, puzzle);
+    json_int(&w, "next_release", (long long)puzzle_next_release(now));
 
-    } else if (mg_match(hm->uri, mg_str("/puzzle/attempt"), NULL)) {
-        if (method_is(hm, "POST")) {
-            handle_puzzle_attempt(c, hm, logged_in ? &user : NULL);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
-        }
+    if (user) {
+        Attempt attempt;
+        if (puzzle_get_attempt(user->id, puzzle->id, &attempt) != 0)
+            memset(&attempt, 0, sizeof(attempt));
+        json_object_begin(&w, "attempt");
+        json_bool(&w, "solved", attempt.solved);
+        json_int(&w, "incorrect_guesses", attempt.incorrect_guesses);
+        json_bool(&w, "hint_used", attempt.hint_used);
+        json_int(&w, "score", attempt.score);
+        json_string(&w, "hint", attempt.hint_used && puzzle->has_hint ? puzzle->hint : NULL);
+        json_object_end(&w);
+    } else {
+        json_null(&w, "attempt");
+    }
+    json_object_end(&w);
+    api_reply(c, &w);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/puzzle/hint"), NULL)) {
-        if (method_is(hm, "POST")) {
-            handle_puzzle_hint(c, hm, logged_in ? &user : NULL);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
-        }
+/* Guesses are for today's puzzle only. A puzzle_id from before the 09:00
+   rollover is refused rather than checked against the new puzzle. */
+static void api_attempt(struct mg_connection *c, struct mg_http_message *hm, User *user) {
+    const ReleaseDay *day = release_today(time(NULL));
+    if (!day->found) {
+        api_error(c, 404, "no_puzzle");
+        return;
+    }
+    const Puzzle *puzzle = &day->puzzle;
 
-    } else if (mg_match(hm->uri, mg_str("/puzzle/result"), NULL)) {
-        handle_puzzle_result(c, hm, logged_in ? &user : NULL);
+    char puzzle_id_str[32] = {0};
+    if (get_form_var(hm, "puzzle_id", puzzle_id_str, sizeof(puzzle_id_str)) > 0 &&
+        atoll(puzzle_id_str) != puzzle->id) {
+        api_error(c, 409, "puzzle_changed");
+        return;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/leagues/join"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_league_join(c, hm, &user);
-        } else {
-            handle_league_join_link(c, hm, &user);
-        }
+    char guess[256] = {0};
+    if (read_guess(hm, puzzle, guess, sizeof(guess)) != NULL) {
+        api_error(c, 400, "invalid_guess");
+        return;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/leagues/leave"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_league_leave(c, hm, &user);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+    int score = 0;
+    int result;
+    if (user) {
+        result = puzzle_submit_guess(user->id, puzzle->id, guess, &score);
+        if (result >= 0)
+            metrics_inc(METRIC_GUESSES);
+        if (result == 1) {
+            metrics_inc(METRIC_SOLVES);
+            live_user_solved(user->id);
         }
+    } else {
+        result = puzzle_check_answer(puzzle->id, guess);
+        if (result == 1)
+            score = puzzle_calculate_score(time(NULL), puzzle->puzzle_date, 0, 0);
+    }
+    if (result < 0) {
+        api_error(c, 500, "internal");
+        return;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/leagues/delete"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_league_delete(c, hm, &user);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
-        }
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_bool(&w, "correct", result == 1);
+    if (result == 1)
+        json_int(&w, "score", score);
+    else
+        json_null(&w, "score");
+    json_object_end(&w);
+    api_reply(c, &w);
+}
 
-    /* Must come after /leagues/join, /leagues/leave, /leagues/delete */
-    } else if (mg_match(hm->uri, mg_str("/leagues/*"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else {
-            handle_league_view(c, hm, &user);
-        }
+static void api_hint(struct mg_connection *c, User *user) {
+    const ReleaseDay *day = release_today(time(NULL));
+    if (!day->found) {
+        api_error(c, 404, "no_puzzle");
+        return;
+    }
+    const Puzzle *puzzle = &day->puzzle;
 
-    } else if (mg_match(hm->uri, mg_str("/leagues"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_league_create(c, hm, &user);
-        } else {
-            handle_leagues_list(c, &user);
+    char hint[512] = {0};
+    if (user) {
+        if (puzzle_reveal_hint(user->id, puzzle->id, hint, sizeof(hint)) != 0) {
+            api_error(c, 404, "no_hint");
+            return;
+        }
+        metrics_inc(METRIC_HINTS);
+    } else {
+        if (!puzzle->has_hint || puzzle->hint[0] == '\0') {
+            api_error(c, 404, "no_hint");
+            return;
         }
+        snprintf(hint, sizeof(hint), "%s", puzzle->hint);
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/archive/*/result"), NULL)) {
-        handle_archive_result(c, hm, logged_in ? &user : NULL);
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_string(&w, "hint", hint);
+    json_object_end(&w);
+    api_reply(c, &w);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/archive/*/attempt"), NULL)) {
-        if (method_is(hm, "POST")) {
-            handle_archive_attempt(c, hm, logged_in ? &user : NULL);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
-        }
+static void api_me(struct mg_connection *c, User *user) {
+    UserStats stats;
+    if (puzzle_get_user_stats(user->id, &stats) != 0) {
+        api_error(c, 500, "internal");
+        return;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/archive/*/hint"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_archive_hint(c, hm, &user);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
-        }
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_int(&w, "id", user->id);
+    json_string(&w, "display_name", user->display_name);
+    json_object_begin(&w, "stats");
+    if (stats.daily_score >= 0)
+        json_int(&w, "daily_score", stats.daily_score);
+    else
+        json_null(&w, "daily_score");
+    json_int(&w, "weekly_total", stats.weekly_total);
+    json_int(&w, "alltime_total", stats.alltime_total);
+    json_int(&w, "average_score", stats.average_score);
+    json_int(&w, "puzzles_solved", stats.puzzles_solved);
+    json_int(&w, "percentile", stats.percentile);
+    json_object_end(&w);
+    json_object_end(&w);
+    api_reply(c, &w);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/archive/*"), NULL)) {
-        handle_archive_puzzle(c, hm, logged_in ? &user : NULL);
+static void api_leagues(struct mg_connection *c, User *user) {
+    League leagues[50];
+    int count = 0;
+    if (league_get_user_leagues(user->id, leagues, 50, &count) != 0) {
+        api_error(c, 500, "internal");
+        return;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/archive"), NULL)) {
-        handle_archive_list(c, logged_in ? &user : NULL);
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_array_begin(&w, "leagues");
+    for (int i = 0; i < count; i++) {
+        json_object_begin(&w, NULL);
+        json_int(&w, "id", leagues[i].id);
+        json_string(&w, "name", leagues[i].name);
+        json_string(&w, "invite_code", leagues[i].invite_code);
+        json_int(&w, "members", leagues[i].member_count);
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+    api_reply(c, &w);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/account"), NULL)) {
-        if (!logged_in) {
-            mg_http_reply(c, 302, "Location: /login\r\n", "");
-        } else if (method_is(hm, "POST")) {
-            handle_account_update(c, hm, &user);
-        } else {
-            handle_account_page(c, hm, &user);
+static const char *const LEAGUE_VIEW_NAMES[LEAGUE_VIEW_COUNT] = {
+    "daily", "weekly", "alltime"
+};
+
+/* The requester's rank and score in many leagues at once:
+   ?leagues=1,2,3 (default: all of theirs) and ?views=daily,weekly
+   (default: all three). Leagues they are not in are left out. */
+static void api_standings(struct mg_connection *c, struct mg_http_message *hm, User *user) {
+    int64_t ids[LEAGUE_MAX_BATCH];
+    int count = 0;
+
+    char list[512] = {0};
+    if (get_query_var(hm, "leagues", list, sizeof(list)) > 0) {
+        for (char *p = list; *p && count < LEAGUE_MAX_BATCH; ) {
+            char *end;
+            long long id = strtoll(p, &end, 10);
+            if (end == p || id <= 0 || (*end != ',' && *end != '\0')) {
+                api_error(c, 400, "bad_leagues");
+                return;
+            }
+            ids[count++] = id;
+            p = *end ? end + 1 : end;
+        }
+    } else {
+        League leagues[LEAGUE_MAX_BATCH];
+        if (league_get_user_leagues(user->id, leagues, LEAGUE_MAX_BATCH, &count) != 0) {
+            api_error(c, 500, "internal");
+            return;
         }
+        for (int i = 0; i < count; i++)
+            ids[i] = leagues[i].id;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/admin/puzzles/new"), NULL)) {
-        if (!logged_in || !auth_is_admin(user.email)) {
-            mg_http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
-        } else if (method_is(hm, "POST")) {
-            handle_admin_puzzle_create(c, hm);
-        } else {
-            handle_admin_puzzle_new(c);
+    int want[LEAGUE_VIEW_COUNT] = {1, 1, 1};
+    char views[64] = {0};
+    if (get_query_var(hm, "views", views, sizeof(views)) > 0) {
+        for (int v = 0; v < LEAGUE_VIEW_COUNT; v++)
+            want[v] = 0;
+        for (char *tok = strtok(views, ","); tok; tok = strtok(NULL, ",")) {
+            int v = 0;
+            while (v < LEAGUE_VIEW_COUNT && strcmp(tok, LEAGUE_VIEW_NAMES[v]) != 0)
+                v++;
+            if (v == LEAGUE_VIEW_COUNT) {
+                api_error(c, 400, "bad_views");
+                return;
+            }
+            want[v] = 1;
         }
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/admin/puzzles/preview"), NULL)) {
-        if (!logged_in || !auth_is_admin(user.email)) {
-            mg_http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
-        } else {
-            handle_admin_puzzle_preview(c, hm);
+    LeagueStanding standings[LEAGUE_MAX_BATCH];
+    if (league_get_standings(user->id, ids, count, standings) != 0) {
+        api_error(c, 500, "internal");
+        return;
+    }
+
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_array_begin(&w, "standings");
+    for (int i = 0; i < count; i++) {
+        if (standings[i].member_count == 0)
+            continue;
+        json_object_begin(&w, NULL);
+        json_int(&w, "league_id", standings[i].league_id);
+        json_int(&w, "members", standings[i].member_count);
+        for (int v = 0; v < LEAGUE_VIEW_COUNT; v++) {
+            if (!want[v])
+                continue;
+            json_object_begin(&w, LEAGUE_VIEW_NAMES[v]);
+            json_int(&w, "rank", standings[i].rank[v]);
+            if (standings[i].score[v] >= 0)
+                json_int(&w, "score", standings[i].score[v]);
+            else
+                json_null(&w, "score");
+            json_object_end(&w);
         }
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+    api_reply(c, &w);
+}
 
-    } else if (mg_match(hm->uri, mg_str("/admin/puzzles/edit"), NULL)) {
-        if (!logged_in || !auth_is_admin(user.email)) {
-            mg_http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
-        } else {
-            handle_admin_puzzle_edit(c, hm);
+/* ?view=daily|weekly|alltime, weekly by default as on the league page */
+static void api_league(struct mg_connection *c, struct mg_http_message *hm, User *user) {
+    /* ID after "/api/v1/leagues/" (16 chars) */
+    char id_str[32] = {0};
+    size_t id_len = hm->uri.len > 16 ? hm->uri.len - 16 : 0;
+    if (id_len >= sizeof(id_str)) id_len = sizeof(id_str) - 1;
+    memcpy(id_str, hm->uri.buf + 16, id_len);
+
+    int64_t league_id = atoll(id_str);
+    League league;
+    if (league_id <= 0 || league_get(league_id, &league) != 0) {
+        api_error(c, 404, "not_found");
+        return;
+    }
+    if (!league_is_member(league_id, user->id)) {
+        api_error(c, 403, "not_a_member");
+        return;
+    }
+
+    char view[16] = {0};
+    get_query_var(hm, "view", view, sizeof(view));
+    int is_daily = strcmp(view, "daily") == 0;
+    int is_alltime = strcmp(view, "alltime") == 0;
+
+    LeaderboardEntry entries[100];
+    int count = 0;
+    int rc;
+    if (is_daily)
+        rc = league_get_leaderboard_today(league_id, entries, 100, &count);
+    else if (is_alltime)
+        rc = league_get_leaderboard_alltime(league_id, entries, 100, &count);
+    else
+        rc = league_get_leaderboard_weekly(league_id, entries, 100, &count);
+    if (rc != 0) {
+        api_error(c, 500, "internal");
+        return;
+    }
+
+    JsonWriter w;
+    json_init(&w, api_buf, sizeof(api_buf));
+    json_object_begin(&w, NULL);
+    json_int(&w, "id", league.id);
+    json_string(&w, "name", league.name);
+    json_string(&w, "view", is_daily ? "daily" : is_alltime ? "alltime" : "weekly");
+    json_array_begin(&w, "rows");
+    for (int i = 0; i < count; i++) {
+        json_object_begin(&w, NULL);
+        json_int(&w, "rank", entries[i].rank);
+        json_int(&w, "user_id", entries[i].user_id);
+        json_string(&w, "name", entries[i].display_name);
+        if (entries[i].score >= 0)
+            json_int(&w, "score", entries[i].score);
+        else
+            json_null(&w, "score");
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+    api_reply(c, &w);
+}
+
+/* --- League races (/leagues/{id}/race) --- */
+
+/* Races use one of the recent archive puzzles: today's would be spoiled */
+#define RACE_PUZZLE_POOL 30
+
+static void handle_league_race(struct mg_connection *c, struct mg_http_message *hm,
+                               User *user) {
+    /* atoll stops at the '/' before "race" */
+    int64_t league_id = hm->uri.len > 9 ? atoll(hm->uri.buf + 9) : 0;
+    League league;
+    if (league_id <= 0 || league_get(league_id, &league) != 0 ||
+        !league_is_member(league_id, user->id)) {
+        http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+        return;
+    }
+
+    struct mg_str *upgrade = mg_http_get_header(hm, "Upgrade");
+    if (upgrade != NULL && mg_strcasecmp(*upgrade, mg_str("websocket")) == 0) {
+        mg_ws_upgrade(c, hm, NULL);
+        const char *name = user->display_name[0] ? user->display_name : user->email;
+        if (race_join(c, league_id, user->id, name) != 0) {
+            mg_ws_send(c, "", 0, WEBSOCKET_OP_CLOSE);
+            c->is_draining = 1;
         }
+        return;
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/admin/puzzles/delete"), NULL)) {
-        if (!logged_in || !auth_is_admin(user.email)) {
-            mg_http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
-        } else if (method_is(hm, "POST")) {
-            handle_admin_puzzle_delete(c, hm);
-        } else {
-            mg_http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+    char safe_name[1536];
+    html_escape(league.name, safe_name, sizeof(safe_name));
+    http_reply(c, 200, page_headers(hm),
+        "%s"
+        "<div class=\"page-header\">\n"
+        "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>%s: Race</div>\n"
+        "  <div class=\"nav\">\n"
+        "    <a href=\"/leagues/%lld\"><span class=\"gt\">&gt;</span>Back to league</a>\n"
+        "  </div>\n"
+        "  <hr class=\"nav-line\">\n"
+        "</div>\n"
+        "<div id=\"race-status\" class=\"content-meta\">Connecting...</div>\n"
+        "<table id=\"race-racers\"></table>\n"
+        "<div id=\"race-puzzle\" class=\"puzzle-box\" style=\"display:none;\"></div>\n"
+        "<form id=\"race-guess\" style=\"display:none;\">\n"
+        "  <input type=\"text\" name=\"guess\" autocomplete=\"off\" placeholder=\"Your answer...\">\n"
+        "  <button type=\"submit\" class=\"action-btn\"><span class=\"gt\">&gt;</span>Guess</button>\n"
+        "</form>\n"
+        "<button id=\"race-start\" class=\"action-btn\" style=\"display:none;\">"
+        "<span class=\"gt\">&gt;</span>Start race</button>\n"
+        "<div id=\"race-log\" class=\"content-meta\" style=\"margin-top:20px;\"></div>\n"
+        "<script>\n"
+        "(function(){if(!window.WebSocket)return;\n"
+        "var ws=new WebSocket((location.protocol=='https:'?'wss://':'ws://')+location.host+'/leagues/%lld/race');\n"
+        "function $(id){return document.getElementById(id);}\n"
+        "var racers={},me=0,st=$('race-status'),pz=$('race-puzzle'),fm=$('race-guess'),go=$('race-start');\n"
+        "function name(id){return racers[id]?racers[id].name:'?';}\n"
+        "function log(t){var d=document.createElement('div');d.textContent=t;$('race-log').prepend(d);}\n"
+        "function draw(){var t=$('race-racers');t.innerHTML='<tr><th>Name</th><th>Wrong</th><th>Place</th></tr>';\n"
+        "  Object.keys(racers).forEach(function(k){var r=racers[k],tr=t.insertRow();\n"
+        "    tr.insertCell().textContent=r.name+(r.id==me?' (you)':'');\n"
+        "    tr.insertCell().textContent=r.guesses;tr.insertCell().textContent=r.place||'-';});}\n"
+        "function show(p){pz.textContent='';var h=document.createElement('div');h.textContent=p.name;pz.appendChild(h);\n"
+        "  var q=document.createElement('div');pz.appendChild(q);\n"
+        "  if(p.ladder)q.textContent=p.ladder.map(function(s){return s.word||'____';}).join(', ');\n"
+        "  else if(p.choice){q.textContent=p.choice.prompt;p.choice.options.forEach(function(o){\n"
+        "    var b=document.createElement('button');b.className='action-btn';b.textContent=o;\n"
+        "    b.onclick=function(){ws.send('guess '+o);};pz.appendChild(b);});}\n"
+        "  else q.textContent=p.question;pz.style.display='';fm.style.display=p.choice?'none':'';}\n"
+        "ws.onmessage=function(e){var m=JSON.parse(e.data);\n"
+        "  if(m.type=='lobby'){me=m.you;racers={};m.racers.forEach(function(r){racers[r.id]=r;});\n"
+        "    st.textContent=m.state=='lobby'?'Waiting to start':'Race under way';go.style.display=m.state=='lobby'?'':'none';}\n"
+        "  else if(m.type=='join'){if(!racers[m.id])racers[m.id]={id:m.id,name:m.name,guesses:0,place:0};log(m.name+' joined');}\n"
+        "  else if(m.type=='leave'){log(name(m.id)+' left');delete racers[m.id];}\n"
+        "  else if(m.type=='countdown'){st.textContent=name(m.by)+' started a race: get ready...';go.style.display='none';\n"
+        "    Object.keys(racers).forEach(function(k){racers[k].guesses=0;racers[k].place=0;});}\n"
+        "  else if(m.type=='start'){st.textContent='Go!';show(m.puzzle);}\n"
+        "  else if(m.type=='guess'){racers[m.id].guesses=m.guesses;log(name(m.id)+' guessed '+m.guess);}\n"
+        "  else if(m.type=='solve'){racers[m.id].place=m.place;log(name(m.id)+' solved it in '+(m.ms/1000).toFixed(1)+'s');\n"
+        "    if(m.id==me){fm.style.display='none';pz.style.display='none';}}\n"
+        "  else if(m.type=='finish'){st.textContent='Finished. The answer was '+m.answer;\n"
+        "    fm.style.display='none';pz.style.display='none';go.style.display='';}\n"
+        "  draw();};\n"
+        "ws.onclose=function(){st.textContent='Disconnected. Reload to rejoin.';go.style.display='none';};\n"
+        "go.onclick=function(){ws.send('start');};\n"
+        "fm.onsubmit=function(e){e.preventDefault();ws.send('guess '+fm.guess.value);fm.guess.value='';};\n"
+        "document.body.addEventListener('htmx:beforeRequest',function(){ws.close();},{once:true});})();\n"
+        "</script>\n"
+        "%s",
+        page_head(hm, "Race"), safe_name, (long long)league_id, (long long)league_id,
+        page_tail(hm));
+}
+
+/* Starts c's race on a random recent puzzle. The query only runs when
+   the race is in its lobby, so repeated starts cost nothing. */
+static void race_start_random(struct mg_connection *c, uint64_t now) {
+    if (race_state(c) != RACE_LOBBY)
+        return;
+
+    static Puzzle pool[RACE_PUZZLE_POOL];
+    int count = 0;
+    unsigned pick = 0;
+    if (puzzle_get_archive(pool, RACE_PUZZLE_POOL, &count, 0) != 0 || count == 0)
+        return;
+    generate_random_bytes((unsigned char *)&pick, sizeof(pick));
+    const Puzzle *puzzle = &pool[pick % (unsigned)count];
+
+    static char buf[4096];
+    JsonWriter w;
+    json_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_int(&w, "id", puzzle->id);
+    json_int(&w, "number", puzzle_get_number(puzzle->id));
+    json_string(&w, "type", puzzle->puzzle_type);
+    json_string(&w, "name", puzzle->puzzle_name);
+    api_write_question(&w, puzzle);
+    json_object_end(&w);
+    if (json_finish(&w, NULL) == 0)
+        race_start(c, puzzle->id, puzzle->answer, buf, now);
+}
+
+/* Racers send "start" or "guess <answer>" as text frames */
+static void handle_race_message(struct mg_connection *c, struct mg_ws_message *wm) {
+    struct mg_str msg = wm->data;
+    uint64_t now = mg_millis();
+    if (mg_strcmp(msg, mg_str("start")) == 0) {
+        race_start_random(c, now);
+    } else if (msg.len > 6 && memcmp(msg.buf, "guess ", 6) == 0) {
+        char guess[256];
+        snprintf(guess, sizeof(guess), "%.*s", (int)(msg.len - 6), msg.buf + 6);
+        race_guess(c, guess, now);
+    }
+}
+
+/* Serves embedded assets from memory, picking the smallest precompressed
+   variant the client accepts. Fingerprinted URLs never change content, so
+   they are cached for a year. */
+static void handle_static(struct mg_connection *c, struct mg_http_message *hm) {
+    int immutable = 0;
+    const Asset *asset = asset_find(hm->uri.buf, hm->uri.len, &immutable);
+    if (asset == NULL) {
+        http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
+        return;
+    }
+
+    const char *cache_control = immutable
+        ? "public, max-age=31536000, immutable"
+        : "no-cache";
+
+    struct mg_str *inm = mg_http_get_header(hm, "If-None-Match");
+    if (inm && etag_matches(inm->buf, inm->len, asset->etag)) {
+        mg_printf(c,
+            "HTTP/1.1 304 Not Modified\r\n"
+            "Cache-Control: %s\r\n"
+            "ETag: %s\r\n"
+            "Content-Length: 0\r\n\r\n",
+            cache_control, asset->etag);
+        c->is_resp = 0;
+        return;
+    }
+
+    const unsigned char *body = asset->data;
+    size_t body_len = asset->len;
+    const char *encoding = "";
+
+    struct mg_str *ae = mg_http_get_header(hm, "Accept-Encoding");
+    if (ae && asset->br && accepts_encoding(ae->buf, ae->len, "br")) {
+        body = asset->br;
+        body_len = asset->br_len;
+        encoding = "Content-Encoding: br\r\n";
+    } else if (ae && asset->gz && accepts_encoding(ae->buf, ae->len, "gzip")) {
+        body = asset->gz;
+        body_len = asset->gz_len;
+        encoding = "Content-Encoding: gzip\r\n";
+    }
+
+    mg_printf(c,
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: %s\r\n"
+        "Cache-Control: %s\r\n"
+        "ETag: %s\r\n"
+        "Vary: Accept-Encoding\r\n"
+        "%s"
+        "Content-Length: %lu\r\n\r\n",
+        asset->content_type, cache_control, asset->etag, encoding,
+        (unsigned long)body_len);
+
+    if (!method_is(hm, "HEAD"))
+        mg_send(c, body, body_len);
+
+    /* Written by hand, so tell mongoose the response is complete */
+    c->is_resp = 0;
+}
+
+typedef enum {
+    ROUTE_HEALTH,
+    ROUTE_AUTH,
+    ROUTE_LOGIN,
+    ROUTE_LOGOUT,
+    ROUTE_PUZZLE,
+    ROUTE_PUZZLE_ATTEMPT,
+    ROUTE_PUZZLE_HINT,
+    ROUTE_PUZZLE_RESULT,
+    ROUTE_LEAGUE_JOIN,
+    ROUTE_LEAGUE_LEAVE,
+    ROUTE_LEAGUE_DELETE,
+    ROUTE_LEAGUE_EVENTS,
+    ROUTE_LEAGUE_RACE,
+    ROUTE_LEAGUE_VIEW,
+    ROUTE_LEAGUES,
+    ROUTE_ARCHIVE_RESULT,
+    ROUTE_ARCHIVE_ATTEMPT,
+    ROUTE_ARCHIVE_HINT,
+    ROUTE_ARCHIVE_PUZZLE,
+    ROUTE_ARCHIVE,
+    ROUTE_ACCOUNT,
+    ROUTE_ADMIN_PUZZLE_NEW,
+    ROUTE_ADMIN_PUZZLE_PREVIEW,
+    ROUTE_ADMIN_PUZZLE_EDIT,
+    ROUTE_ADMIN_PUZZLE_DELETE,
+    ROUTE_ADMIN_PUZZLES,
+    ROUTE_ADMIN,
+    ROUTE_METRICS,
+    ROUTE_HOME,
+    ROUTE_STATIC,
+    ROUTE_API_PUZZLE,
+    ROUTE_API_ATTEMPT,
+    ROUTE_API_HINT,
+    ROUTE_API_ME,
+    ROUTE_API_LEAGUES,
+    ROUTE_API_LEAGUE,
+    ROUTE_API_STANDINGS,
+    ROUTE_API_NOT_FOUND,
+    ROUTE_NOT_FOUND
+} RouteId;
+
+/* Fills key with everything a page's content depends on, using only
+   in-memory version counters. Returns 1 if the page can be validated. */
+typedef int (*RouteValidator)(struct mg_http_message *hm, const User *user,
+                              char *key, size_t key_size);
+
+typedef struct {
+    RouteId id;
+    const char *pattern;        /* mg_match glob, also the stats label */
+    RouteValidator validator;   /* NULL: always rendered */
+    Priority priority;          /* what overload sheds first */
+    RateLimitPolicy limit;      /* see route_limit */
+} Route;
+
+/* Id of today's puzzle as release.c resolved it, 0 if there is none.
+   The data version only counts this process's writes; a puzzle added
+   straight to the database (scripts/add_puzzle.sh) shows up here once
+   release.c retries the missing day. */
+static int64_t released_puzzle_id(void) {
+    const ReleaseDay *day = release_today(time(NULL));
+    return day->found ? day->puzzle.id : 0;
+}
+
+/* Today's puzzle, the archive and result pages: the puzzle set, the day
+   (archive grows at 09:00 UTC) and the viewer's own attempts. A boosted
+   navigation gets the body only, so it is a different representation. */
+static int validate_puzzle_pages(struct mg_http_message *hm, const User *user,
+                                 char *key, size_t key_size) {
+    char today[16];
+    puzzle_current_date(today, sizeof(today));
+
+    int64_t uid = user ? user->id : 0;
+    snprintf(key, key_size, "%lu:%s:p%lu.r%lld:u%lld.%lu:f%d",
+             db_boot_id(), today, db_data_version(DATA_PUZZLES),
+             (long long)released_puzzle_id(),
+             (long long)uid, user ? db_user_version(uid) : 0, is_boosted(hm));
+    return 1;
+}
+
+/* Result pages: a logged-out result puts the current time in its share
+   text, so only the viewer's own result can be revalidated */
+static int validate_result_pages(struct mg_http_message *hm, const User *user,
+                                 char *key, size_t key_size) {
+    if (user == NULL)
+        return 0;
+    return validate_puzzle_pages(hm, user, key, key_size);
+}
+
+/* League pages: memberships, everyone's attempts and display names */
+static int validate_league_pages(struct mg_http_message *hm, const User *user,
+                                 char *key, size_t key_size) {
+    if (user == NULL)
+        return 0;
+
+    char today[16];
+    puzzle_current_date(today, sizeof(today));
+
+    snprintf(key, key_size, "%lu:%s:l%lu:a%lu:n%lu:u%lld:f%d",
+             db_boot_id(), today, db_data_version(DATA_LEAGUES),
+             db_data_version(DATA_ATTEMPTS), db_data_version(DATA_USERS),
+             (long long)user->id, is_boosted(hm));
+    return 1;
+}
+
+/* The API's stats: the viewer's attempts, and everyone's for the
+   percentile */
+static int validate_user_stats(struct mg_http_message *hm, const User *user,
+                               char *key, size_t key_size) {
+    (void)hm;
+    if (user == NULL)
+        return 0;
+
+    char today[16];
+    puzzle_current_date(today, sizeof(today));
+
+    snprintf(key, key_size, "%lu:%s:a%lu:n%lu:u%lld",
+             db_boot_id(), today, db_data_version(DATA_ATTEMPTS),
+             db_data_version(DATA_USERS), (long long)user->id);
+    return 1;
+}
+
+/* Matched in order, first match wins: specific paths must come before
+   the wildcard patterns that would also match them. */
+static const Route ROUTES[] = {
+    { ROUTE_HEALTH,               "/health",                NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_AUTH,                 "/auth",                  NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_LOGIN,                "/login",                 NULL,                  PRIORITY_CRITICAL, RATELIMIT_LOGIN },
+    { ROUTE_LOGOUT,               "/logout",                NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_PUZZLE,               "/puzzle",                validate_puzzle_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_PUZZLE_ATTEMPT,       "/puzzle/attempt",        NULL,                  PRIORITY_CRITICAL, RATELIMIT_GUESS },
+    { ROUTE_PUZZLE_HINT,          "/puzzle/hint",           NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_PUZZLE_RESULT,        "/puzzle/result",         validate_result_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_LEAGUE_JOIN,          "/leagues/join",          NULL,                  PRIORITY_NORMAL,   RATELIMIT_JOIN },
+    { ROUTE_LEAGUE_LEAVE,         "/leagues/leave",         NULL,                  PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_LEAGUE_DELETE,        "/leagues/delete",        NULL,                  PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_LEAGUE_EVENTS,        "/leagues/*/events",      NULL,                  PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_LEAGUE_RACE,          "/leagues/*/race",        NULL,                  PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_LEAGUE_VIEW,          "/leagues/*",             validate_league_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_LEAGUES,              "/leagues",               validate_league_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_ARCHIVE_RESULT,       "/archive/*/result",      validate_result_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_ARCHIVE_ATTEMPT,      "/archive/*/attempt",     NULL,                  PRIORITY_CRITICAL, RATELIMIT_GUESS },
+    { ROUTE_ARCHIVE_HINT,         "/archive/*/hint",        NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_ARCHIVE_PUZZLE,       "/archive/*",             validate_puzzle_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_ARCHIVE,              "/archive",               validate_puzzle_pages, PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_ACCOUNT,              "/account",               NULL,                  PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_ADMIN_PUZZLE_NEW,     "/admin/puzzles/new",     NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_ADMIN_PUZZLE_PREVIEW, "/admin/puzzles/preview", NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_ADMIN_PUZZLE_EDIT,    "/admin/puzzles/edit",    NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_ADMIN_PUZZLE_DELETE,  "/admin/puzzles/delete",  NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_ADMIN_PUZZLES,        "/admin/puzzles",         NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_ADMIN,                "/admin",                 NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_METRICS,              "/metrics",               NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+    { ROUTE_HOME,                 "/",                      NULL,                  PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_STATIC,               "/static/*",              NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_API_PUZZLE,           "/api/v1/puzzle",         validate_puzzle_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_API_ATTEMPT,          "/api/v1/puzzle/attempt", NULL,                  PRIORITY_CRITICAL, RATELIMIT_GUESS },
+    { ROUTE_API_HINT,             "/api/v1/puzzle/hint",    NULL,                  PRIORITY_CRITICAL, RATELIMIT_NONE },
+    { ROUTE_API_ME,               "/api/v1/me",             validate_user_stats,   PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_API_LEAGUES,          "/api/v1/leagues",        validate_league_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_API_LEAGUE,           "/api/v1/leagues/*",      validate_league_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_API_STANDINGS,        "/api/v1/standings",      validate_league_pages, PRIORITY_NORMAL,   RATELIMIT_NONE },
+    { ROUTE_API_NOT_FOUND,        "/api/#",                 NULL,                  PRIORITY_LOW,      RATELIMIT_NONE },
+};
+
+static const Route *route_find(struct mg_http_message *hm) {
+    for (size_t i = 0; i < sizeof(ROUTES) / sizeof(ROUTES[0]); i++) {
+        if (mg_match(hm->uri, mg_str(ROUTES[i].pattern), NULL))
+            return &ROUTES[i];
+    }
+    return NULL;
+}
+
+/* The all-time leaderboard is the one expensive view of a league page */
+static Priority route_priority(const Route *route, struct mg_http_message *hm) {
+    if (route == NULL)
+        return PRIORITY_NORMAL;
+    if (route->id == ROUTE_LEAGUE_VIEW || route->id == ROUTE_API_LEAGUE) {
+        char view[16];
+        if (get_query_var(hm, "view", view, sizeof(view)) > 0 &&
+            strcmp(view, "alltime") == 0)
+            return PRIORITY_LOW;
+    }
+    return route->priority;
+}
+
+/* The policy a request counts against: posts to a limited route, and
+   invite links too, since following one looks its code up */
+static RateLimitPolicy route_limit(const Route *route, struct mg_http_message *hm) {
+    if (route == NULL)
+        return RATELIMIT_NONE;
+    if (method_is(hm, "POST") || (route->id == ROUTE_LEAGUE_JOIN && hm->query.len > 0))
+        return route->limit;
+    return RATELIMIT_NONE;
+}
+
+static const char *LIMIT_MESSAGES[RATELIMIT_POLICY_COUNT] = {
+    [RATELIMIT_LOGIN] = "Too many login attempts.",
+    [RATELIMIT_GUESS] = "Too many guesses.",
+    [RATELIMIT_JOIN]  = "Too many invite codes tried.",
+};
+
+static void reply_rate_limited(struct mg_connection *c, struct mg_http_message *hm,
+                               RateLimitPolicy policy, unsigned retry_after) {
+    char headers[96];
+    if (mg_match(hm->uri, mg_str("/api/#"), NULL)) {
+        snprintf(headers, sizeof(headers), "%sRetry-After: %u\r\n", API_JSON, retry_after);
+        http_reply(c, 429, headers, "{\"error\":\"rate_limited\"}");
+        return;
+    }
+
+    /* Back to the page the form was on: /login, /puzzle, /archive/N */
+    size_t back_len = hm->uri.len;
+    while (back_len > 1 && hm->uri.buf[back_len - 1] != '/')
+        back_len--;
+    back_len = back_len <= 1 ? hm->uri.len : back_len - 1;
+    char back[128], safe_back[768];
+    snprintf(back, sizeof(back), "%.*s", (int)back_len, hm->uri.buf);
+    html_escape(back, safe_back, sizeof(safe_back));
+
+    snprintf(headers, sizeof(headers),
+             "Content-Type: text/html\r\nRetry-After: %u\r\n", retry_after);
+    http_reply(c, 429, headers,
+        "%s"
+        "<div class=\"page-header\">\n"
+        "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Too Many Requests</div>\n"
+        "  <hr class=\"nav-line\">\n"
+        "</div>\n"
+        "<div class=\"puzzle-box\">\n"
+        "  <div>%s<br>Please wait %u seconds and try again.</div>\n"
+        "</div>\n"
+        "<a href=\"%s\" class=\"action-btn\">\n"
+        "  <span class=\"gt\">&gt;</span>Back\n"
+        "</a>\n"
+        "%s",
+        page_head(hm, "Rate Limited"), LIMIT_MESSAGES[policy], retry_after,
+        safe_back, page_tail(hm));
+}
+
+/* Handlers queue the whole response before returning: read its status
+   back from the status line they appended */
+static int response_status(struct mg_connection *c, size_t start) {
+    if (c->send.len < start + 12 || memcmp(c->send.buf + start, "HTTP/1.", 7) != 0)
+        return 0;
+    return atoi((const char *)c->send.buf + start + 9);
+}
+
+/* Logged-out pages that are the same for every visitor. The key holds
+   what the response varies on: the path, the two feedback flags in the
+   query, full page or boosted body, and the encoding. The generation
+   covers what the content depends on: the puzzle day, the puzzles table
+   and the puzzle release.c found for today. */
+static int page_cache_key(struct mg_http_message *hm, const Route *route,
+                          char *key, size_t key_size) {
+    if (route == NULL || !method_is(hm, "GET"))
+        return 0;
+    switch (route->id) {
+        case ROUTE_HOME:
+        case ROUTE_PUZZLE:
+        case ROUTE_ARCHIVE:
+        case ROUTE_ARCHIVE_PUZZLE:
+            break;
+        default:
+            return 0;
+    }
+
+    char today[16], generation[64];
+    puzzle_current_date(today, sizeof(today));
+    snprintf(generation, sizeof(generation), "%lu:%s:p%lu.r%lld",
+             db_boot_id(), today, db_data_version(DATA_PUZZLES),
+             (long long)released_puzzle_id());
+    pagecache_generation(generation);
+
+    char wrong[8] = {0}, hint[8] = {0};
+    get_query_var(hm, "wrong", wrong, sizeof(wrong));
+    get_query_var(hm, "hint", hint, sizeof(hint));
+    int n = snprintf(key, key_size, "%.*s|w%d|h%d|f%d|%s",
+                     (int)hm->uri.len, hm->uri.buf, wrong[0] == '1', hint[0] == '1',
+                     is_boosted(hm), http_gzip_accepted() ? "gzip" : "identity");
+    return n > 0 && (size_t)n < key_size;
+}
+
+/* Fills *requester with the logged-in user, if any */
+static void route_request(struct mg_connection *c, struct mg_http_message *hm,
+                          const Route *route, User *requester) {
+    http_begin(hm, route ? route->pattern : NULL);
+
+    /* Shed before the session lookup so a rejected request costs nothing */
+    if (!admission_admit(route_priority(route, hm))) {
+        AdmissionConfig cfg;
+        admission_get_config(&cfg);
+        char headers[96];
+        snprintf(headers, sizeof(headers),
+                 "Content-Type: text/plain\r\nRetry-After: %u\r\n",
+                 cfg.retry_after_secs);
+        http_reply(c, 503, headers, "Server busy, try again shortly\n");
+        return;
+    }
+
+    User user = {0};
+    TimingPhase phase = timing_enter(TIMING_AUTH);
+    int logged_in = get_current_user(hm, &user);
+    if (logged_in)
+        *requester = user;
+    timing_enter(phase);
+
+    /* Logged-in clients are limited per account, others per IP */
+    RateLimitPolicy limit = route_limit(route, hm);
+    if (limit != RATELIMIT_NONE) {
+        char client[RATELIMIT_KEY_MAX];
+        if (logged_in)
+            snprintf(client, sizeof(client), "u:%lld", (long long)user.id);
+        else
+            get_client_ip(c, hm, client, sizeof(client));
+        unsigned retry_after;
+        if (!ratelimit_take(limit, client, mg_millis(), &retry_after)) {
+            reply_rate_limited(c, hm, limit, retry_after);
+            return;
         }
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/admin/puzzles"), NULL)) {
-        if (!logged_in || !auth_is_admin(user.email)) {
-            mg_http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
-        } else {
-            handle_admin_puzzles_list(c);
+    /* Conditional GET: answer 304 before any rendering queries run */
+    if (route && route->validator && method_is(hm, "GET")) {
+        char key[256];
+        if (route->validator(hm, logged_in ? &user : NULL, key, sizeof(key))) {
+            http_set_etag(key);
+            if (http_not_modified(c, hm))
+                return;
         }
+    }
 
-    } else if (mg_match(hm->uri, mg_str("/admin"), NULL)) {
-        if (!logged_in || !auth_is_admin(user.email)) {
-            mg_http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
-        } else {
-            handle_admin_dashboard(c);
+    char cache_key[PAGECACHE_KEY_MAX];
+    int cacheable = !logged_in && page_cache_key(hm, route, cache_key, sizeof(cache_key));
+    if (cacheable) {
+        const void *data;
+        size_t len;
+        if (pagecache_lookup(cache_key, &data, &len)) {
+            phase = timing_enter(TIMING_WRITE);
+            mg_send(c, data, len);
+            c->is_resp = 0;
+            timing_enter(phase);
+            return;
         }
+    }
+    size_t start = c->send.len;
 
-    } else if (mg_match(hm->uri, mg_str("/"), NULL)) {
-        if (logged_in) {
-            mg_http_reply(c, 302, "Location: /puzzle\r\n", "");
-        } else {
-            mg_http_reply(c, 200, "Content-Type: text/html\r\n",
-                "<!DOCTYPE html>\n"
-                "<html><head><title>Puzzle Pause</title>%s</head>\n"
-                "<body>\n"
-                "<div class=\"page-header\">\n"
-                "  <div class=\"page-title\"><span class=\"gt\">&gt;</span>Puzzle Pause</div>\n"
-                "  <hr class=\"nav-line\">\n"
-                "</div>\n"
-                "<div class=\"puzzle-box\">\n"
-                "  <div>\n"
-                "    A new puzzle awaits<br>every day at 09:00 UTC.<br><br>\n"
-                "    Compete with friends<br>in mini leagues!\n"
-                "  </div>\n"
-                "</div>\n"
-                "<a href=\"/puzzle\" class=\"action-btn\">\n"
-                "  <span class=\"gt\">&gt;</span>Today's puzzle\n"
-                "</a>\n"
-                "<a href=\"/login\" class=\"action-btn\">\n"
-                "  <span class=\"gt\">&gt;</span>Login\n"
-                "</a>\n"
-                "</body></html>\n",
-                TERMINAL_CSS);
+    switch (route ? route->id : ROUTE_NOT_FOUND) {
+        case ROUTE_HEALTH:
+            http_reply(c, 200, "Content-Type: text/plain\r\n", "OK\n");
+            break;
+
+        case ROUTE_AUTH:
+            if (method_is(hm, "POST"))
+                handle_auth_code(c, hm);
+            else
+                handle_auth(c, hm);
+            break;
+
+        case ROUTE_LOGIN:
+            if (logged_in) {
+                http_reply(c, 302, "Location: /\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_login_submit(c, hm);
+            } else {
+                handle_login_page(c);
+            }
+            break;
+
+        case ROUTE_LOGOUT:
+            if (method_is(hm, "POST")) {
+                handle_logout(c, hm);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_PUZZLE:
+            handle_puzzle_page(c, hm, logged_in ? &user : NULL);
+            break;
+
+        case ROUTE_PUZZLE_ATTEMPT:
+            if (method_is(hm, "POST")) {
+                handle_puzzle_attempt(c, hm, logged_in ? &user : NULL);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_PUZZLE_HINT:
+            if (method_is(hm, "POST")) {
+                handle_puzzle_hint(c, hm, logged_in ? &user : NULL);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_PUZZLE_RESULT:
+            handle_puzzle_result(c, hm, logged_in ? &user : NULL);
+            break;
+
+        case ROUTE_LEAGUE_JOIN:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_league_join(c, hm, &user);
+            } else {
+                handle_league_join_link(c, hm, &user);
+            }
+            break;
+
+        case ROUTE_LEAGUE_LEAVE:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_league_leave(c, hm, &user);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_LEAGUE_DELETE:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_league_delete(c, hm, &user);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_LEAGUE_EVENTS:
+            if (!logged_in) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else {
+                handle_league_events(c, hm, &user);
+            }
+            break;
+
+        case ROUTE_LEAGUE_RACE:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else {
+                handle_league_race(c, hm, &user);
+            }
+            break;
+
+        case ROUTE_LEAGUE_VIEW:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else {
+                handle_league_view(c, hm, &user);
+            }
+            break;
+
+        case ROUTE_LEAGUES:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_league_create(c, hm, &user);
+            } else {
+                handle_leagues_list(c, hm, &user);
+            }
+            break;
+
+        case ROUTE_ARCHIVE_RESULT:
+            handle_archive_result(c, hm, logged_in ? &user : NULL);
+            break;
+
+        case ROUTE_ARCHIVE_ATTEMPT:
+            if (method_is(hm, "POST")) {
+                handle_archive_attempt(c, hm, logged_in ? &user : NULL);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_ARCHIVE_HINT:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_archive_hint(c, hm, &user);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_ARCHIVE_PUZZLE:
+            handle_archive_puzzle(c, hm, logged_in ? &user : NULL);
+            break;
+
+        case ROUTE_ARCHIVE:
+            handle_archive_list(c, hm, logged_in ? &user : NULL);
+            break;
+
+        case ROUTE_ACCOUNT:
+            if (!logged_in) {
+                http_reply(c, 302, "Location: /login\r\n", "");
+            } else if (method_is(hm, "POST")) {
+                handle_account_update(c, hm, &user);
+            } else {
+                handle_account_page(c, hm, &user);
+            }
+            break;
+
+        case ROUTE_ADMIN_PUZZLE_NEW:
+            if (!logged_in || !(user.roles & ROLE_ADMIN)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else if (method_is(hm, "POST")) {
+                handle_admin_puzzle_create(c, hm);
+            } else {
+                handle_admin_puzzle_new(c);
+            }
+            break;
+
+        case ROUTE_ADMIN_PUZZLE_PREVIEW:
+            if (!logged_in || !(user.roles & ROLE_ADMIN)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else {
+                handle_admin_puzzle_preview(c, hm);
+            }
+            break;
+
+        case ROUTE_ADMIN_PUZZLE_EDIT:
+            if (!logged_in || !(user.roles & ROLE_ADMIN)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else {
+                handle_admin_puzzle_edit(c, hm);
+            }
+            break;
+
+        case ROUTE_ADMIN_PUZZLE_DELETE:
+            if (!logged_in || !(user.roles & ROLE_ADMIN)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else if (method_is(hm, "POST")) {
+                handle_admin_puzzle_delete(c, hm);
+            } else {
+                http_reply(c, 405, "Content-Type: text/plain\r\n", "Method Not Allowed\n");
+            }
+            break;
+
+        case ROUTE_ADMIN_PUZZLES:
+            if (!logged_in || !(user.roles & ROLE_ADMIN)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else {
+                handle_admin_puzzles_list(c);
+            }
+            break;
+
+        case ROUTE_ADMIN:
+            if (!logged_in || !(user.roles & ROLE_ADMIN)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else {
+                handle_admin_dashboard(c);
+            }
+            break;
+
+        case ROUTE_METRICS:
+            if (!metrics_authorized(hm, logged_in ? &user : NULL)) {
+                http_reply(c, 403, "Content-Type: text/plain\r\n", "Forbidden\n");
+            } else {
+                handle_metrics(c);
+            }
+            break;
+
+        case ROUTE_HOME:
+            if (logged_in) {
+                http_reply(c, 302, "Location: /puzzle\r\n", "");
+            } else {
+                tpl_begin(&page_render, &TPL_HOME);
+                tpl_set_str(&page_render, TPL_HOME_CSS, TERMINAL_CSS);
+                if (tpl_render(&page_render) == 0)
+                    http_reply_iov(c, 200, "Content-Type: text/html\r\n",
+                                   page_render.iov, page_render.iovcnt);
+                else
+                    http_reply(c, 500, "Content-Type: text/plain\r\n", "Internal Server Error\n");
+            }
+            break;
+
+        case ROUTE_STATIC:
+            handle_static(c, hm);
+            break;
+
+        case ROUTE_API_PUZZLE:
+            api_puzzle(c, logged_in ? &user : NULL);
+            break;
+
+        case ROUTE_API_ATTEMPT:
+            if (method_is(hm, "POST"))
+                api_attempt(c, hm, logged_in ? &user : NULL);
+            else
+                api_error(c, 405, "method_not_allowed");
+            break;
+
+        case ROUTE_API_HINT:
+            if (method_is(hm, "POST"))
+                api_hint(c, logged_in ? &user : NULL);
+            else
+                api_error(c, 405, "method_not_allowed");
+            break;
+
+        case ROUTE_API_ME:
+        case ROUTE_API_LEAGUES:
+        case ROUTE_API_LEAGUE:
+        case ROUTE_API_STANDINGS:
+            if (!logged_in)
+                api_error(c, 401, "login_required");
+            else if (route->id == ROUTE_API_ME)
+                api_me(c, &user);
+            else if (route->id == ROUTE_API_LEAGUES)
+                api_leagues(c, &user);
+            else if (route->id == ROUTE_API_LEAGUE)
+                api_league(c, hm, &user);
+            else
+                api_standings(c, hm, &user);
+            break;
+
+        case ROUTE_API_NOT_FOUND:
+            api_error(c, 404, "not_found");
+            break;
+
+        case ROUTE_NOT_FOUND:
+            http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
+            break;
+    }
+
+    if (cacheable && response_status(c, start) == 200)
+        pagecache_store(cache_key, c->send.buf + start, c->send.len - start);
+}
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void event_handler(struct mg_connection *c, int ev, void *ev_data) {
+    if (ev == MG_EV_CLOSE) {
+        live_unsubscribe(c);
+        race_leave(c);
+    }
+    if (ev == MG_EV_WS_MSG) handle_race_message(c, (struct mg_ws_message *) ev_data);
+    if (ev != MG_EV_HTTP_MSG) return;
+
+    struct mg_http_message *hm = (struct mg_http_message *) ev_data;
+    const Route *route = route_find(hm);
+    const char *pattern = route ? route->pattern : NULL;
+    size_t sent_before = c->send.len;
+    User requester = {0};
+    RequestTiming timing;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    timing_begin();
+    admission_request_begin();
+    route_request(c, hm, route, &requester);
+    admission_request_end();
+    timing_end(&timing);
+
+    int status = response_status(c, sent_before);
+    size_t bytes = c->send.len - sent_before;
+    metrics_observe(pattern, status, timing.total, bytes);
+    metrics_observe_phases(pattern, &timing);
+
+    AccessRecord rec;
+    rec.time_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    rec.route = pattern;
+    rec.user_id = requester.id;
+    rec.status = status;
+    rec.bytes = (uint32_t)bytes;
+    rec.latency_us = (uint32_t)(timing.total * 1e6);
+    accesslog_record(&rec);
+
+    /* The response is queued whole, so the header can still go in */
+    if (requester.id != 0 && (requester.roles & ROLE_ADMIN)) {
+        char header[256];
+        if (timing_header(&timing, header, sizeof(header)) > 0)
+            http_insert_header(c, sent_before, header);
+    }
+
+    /* A session whose expiry just slid gets its cookie again, or the
+       browser would still drop it SESSION_EXPIRY_SECS after login */
+    if (requester.session_extended && route != NULL &&
+        route->id != ROUTE_LOGOUT && route->id != ROUTE_AUTH) {
+        char token[SESSION_TOKEN_MAX];
+        char header[SESSION_TOKEN_MAX + 128];
+        if (get_session_cookie(hm, token, sizeof(token))) {
+            snprintf(header, sizeof(header),
+                "Set-Cookie: session=%s; HttpOnly; Secure; SameSite=Strict; Path=/; Max-Age=%d\r\n",
+                token, SESSION_EXPIRY_SECS);
+            http_insert_header(c, sent_before, header);
         }
+    }
+}
+
+/* Accepted connections holding an unparsed request or an unsent response */
+static unsigned count_queued(struct mg_mgr *mgr) {
+    unsigned n = 0;
+    for (struct mg_connection *c = mgr->conns; c != NULL; c = c->next) {
+        if (c->is_accepted && (c->recv.len > 0 || c->send.len > 0))
+            n++;
+    }
+    return n;
+}
 
-    } else if (mg_match(hm->uri, mg_str("/static/*"), NULL)) {
-        struct mg_http_serve_opts opts = {
-            .root_dir = ".",
-            .extra_headers = "Cache-Control: public, max-age=86400\r\n"
-        };
-        mg_http_serve_dir(c, hm, &opts);
+/* Restarts: how long the new process gets to take the listener and state
+   (the old one is not serving meanwhile), and how long the old one keeps
+   serving its open connections afterwards */
+#define HANDOFF_TIMEOUT_MS 2000
+#define DRAIN_TIMEOUT_SECS 30
 
-    } else {
-        mg_http_reply(c, 404, "Content-Type: text/plain\r\n", "Not Found\n");
+extern char **environ;
+
+static volatile sig_atomic_t handoff_requested = 0;
+static volatile sig_atomic_t reload_requested = 0;
+
+static void on_sigusr2(int sig) {
+    (void)sig;
+    handoff_requested = 1;
+}
+
+/* kill -HUP <pid> rereads ADMIN_EMAILS and user_roles */
+static void on_sighup(int sig) {
+    (void)sig;
+    reload_requested = 1;
+}
+
+static int conn_fd(struct mg_connection *c) {
+    return (int)(size_t)c->fd;
+}
+
+/* Finds argv0 on PATH as execvp would: the child may only call execve */
+static int find_binary(const char *argv0, char *path, size_t path_size) {
+    if (strchr(argv0, '/') != NULL) {
+        int n = snprintf(path, path_size, "%s", argv0);
+        return n > 0 && (size_t)n < path_size ? 0 : -1;
+    }
+
+    const char *dirs = getenv("PATH");
+    if (dirs == NULL)
+        dirs = "/usr/bin:/bin";
+    for (;;) {
+        size_t len = strcspn(dirs, ":");
+        int n = len == 0 ? snprintf(path, path_size, "./%s", argv0)
+                         : snprintf(path, path_size, "%.*s/%s", (int)len, dirs, argv0);
+        if (n > 0 && (size_t)n < path_size && access(path, X_OK) == 0)
+            return 0;
+        if (dirs[len] == '\0')
+            return -1;
+        dirs += len + 1;
+    }
+}
+
+/* Our environment with HANDOFF_ENV set to fd, in a malloc'd array whose
+   strings are environ's and fd_var */
+static char **handoff_environ(int fd, char *fd_var, size_t fd_var_size) {
+    size_t n = 0;
+    while (environ[n] != NULL)
+        n++;
+    char **envp = malloc((n + 2) * sizeof(char *));
+    if (envp == NULL)
+        return NULL;
+
+    size_t name_len = strlen(HANDOFF_ENV), k = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (strncmp(environ[i], HANDOFF_ENV, name_len) != 0 || environ[i][name_len] != '=')
+            envp[k++] = environ[i];
+    }
+    snprintf(fd_var, fd_var_size, "%s=%d", HANDOFF_ENV, fd);
+    envp[k++] = fd_var;
+    envp[k] = NULL;
+    return envp;
+}
+
+/* Execs the binary on disk (the new deploy, not /proc/self/exe) and passes
+   it the listener. Returns 0 once it holds it; we then stop listening.
+   The sender and access log threads may hold locks at fork, so the path
+   and environment are built first and the child only closes fds and
+   calls execve. */
+static int start_handoff(struct mg_mgr *mgr, struct mg_connection *listener,
+                         char **argv) {
+    char path[1024];
+    if (find_binary(argv[0], path, sizeof(path)) != 0) {
+        fprintf(stderr, "Handoff: cannot find %s\n", argv[0]);
+        return -1;
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror("socketpair");
+        return -1;
+    }
+
+    char fd_var[64];
+    char **envp = handoff_environ(sv[1], fd_var, sizeof(fd_var));
+    pid_t pid = envp != NULL ? fork() : -1;
+    if (pid < 0) {
+        perror("fork");
+        free(envp);
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* Without this the new process would hold every client connection
+           open after the old one closes it */
+        for (struct mg_connection *c = mgr->conns; c != NULL; c = c->next)
+            close(conn_fd(c));
+        close(sv[0]);
+        execve(path, argv, envp);
+        _exit(127);
+    }
+
+    free(envp);
+    close(sv[1]);
+    uint64_t deadline = mg_millis() + HANDOFF_TIMEOUT_MS;
+    int rc = handoff_send(sv[0], conn_fd(listener), HANDOFF_TIMEOUT_MS);
+    if (rc == 0) {
+        uint64_t now = mg_millis();
+        rc = now < deadline ? handoff_wait_ack(sv[0], (int)(deadline - now)) : -1;
+    }
+    close(sv[0]);
+
+    if (rc != 0) {
+        /* It may hold the listener by now; it must not serve beside us */
+        kill(pid, SIGKILL);
+        fprintf(stderr, "Handoff to pid %d failed, still serving\n", (int)pid);
+        return -1;
+    }
+
+    printf("Handed listener to pid %d, draining\n", (int)pid);
+    listener->is_closing = 1;
+    return 0;
+}
+
+/* Closes idle keep-alive connections; returns how many are still busy */
+static unsigned drain_connections(struct mg_mgr *mgr) {
+    unsigned busy = 0;
+    for (struct mg_connection *c = mgr->conns; c != NULL; c = c->next) {
+        if (!c->is_accepted)
+            continue;
+        if (c->recv.len == 0 && c->send.len == 0)
+            c->is_closing = 1;
+        else
+            busy++;
+    }
+    return busy;
+}
+
+/* New process side of a restart: takes over the old listener instead of
+   binding the port, which the old process still holds */
+static struct mg_connection *adopt_listener(struct mg_mgr *mgr, int sock) {
+    int fd;
+    int restored = handoff_recv(sock, &fd);
+    if (restored < 0) {
+        fprintf(stderr, "Failed to receive listener from previous process\n");
+        return NULL;
+    }
+
+    /* Mongoose cannot wrap an existing listening socket, so open a
+       throwaway one for the HTTP handler and swap the fd underneath it */
+    struct mg_connection *listener =
+        mg_http_listen(mgr, "http://127.0.0.1:0", event_handler, NULL);
+    if (listener == NULL || dup2(fd, conn_fd(listener)) < 0) {
+        close(fd);
+        return NULL;
     }
+    close(fd);
+
+    ratelimit_restored();
+
+    handoff_ack(sock);
+    printf("Took over listener from previous process, %d regions restored\n",
+           restored);
+    return listener;
+}
+
+static unsigned env_unsigned(const char *name, unsigned fallback) {
+    const char *v = getenv(name);
+    return v ? (unsigned)atoi(v) : fallback;
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+    (void)argc;
     signal(SIGCHLD, SIG_IGN);
+    signal(SIGUSR2, on_sigusr2);
+    signal(SIGHUP, on_sighup);
+
+    mg_log_set(MG_LL_INFO);
+
+    struct mg_mgr mgr;
+    mg_mgr_init(&mgr);
+
+    const char *port = getenv("PORT");
+    if (!port) port = "8080";
+
+    /* State that survives a restart: rate limit buckets */
+    size_t ratelimit_size;
+    void *ratelimit = ratelimit_state(&ratelimit_size);
+    handoff_register("ratelimit", ratelimit, ratelimit_size);
+
+    /* On a restart, take the listener and state before anything slow:
+       the old process is waiting on us. Connections arriving until the
+       loop starts wait in the listen queue. */
+    struct mg_connection *listener = NULL;
+    const char *handoff_fd = getenv(HANDOFF_ENV);
+    if (handoff_fd != NULL) {
+        int sock = atoi(handoff_fd);
+        unsetenv(HANDOFF_ENV);
+        listener = adopt_listener(&mgr, sock);
+        close(sock);
+        if (listener == NULL) {
+            fprintf(stderr, "Failed to take over port %s\n", port);
+            return 1;
+        }
+    }
 
     const char *db_path = getenv("PUZZLE_DB_PATH");
     if (!db_path) {
@@ -2967,26 +4081,115 @@ int main(void) {
         fprintf(stderr, "Failed to initialize database\n");
         return 1;
     }
+    timing_attach(db_get());
 
     auth_cleanup_expired();
+    auth_load_roles();
 
-    mg_log_set(MG_LL_INFO);
+    /* SESSION_KEYS switches new logins to signed cookies, see auth.h */
+    if (auth_configure_session_keys(getenv("SESSION_KEYS")) != 0) {
+        fprintf(stderr, "Invalid SESSION_KEYS (expected id:hexsecret,... with %d+ byte secrets)\n",
+                SESSION_KEY_MIN_BYTES);
+        return 1;
+    }
 
-    struct mg_mgr mgr;
-    mg_mgr_init(&mgr);
+    /* Response compression: GZIP_LEVEL=0 turns it off */
+    const char *gzip_level = getenv("GZIP_LEVEL");
+    const char *gzip_min = getenv("GZIP_MIN_SIZE");
+    compress_configure(gzip_level ? atoi(gzip_level) : COMPRESS_DEFAULT_LEVEL,
+                       gzip_min ? (size_t)atol(gzip_min) : COMPRESS_DEFAULT_MIN_SIZE);
 
-    const char *port = getenv("PORT");
-    if (!port) port = "8080";
+    /* Login emails go through the outbox; without a key, codes are
+       printed to the console instead */
+    const char *resend_key = getenv("RESEND_API_KEY");
+    if (resend_key != NULL && resend_key[0] != '\0') {
+        OutboxConfig outbox = {0};
+        outbox.url = getenv("RESEND_API_URL");
+        outbox.api_key = resend_key;
+        outbox.from = getenv("RESEND_FROM_EMAIL");
+        if (outbox_start(db_path, &outbox) != 0) {
+            fprintf(stderr, "Failed to start email sender (is RESEND_FROM_EMAIL set?)\n");
+            return 1;
+        }
+    }
 
-    char listen_addr[64];
-    snprintf(listen_addr, sizeof(listen_addr), "http://0.0.0.0:%s", port);
+    /* Access log: ACCESS_LOG names the file, unset turns it off */
+    const char *access_log = getenv("ACCESS_LOG");
+    if (access_log != NULL && access_log[0] != '\0') {
+        AccessLogConfig alog = {0};
+        alog.path = access_log;
+        alog.capacity = env_unsigned("ACCESS_LOG_BUFFER", ACCESSLOG_DEFAULT_CAPACITY);
+        alog.max_bytes = (long)env_unsigned("ACCESS_LOG_MAX_MB", ACCESSLOG_DEFAULT_MAX_BYTES >> 20) << 20;
+        alog.keep = (int)env_unsigned("ACCESS_LOG_KEEP", ACCESSLOG_DEFAULT_KEEP);
+        if (accesslog_start(&alog) != 0) {
+            fprintf(stderr, "Failed to open access log %s\n", access_log);
+            return 1;
+        }
+    }
 
-    mg_http_listen(&mgr, listen_addr, event_handler, NULL);
+    /* Overload shedding thresholds, see admission.h */
+    AdmissionConfig admit;
+    admission_get_config(&admit);
+    admit.lag_low_ms = env_unsigned("ADMIT_LAG_LOW_MS", admit.lag_low_ms);
+    admit.lag_high_ms = env_unsigned("ADMIT_LAG_HIGH_MS", admit.lag_high_ms);
+    admit.queue_low = env_unsigned("ADMIT_QUEUE_LOW", admit.queue_low);
+    admit.queue_high = env_unsigned("ADMIT_QUEUE_HIGH", admit.queue_high);
+    admit.retry_after_secs = env_unsigned("ADMIT_RETRY_AFTER", admit.retry_after_secs);
+    admission_configure(&admit);
+
+    if (listener == NULL) {
+        char listen_addr[64];
+        snprintf(listen_addr, sizeof(listen_addr), "http://0.0.0.0:%s", port);
+        listener = mg_http_listen(&mgr, listen_addr, event_handler, NULL);
+    }
+    if (listener == NULL) {
+        fprintf(stderr, "Failed to listen on port %s\n", port);
+        return 1;
+    }
     printf("Server listening on port %s\n", port);
 
-    for (;;)
-        mg_mgr_poll(&mgr, 1000);
+    /* kill -USR2 <pid> after installing a new binary restarts without
+       dropping connections */
+    int draining = 0;
+    time_t drain_deadline = 0;
+
+    for (;;) {
+        mg_mgr_poll(&mgr, race_poll_ms(1000, mg_millis()));
+        double work_start = monotonic_seconds();
+        release_tick(time(NULL));
+        writeback_tick(time(NULL));
+        auth_tick(time(NULL));
+        live_flush();
+        race_flush(mg_millis());
+        if (admission_tick(count_queued(&mgr))) {
+            AdmissionStats st;
+            admission_get_stats(&st);
+            printf("Admission: %s (lag %.0fms, %u queued)\n",
+                   admission_level_name(st.level), st.lag_ms, st.queued);
+        }
+        metrics_loop_iteration(monotonic_seconds() - work_start);
+
+        if (reload_requested) {
+            reload_requested = 0;
+            if (auth_load_roles() == 0)
+                printf("Roles reloaded\n");
+        }
+
+        if (handoff_requested) {
+            handoff_requested = 0;
+            if (!draining && start_handoff(&mgr, listener, argv) == 0) {
+                draining = 1;
+                drain_deadline = time(NULL) + DRAIN_TIMEOUT_SECS;
+            }
+        }
+
+        if (draining && (drain_connections(&mgr) == 0 || time(NULL) >= drain_deadline))
+            break;
+    }
 
+    writeback_flush();
+    outbox_stop();
+    accesslog_stop();
     mg_mgr_free(&mgr);
     return 0;
 }
@@ -0,0 +1,203 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "metrics.h"
+#include "sqlite3.h"
+
+/* Latency bucket upper bounds in seconds; one more bucket for +Inf */
+static const double BUCKETS[] = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5
+};
+#define BUCKET_COUNT (sizeof(BUCKETS) / sizeof(BUCKETS[0]))
+
+/* Status codes the server sends; anything else is counted as "other" */
+static const int STATUS_CODES[] = {
+    200, 302, 304, 400, 403, 404, 405, 429, 500, 503
+};
+#define STATUS_COUNT (sizeof(STATUS_CODES) / sizeof(STATUS_CODES[0]))
+
+static const char *COUNTER_NAMES[METRIC_COUNT] = {
+    "guesses", "solves", "hints", "login_codes", "logins"
+};
+
+static const char *COUNTER_HELP[METRIC_COUNT] = {
+    "Guesses submitted by logged-in users.",
+    "Guesses that solved a puzzle.",
+    "Hints revealed.",
+    "Login codes issued.",
+    "Sessions created by a successful login.",
+};
+
+typedef struct {
+    unsigned long buckets[BUCKET_COUNT + 1];
+    unsigned long count;
+    double sum;
+} Histogram;
+
+typedef struct {
+    const char *route;
+    unsigned long status[STATUS_COUNT + 1];
+    unsigned long long bytes;
+    Histogram latency;
+    double phases[TIMING_PHASE_COUNT];
+    double cpu;
+} RouteMetrics;
+
+static RouteMetrics routes[METRICS_MAX_ROUTES];
+static int route_count = 0;
+static Histogram loop_time;
+static double loop_busy = 0;
+static unsigned long counters[METRIC_COUNT];
+
+static void histogram_add(Histogram *h, double value) {
+    size_t i = 0;
+    while (i < BUCKET_COUNT && value > BUCKETS[i])
+        i++;
+    h->buckets[i]++;
+    h->count++;
+    h->sum += value;
+}
+
+/* Route patterns are static strings, so the pointer usually matches */
+static RouteMetrics *route_slot(const char *route) {
+    for (int i = 0; i < route_count; i++) {
+        if (routes[i].route == route || strcmp(routes[i].route, route) == 0)
+            return &routes[i];
+    }
+    if (route_count >= METRICS_MAX_ROUTES)
+        return NULL;
+
+    routes[route_count].route = route;
+    return &routes[route_count++];
+}
+
+void metrics_inc(MetricCounter counter) {
+    if ((unsigned)counter < METRIC_COUNT)
+        counters[counter]++;
+}
+
+void metrics_observe(const char *route, int status, double seconds, size_t bytes) {
+    RouteMetrics *rm = route_slot(route ? route : "unmatched");
+    loop_busy += seconds;
+    if (rm == NULL)
+        return;
+
+    size_t code = 0;
+    while (code < STATUS_COUNT && STATUS_CODES[code] != status)
+        code++;
+    rm->status[code]++;
+    rm->bytes += bytes;
+    histogram_add(&rm->latency, seconds);
+}
+
+void metrics_observe_phases(const char *route, const RequestTiming *timing) {
+    RouteMetrics *rm = route_slot(route ? route : "unmatched");
+    if (rm == NULL)
+        return;
+
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++)
+        rm->phases[i] += timing->phase[i];
+    rm->cpu += timing->cpu;
+}
+
+void metrics_loop_iteration(double extra_seconds) {
+    histogram_add(&loop_time, loop_busy + extra_seconds);
+    loop_busy = 0;
+}
+
+static void emit(metrics_out_fn out, void *arg, const char *fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        out(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1, arg);
+}
+
+/* labels is either empty or "name=\"value\"," */
+static void emit_histogram(metrics_out_fn out, void *arg, const char *name,
+                           const char *labels, const Histogram *h) {
+    unsigned long cumulative = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        cumulative += h->buckets[i];
+        emit(out, arg, "%s_bucket{%sle=\"%g\"} %lu\n", name, labels, BUCKETS[i], cumulative);
+    }
+    emit(out, arg, "%s_bucket{%sle=\"+Inf\"} %lu\n", name, labels, h->count);
+
+    /* Drop the trailing comma for the sum and count series */
+    int len = (int)strlen(labels);
+    if (len > 0) {
+        emit(out, arg, "%s_sum{%.*s} %.6f\n", name, len - 1, labels, h->sum);
+        emit(out, arg, "%s_count{%.*s} %lu\n", name, len - 1, labels, h->count);
+    } else {
+        emit(out, arg, "%s_sum %.6f\n", name, h->sum);
+        emit(out, arg, "%s_count %lu\n", name, h->count);
+    }
+}
+
+void metrics_render(metrics_out_fn out, void *arg) {
+    emit(out, arg, "# HELP puzzle_http_requests_total Requests by route and status code.\n"
+                   "# TYPE puzzle_http_requests_total counter\n");
+    for (int i = 0; i < route_count; i++) {
+        for (size_t s = 0; s <= STATUS_COUNT; s++) {
+            if (routes[i].status[s] == 0)
+                continue;
+            if (s < STATUS_COUNT)
+                emit(out, arg, "puzzle_http_requests_total{route=\"%s\",code=\"%d\"} %lu\n",
+                     routes[i].route, STATUS_CODES[s], routes[i].status[s]);
+            else
+                emit(out, arg, "puzzle_http_requests_total{route=\"%s\",code=\"other\"} %lu\n",
+                     routes[i].route, routes[i].status[s]);
+        }
+    }
+
+    emit(out, arg, "# HELP puzzle_http_response_bytes_total Response bytes queued, headers included.\n"
+                   "# TYPE puzzle_http_response_bytes_total counter\n");
+    for (int i = 0; i < route_count; i++)
+        emit(out, arg, "puzzle_http_response_bytes_total{route=\"%s\"} %llu\n",
+             routes[i].route, routes[i].bytes);
+
+    emit(out, arg, "# HELP puzzle_http_request_duration_seconds Handler time per request.\n"
+                   "# TYPE puzzle_http_request_duration_seconds histogram\n");
+    for (int i = 0; i < route_count; i++) {
+        char labels[128];
+        snprintf(labels, sizeof(labels), "route=\"%s\",", routes[i].route);
+        emit_histogram(out, arg, "puzzle_http_request_duration_seconds", labels,
+                       &routes[i].latency);
+    }
+
+    emit(out, arg, "# HELP puzzle_http_phase_seconds_total Handler time by phase: auth, db, render, write.\n"
+                   "# TYPE puzzle_http_phase_seconds_total counter\n");
+    for (int i = 0; i < route_count; i++) {
+        for (int p = 0; p < TIMING_PHASE_COUNT; p++)
+            emit(out, arg, "puzzle_http_phase_seconds_total{route=\"%s\",phase=\"%s\"} %.6f\n",
+                 routes[i].route, timing_phase_name((TimingPhase)p), routes[i].phases[p]);
+    }
+
+    emit(out, arg, "# HELP puzzle_http_cpu_seconds_total Thread CPU time spent handling requests.\n"
+                   "# TYPE puzzle_http_cpu_seconds_total counter\n");
+    for (int i = 0; i < route_count; i++)
+        emit(out, arg, "puzzle_http_cpu_seconds_total{route=\"%s\"} %.6f\n",
+             routes[i].route, routes[i].cpu);
+
+    emit(out, arg, "# HELP puzzle_loop_iteration_seconds Time each event loop iteration spent working.\n"
+                   "# TYPE puzzle_loop_iteration_seconds histogram\n");
+    emit_histogram(out, arg, "puzzle_loop_iteration_seconds", "", &loop_time);
+
+    emit(out, arg, "# HELP puzzle_sqlite_memory_bytes Memory held by SQLite.\n"
+                   "# TYPE puzzle_sqlite_memory_bytes gauge\n"
+                   "puzzle_sqlite_memory_bytes %lld\n",
+         (long long)sqlite3_memory_used());
+    emit(out, arg, "# HELP puzzle_sqlite_memory_highwater_bytes Peak memory held by SQLite.\n"
+                   "# TYPE puzzle_sqlite_memory_highwater_bytes gauge\n"
+                   "puzzle_sqlite_memory_highwater_bytes %lld\n",
+         (long long)sqlite3_memory_highwater(0));
+
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        emit(out, arg, "# HELP puzzle_%s_total %s\n# TYPE puzzle_%s_total counter\n"
+                       "puzzle_%s_total %lu\n",
+             COUNTER_NAMES[i], COUNTER_HELP[i], COUNTER_NAMES[i], COUNTER_NAMES[i],
+             counters[i]);
+    }
+}
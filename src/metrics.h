@@ -0,0 +1,39 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include "timing.h"
+
+/* Counters for /metrics in the Prometheus text format. Everything lives
+   in fixed static tables, so recording never allocates. */
+
+#define METRICS_MAX_ROUTES 64
+
+/* Application events, counted as puzzle_<name>_total */
+typedef enum {
+    METRIC_GUESSES,
+    METRIC_SOLVES,
+    METRIC_HINTS,
+    METRIC_LOGIN_CODES,     /* login codes issued */
+    METRIC_LOGINS,          /* sessions created */
+    METRIC_COUNT
+} MetricCounter;
+
+void metrics_inc(MetricCounter counter);
+
+/* Records one request against its route pattern (NULL: unmatched) */
+void metrics_observe(const char *route, int status, double seconds, size_t bytes);
+
+/* Adds one request's phase and CPU times to its route's totals */
+void metrics_observe_phases(const char *route, const RequestTiming *timing);
+
+/* Records the time one event loop iteration spent working: the request
+   handlers observed since the last call plus extra_seconds */
+void metrics_loop_iteration(double extra_seconds);
+
+/* Receives the exposition text piece by piece */
+typedef void (*metrics_out_fn)(const char *text, size_t len, void *arg);
+
+void metrics_render(metrics_out_fn out, void *arg);
+
+#endif /* METRICS_H */
@@ -0,0 +1,407 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+#include "outbox.h"
+#include "db.h"
+#include "util.h"
+
+/* A claimed message is hidden from other senders (the old process during
+   a restart handoff) for this long, so it is never sent twice */
+#define LEASE_SECS 120
+#define MAX_BACKOFF_SECS 3600
+#define IDLE_WAIT_SECS 60
+
+typedef enum {
+    SEND_OK,
+    SEND_RETRY,                 /* network error, 5xx, 408 or 429 */
+    SEND_REJECTED               /* any other 4xx: sending again won't help */
+} SendResult;
+
+typedef struct {
+    int64_t id;
+    int attempts;
+    size_t start, len;          /* its JSON object in the batch body */
+    SendResult result;
+    char error[128];
+} Claimed;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t size;
+} Buf;
+
+static OutboxConfig config;
+static OutboxStats stats;
+static char db_path_copy[512];
+
+static pthread_t sender;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int running = 0;
+static int woken = 0;
+
+int outbox_enqueue(const char *to, const char *subject, const char *html) {
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db_get(),
+            "INSERT INTO outbox (recipient, subject, html, next_attempt_at) "
+            "VALUES (?, ?, ?, ?)", -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+
+    sqlite3_bind_text(stmt, 1, to, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, subject, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, html, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, (sqlite3_int64)time(NULL));
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE)
+        return -1;
+
+    pthread_mutex_lock(&lock);
+    woken = 1;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+static int buf_append(Buf *b, const char *s, size_t len) {
+    if (b->len + len + 1 > b->size) {
+        size_t size = b->size ? b->size : 4096;
+        while (size < b->len + len + 1)
+            size *= 2;
+        char *data = realloc(b->data, size);
+        if (data == NULL)
+            return -1;
+        b->data = data;
+        b->size = size;
+    }
+    memcpy(b->data + b->len, s, len);
+    b->len += len;
+    b->data[b->len] = '\0';
+    return 0;
+}
+
+static int buf_puts(Buf *b, const char *s) {
+    return buf_append(b, s, strlen(s));
+}
+
+/* Appends value as a quoted JSON string */
+static int buf_put_json(Buf *b, const char *value) {
+    size_t escaped_size = strlen(value) * 6 + 1;
+    char *escaped = malloc(escaped_size);
+    if (escaped == NULL)
+        return -1;
+    size_t n = json_escape(value, escaped, escaped_size);
+
+    int rc = buf_puts(b, "\"") | buf_append(b, escaped, n) | buf_puts(b, "\"");
+    free(escaped);
+    return rc;
+}
+
+/* Takes up to batch_max due messages, leases them, and renders the
+   request body. Returns the number claimed. */
+static int claim_batch(sqlite3 *db, Claimed *claimed, Buf *body) {
+    time_t now = time(NULL);
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK)
+        return 0;
+
+    sqlite3_stmt *sel = NULL, *lease = NULL;
+    int n = 0;
+    body->len = 0;
+    buf_puts(body, "[");
+
+    if (sqlite3_prepare_v2(db,
+            "SELECT id, recipient, subject, html, attempts FROM outbox "
+            "WHERE next_attempt_at <= ? ORDER BY id LIMIT ?", -1, &sel, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db,
+            "UPDATE outbox SET next_attempt_at = ? WHERE id = ?", -1, &lease, NULL) != SQLITE_OK)
+        goto done;
+
+    sqlite3_bind_int64(sel, 1, (sqlite3_int64)now);
+    sqlite3_bind_int(sel, 2, config.batch_max);
+    while (sqlite3_step(sel) == SQLITE_ROW) {
+        if (n > 0)
+            buf_puts(body, ",");
+        claimed[n].start = body->len;
+        buf_puts(body, "{\"from\":");
+        buf_put_json(body, config.from);
+        buf_puts(body, ",\"to\":[");
+        buf_put_json(body, (const char *)sqlite3_column_text(sel, 1));
+        buf_puts(body, "],\"subject\":");
+        buf_put_json(body, (const char *)sqlite3_column_text(sel, 2));
+        buf_puts(body, ",\"html\":");
+        buf_put_json(body, (const char *)sqlite3_column_text(sel, 3));
+        buf_puts(body, "}");
+        claimed[n].len = body->len - claimed[n].start;
+
+        claimed[n].id = sqlite3_column_int64(sel, 0);
+        claimed[n].attempts = sqlite3_column_int(sel, 4);
+
+        sqlite3_bind_int64(lease, 1, (sqlite3_int64)(now + LEASE_SECS));
+        sqlite3_bind_int64(lease, 2, claimed[n].id);
+        sqlite3_step(lease);
+        sqlite3_reset(lease);
+        n++;
+    }
+
+done:
+    buf_puts(body, "]");
+    sqlite3_finalize(sel);
+    sqlite3_finalize(lease);
+    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+    return n;
+}
+
+/* Sent and rejected messages are deleted; failed ones are rescheduled
+   with exponential backoff until max_attempts, then dropped */
+static void finish_batch(sqlite3 *db, const Claimed *claimed, int n, int requests) {
+    sqlite3_stmt *del = NULL, *retry = NULL;
+    time_t now = time(NULL);
+    int sent = 0, retried = 0, dropped = 0;
+
+    sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
+    sqlite3_prepare_v2(db, "DELETE FROM outbox WHERE id = ?", -1, &del, NULL);
+    sqlite3_prepare_v2(db,
+        "UPDATE outbox SET attempts = ?, next_attempt_at = ?, last_error = ? WHERE id = ?",
+        -1, &retry, NULL);
+
+    for (int i = 0; i < n; i++) {
+        int attempts = claimed[i].attempts + 1;
+        const char *error = claimed[i].error;
+        if (claimed[i].result != SEND_RETRY || attempts >= config.max_attempts) {
+            if (claimed[i].result == SEND_OK) {
+                sent++;
+            } else if (claimed[i].result == SEND_REJECTED) {
+                fprintf(stderr, "Outbox: dropping message %lld, rejected: %s\n",
+                        (long long)claimed[i].id, error);
+                dropped++;
+            } else {
+                fprintf(stderr, "Outbox: dropping message %lld after %d attempts: %s\n",
+                        (long long)claimed[i].id, attempts, error);
+                dropped++;
+            }
+            sqlite3_bind_int64(del, 1, claimed[i].id);
+            sqlite3_step(del);
+            sqlite3_reset(del);
+            continue;
+        }
+
+        long backoff = (long)config.backoff_secs << (attempts - 1 < 20 ? attempts - 1 : 20);
+        if (backoff > MAX_BACKOFF_SECS)
+            backoff = MAX_BACKOFF_SECS;
+        sqlite3_bind_int(retry, 1, attempts);
+        sqlite3_bind_int64(retry, 2, (sqlite3_int64)(now + backoff));
+        sqlite3_bind_text(retry, 3, error, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(retry, 4, claimed[i].id);
+        sqlite3_step(retry);
+        sqlite3_reset(retry);
+        retried++;
+    }
+
+    sqlite3_finalize(del);
+    sqlite3_finalize(retry);
+    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+
+    pthread_mutex_lock(&lock);
+    stats.requests += requests;
+    stats.sent += sent;
+    stats.retried += retried;
+    stats.dropped += dropped;
+    pthread_mutex_unlock(&lock);
+}
+
+/* The kept-alive socket must not leak into the binary a restart execs */
+static int set_cloexec(void *arg, curl_socket_t fd, curlsocktype purpose) {
+    (void)arg;
+    (void)purpose;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return CURL_SOCKOPT_OK;
+}
+
+static size_t discard_response(char *ptr, size_t size, size_t nmemb, void *arg) {
+    (void)ptr;
+    (void)arg;
+    return size * nmemb;
+}
+
+/* Posts body; on failure fills error */
+static SendResult post_batch(CURL *curl, const Buf *body, char *error, size_t error_size) {
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->data);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)body->len);
+
+    CURLcode res = curl_easy_perform(curl);
+    if (res != CURLE_OK) {
+        snprintf(error, error_size, "%s", curl_easy_strerror(res));
+        return SEND_RETRY;
+    }
+
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 200 && status < 300)
+        return SEND_OK;
+    snprintf(error, error_size, "HTTP %ld", status);
+    if (status >= 400 && status < 500 && status != 408 && status != 429)
+        return SEND_REJECTED;
+    return SEND_RETRY;
+}
+
+/* The provider validates a batch as a whole, so one bad address fails
+   them all. Sends each message on its own so only that one is dropped.
+   Returns the number of requests made. */
+static int post_each(CURL *curl, Claimed *claimed, int n, const Buf *body, Buf *single) {
+    for (int i = 0; i < n; i++) {
+        single->len = 0;
+        if (buf_puts(single, "[") != 0 ||
+            buf_append(single, body->data + claimed[i].start, claimed[i].len) != 0 ||
+            buf_puts(single, "]") != 0) {
+            claimed[i].result = SEND_RETRY;
+            snprintf(claimed[i].error, sizeof(claimed[i].error), "out of memory");
+            continue;
+        }
+        claimed[i].result = post_batch(curl, single, claimed[i].error,
+                                       sizeof(claimed[i].error));
+    }
+    return n;
+}
+
+/* Sleeps until a message is enqueued, the next retry is due, or stop */
+static void wait_for_work(sqlite3 *db) {
+    time_t now = time(NULL);
+    time_t until = now + IDLE_WAIT_SECS;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT MIN(next_attempt_at) FROM outbox",
+                           -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW &&
+            sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            time_t next = (time_t)sqlite3_column_int64(stmt, 0);
+            if (next < until)
+                until = next;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    struct timespec deadline = { until, 0 };
+    pthread_mutex_lock(&lock);
+    while (running && !woken && time(NULL) < until) {
+        if (pthread_cond_timedwait(&cond, &lock, &deadline) != 0)
+            break;
+    }
+    woken = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void *sender_main(void *arg) {
+    (void)arg;
+    sqlite3 *db = NULL;
+    if (sqlite3_open(db_path_copy, &db) != SQLITE_OK) {
+        fprintf(stderr, "Outbox: cannot open database: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    /* One handle for the thread's lifetime: curl keeps the connection
+       (and its TLS session) open between requests */
+    CURL *curl = curl_easy_init();
+    char auth[512];
+    snprintf(auth, sizeof(auth), "Authorization: Bearer %s", config.api_key);
+    struct curl_slist *headers = curl_slist_append(NULL, auth);
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+
+    curl_easy_setopt(curl, CURLOPT_URL, config.url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)config.timeout_secs);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_response);
+    curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, set_cloexec);
+
+    Claimed *claimed = calloc((size_t)config.batch_max, sizeof(Claimed));
+    Buf body = {0}, single = {0};
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        int keep_running = running;
+        pthread_mutex_unlock(&lock);
+        if (!keep_running)
+            break;
+
+        int n = claim_batch(db, claimed, &body);
+        if (n == 0) {
+            wait_for_work(db);
+            continue;
+        }
+
+        char error[128] = "";
+        SendResult result = post_batch(curl, &body, error, sizeof(error));
+        int requests = 1;
+        if (result == SEND_REJECTED && n > 1) {
+            requests += post_each(curl, claimed, n, &body, &single);
+        } else {
+            for (int i = 0; i < n; i++) {
+                claimed[i].result = result;
+                snprintf(claimed[i].error, sizeof(claimed[i].error), "%s", error);
+            }
+        }
+        finish_batch(db, claimed, n, requests);
+    }
+
+    free(single.data);
+    free(body.data);
+    free(claimed);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    sqlite3_close(db);
+    return NULL;
+}
+
+int outbox_start(const char *db_path, const OutboxConfig *cfg) {
+    if (running || db_path == NULL || cfg->api_key == NULL || cfg->from == NULL)
+        return -1;
+
+    config = *cfg;
+    if (config.url == NULL)
+        config.url = OUTBOX_DEFAULT_URL;
+    if (config.batch_max <= 0)
+        config.batch_max = OUTBOX_DEFAULT_BATCH;
+    if (config.max_attempts <= 0)
+        config.max_attempts = OUTBOX_DEFAULT_MAX_ATTEMPTS;
+    if (config.backoff_secs <= 0)
+        config.backoff_secs = OUTBOX_DEFAULT_BACKOFF_SECS;
+    if (config.timeout_secs <= 0)
+        config.timeout_secs = 10;
+    snprintf(db_path_copy, sizeof(db_path_copy), "%s", db_path);
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    running = 1;
+    if (pthread_create(&sender, NULL, sender_main, NULL) != 0) {
+        running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void outbox_stop(void) {
+    pthread_mutex_lock(&lock);
+    if (!running) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    running = 0;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+
+    pthread_join(sender, NULL);
+}
+
+void outbox_get_stats(OutboxStats *out) {
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
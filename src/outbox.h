@@ -0,0 +1,43 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+/* Persistent outbound email queue. Request handlers insert into the
+   outbox table; one sender thread drains it over a single kept-alive
+   HTTP connection, batching messages and retrying with backoff. */
+
+#define OUTBOX_DEFAULT_URL "https://api.resend.com/emails/batch"
+#define OUTBOX_DEFAULT_BATCH 50         /* the provider accepts up to 100 */
+#define OUTBOX_DEFAULT_MAX_ATTEMPTS 6
+#define OUTBOX_DEFAULT_BACKOFF_SECS 2   /* doubles per failed attempt */
+
+typedef struct {
+    const char *url;            /* batch endpoint taking a JSON array */
+    const char *api_key;
+    const char *from;
+    int batch_max;
+    int max_attempts;           /* then the message is dropped */
+    int backoff_secs;
+    int timeout_secs;           /* per HTTP request */
+} OutboxConfig;
+
+typedef struct {
+    unsigned long requests;     /* HTTP requests made */
+    unsigned long sent;         /* messages accepted by the provider */
+    unsigned long retried;      /* message attempts that failed */
+    unsigned long dropped;      /* messages given up on */
+} OutboxStats;
+
+/* Queues a message on the event loop's connection (db_get()) and wakes
+   the sender. Returns 0 on success, -1 on error. */
+int outbox_enqueue(const char *to, const char *subject, const char *html);
+
+/* Starts the sender thread with its own connection to db_path. The
+   config strings must outlive the thread. */
+int outbox_start(const char *db_path, const OutboxConfig *cfg);
+
+/* Stops the sender after its current request */
+void outbox_stop(void);
+
+void outbox_get_stats(OutboxStats *out);
+
+#endif /* OUTBOX_H */
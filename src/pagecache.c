@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pagecache.h"
+
+typedef struct {
+    uint64_t hash;              /* 0: slot free */
+    char key[PAGECACHE_KEY_MAX];
+    char *data;
+    size_t len;
+    unsigned long seq;          /* store order, oldest is evicted first */
+} Entry;
+
+static Entry entries[PAGECACHE_MAX_ENTRIES];
+static char current_generation[PAGECACHE_KEY_MAX];
+static unsigned long next_seq = 1;
+static PageCacheStats stats;
+
+/* FNV-1a, never 0 so that 0 can mark a free slot */
+static uint64_t key_hash(const char *key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+static Entry *find(const char *key, uint64_t hash) {
+    for (int i = 0; i < PAGECACHE_MAX_ENTRIES; i++) {
+        if (entries[i].hash == hash && strcmp(entries[i].key, key) == 0)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+static void drop(Entry *e) {
+    free(e->data);
+    stats.bytes -= e->len;
+    stats.entries--;
+    memset(e, 0, sizeof(*e));
+}
+
+static Entry *oldest(void) {
+    Entry *old = NULL;
+    for (int i = 0; i < PAGECACHE_MAX_ENTRIES; i++) {
+        if (entries[i].hash != 0 && (old == NULL || entries[i].seq < old->seq))
+            old = &entries[i];
+    }
+    return old;
+}
+
+void pagecache_generation(const char *generation) {
+    if (strncmp(current_generation, generation, sizeof(current_generation) - 1) == 0)
+        return;
+
+    if (current_generation[0] != '\0')
+        stats.flushes++;
+    pagecache_flush();
+    snprintf(current_generation, sizeof(current_generation), "%s", generation);
+}
+
+int pagecache_lookup(const char *key, const void **data, size_t *len) {
+    Entry *e = find(key, key_hash(key));
+    if (e == NULL) {
+        stats.misses++;
+        return 0;
+    }
+    *data = e->data;
+    *len = e->len;
+    stats.hits++;
+    return 1;
+}
+
+int pagecache_store(const char *key, const void *data, size_t len) {
+    if (len == 0 || len > PAGECACHE_MAX_RESPONSE || strlen(key) >= PAGECACHE_KEY_MAX)
+        return -1;
+
+    uint64_t hash = key_hash(key);
+    Entry *e = find(key, hash);
+    if (e != NULL)
+        drop(e);
+
+    while (stats.entries >= PAGECACHE_MAX_ENTRIES || stats.bytes + len > PAGECACHE_MAX_BYTES) {
+        drop(oldest());
+        stats.evictions++;
+    }
+
+    char *copy = malloc(len);
+    if (copy == NULL)
+        return -1;
+    memcpy(copy, data, len);
+
+    for (int i = 0; i < PAGECACHE_MAX_ENTRIES; i++) {
+        if (entries[i].hash != 0)
+            continue;
+        e = &entries[i];
+        e->hash = hash;
+        snprintf(e->key, sizeof(e->key), "%s", key);
+        e->data = copy;
+        e->len = len;
+        e->seq = next_seq++;
+        stats.entries++;
+        stats.bytes += len;
+        stats.stores++;
+        return 0;
+    }
+
+    free(copy);
+    return -1;
+}
+
+void pagecache_flush(void) {
+    for (int i = 0; i < PAGECACHE_MAX_ENTRIES; i++) {
+        if (entries[i].hash != 0)
+            drop(&entries[i]);
+    }
+}
+
+void pagecache_get_stats(PageCacheStats *out) {
+    *out = stats;
+}
@@ -0,0 +1,43 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <stddef.h>
+
+/* Finished responses for pages that are the same for every logged-out
+   visitor. An entry is the exact bytes queued for one key, status line
+   to last chunk, so a hit is replayed with a single send. The caller puts
+   the encoding in the key, so gzip and identity variants are stored side
+   by side and a hit never compresses.
+
+   Entries belong to a generation describing everything the pages depend
+   on; moving to a new one drops them all. */
+
+#define PAGECACHE_MAX_ENTRIES 128
+#define PAGECACHE_MAX_BYTES (4 * 1024 * 1024)
+#define PAGECACHE_MAX_RESPONSE (256 * 1024)     /* larger ones are not kept */
+#define PAGECACHE_KEY_MAX 160
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long stores;
+    unsigned long evictions;    /* entries dropped to make room */
+    unsigned long flushes;      /* generation changes */
+    unsigned entries;
+    size_t bytes;
+} PageCacheStats;
+
+/* Drops every entry if generation differs from the current one */
+void pagecache_generation(const char *generation);
+
+/* Returns 1 and points *data at the stored response on a hit */
+int pagecache_lookup(const char *key, const void **data, size_t *len);
+
+/* Copies a response in, evicting the oldest entries if full.
+   Returns 0 on success, -1 if it is too large or memory runs out. */
+int pagecache_store(const char *key, const void *data, size_t len);
+
+void pagecache_flush(void);
+void pagecache_get_stats(PageCacheStats *out);
+
+#endif /* PAGECACHE_H */
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
@@ -107,17 +108,25 @@ int puzzle_parse_choice(const char *question, ChoicePuzzle *out) {
 }
 
 /* Before 09:00 UTC, show yesterday's puzzle */
-static void get_puzzle_date(char *out, size_t out_size) {
-    time_t now = (time_t)get_current_time();
-    struct tm *tm = gmtime(&now);
+void puzzle_date_at(time_t when, char *out, size_t out_size) {
+    struct tm *tm = gmtime(&when);
 
     if (tm->tm_hour < 9)
-        now -= 86400;
+        when -= 86400;
 
-    tm = gmtime(&now);
+    tm = gmtime(&when);
     strftime(out, out_size, "%Y-%m-%d", tm);
 }
 
+void puzzle_current_date(char *out, size_t out_size) {
+    puzzle_date_at((time_t)get_current_time(), out, out_size);
+}
+
+time_t puzzle_next_release(time_t now) {
+    time_t release = now - now % 86400 + 9 * 3600;
+    return release > now ? release : release + 86400;
+}
+
 static int populate_puzzle(sqlite3_stmt *stmt, Puzzle *p) {
     memset(p, 0, sizeof(Puzzle));
 
@@ -151,15 +160,18 @@ static const char *PUZZLE_SELECT =
     "SELECT id, puzzle_date, puzzle_type, puzzle_name, question, answer, hint FROM puzzles ";
 
 int puzzle_get_today(Puzzle *puzzle_out) {
+    char today[16];
+    puzzle_current_date(today, sizeof(today));
+    return puzzle_get_by_date(today, puzzle_out);
+}
+
+int puzzle_get_by_date(const char *date, Puzzle *puzzle_out) {
     sqlite3 *db = db_get();
     sqlite3_stmt *stmt = NULL;
 
-    if (db == NULL || puzzle_out == NULL)
+    if (db == NULL || date == NULL || puzzle_out == NULL)
         return -1;
 
-    char today[16];
-    get_puzzle_date(today, sizeof(today));
-
     char sql[512];
     snprintf(sql, sizeof(sql), "%s WHERE puzzle_date = ?", PUZZLE_SELECT);
 
@@ -167,7 +179,7 @@ int puzzle_get_today(Puzzle *puzzle_out) {
     if (rc != SQLITE_OK)
         return -1;
 
-    sqlite3_bind_text(stmt, 1, today, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 1, date, -1, SQLITE_STATIC);
 
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
@@ -215,7 +227,7 @@ int puzzle_get_archive(Puzzle *puzzles, int max, int *count, int include_future)
         return -1;
 
     char today[16];
-    get_puzzle_date(today, sizeof(today));
+    puzzle_current_date(today, sizeof(today));
 
     char sql[512];
     if (include_future) {
@@ -314,6 +326,12 @@ int puzzle_get_attempt(int64_t user_id, int64_t puzzle_id, Attempt *attempt_out)
     return 0;
 }
 
+/* Invalidates validators of pages showing this user's attempts */
+static void attempts_changed(int64_t user_id) {
+    db_bump_version(DATA_ATTEMPTS);
+    db_bump_user_version(user_id);
+}
+
 /* Creates attempt record if one doesn't exist, returns attempt ID */
 static int64_t ensure_attempt_exists(int64_t user_id, int64_t puzzle_id) {
     sqlite3 *db = db_get();
@@ -339,6 +357,7 @@ static int64_t ensure_attempt_exists(int64_t user_id, int64_t puzzle_id) {
     if (rc != SQLITE_DONE)
         return -1;
 
+    attempts_changed(user_id);
     return sqlite3_last_insert_rowid(db);
 }
 
@@ -412,7 +431,7 @@ static int check_unordered(const char *guess_norm, const char *answer_words) {
     return 1;
 }
 
-static int check_answer(const char *guess, const char *answer) {
+int puzzle_answer_matches(const char *guess, const char *answer) {
     char guess_norm[256];
     strncpy(guess_norm, guess, sizeof(guess_norm) - 1);
     guess_norm[sizeof(guess_norm) - 1] = '\0';
@@ -449,7 +468,7 @@ int puzzle_check_answer(int64_t puzzle_id, const char *guess) {
     if (puzzle_get_by_id(puzzle_id, &puzzle) != 0)
         return -1;
 
-    return check_answer(guess, puzzle.answer) ? 1 : 0;
+    return puzzle_answer_matches(guess, puzzle.answer);
 }
 
 int puzzle_calculate_score(time_t solve_time, const char *puzzle_date,
@@ -547,7 +566,7 @@ int puzzle_submit_guess(int64_t user_id, int64_t puzzle_id,
         return 1;
     }
 
-    if (check_answer(guess, answer)) {
+    if (puzzle_answer_matches(guess, answer)) {
         time_t now = (time_t)get_current_time();
         int score = puzzle_calculate_score(now, puzzle_date,
                                            attempt.incorrect_guesses,
@@ -569,6 +588,7 @@ int puzzle_submit_guess(int64_t user_id, int64_t puzzle_id,
 
         sqlite3_step(stmt);
         sqlite3_finalize(stmt);
+        attempts_changed(user_id);
 
         if (score_out) *score_out = score;
         return 1;
@@ -582,6 +602,7 @@ int puzzle_submit_guess(int64_t user_id, int64_t puzzle_id,
             sqlite3_step(stmt);
             sqlite3_finalize(stmt);
         }
+        attempts_changed(user_id);
 
         return 0;
     }
@@ -631,6 +652,7 @@ int puzzle_reveal_hint(int64_t user_id, int64_t puzzle_id,
         sqlite3_step(stmt);
         sqlite3_finalize(stmt);
     }
+    attempts_changed(user_id);
 
     return 0;
 }
@@ -747,7 +769,11 @@ int puzzle_create(const Puzzle *puzzle) {
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
-    return (rc == SQLITE_DONE) ? 0 : -1;
+    if (rc != SQLITE_DONE)
+        return -1;
+
+    db_bump_version(DATA_PUZZLES);
+    return 0;
 }
 
 int puzzle_update(const Puzzle *puzzle) {
@@ -782,6 +808,7 @@ int puzzle_update(const Puzzle *puzzle) {
     if (rc != SQLITE_DONE)
         return -1;
 
+    db_bump_version(DATA_PUZZLES);
     return sqlite3_changes(db) > 0 ? 0 : -1;
 }
 
@@ -800,6 +827,7 @@ int puzzle_delete(int64_t puzzle_id) {
     sqlite3_bind_int64(stmt, 1, puzzle_id);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    db_bump_version(DATA_ATTEMPTS);
 
     rc = sqlite3_prepare_v2(db,
         "DELETE FROM puzzles WHERE id = ?", -1, &stmt, NULL);
@@ -813,5 +841,6 @@ int puzzle_delete(int64_t puzzle_id) {
     if (rc != SQLITE_DONE)
         return -1;
 
+    db_bump_version(DATA_PUZZLES);
     return sqlite3_changes(db) > 0 ? 0 : -1;
 }
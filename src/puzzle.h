@@ -45,7 +45,15 @@ typedef struct {
 
 int puzzle_parse_choice(const char *question, ChoicePuzzle *out);
 
+/* Current puzzle day as YYYY-MM-DD; the day rolls over at 09:00 UTC */
+void puzzle_current_date(char *out, size_t out_size);
+void puzzle_date_at(time_t when, char *out, size_t out_size);
+
+/* The first 09:00 UTC rollover strictly after now */
+time_t puzzle_next_release(time_t now);
+
 int puzzle_get_today(Puzzle *puzzle_out);
+int puzzle_get_by_date(const char *date, Puzzle *puzzle_out);
 int puzzle_get_by_id(int64_t puzzle_id, Puzzle *puzzle_out);
 int puzzle_get_archive(Puzzle *puzzles, int max, int *count, int include_future);
 int puzzle_get_number(int64_t puzzle_id);
@@ -64,6 +72,10 @@ int puzzle_calculate_score(time_t solve_time, const char *puzzle_date,
 /* Returns 1 if correct, 0 if incorrect, -1 on error. No DB writes. */
 int puzzle_check_answer(int64_t puzzle_id, const char *guess);
 
+/* Returns 1 if guess matches answer: "a|b" accepts either, a leading "~"
+   accepts the words in any order. Pure string work, no DB access. */
+int puzzle_answer_matches(const char *guess, const char *answer);
+
 char *puzzle_normalize_answer(char *str);
 
 typedef struct {
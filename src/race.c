@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <string.h>
+#include "race.h"
+#include "json.h"
+#include "puzzle.h"
+
+typedef struct {
+    int64_t league_id;
+    unsigned racers;            /* 0: slot free */
+    int first;                  /* racer list, -1: empty */
+    RaceState state;
+    uint64_t starts_at;         /* countdown over, the puzzle goes out */
+    uint64_t ends_at;
+    int64_t puzzle_id;
+    char answer[256];
+    int solved;                 /* the next solver's place is solved + 1 */
+    struct mg_iobuf start;      /* the puzzle frame, written by race_start */
+    struct mg_iobuf out;        /* frames queued this iteration, sent to all */
+} Race;
+
+typedef struct {
+    struct mg_connection *c;    /* NULL: slot free */
+    int race;
+    int prev, next;             /* within the race, -1: none */
+    int64_t user_id;
+    char name[64];
+    int guesses;                /* wrong ones, this race */
+    int place;                  /* 0: not solved yet */
+} Racer;
+
+static Race races[RACE_MAX_RACES];
+static Racer racers[RACE_MAX_RACERS];
+static uint64_t ping_ms = 0;
+static RaceStats stats;
+
+/* Every event is written here, then framed into a queue */
+static char doc_buf[RACE_MAX_FRAME];
+
+/* Server frames are unmasked, so one copy serves every racer */
+static void queue_frame(struct mg_iobuf *out, const char *doc, size_t len) {
+    unsigned char hdr[4] = { 0x80 | WEBSOCKET_OP_TEXT };
+    size_t n = 2;
+    if (len < 126) {
+        hdr[1] = (unsigned char)len;
+    } else {
+        hdr[1] = 126;
+        hdr[2] = (unsigned char)(len >> 8);
+        hdr[3] = (unsigned char)len;
+        n = 4;
+    }
+    mg_iobuf_add(out, out->len, hdr, n);
+    mg_iobuf_add(out, out->len, doc, len);
+}
+
+static void event_begin(JsonWriter *w, const char *type) {
+    json_init(w, doc_buf, sizeof(doc_buf));
+    json_object_begin(w, NULL);
+    json_string(w, "type", type);
+}
+
+static void event_queue(JsonWriter *w, struct mg_iobuf *out) {
+    json_object_end(w);
+    size_t len;
+    if (json_finish(w, &len) == 0)
+        queue_frame(out, doc_buf, len);
+}
+
+/* A racer that cannot keep up is dropped rather than buffered without
+   bound; the page reconnects and gets the lobby again */
+static void send_frames(struct mg_connection *c, const void *buf, size_t len) {
+    if (c->is_closing)
+        return;
+    if (c->send.len > RACE_MAX_BACKLOG) {
+        c->is_closing = 1;
+        stats.overflows++;
+        return;
+    }
+    mg_send(c, buf, len);
+    stats.frames++;
+}
+
+/* The slot is kept in the connection so a close does not search */
+static Racer *find_racer(struct mg_connection *c) {
+    int slot;
+    memcpy(&slot, c->data, sizeof(slot));
+    if (slot < 0 || slot >= RACE_MAX_RACERS || racers[slot].c != c)
+        return NULL;
+    return &racers[slot];
+}
+
+static void write_racer(JsonWriter *w, const Racer *rc) {
+    json_object_begin(w, NULL);
+    json_int(w, "id", rc->user_id);
+    json_string(w, "name", rc->name);
+    json_int(w, "guesses", rc->guesses);
+    json_int(w, "place", rc->place);
+    json_object_end(w);
+}
+
+static void finish(Race *r) {
+    /* Shown as on the puzzle page: no '~' marker, first alternative only */
+    char shown[sizeof(r->answer)];
+    snprintf(shown, sizeof(shown), "%s", r->answer[0] == '~' ? r->answer + 1 : r->answer);
+    char *pipe = strchr(shown, '|');
+    if (pipe)
+        *pipe = '\0';
+
+    JsonWriter w;
+    event_begin(&w, "finish");
+    json_int(&w, "puzzle_id", r->puzzle_id);
+    json_string(&w, "answer", shown);
+    json_array_begin(&w, "racers");
+    for (int i = r->first; i >= 0; i = racers[i].next)
+        write_racer(&w, &racers[i]);
+    json_array_end(&w);
+    event_queue(&w, &r->out);
+    r->state = RACE_LOBBY;
+}
+
+static int all_solved(const Race *r) {
+    for (int i = r->first; i >= 0; i = racers[i].next) {
+        if (racers[i].place == 0)
+            return 0;
+    }
+    return 1;
+}
+
+static int find_race(int64_t league_id) {
+    int free_slot = -1;
+    for (int i = 0; i < RACE_MAX_RACES; i++) {
+        if (races[i].racers == 0) {
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (races[i].league_id == league_id) {
+            return i;
+        }
+    }
+    if (free_slot < 0)
+        return -1;
+
+    Race *r = &races[free_slot];
+    memset(r, 0, sizeof(*r));
+    r->league_id = league_id;
+    r->first = -1;
+    stats.races++;
+    return free_slot;
+}
+
+int race_join(struct mg_connection *c, int64_t league_id, int64_t user_id,
+              const char *name) {
+    int slot = -1;
+    for (int i = 0; i < RACE_MAX_RACERS && slot < 0; i++) {
+        if (racers[i].c == NULL)
+            slot = i;
+    }
+    if (slot < 0)
+        return -1;
+
+    int race = find_race(league_id);
+    if (race < 0)
+        return -1;
+
+    Race *r = &races[race];
+    Racer *rc = &racers[slot];
+    memset(rc, 0, sizeof(*rc));
+    rc->c = c;
+    rc->race = race;
+    rc->user_id = user_id;
+    snprintf(rc->name, sizeof(rc->name), "%s", name);
+    rc->prev = -1;
+    rc->next = r->first;
+    if (r->first >= 0)
+        racers[r->first].prev = slot;
+    r->first = slot;
+    r->racers++;
+    memcpy(c->data, &slot, sizeof(slot));
+    stats.racers++;
+
+    JsonWriter w;
+    event_begin(&w, "join");
+    json_int(&w, "id", user_id);
+    json_string(&w, "name", rc->name);
+    event_queue(&w, &r->out);
+
+    /* The lobby as it stands goes to the newcomer alone, with the puzzle
+       if the race is already running */
+    static const char *STATE_NAMES[] = { "lobby", "countdown", "running" };
+    struct mg_iobuf lobby = {0};
+    event_begin(&w, "lobby");
+    json_string(&w, "state", STATE_NAMES[r->state]);
+    json_int(&w, "you", user_id);
+    json_array_begin(&w, "racers");
+    for (int i = r->first; i >= 0; i = racers[i].next)
+        write_racer(&w, &racers[i]);
+    json_array_end(&w);
+    event_queue(&w, &lobby);
+    if (r->state == RACE_RUNNING)
+        mg_iobuf_add(&lobby, lobby.len, r->start.buf, r->start.len);
+    send_frames(c, lobby.buf, lobby.len);
+    mg_iobuf_free(&lobby);
+    return 0;
+}
+
+void race_leave(struct mg_connection *c) {
+    if (!c->is_websocket)
+        return;
+    Racer *rc = find_racer(c);
+    if (rc == NULL)
+        return;
+
+    Race *r = &races[rc->race];
+    if (rc->prev >= 0)
+        racers[rc->prev].next = rc->next;
+    else
+        r->first = rc->next;
+    if (rc->next >= 0)
+        racers[rc->next].prev = rc->prev;
+    rc->c = NULL;
+    stats.racers--;
+
+    if (--r->racers == 0) {
+        mg_iobuf_free(&r->start);
+        mg_iobuf_free(&r->out);
+        stats.races--;
+        return;
+    }
+
+    JsonWriter w;
+    event_begin(&w, "leave");
+    json_int(&w, "id", rc->user_id);
+    event_queue(&w, &r->out);
+
+    /* Whoever is left may all have solved already */
+    if (r->state == RACE_RUNNING && all_solved(r))
+        finish(r);
+}
+
+int race_start(struct mg_connection *c, int64_t puzzle_id, const char *answer,
+               const char *puzzle_json, uint64_t now_ms) {
+    Racer *rc = find_racer(c);
+    if (rc == NULL || races[rc->race].state != RACE_LOBBY)
+        return -1;
+
+    Race *r = &races[rc->race];
+    JsonWriter w;
+    event_begin(&w, "start");
+    json_raw(&w, "puzzle", puzzle_json);
+    json_int(&w, "ms", RACE_TIME_LIMIT_MS);
+    r->start.len = 0;
+    event_queue(&w, &r->start);
+    if (r->start.len == 0)
+        return -1;
+
+    r->puzzle_id = puzzle_id;
+    snprintf(r->answer, sizeof(r->answer), "%s", answer);
+    r->solved = 0;
+    for (int i = r->first; i >= 0; i = racers[i].next) {
+        racers[i].guesses = 0;
+        racers[i].place = 0;
+    }
+    r->state = RACE_COUNTDOWN;
+    r->starts_at = now_ms + RACE_COUNTDOWN_MS;
+
+    event_begin(&w, "countdown");
+    json_int(&w, "by", rc->user_id);
+    json_int(&w, "ms", RACE_COUNTDOWN_MS);
+    event_queue(&w, &r->out);
+    return 0;
+}
+
+int race_guess(struct mg_connection *c, const char *guess, uint64_t now_ms) {
+    Racer *rc = find_racer(c);
+    if (rc == NULL || races[rc->race].state != RACE_RUNNING || rc->place != 0)
+        return -1;
+
+    Race *r = &races[rc->race];
+    JsonWriter w;
+    if (!puzzle_answer_matches(guess, r->answer)) {
+        rc->guesses++;
+        event_begin(&w, "guess");
+        json_int(&w, "id", rc->user_id);
+        json_string(&w, "guess", guess);
+        json_int(&w, "guesses", rc->guesses);
+        event_queue(&w, &r->out);
+        return 0;
+    }
+
+    rc->place = ++r->solved;
+    event_begin(&w, "solve");
+    json_int(&w, "id", rc->user_id);
+    json_int(&w, "place", rc->place);
+    json_int(&w, "guesses", rc->guesses);
+    json_int(&w, "ms", (long long)(now_ms + RACE_TIME_LIMIT_MS - r->ends_at));
+    event_queue(&w, &r->out);
+
+    if (all_solved(r))
+        finish(r);
+    return 1;
+}
+
+RaceState race_state(struct mg_connection *c) {
+    Racer *rc = find_racer(c);
+    return rc != NULL ? races[rc->race].state : RACE_LOBBY;
+}
+
+void race_flush(uint64_t now_ms) {
+    if (stats.racers == 0)
+        return;
+
+    /* Pings keep idle sockets open through proxies */
+    static const unsigned char PING[2] = { 0x89, 0x00 };
+    int ping = now_ms - ping_ms >= RACE_PING_MS;
+    if (ping)
+        ping_ms = now_ms;
+
+    for (int i = 0; i < RACE_MAX_RACES; i++) {
+        Race *r = &races[i];
+        if (r->racers == 0)
+            continue;
+
+        if (r->state == RACE_COUNTDOWN && now_ms >= r->starts_at) {
+            mg_iobuf_add(&r->out, r->out.len, r->start.buf, r->start.len);
+            r->state = RACE_RUNNING;
+            r->ends_at = r->starts_at + RACE_TIME_LIMIT_MS;
+            stats.started++;
+        } else if (r->state == RACE_RUNNING && now_ms >= r->ends_at) {
+            finish(r);
+        }
+        if (ping)
+            mg_iobuf_add(&r->out, r->out.len, PING, sizeof(PING));
+        if (r->out.len == 0)
+            continue;
+
+        for (int k = r->first; k >= 0; k = racers[k].next)
+            send_frames(racers[k].c, r->out.buf, r->out.len);
+        r->out.len = 0;
+    }
+}
+
+int race_poll_ms(int max_ms, uint64_t now_ms) {
+    int wait = max_ms;
+    for (int i = 0; i < RACE_MAX_RACES && stats.racers > 0; i++) {
+        const Race *r = &races[i];
+        uint64_t due;
+        if (r->racers == 0 || r->state == RACE_LOBBY)
+            continue;
+        due = r->state == RACE_COUNTDOWN ? r->starts_at : r->ends_at;
+        if (due <= now_ms)
+            return 0;
+        if (due - now_ms < (uint64_t)wait)
+            wait = (int)(due - now_ms);
+    }
+    return wait;
+}
+
+void race_get_stats(RaceStats *out) {
+    *out = stats;
+}
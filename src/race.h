@@ -0,0 +1,62 @@
+#ifndef RACE_H
+#define RACE_H
+
+#include <stdint.h>
+#include "mongoose.h"
+
+/* Head-to-head races for league members over WebSockets. Everyone in a
+   league's race gets the puzzle in the same loop iteration, then each
+   wrong guess and each solve as it happens. Events are written once per
+   race as finished WebSocket frames, queued during the iteration and
+   copied to every racer's socket in race_flush(). */
+
+#define RACE_MAX_RACES 256
+#define RACE_MAX_RACERS 4096
+#define RACE_MAX_BACKLOG (64 * 1024)    /* unsent bytes before we disconnect */
+#define RACE_MAX_FRAME 8192             /* one event, puzzle included */
+#define RACE_COUNTDOWN_MS 3000
+#define RACE_TIME_LIMIT_MS (10 * 60 * 1000)
+#define RACE_PING_MS 25000
+
+typedef enum { RACE_LOBBY, RACE_COUNTDOWN, RACE_RUNNING } RaceState;
+
+typedef struct {
+    unsigned racers;
+    unsigned races;
+    unsigned long started;
+    unsigned long frames;           /* frames written, summed over racers */
+    unsigned long overflows;        /* racers dropped for backpressure */
+} RaceStats;
+
+/* Adds an upgraded WebSocket to its league's race and sends it the lobby.
+   Returns 0 on success, -1 if no slot is free. */
+int race_join(struct mg_connection *c, int64_t league_id, int64_t user_id,
+              const char *name);
+
+/* Call on MG_EV_CLOSE for every connection */
+void race_leave(struct mg_connection *c);
+
+/* Starts the countdown for c's race. puzzle_json is the puzzle as racers
+   see it, a JSON object; the answer stays here. Returns 0, or -1 if c is
+   not racing or its race is already under way. Times are mg_millis(). */
+int race_start(struct mg_connection *c, int64_t puzzle_id, const char *answer,
+               const char *puzzle_json, uint64_t now_ms);
+
+/* Checks a guess from c against the running race's answer. Returns 1 if
+   correct, 0 if not, -1 if c has no race to guess in. */
+int race_guess(struct mg_connection *c, const char *guess, uint64_t now_ms);
+
+/* The state of c's race; RACE_LOBBY when c is not racing */
+RaceState race_state(struct mg_connection *c);
+
+/* Call once per event loop iteration: starts races whose countdown is
+   over, ends those out of time and sends what was queued */
+void race_flush(uint64_t now_ms);
+
+/* How long the event loop may block, at most max_ms, without starting
+   or ending a race late */
+int race_poll_ms(int max_ms, uint64_t now_ms);
+
+void race_get_stats(RaceStats *out);
+
+#endif /* RACE_H */
@@ -0,0 +1,217 @@
+#include <string.h>
+#include "ratelimit.h"
+#include "util.h"
+
+#define SLOT_MASK (RATELIMIT_SLOTS - 1)
+#define STATE_MAGIC 0x524c5432u     /* "RLT2", bump when the layout changes */
+
+/* A bucket is kept as the time it will be full again: taking a token
+   pushes that refill_ms later, and a bucket may run at most burst tokens
+   ahead of now. Once full_at has passed the bucket is as good as new. */
+typedef struct {
+    uint64_t hash;
+    uint64_t full_at;
+    char key[RATELIMIT_KEY_MAX];
+    uint8_t policy;
+    uint8_t referenced;         /* used again since the hand passed */
+} Bucket;
+
+/* Everything a restart hands over, including the hash seed the index
+   was built with. Buckets are dense and form the CLOCK ring; the index
+   maps hashes to them by linear probing. Keeping the two apart matters:
+   a hand sweeping the index itself would empty the slots behind it and
+   pack every probe chain into the slots ahead. */
+typedef struct {
+    uint32_t magic;
+    unsigned count;
+    unsigned hand;
+    uint64_t seed;
+    uint32_t index[RATELIMIT_SLOTS];        /* bucket + 1, 0: free */
+    Bucket buckets[RATELIMIT_MAX_BUCKETS];
+} State;
+
+static State st;
+static RateLimitStats stats;
+
+static RateLimitRule rules[RATELIMIT_POLICY_COUNT] = {
+    [RATELIMIT_LOGIN] = { 5, 12000 },       /* 5 a minute */
+    [RATELIMIT_GUESS] = { 10, 3000 },       /* 20 a minute after a burst of 10 */
+    [RATELIMIT_JOIN]  = { 5, 60000 },       /* 1 a minute after a burst of 5 */
+};
+
+static const char *POLICY_NAMES[RATELIMIT_POLICY_COUNT] = {
+    "none", "login", "guess", "join"
+};
+
+void ratelimit_configure(RateLimitPolicy policy, const RateLimitRule *rule) {
+    if (policy > RATELIMIT_NONE && policy < RATELIMIT_POLICY_COUNT)
+        rules[policy] = *rule;
+}
+
+void ratelimit_get_rule(RateLimitPolicy policy, RateLimitRule *out) {
+    *out = rules[policy < RATELIMIT_POLICY_COUNT ? policy : RATELIMIT_NONE];
+}
+
+void ratelimit_reset(void) {
+    memset(&st, 0, sizeof(st));
+    st.magic = STATE_MAGIC;
+    /* Seeded so that nobody can pick client keys that share a probe chain */
+    if (generate_random_bytes((unsigned char *)&st.seed, sizeof(st.seed)) != 0)
+        st.seed = 0x9e3779b97f4a7c15ULL;
+}
+
+/* FNV-1a from the seed */
+static uint64_t key_hash(RateLimitPolicy policy, const char *key) {
+    uint64_t h = 14695981039346656037ULL ^ st.seed;
+    h = (h ^ (uint64_t)policy) * 1099511628211ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h ^ (h >> 32);
+}
+
+static uint64_t slot_hash(unsigned slot) {
+    return st.buckets[st.index[slot] - 1].hash;
+}
+
+/* Linear probing: the index slot for the bucket, or the free slot that
+   ends its chain. The load cap keeps a free slot within a few probes. */
+static unsigned probe(uint64_t hash, RateLimitPolicy policy, const char *key) {
+    unsigned i = (unsigned)hash & SLOT_MASK;
+    while (st.index[i] != 0) {
+        Bucket *b = &st.buckets[st.index[i] - 1];
+        if (b->hash == hash && b->policy == policy && strcmp(b->key, key) == 0)
+            break;
+        i = (i + 1) & SLOT_MASK;
+    }
+    return i;
+}
+
+/* Backward-shift deletion: pulls later members of the chain into the gap
+   so that lookups never need tombstones */
+static void unindex(unsigned bucket) {
+    unsigned i = (unsigned)st.buckets[bucket].hash & SLOT_MASK;
+    while (st.index[i] != bucket + 1)
+        i = (i + 1) & SLOT_MASK;
+
+    unsigned j = i;
+    for (;;) {
+        st.index[i] = 0;
+        for (;;) {
+            j = (j + 1) & SLOT_MASK;
+            if (st.index[j] == 0)
+                return;
+            unsigned home = (unsigned)slot_hash(j) & SLOT_MASK;
+            /* Movable unless its home lies cyclically within (i, j] */
+            if (i <= j ? (home <= i || home > j) : (home <= i && home > j))
+                break;
+        }
+        st.index[i] = st.index[j];
+        i = j;
+    }
+}
+
+/* CLOCK over the bucket ring: a refilled bucket goes at once, a
+   referenced one loses its mark. The newcomer takes the victim's place
+   just behind the hand, so it is the last to be looked at again. */
+static unsigned evict_one(uint64_t now_ms) {
+    for (;;) {
+        unsigned victim = st.hand;
+        Bucket *b = &st.buckets[victim];
+        st.hand = (st.hand + 1) % RATELIMIT_MAX_BUCKETS;
+        if (b->full_at <= now_ms || !b->referenced) {
+            unindex(victim);
+            stats.evictions++;
+            return victim;
+        }
+        b->referenced = 0;
+    }
+}
+
+int ratelimit_take(RateLimitPolicy policy, const char *key, uint64_t now_ms,
+                   unsigned *retry_after_secs) {
+    if (policy <= RATELIMIT_NONE || policy >= RATELIMIT_POLICY_COUNT)
+        return 1;
+    if (st.magic != STATE_MAGIC)
+        ratelimit_reset();
+
+    char k[RATELIMIT_KEY_MAX];
+    size_t len = strlen(key);
+    if (len >= sizeof(k))
+        len = sizeof(k) - 1;
+    memcpy(k, key, len);
+    k[len] = '\0';
+
+    uint64_t hash = key_hash(policy, k);
+    unsigned slot = probe(hash, policy, k);
+    Bucket *s;
+    if (st.index[slot] != 0) {
+        s = &st.buckets[st.index[slot] - 1];
+        s->referenced = 1;
+    } else {
+        unsigned bucket;
+        if (st.count < RATELIMIT_MAX_BUCKETS) {
+            bucket = st.count++;
+        } else {
+            /* The removal may shift the chain this key belongs to */
+            bucket = evict_one(now_ms);
+            slot = probe(hash, policy, k);
+        }
+        s = &st.buckets[bucket];
+        s->hash = hash;
+        s->full_at = now_ms;
+        memcpy(s->key, k, len + 1);
+        s->policy = (uint8_t)policy;
+        s->referenced = 0;
+        st.index[slot] = bucket + 1;
+    }
+
+    const RateLimitRule *rule = &rules[policy];
+    uint64_t full_at = s->full_at > now_ms ? s->full_at : now_ms;
+    uint64_t next = full_at + rule->refill_ms;
+    uint64_t capacity = (uint64_t)rule->burst * rule->refill_ms;
+    if (next - now_ms > capacity) {
+        uint64_t wait_ms = next - now_ms - capacity;
+        if (retry_after_secs)
+            *retry_after_secs = (unsigned)((wait_ms + 999) / 1000);
+        stats.limited[policy]++;
+        return 0;
+    }
+    s->full_at = next;
+    stats.allowed[policy]++;
+    return 1;
+}
+
+void ratelimit_get_stats(RateLimitStats *out) {
+    *out = stats;
+    out->buckets = st.count;
+}
+
+const char *ratelimit_policy_name(RateLimitPolicy policy) {
+    return policy < RATELIMIT_POLICY_COUNT ? POLICY_NAMES[policy] : "unknown";
+}
+
+void *ratelimit_state(size_t *size) {
+    *size = sizeof(st);
+    return &st;
+}
+
+/* A region from an older layout, or one cut short, starts over */
+void ratelimit_restored(void) {
+    if (st.magic != STATE_MAGIC || st.count > RATELIMIT_MAX_BUCKETS ||
+        st.hand >= RATELIMIT_MAX_BUCKETS) {
+        ratelimit_reset();
+        return;
+    }
+    unsigned indexed = 0;
+    for (unsigned i = 0; i < RATELIMIT_SLOTS; i++) {
+        if (st.index[i] > st.count) {
+            ratelimit_reset();
+            return;
+        }
+        indexed += st.index[i] != 0;
+    }
+    if (indexed != st.count)
+        ratelimit_reset();
+}
@@ -0,0 +1,56 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Token buckets keyed by policy and client (an IP or a user id), held in
+   one fixed open-addressing table so a lookup costs the same with ten
+   clients or a flood of a hundred thousand. Buckets refill lazily when
+   they are next touched. When the table is full a CLOCK hand evicts a
+   bucket that has refilled, or failing that one not used since the hand
+   last passed; new clients get no second chance until they come back. */
+
+typedef enum {
+    RATELIMIT_NONE,
+    RATELIMIT_LOGIN,        /* login link requests, per IP */
+    RATELIMIT_GUESS,        /* answer submissions */
+    RATELIMIT_JOIN,         /* invite code lookups */
+    RATELIMIT_POLICY_COUNT
+} RateLimitPolicy;
+
+typedef struct {
+    unsigned burst;         /* bucket size */
+    unsigned refill_ms;     /* one token comes back every refill_ms */
+} RateLimitRule;
+
+#define RATELIMIT_SLOTS 16384                       /* power of two */
+#define RATELIMIT_MAX_BUCKETS (RATELIMIT_SLOTS / 4 * 3)
+#define RATELIMIT_KEY_MAX 48
+
+typedef struct {
+    unsigned buckets;
+    unsigned long allowed[RATELIMIT_POLICY_COUNT];
+    unsigned long limited[RATELIMIT_POLICY_COUNT];
+    unsigned long evictions;
+} RateLimitStats;
+
+void ratelimit_configure(RateLimitPolicy policy, const RateLimitRule *rule);
+void ratelimit_get_rule(RateLimitPolicy policy, RateLimitRule *out);
+
+/* Takes a token from key's bucket under policy. Returns 1 if allowed, 0
+   if the bucket is empty, setting *retry_after_secs to when the next
+   token is due. now_ms is any clock that does not go backwards. */
+int ratelimit_take(RateLimitPolicy policy, const char *key, uint64_t now_ms,
+                   unsigned *retry_after_secs);
+
+void ratelimit_reset(void);
+void ratelimit_get_stats(RateLimitStats *out);
+const char *ratelimit_policy_name(RateLimitPolicy policy);
+
+/* The table as one region for handoff_register. Call ratelimit_restored
+   after a handoff has written into it. */
+void *ratelimit_state(size_t *size);
+void ratelimit_restored(void);
+
+#endif /* RATELIMIT_H */
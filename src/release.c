@@ -0,0 +1,227 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "release.h"
+#include "db.h"
+#include "util.h"
+#include "sqlite3.h"
+
+/* A day with no puzzle is looked up again after this long, in case one
+   was added without going through the admin pages */
+#define RELEASE_MISS_RETRY_SECS 30
+
+static ReleaseDay days[2];
+static ReleaseDay *current = NULL;
+static ReleaseDay *next = NULL;
+static time_t current_loaded = 0;
+static ReleaseStats stats;
+
+/* Output past the end of the buffer is dropped */
+static void append(char *buf, size_t *len, const char *fmt, ...) {
+    if (*len >= RELEASE_HTML_MAX - 1)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, RELEASE_HTML_MAX - *len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        *len = *len + n < RELEASE_HTML_MAX ? *len + n : RELEASE_HTML_MAX - 1;
+}
+
+static void render_question(ReleaseDay *d) {
+    const Puzzle *p = &d->puzzle;
+    char *out = d->question_html;
+    size_t len = 0;
+    out[0] = '\0';
+
+    if (strcmp(p->puzzle_type, "ladder") == 0) {
+        LadderStep steps[MAX_LADDER_STEPS];
+        int step_count = puzzle_parse_ladder(p->question, steps, MAX_LADDER_STEPS);
+
+        append(out, &len,
+            "<div data-testid=\"puzzle-container\" class=\"puzzle-box\" style=\"text-align:left;display:block;\">\n"
+            "  <div>\n");
+        for (int i = 0; i < step_count; i++) {
+            if (steps[i].is_blank) {
+                append(out, &len, "    <div>%d. ____</div>\n", i + 1);
+            } else {
+                char safe_word[256] = {0};
+                html_escape(steps[i].word, safe_word, sizeof(safe_word));
+                append(out, &len, "    <div>%d. %s</div>\n", i + 1, safe_word);
+            }
+        }
+        append(out, &len, "  </div>\n</div>\n");
+    } else if (strcmp(p->puzzle_type, "choice") == 0) {
+        ChoicePuzzle cp;
+        if (puzzle_parse_choice(p->question, &cp) == 0) {
+            char safe_prompt[2048] = {0};
+            html_escape(cp.prompt, safe_prompt, sizeof(safe_prompt));
+            append(out, &len,
+                "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">\n"
+                "  <div>%s</div>\n"
+                "</div>\n",
+                safe_prompt);
+        }
+    } else {
+        append(out, &len,
+            "<div data-testid=\"puzzle-container\" class=\"puzzle-box\">\n"
+            "  <div>%s</div>\n"
+            "</div>\n",
+            p->question);
+    }
+}
+
+static void render_inputs(ReleaseDay *d) {
+    const Puzzle *p = &d->puzzle;
+    char *out = d->inputs_html;
+    size_t len = 0;
+    out[0] = '\0';
+
+    if (strcmp(p->puzzle_type, "ladder") == 0) {
+        LadderStep steps[MAX_LADDER_STEPS];
+        int step_count = puzzle_parse_ladder(p->question, steps, MAX_LADDER_STEPS);
+        int blank_idx = 0;
+
+        for (int i = 0; i < step_count; i++) {
+            if (steps[i].is_blank) {
+                append(out, &len,
+                    "  <label class=\"action-btn\">\n"
+                    "    <span class=\"gt\">&gt;</span>\n"
+                    "    <input type=\"text\" name=\"step_%d\" placeholder=\"Step %d\" autocomplete=\"off\" required>\n"
+                    "  </label>\n",
+                    blank_idx, i + 1);
+                blank_idx++;
+            }
+        }
+    } else if (strcmp(p->puzzle_type, "choice") == 0) {
+        ChoicePuzzle cp;
+        if (puzzle_parse_choice(p->question, &cp) == 0) {
+            for (int i = 0; i < cp.num_options; i++) {
+                char safe_opt[512] = {0};
+                html_escape(cp.options[i], safe_opt, sizeof(safe_opt));
+                append(out, &len,
+                    "  <label class=\"action-btn\">\n"
+                    "    <span class=\"gt\">&gt;</span>\n"
+                    "    <input type=\"radio\" name=\"guess\" value=\"%c\" required "
+                    "style=\"margin-right:10px;\"> %c. %s\n"
+                    "  </label>\n",
+                    'a' + i, 'A' + i, safe_opt);
+            }
+        }
+    } else if (strcmp(p->puzzle_type, "math") == 0) {
+        append(out, &len,
+            "  <label class=\"action-btn\">\n"
+            "    <span class=\"gt\">&gt;</span>\n"
+            "    <input data-testid=\"answer-input\" type=\"number\" step=\"any\" name=\"guess\" placeholder=\"Enter your answer\" autocomplete=\"off\" required>\n"
+            "  </label>\n");
+    } else {
+        append(out, &len,
+            "  <label class=\"action-btn\">\n"
+            "    <span class=\"gt\">&gt;</span>\n"
+            "    <input data-testid=\"answer-input\" type=\"text\" name=\"guess\" placeholder=\"Enter your answer\" autocomplete=\"off\" required>\n"
+            "  </label>\n");
+    }
+}
+
+static void load(ReleaseDay *d, const char *date) {
+    snprintf(d->date, sizeof(d->date), "%s", date);
+    d->found = puzzle_get_by_date(date, &d->puzzle) == 0;
+    d->number = 0;
+    d->question_html[0] = '\0';
+    d->inputs_html[0] = '\0';
+    if (!d->found)
+        return;
+
+    d->number = puzzle_get_number(d->puzzle.id);
+    render_question(d);
+    render_inputs(d);
+}
+
+/* Touches the pages the first requests of a day are sure to write: the
+   right-hand edge of attempts, where the guesses land, and of sessions,
+   where the logins land. Each is one seek down the B-tree, so the cost
+   stays flat as history grows; the new puzzle's own rows were just read
+   by load(). Anything that scans would block the loop seconds before the
+   busiest moment of the day. */
+static const char *WARM_SQL[] = {
+    "SELECT MAX(id) FROM attempts",
+    "SELECT MAX(id) FROM sessions",
+};
+
+static void warm(void) {
+    sqlite3 *db = db_get();
+    if (db == NULL)
+        return;
+
+    for (size_t i = 0; i < sizeof(WARM_SQL) / sizeof(WARM_SQL[0]); i++) {
+        sqlite3_stmt *stmt = NULL;
+        if (sqlite3_prepare_v2(db, WARM_SQL[i], -1, &stmt, NULL) != SQLITE_OK)
+            continue;
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+    }
+}
+
+static ReleaseDay *spare_slot(void) {
+    return current == &days[0] ? &days[1] : &days[0];
+}
+
+const ReleaseDay *release_today(time_t now) {
+    char date[16];
+    puzzle_date_at(now, date, sizeof(date));
+
+    if (current != NULL && strcmp(current->date, date) == 0 &&
+        (current->found || now - current_loaded < RELEASE_MISS_RETRY_SECS))
+        return current;
+
+    if (next != NULL && strcmp(next->date, date) == 0) {
+        current = next;
+        current_loaded = now;
+        next = NULL;
+        stats.switches++;
+        return current;
+    }
+
+    /* Startup, an admin edit, or the rollover came before release_tick() */
+    ReleaseDay *slot = spare_slot();
+    next = NULL;
+    load(slot, date);
+    current = slot;
+    current_loaded = now;
+    stats.cold_loads++;
+    return current;
+}
+
+void release_tick(time_t now) {
+    time_t release = puzzle_next_release(now);
+    if (release - now > RELEASE_PREPARE_SECS)
+        return;
+
+    char date[16];
+    puzzle_date_at(release, date, sizeof(date));
+    if (next != NULL && strcmp(next->date, date) == 0)
+        return;
+
+    /* Settle today first so the spare slot is not the one being served */
+    release_today(now);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ReleaseDay *slot = spare_slot();
+    load(slot, date);
+    warm();
+    next = slot;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    stats.prepared++;
+    stats.prepare_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+void release_invalidate(void) {
+    current = NULL;
+    next = NULL;
+}
+
+void release_get_stats(ReleaseStats *out) {
+    *out = stats;
+}
@@ -0,0 +1,43 @@
+#ifndef RELEASE_H
+#define RELEASE_H
+
+#include <time.h>
+#include "puzzle.h"
+
+/* Today's puzzle, loaded, parsed and rendered once per day instead of once
+   per request. Shortly before the 09:00 UTC rollover release_tick() does
+   the same for the next day and warms the SQLite pages its first requests
+   will read; the first lookup at or after the boundary switches to it. */
+
+#define RELEASE_PREPARE_SECS 15     /* how long before 09:00 to prepare */
+#define RELEASE_HTML_MAX 8192
+
+typedef struct {
+    char date[16];
+    int found;                          /* 0: no puzzle scheduled */
+    Puzzle puzzle;
+    int number;                         /* #N shown in the title */
+    char question_html[RELEASE_HTML_MAX];   /* the puzzle-container block */
+    char inputs_html[RELEASE_HTML_MAX];     /* answer inputs for the form */
+} ReleaseDay;
+
+typedef struct {
+    unsigned long prepared;     /* days loaded ahead of their rollover */
+    unsigned long switches;     /* rollovers served from a prepared day */
+    unsigned long cold_loads;   /* lookups that had to load on the spot */
+    double prepare_ms;          /* time the last preparation took */
+} ReleaseStats;
+
+/* The puzzle day in effect at now; loads it if it is not ready.
+   Never returns NULL. Event loop only. */
+const ReleaseDay *release_today(time_t now);
+
+/* Call once per event loop iteration */
+void release_tick(time_t now);
+
+/* Drops the loaded days, e.g. after an admin edits a puzzle */
+void release_invalidate(void);
+
+void release_get_stats(ReleaseStats *out);
+
+#endif /* RELEASE_H */
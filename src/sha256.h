@@ -0,0 +1,33 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* SHA-256 (FIPS 180-4) and HMAC-SHA256 (RFC 2104) for signing session
+   cookies. An HmacKey holds the hash states after the padded key, so a
+   MAC over a short message costs two compressions. */
+
+#define SHA256_BYTES 32
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t total;             /* bytes hashed so far */
+    unsigned char block[64];
+    size_t used;                /* bytes waiting in block */
+} Sha256;
+
+typedef struct {
+    Sha256 inner;
+    Sha256 outer;
+} HmacKey;
+
+void sha256_init(Sha256 *ctx);
+void sha256_update(Sha256 *ctx, const void *data, size_t len);
+void sha256_final(Sha256 *ctx, unsigned char out[SHA256_BYTES]);
+
+void hmac_sha256_key(HmacKey *key, const void *secret, size_t len);
+void hmac_sha256(const HmacKey *key, const void *data, size_t len,
+                 unsigned char out[SHA256_BYTES]);
+
+#endif /* SHA256_H */
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <string.h>
+#include "template.h"
+#include "util.h"
+
+void tpl_begin(TemplateRender *r, const Template *tpl) {
+    r->tpl = tpl;
+    memset(r->values, 0, sizeof(TemplateValue) * (size_t)tpl->slot_count);
+    r->iovcnt = 0;
+    r->total = 0;
+    r->scratch_len = 0;
+}
+
+void tpl_set_str(TemplateRender *r, int slot, const char *value) {
+    if (slot < 0 || slot >= r->tpl->slot_count)
+        return;
+    r->values[slot].str = value ? value : "";
+    r->values[slot].is_int = 0;
+}
+
+void tpl_set_int(TemplateRender *r, int slot, long long value) {
+    if (slot < 0 || slot >= r->tpl->slot_count)
+        return;
+    r->values[slot].str = NULL;
+    r->values[slot].num = value;
+    r->values[slot].is_int = 1;
+}
+
+static int push(TemplateRender *r, const void *data, size_t len) {
+    if (len == 0)
+        return 0;
+    if (r->iovcnt >= TPL_MAX_IOV)
+        return -1;
+    r->iov[r->iovcnt].iov_base = (void *)data;
+    r->iov[r->iovcnt].iov_len = len;
+    r->iovcnt++;
+    r->total += len;
+    return 0;
+}
+
+int tpl_render(TemplateRender *r) {
+    const Template *t = r->tpl;
+    char *scratch = r->scratch + r->scratch_len;
+    size_t room = TPL_SCRATCH - r->scratch_len;
+
+    for (int i = 0; i < t->part_count; i++) {
+        const TemplatePart *p = &t->parts[i];
+        const TemplateValue *v = p->type == TPL_PART_TEXT ? NULL : &r->values[p->slot];
+        size_t len;
+
+        switch (p->type) {
+            case TPL_PART_TEXT:
+                if (push(r, p->text, p->len) != 0)
+                    return -1;
+                break;
+
+            case TPL_PART_RAW:
+                if (v->str == NULL)
+                    return -1;
+                if (push(r, v->str, strlen(v->str)) != 0)
+                    return -1;
+                break;
+
+            case TPL_PART_HTML:
+                if (v->str == NULL)
+                    return -1;
+                len = html_escape(v->str, scratch, room);
+                if (len >= room)
+                    return -1;
+                if (push(r, scratch, len) != 0)
+                    return -1;
+                scratch += len;
+                room -= len;
+                break;
+
+            case TPL_PART_INT: {
+                if (!v->is_int)
+                    return -1;
+                int n = snprintf(scratch, room, "%lld", v->num);
+                if (n < 0 || (size_t)n >= room)
+                    return -1;
+                if (push(r, scratch, (size_t)n) != 0)
+                    return -1;
+                scratch += n;
+                room -= (size_t)n;
+                break;
+            }
+        }
+    }
+
+    r->scratch_len = TPL_SCRATCH - room;
+    return 0;
+}
@@ -0,0 +1,63 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/* Pages compiled from templates/ by scripts/compile_templates.sh. A
+   template is a list of constant segments and typed holes; rendering
+   fills the holes and produces an iovec list whose constant entries point
+   straight at the compiled segments, so no format string is parsed and no
+   constant markup is copied until the response is queued. */
+
+typedef enum {
+    TPL_PART_TEXT,      /* constant segment */
+    TPL_PART_HTML,      /* string, HTML-escaped */
+    TPL_PART_RAW,       /* string, as-is */
+    TPL_PART_INT
+} TemplatePartType;
+
+typedef struct {
+    TemplatePartType type;
+    const char *text;       /* TPL_PART_TEXT only */
+    size_t len;
+    int slot;               /* holes only */
+} TemplatePart;
+
+typedef struct {
+    const char *name;
+    const TemplatePart *parts;
+    int part_count;
+    int slot_count;
+} Template;
+
+#define TPL_MAX_SLOTS 32
+#define TPL_MAX_IOV 128
+#define TPL_SCRATCH 16384       /* escaped strings and formatted integers */
+
+typedef struct {
+    const char *str;        /* NULL: unset, or an integer */
+    long long num;
+    int is_int;
+} TemplateValue;
+
+/* One render in progress. Strings set with tpl_set_str must outlive it. */
+typedef struct {
+    const Template *tpl;
+    TemplateValue values[TPL_MAX_SLOTS];
+    struct iovec iov[TPL_MAX_IOV];
+    int iovcnt;
+    size_t total;           /* bytes across iov */
+    char scratch[TPL_SCRATCH];
+    size_t scratch_len;
+} TemplateRender;
+
+void tpl_begin(TemplateRender *r, const Template *tpl);
+void tpl_set_str(TemplateRender *r, int slot, const char *value);
+void tpl_set_int(TemplateRender *r, int slot, long long value);
+
+/* Fills r->iov. Returns 0 on success, -1 if a hole is unset or of the
+   wrong type, or the iovec or scratch space runs out. */
+int tpl_render(TemplateRender *r);
+
+#endif /* TEMPLATE_H */
@@ -16,13 +16,29 @@
  *       RUN_TEST(test_name);
  *       return test_summary();
  *   }
+ *
+ * Microbenchmarks use the same style:
+ *
+ *   BENCH(bench_name) {
+ *       BENCH_KEEP(html_escape(src, dst, sizeof(dst)));
+ *   }
+ *
+ *   int main() {
+ *       BENCH_RUN(bench_name, 100000);
+ *       return bench_summary();
+ *   }
  */
 
 #ifndef TEST_H
 #define TEST_H
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 /* Global counters for test results */
 static int tests_run = 0;
@@ -31,14 +47,14 @@ static int tests_failed = 0;
 static const char *current_test = NULL;
 
 /* Initialize test counters */
-static void test_init(void) {
+static inline void test_init(void) {
     tests_run = 0;
     tests_passed = 0;
     tests_failed = 0;
 }
 
 /* Print test summary and return exit code (0 = all passed) */
-static int test_summary(void) {
+static inline int test_summary(void) {
     printf("\n========================================\n");
     printf("Tests run: %d, Passed: %d, Failed: %d\n",
            tests_run, tests_passed, tests_failed);
@@ -114,4 +130,162 @@ static int test_summary(void) {
     } \
 } while(0)
 
+/*
+ * Benchmarks
+ *
+ * BENCH_RUN calls the body `iterations` times to warm caches and branch
+ * predictors, then times BENCH_ROUNDS rounds of `iterations` calls. The
+ * fastest round is the best estimate of the cost; the median shows the
+ * noise. The cost of an empty body is measured once and subtracted.
+ *
+ * Cycles are estimated from the time-stamp counter on x86, or from
+ * BENCH_GHZ if it is set. With BENCH_JSON set to a path, bench_summary()
+ * also writes the results there as JSON.
+ *
+ * The helpers are static inline so that test files including this header
+ * do not get unused-function warnings.
+ */
+
+#define BENCH_ROUNDS 9
+#define BENCH_MAX 64
+
+typedef struct {
+    const char *name;
+    long iterations;
+    double ns_min;          /* per call, overhead subtracted */
+    double ns_median;
+} BenchResult;
+
+/* Results are kept in function statics for the same reason */
+static inline BenchResult *bench_results(int **count) {
+    static BenchResult results[BENCH_MAX];
+    static int n = 0;
+    *count = &n;
+    return results;
+}
+
+/* Stores a result where the compiler cannot prove it unused */
+static inline void bench_keep(unsigned long value) {
+    static volatile unsigned long sink;
+    sink += value;
+}
+
+#define BENCH_KEEP(expr) bench_keep((unsigned long)(expr))
+
+static inline double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static inline int bench_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Clock rate in GHz, 0 if unknown */
+static inline double bench_ghz(void) {
+    static double ghz = -1;
+    if (ghz >= 0)
+        return ghz;
+
+    const char *env = getenv("BENCH_GHZ");
+    ghz = env ? atof(env) : 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (env == NULL) {
+        double start = bench_now_ns(), now;
+        unsigned long long tsc = __rdtsc();
+        do {
+            now = bench_now_ns();
+        } while (now - start < 20e6);
+        ghz = (double)(__rdtsc() - tsc) / (now - start);
+    }
+#endif
+    return ghz;
+}
+
+/* Per-call time of each round, sorted */
+static inline void bench_time(void (*fn)(void), long iterations, double *rounds) {
+    for (long i = 0; i < iterations; i++)
+        fn();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        double start = bench_now_ns();
+        for (long i = 0; i < iterations; i++)
+            fn();
+        rounds[r] = (bench_now_ns() - start) / iterations;
+    }
+    qsort(rounds, BENCH_ROUNDS, sizeof(double), bench_cmp_double);
+}
+
+static inline void bench_empty(void) {
+}
+
+static inline void bench_run(const char *name, void (*fn)(void), long iterations) {
+    static double overhead = -1;
+    double rounds[BENCH_ROUNDS];
+    current_test = name;
+    if (overhead < 0) {
+        bench_time(bench_empty, 1000000, rounds);
+        overhead = rounds[0];
+    }
+
+    bench_time(fn, iterations, rounds);
+    double ns_min = rounds[0] > overhead ? rounds[0] - overhead : 0;
+    double ns_median = rounds[BENCH_ROUNDS / 2] > overhead ? rounds[BENCH_ROUNDS / 2] - overhead : 0;
+    double ghz = bench_ghz();
+
+    printf("%-32s %10.1f ns/op  (median %.1f)", name, ns_min, ns_median);
+    if (ghz > 0)
+        printf("  ~%.0f cycles/op", ns_min * ghz);
+    printf("\n");
+
+    int *count;
+    BenchResult *results = bench_results(&count);
+    if (*count < BENCH_MAX) {
+        results[*count].name = name;
+        results[*count].iterations = iterations;
+        results[*count].ns_min = ns_min;
+        results[*count].ns_median = ns_median;
+        (*count)++;
+    }
+}
+
+/* Writes BENCH_JSON if set; returns the exit code */
+static inline int bench_summary(void) {
+    const char *path = getenv("BENCH_JSON");
+    if (path == NULL || path[0] == '\0')
+        return 0;
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        printf("Cannot write %s\n", path);
+        return 1;
+    }
+
+    int *count;
+    BenchResult *results = bench_results(&count);
+    double ghz = bench_ghz();
+    fprintf(f, "{\"ghz\":%.3f,\"rounds\":%d,\"benchmarks\":[", ghz, BENCH_ROUNDS);
+    for (int i = 0; i < *count; i++) {
+        fprintf(f, "%s\n  {\"name\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.2f,"
+                   "\"ns_per_op_median\":%.2f,\"cycles_per_op\":%.1f}",
+                i ? "," : "", results[i].name, results[i].iterations,
+                results[i].ns_min, results[i].ns_median, results[i].ns_min * ghz);
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    printf("\nWrote %s\n", path);
+    return 0;
+}
+
+/*
+ * BENCH macro - defines a benchmark body, called once per iteration
+ */
+#define BENCH(name) static void name(void)
+
+/*
+ * BENCH_RUN macro - warms up, times and reports a benchmark
+ */
+#define BENCH_RUN(name, iterations) bench_run(#name, name, (iterations))
+
 #endif /* TEST_H */
@@ -0,0 +1,167 @@
+/*
+ * test_accesslog.c - Access Log Tests
+ *
+ * Tests for the lock-free record ring, the JSON-lines writer thread and
+ * size-based rotation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "accesslog.h"
+
+#define TEST_LOG "test_access.log"
+
+static void remove_logs(void) {
+    char path[64];
+    remove(TEST_LOG);
+    for (int i = 1; i <= 4; i++) {
+        snprintf(path, sizeof(path), "%s.%d", TEST_LOG, i);
+        remove(path);
+    }
+}
+
+static int count_lines(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return -1;
+    int lines = 0, ch;
+    while ((ch = fgetc(f)) != EOF)
+        lines += ch == '\n';
+    fclose(f);
+    return lines;
+}
+
+static AccessRecord sample(int64_t user_id) {
+    AccessRecord rec;
+    rec.time_ms = 1767258000123LL;     /* 2026-01-01T09:00:00.123Z */
+    rec.route = "/puzzle";
+    rec.user_id = user_id;
+    rec.status = 200;
+    rec.bytes = 5120;
+    rec.latency_us = 850;
+    return rec;
+}
+
+/*
+ * Test: Records are written as JSON lines, unmatched routes named
+ */
+TEST(test_writes_json_lines) {
+    remove_logs();
+    AccessLogConfig cfg = {0};
+    cfg.path = TEST_LOG;
+    ASSERT_INT_EQ(0, accesslog_start(&cfg));
+
+    AccessRecord rec = sample(42);
+    ASSERT_INT_EQ(0, accesslog_record(&rec));
+    rec.route = NULL;
+    rec.status = 404;
+    rec.user_id = 0;
+    ASSERT_INT_EQ(0, accesslog_record(&rec));
+    accesslog_stop();
+
+    char buf[512] = {0};
+    FILE *f = fopen(TEST_LOG, "r");
+    ASSERT_NOT_NULL(f);
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    ASSERT_STR_EQ(
+        "{\"ts\":\"2026-01-01T09:00:00.123Z\",\"route\":\"/puzzle\",\"status\":200,"
+        "\"bytes\":5120,\"us\":850,\"user\":42}\n"
+        "{\"ts\":\"2026-01-01T09:00:00.123Z\",\"route\":\"unmatched\",\"status\":404,"
+        "\"bytes\":5120,\"us\":850,\"user\":0}\n", buf);
+    return 1;
+}
+
+/*
+ * Test: A full ring drops records instead of blocking, and counts them
+ */
+TEST(test_full_ring_drops) {
+    remove_logs();
+    AccessLogStats before, after;
+    accesslog_get_stats(&before);
+
+    AccessLogConfig cfg = {0};
+    cfg.path = TEST_LOG;
+    cfg.capacity = 4;
+    ASSERT_INT_EQ(0, accesslog_start(&cfg));
+
+    AccessRecord rec = sample(1);
+    int accepted = 0;
+    for (int i = 0; i < 1000; i++)
+        accepted += accesslog_record(&rec) == 0;
+    accesslog_stop();
+    accesslog_get_stats(&after);
+
+    ASSERT(accepted < 1000);
+    ASSERT_INT_EQ(1000 - accepted, (int)(after.dropped - before.dropped));
+    ASSERT_INT_EQ(accepted, (int)(after.written - before.written));
+    ASSERT_INT_EQ(accepted, count_lines(TEST_LOG));
+    return 1;
+}
+
+/*
+ * Test: The file is rotated by size, keeping a fixed number of old files
+ */
+TEST(test_rotation) {
+    remove_logs();
+    AccessLogStats before, after;
+    accesslog_get_stats(&before);
+
+    AccessLogConfig cfg = {0};
+    cfg.path = TEST_LOG;
+    cfg.max_bytes = 150;        /* between one and two records */
+    cfg.keep = 2;
+    ASSERT_INT_EQ(0, accesslog_start(&cfg));
+
+    AccessRecord rec = sample(7);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_INT_EQ(0, accesslog_record(&rec));
+        ASSERT_INT_EQ(0, accesslog_record(&rec));
+        usleep(3 * ACCESSLOG_FLUSH_MS * 1000);
+    }
+    accesslog_stop();
+    accesslog_get_stats(&after);
+
+    ASSERT(after.rotations - before.rotations >= 4);
+    ASSERT(count_lines(TEST_LOG ".1") >= 2);
+    ASSERT(count_lines(TEST_LOG ".2") >= 2);
+    ASSERT_INT_EQ(-1, count_lines(TEST_LOG ".3"));
+    return 1;
+}
+
+/*
+ * Test: Recording without a running log is refused
+ */
+TEST(test_not_running) {
+    AccessRecord rec = sample(1);
+    ASSERT_INT_EQ(-1, accesslog_record(&rec));
+
+    AccessLogConfig cfg = {0};
+    ASSERT_INT_EQ(-1, accesslog_start(&cfg));
+    cfg.path = "/nonexistent/dir/access.log";
+    ASSERT_INT_EQ(-1, accesslog_start(&cfg));
+    return 1;
+}
+
+/*
+ * Main: Run all access log tests
+ */
+int main(void) {
+    printf("Access Log Tests\n");
+    printf("================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_writes_json_lines);
+    RUN_TEST(test_full_ring_drops);
+    RUN_TEST(test_rotation);
+    RUN_TEST(test_not_running);
+
+    remove_logs();
+    return test_summary();
+}
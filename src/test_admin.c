@@ -11,24 +11,28 @@
 
 TEST(test_admin_exact_match) {
     setenv("ADMIN_EMAILS", "admin@example.com", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("admin@example.com") == 1);
     return 1;
 }
 
 TEST(test_admin_no_match) {
     setenv("ADMIN_EMAILS", "admin@example.com", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("other@example.com") == 0);
     return 1;
 }
 
 TEST(test_admin_case_insensitive) {
     setenv("ADMIN_EMAILS", "Admin@Example.COM", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("admin@example.com") == 1);
     return 1;
 }
 
 TEST(test_admin_multiple_emails) {
     setenv("ADMIN_EMAILS", "one@example.com,two@example.com,three@example.com", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("two@example.com") == 1);
     ASSERT(auth_is_admin("three@example.com") == 1);
     ASSERT(auth_is_admin("four@example.com") == 0);
@@ -37,6 +41,7 @@ TEST(test_admin_multiple_emails) {
 
 TEST(test_admin_spaces_around_emails) {
     setenv("ADMIN_EMAILS", " one@example.com , two@example.com ", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("one@example.com") == 1);
     ASSERT(auth_is_admin("two@example.com") == 1);
     return 1;
@@ -44,17 +49,31 @@ TEST(test_admin_spaces_around_emails) {
 
 TEST(test_admin_null_env) {
     unsetenv("ADMIN_EMAILS");
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("admin@example.com") == 0);
     return 1;
 }
 
 TEST(test_admin_empty_email) {
     setenv("ADMIN_EMAILS", "admin@example.com", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT(auth_is_admin("") == 0);
     ASSERT(auth_is_admin(NULL) == 0);
     return 1;
 }
 
+TEST(test_admin_reload_drops_removed) {
+    setenv("ADMIN_EMAILS", "one@example.com,two@example.com", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
+    setenv("ADMIN_EMAILS", "two@example.com", 1);
+    ASSERT(auth_is_admin("one@example.com") == 1);   /* until reloaded */
+    ASSERT_INT_EQ(0, auth_load_roles());
+    ASSERT(auth_is_admin("one@example.com") == 0);
+    ASSERT(auth_is_admin("TWO@example.com") == 1);
+    ASSERT(auth_roles_for("two@example.com") == ROLE_ADMIN);
+    return 1;
+}
+
 /* --- puzzle CRUD tests --- */
 
 static void setup_db(void) {
@@ -67,6 +86,25 @@ static void teardown_db(void) {
     remove("test_admin.db");
 }
 
+TEST(test_admin_roles_table) {
+    setup_db();
+    unsetenv("ADMIN_EMAILS");
+    sqlite3_exec(db_get(),
+        "INSERT INTO user_roles (email, role) VALUES "
+        "('Stored@Example.com', 'admin'), ('editor@example.com', 'editor')",
+        NULL, NULL, NULL);
+    ASSERT_INT_EQ(0, auth_load_roles());
+    ASSERT(auth_is_admin("stored@example.com") == 1);
+    /* A role this build does not know grants nothing */
+    ASSERT(auth_roles_for("editor@example.com") == 0);
+
+    sqlite3_exec(db_get(), "DELETE FROM user_roles", NULL, NULL, NULL);
+    ASSERT_INT_EQ(0, auth_load_roles());
+    ASSERT(auth_is_admin("stored@example.com") == 0);
+    teardown_db();
+    return 1;
+}
+
 TEST(test_puzzle_create) {
     setup_db();
     Puzzle p = {0};
@@ -207,6 +245,8 @@ int main(void) {
     RUN_TEST(test_admin_spaces_around_emails);
     RUN_TEST(test_admin_null_env);
     RUN_TEST(test_admin_empty_email);
+    RUN_TEST(test_admin_reload_drops_removed);
+    RUN_TEST(test_admin_roles_table);
     RUN_TEST(test_puzzle_create);
     RUN_TEST(test_puzzle_create_duplicate_date);
     RUN_TEST(test_puzzle_update);
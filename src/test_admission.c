@@ -0,0 +1,149 @@
+/*
+ * test_admission.c - Admission Control Tests
+ *
+ * Tests for overload detection, priority shedding and hysteresis.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "test.h"
+#include "admission.h"
+
+static void configure(unsigned lag_low, unsigned lag_high,
+                      unsigned queue_low, unsigned queue_high) {
+    AdmissionConfig cfg = {lag_low, lag_high, queue_low, queue_high, 5};
+    admission_configure(&cfg);
+}
+
+static void spin_ms(long ms) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000 +
+             (now.tv_nsec - start.tv_nsec) / 1000000 < ms);
+}
+
+/*
+ * Test: Everything is admitted when idle
+ */
+TEST(test_admits_all_when_idle) {
+    configure(100, 500, 64, 256);
+    admission_tick(0);
+
+    ASSERT_INT_EQ(1, admission_admit(PRIORITY_CRITICAL));
+    ASSERT_INT_EQ(1, admission_admit(PRIORITY_NORMAL));
+    ASSERT_INT_EQ(1, admission_admit(PRIORITY_LOW));
+    return 1;
+}
+
+/*
+ * Test: Queued work sheds low priority first, then all but critical
+ */
+TEST(test_queue_sheds_by_priority) {
+    configure(100000, 100000, 10, 20);
+
+    ASSERT_INT_EQ(1, admission_tick(15));
+    ASSERT_INT_EQ(0, admission_admit(PRIORITY_LOW));
+    ASSERT_INT_EQ(1, admission_admit(PRIORITY_NORMAL));
+    ASSERT_INT_EQ(1, admission_admit(PRIORITY_CRITICAL));
+
+    ASSERT_INT_EQ(1, admission_tick(25));
+    ASSERT_INT_EQ(0, admission_admit(PRIORITY_LOW));
+    ASSERT_INT_EQ(0, admission_admit(PRIORITY_NORMAL));
+    ASSERT_INT_EQ(1, admission_admit(PRIORITY_CRITICAL));
+    return 1;
+}
+
+/*
+ * Test: Levels relax only once well below the threshold
+ */
+TEST(test_hysteresis) {
+    configure(100000, 100000, 10, 20);
+    admission_tick(25);
+
+    AdmissionStats st;
+
+    /* Below high (20) but above 3/4 of it: stays critical only */
+    admission_tick(16);
+    admission_get_stats(&st);
+    ASSERT_INT_EQ(ADMIT_CRITICAL_ONLY, st.level);
+
+    admission_tick(12);
+    admission_get_stats(&st);
+    ASSERT_INT_EQ(ADMIT_SHED_LOW, st.level);
+
+    /* Below low (10) but above 3/4 of it */
+    admission_tick(8);
+    admission_get_stats(&st);
+    ASSERT_INT_EQ(ADMIT_SHED_LOW, st.level);
+
+    admission_tick(2);
+    admission_get_stats(&st);
+    ASSERT_INT_EQ(ADMIT_ALL, st.level);
+    return 1;
+}
+
+/*
+ * Test: Slow handlers raise loop lag and trigger shedding
+ */
+TEST(test_lag_sheds) {
+    configure(10, 100000, 1000, 1000);
+    admission_tick(0);
+
+    admission_request_begin();
+    spin_ms(200);
+    admission_request_end();
+    admission_tick(0);
+
+    AdmissionStats st;
+    admission_get_stats(&st);
+    ASSERT(st.lag_ms >= 10);
+    ASSERT_INT_EQ(ADMIT_SHED_LOW, st.level);
+    ASSERT_INT_EQ(0, admission_admit(PRIORITY_LOW));
+    return 1;
+}
+
+/*
+ * Test: Admitted and shed requests are counted per priority
+ */
+TEST(test_counters) {
+    AdmissionStats before, after;
+    configure(100000, 100000, 10, 20);
+    admission_tick(0);
+    admission_tick(0);
+    admission_get_stats(&before);
+
+    admission_admit(PRIORITY_LOW);
+    admission_tick(30);
+    admission_admit(PRIORITY_LOW);
+    admission_admit(PRIORITY_NORMAL);
+    admission_admit(PRIORITY_CRITICAL);
+
+    admission_get_stats(&after);
+    ASSERT(after.admitted[PRIORITY_LOW] == before.admitted[PRIORITY_LOW] + 1);
+    ASSERT(after.shed[PRIORITY_LOW] == before.shed[PRIORITY_LOW] + 1);
+    ASSERT(after.shed[PRIORITY_NORMAL] == before.shed[PRIORITY_NORMAL] + 1);
+    ASSERT(after.admitted[PRIORITY_CRITICAL] == before.admitted[PRIORITY_CRITICAL] + 1);
+    ASSERT(after.level_changes > before.level_changes);
+    ASSERT(after.queued == 30);
+    return 1;
+}
+
+/*
+ * Main: Run all admission control tests
+ */
+int main(void) {
+    printf("Admission Control Tests\n");
+    printf("=======================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_admits_all_when_idle);
+    RUN_TEST(test_queue_sheds_by_priority);
+    RUN_TEST(test_hysteresis);
+    RUN_TEST(test_lag_sheds);
+    RUN_TEST(test_counters);
+
+    return test_summary();
+}
@@ -0,0 +1,151 @@
+/*
+ * test_assets.c - Embedded Asset Tests
+ *
+ * Tests for the build-time asset table and content negotiation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "assets.h"
+#include "assets_data.h"
+#include "util.h"
+
+/*
+ * Test: Plain path resolves but is not immutable
+ */
+TEST(test_find_plain_path) {
+    int immutable = -1;
+    const Asset *a = asset_find("/static/style.css", strlen("/static/style.css"), &immutable);
+    ASSERT_NOT_NULL(a);
+    ASSERT_INT_EQ(0, immutable);
+    ASSERT(strstr(a->content_type, "text/css") != NULL);
+    return 1;
+}
+
+/*
+ * Test: Fingerprinted path resolves to the same asset, immutable
+ */
+TEST(test_find_hashed_path) {
+    int immutable = -1;
+    const char *url = ASSET_STYLE_CSS_URL;
+    const Asset *a = asset_find(url, strlen(url), &immutable);
+    ASSERT_NOT_NULL(a);
+    ASSERT_INT_EQ(1, immutable);
+    ASSERT_STR_EQ("/static/style.css", a->path);
+    return 1;
+}
+
+/*
+ * Test: Unknown and prefix-only paths are not found
+ */
+TEST(test_find_unknown) {
+    ASSERT_NULL(asset_find("/static/nope.css", strlen("/static/nope.css"), NULL));
+    ASSERT_NULL(asset_find("/static/style.cs", strlen("/static/style.cs"), NULL));
+    ASSERT_NULL(asset_find(NULL, 0, NULL));
+    return 1;
+}
+
+/*
+ * Test: Embedded bytes match the source file
+ */
+TEST(test_embedded_content) {
+    const Asset *a = asset_find("/static/style.css", strlen("/static/style.css"), NULL);
+    ASSERT_NOT_NULL(a);
+
+    FILE *f = fopen("static/style.css", "rb");
+    ASSERT_NOT_NULL(f);
+    static unsigned char buf[65536];
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    ASSERT(n == a->len);
+    ASSERT(memcmp(buf, a->data, n) == 0);
+
+    /* gzip variant is always built, and should actually be smaller */
+    ASSERT_NOT_NULL(a->gz);
+    ASSERT(a->gz_len < a->len);
+    ASSERT(a->gz[0] == 0x1f && a->gz[1] == 0x8b);
+    return 1;
+}
+
+/*
+ * Test: Accept-Encoding negotiation
+ */
+TEST(test_accepts_encoding) {
+    const char *h = "gzip, deflate, br";
+    ASSERT_INT_EQ(1, accepts_encoding(h, strlen(h), "gzip"));
+    ASSERT_INT_EQ(1, accepts_encoding(h, strlen(h), "br"));
+    ASSERT_INT_EQ(0, accepts_encoding(h, strlen(h), "zstd"));
+
+    h = "br;q=1.0, gzip;q=0";
+    ASSERT_INT_EQ(1, accepts_encoding(h, strlen(h), "br"));
+    ASSERT_INT_EQ(0, accepts_encoding(h, strlen(h), "gzip"));
+
+    h = "GZIP;q=0.5";
+    ASSERT_INT_EQ(1, accepts_encoding(h, strlen(h), "gzip"));
+
+    h = "gzipx";
+    ASSERT_INT_EQ(0, accepts_encoding(h, strlen(h), "gzip"));
+    ASSERT_INT_EQ(0, accepts_encoding(NULL, 0, "gzip"));
+    return 1;
+}
+
+/*
+ * Test: If-None-Match lists, weak validators and wildcard
+ */
+TEST(test_etag_matches) {
+    const char *etag = "\"1a2b3c4d\"";
+
+    const char *h = "\"1a2b3c4d\"";
+    ASSERT_INT_EQ(1, etag_matches(h, strlen(h), etag));
+
+    h = "\"00000000\", W/\"1a2b3c4d\"";
+    ASSERT_INT_EQ(1, etag_matches(h, strlen(h), etag));
+
+    h = "*";
+    ASSERT_INT_EQ(1, etag_matches(h, strlen(h), etag));
+
+    h = "\"1a2b3c4d-gz\"";
+    ASSERT_INT_EQ(0, etag_matches(h, strlen(h), etag));
+
+    h = "1a2b3c4d";
+    ASSERT_INT_EQ(0, etag_matches(h, strlen(h), etag));
+    ASSERT_INT_EQ(0, etag_matches(NULL, 0, etag));
+    return 1;
+}
+
+/*
+ * Test: Secrets compare over their full length, whatever the guess
+ */
+TEST(test_secret_equal) {
+    static char secret[400];
+    memset(secret, 's', sizeof(secret) - 1);
+
+    ASSERT_INT_EQ(1, secret_equal(secret, strlen(secret), secret, strlen(secret)));
+    ASSERT_INT_EQ(0, secret_equal(secret, 248, secret, strlen(secret)));
+    ASSERT_INT_EQ(0, secret_equal("sx", 2, "ss", 2));
+    ASSERT_INT_EQ(0, secret_equal("ssx", 3, "ss", 2));
+    ASSERT_INT_EQ(0, secret_equal("", 0, "ss", 2));
+    return 1;
+}
+
+/*
+ * Main: Run all asset tests
+ */
+int main(void) {
+    printf("Asset Tests\n");
+    printf("===========\n\n");
+
+    test_init();
+
+    RUN_TEST(test_find_plain_path);
+    RUN_TEST(test_find_hashed_path);
+    RUN_TEST(test_find_unknown);
+    RUN_TEST(test_embedded_content);
+    RUN_TEST(test_accepts_encoding);
+    RUN_TEST(test_etag_matches);
+    RUN_TEST(test_secret_equal);
+
+    return test_summary();
+}
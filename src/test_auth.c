@@ -1,16 +1,21 @@
 /*
  * test_auth.c - Authentication Tests
  *
- * Tests for token generation, magic links, and session management.
+ * Tests for token generation, magic links, session management and
+ * signed sessions.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/wait.h>
 #include "test.h"
 #include "db.h"
 #include "auth.h"
 #include "util.h"
+#include "sha256.h"
+#include "writeback.h"
 #include "sqlite3.h"
 
 /*
@@ -28,6 +33,38 @@ TEST(test_random_bytes) {
     return 1;
 }
 
+/*
+ * Test: A forked child does not repeat the parent's random bytes
+ */
+TEST(test_random_bytes_fork) {
+    unsigned char parent[32], child[32];
+    int fds[2];
+
+    /* Leaves most of a buffer of output ready to hand out */
+    ASSERT_INT_EQ(0, generate_random_bytes(parent, 1));
+    ASSERT_INT_EQ(0, pipe(fds));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        int ok = generate_random_bytes(child, sizeof(child)) == 0 &&
+                 write(fds[1], child, sizeof(child)) == (ssize_t)sizeof(child);
+        _exit(ok ? 0 : 1);
+    }
+    ASSERT(pid > 0);
+    close(fds[1]);
+    ASSERT_INT_EQ(0, generate_random_bytes(parent, sizeof(parent)));
+    ASSERT((int)read(fds[0], child, sizeof(child)) == (int)sizeof(child));
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ASSERT(memcmp(parent, child, sizeof(parent)) != 0);
+
+    return 1;
+}
+
 /*
  * Test: Token generation produces valid hex string
  */
@@ -76,6 +113,29 @@ TEST(test_token_buffer_too_small) {
     return 1;
 }
 
+/*
+ * Test: Session cookie is found among other cookies
+ */
+TEST(test_cookie_value) {
+    const char *header = "theme=dark; session=abc123; sessionx=no";
+    char value[16];
+
+    ASSERT_INT_EQ(1, cookie_value(header, strlen(header), "session", value, sizeof(value)));
+    ASSERT_STR_EQ("abc123", value);
+    ASSERT_INT_EQ(1, cookie_value(header, strlen(header), "theme", value, sizeof(value)));
+    ASSERT_STR_EQ("dark", value);
+
+    /* A longer name sharing the prefix is not a match */
+    const char *other = "sessionx=no";
+    ASSERT_INT_EQ(0, cookie_value(other, strlen(other), "session", value, sizeof(value)));
+
+    /* Values are truncated to the buffer */
+    char small[4];
+    ASSERT_INT_EQ(1, cookie_value(header, strlen(header), "session", small, sizeof(small)));
+    ASSERT_STR_EQ("abc", small);
+    return 1;
+}
+
 /*
  * Test: Create magic link stores token in database
  */
@@ -205,11 +265,20 @@ TEST(test_get_user_from_session) {
     ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
 
     /* Get user from session */
+    setenv("ADMIN_EMAILS", "Session@example.com", 1);
+    ASSERT_INT_EQ(0, auth_load_roles());
     ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
 
-    /* Verify user info */
+    /* Verify user info, roles included */
     ASSERT_STR_EQ("session@example.com", user.email);
     ASSERT_INT_EQ((int)user_id, (int)user.id);
+    ASSERT(user.roles == ROLE_ADMIN);
+
+    /* A reload reaches the cached copy */
+    unsetenv("ADMIN_EMAILS");
+    ASSERT_INT_EQ(0, auth_load_roles());
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT(user.roles == 0);
 
     /* Cleanup */
     sqlite3 *db = db_get();
@@ -411,6 +480,405 @@ TEST(test_validate_code_max_attempts) {
     return 1;
 }
 
+/*
+ * Test: Repeated lookups of a session are answered from the cache
+ */
+TEST(test_session_cache_hits) {
+    char token[65], code[AUTH_CODE_LEN + 1], session[65];
+    int64_t user_id;
+    User user;
+    SessionCacheStats before, after;
+
+    ASSERT_INT_EQ(0, auth_create_magic_link("cached@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
+
+    auth_session_cache_stats(&before);
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    for (int i = 0; i < 10; i++) {
+        memset(&user, 0xff, sizeof(user));
+        ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+        ASSERT_STR_EQ("cached@example.com", user.email);
+        ASSERT_INT_EQ((int)user_id, (int)user.id);
+    }
+    auth_session_cache_stats(&after);
+    ASSERT(after.misses - before.misses == 1);
+    ASSERT(after.hits - before.hits == 10);
+    ASSERT(after.entries >= 1);
+
+    /* A new display name shows up without waiting for the TTL */
+    ASSERT_INT_EQ(0, auth_update_display_name(user_id, "Cached"));
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_STR_EQ("Cached", user.display_name);
+
+    /* Logging out drops the cached copy too */
+    ASSERT_INT_EQ(0, auth_logout(session));
+    ASSERT_INT_EQ(-1, auth_get_user_from_session(session, &user));
+
+    /* Cleanup */
+    sqlite3 *db = db_get();
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'cached@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'cached@example.com'",
+                 NULL, NULL, NULL);
+
+    return 1;
+}
+
+/*
+ * Test: The cache stays bounded, dropping the least recently used session
+ */
+TEST(test_session_cache_lru) {
+    char token[65], code[AUTH_CODE_LEN + 1], first[65], session[65];
+    int64_t user_id;
+    User user;
+    SessionCacheStats before, after;
+
+    auth_session_cache_flush();
+    ASSERT_INT_EQ(0, auth_create_magic_link("lru@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, first, &user_id));
+    ASSERT_INT_EQ(0, auth_get_user_from_session(first, &user));
+
+    /* Fill the cache with other sessions, touching the first as we go */
+    sqlite3 *db = db_get();
+    sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+    for (int i = 0; i < SESSION_CACHE_MAX + 10; i++) {
+        char sql[256];
+        snprintf(session, sizeof(session), "lru%061d", i);
+        snprintf(sql, sizeof(sql),
+                 "INSERT INTO sessions (user_id, token, expires_at) "
+                 "VALUES (%lld, '%s', datetime('now', '+1 day'))", (long long)user_id, session);
+        sqlite3_exec(db, sql, NULL, NULL, NULL);
+    }
+    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+
+    auth_session_cache_stats(&before);
+    for (int i = 0; i < SESSION_CACHE_MAX + 10; i++) {
+        snprintf(session, sizeof(session), "lru%061d", i);
+        ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+        if (i % 100 == 0)
+            ASSERT_INT_EQ(0, auth_get_user_from_session(first, &user));
+    }
+    auth_session_cache_stats(&after);
+    ASSERT(after.entries == SESSION_CACHE_MAX);
+    ASSERT(after.evictions - before.evictions == 11);
+
+    /* The first session was kept; the oldest of the others was not */
+    auth_session_cache_stats(&before);
+    ASSERT_INT_EQ(0, auth_get_user_from_session(first, &user));
+    ASSERT_INT_EQ(0, auth_get_user_from_session("lru0000000000000000000000000000000000000000000000000000000000000", &user));
+    auth_session_cache_stats(&after);
+    ASSERT(after.hits - before.hits == 1);
+    ASSERT(after.misses - before.misses == 1);
+
+    /* Cleanup */
+    sqlite3_exec(db, "DELETE FROM sessions WHERE user_id IN "
+                     "(SELECT id FROM users WHERE email = 'lru@example.com')",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'lru@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'lru@example.com'",
+                 NULL, NULL, NULL);
+    auth_session_cache_flush();
+
+    return 1;
+}
+
+/*
+ * Test: Use slides a session's expiry forward, written behind in a batch
+ */
+TEST(test_session_sliding_expiry) {
+    char token[65], code[AUTH_CODE_LEN + 1], session[65], sql[256];
+    int64_t user_id;
+    User user;
+    sqlite3 *db = db_get();
+    sqlite3_stmt *stmt;
+    long stored = 0;
+
+    ASSERT_INT_EQ(0, auth_create_magic_link("sliding@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
+
+    /* A fresh session has nothing to slide */
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_INT_EQ(0, user.session_extended);
+
+    /* One day left: the next use moves it back out to the full term */
+    snprintf(sql, sizeof(sql),
+             "UPDATE sessions SET expires_at = datetime('now', '+1 day') WHERE token = '%s'",
+             session);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+    auth_session_cache_flush();
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_INT_EQ(1, user.session_extended);
+
+    /* Later uses neither slide again nor touch the row */
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_INT_EQ(0, user.session_extended);
+    auth_session_cache_flush();
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_INT_EQ(0, user.session_extended);
+
+    snprintf(sql, sizeof(sql),
+             "SELECT CAST(strftime('%%s', expires_at) AS INTEGER) FROM sessions WHERE token = '%s'",
+             session);
+    ASSERT(sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        stored = (long)sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    ASSERT(stored < get_current_time() + SESSION_SLIDE_SECS + 60);
+
+    /* The flush writes it */
+    ASSERT(writeback_flush() >= 1);
+    ASSERT(sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        stored = (long)sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    ASSERT(stored >= get_current_time() + SESSION_EXPIRY_SECS - 60);
+
+    /* Cleanup */
+    ASSERT_INT_EQ(0, auth_logout(session));
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'sliding@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'sliding@example.com'",
+                 NULL, NULL, NULL);
+
+    return 1;
+}
+
+/*
+ * Test: The tick removes expired sessions once the interval is up
+ */
+TEST(test_cleanup_tick) {
+    char token[65], code[AUTH_CODE_LEN + 1], session[65], sql[256];
+    int64_t user_id;
+    User user;
+    sqlite3 *db = db_get();
+    sqlite3_stmt *stmt;
+    int rows = -1;
+
+    ASSERT_INT_EQ(0, auth_create_magic_link("tick@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    snprintf(sql, sizeof(sql),
+             "UPDATE sessions SET expires_at = datetime('now', '-1 minute') WHERE token = '%s'",
+             session);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+
+    /* The first tick only starts the clock */
+    long now = get_current_time();
+    auth_tick(now);
+    auth_tick(now + AUTH_CLEANUP_SECS - 1);
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*) FROM sessions WHERE token = '%s'", session);
+    ASSERT(sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        rows = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
+    ASSERT_INT_EQ(1, rows);
+
+    auth_tick(now + AUTH_CLEANUP_SECS);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        rows = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    ASSERT_INT_EQ(0, rows);
+
+    /* Cleanup */
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'tick@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'tick@example.com'",
+                 NULL, NULL, NULL);
+
+    return 1;
+}
+
+/*
+ * Test: SHA-256 and HMAC-SHA256 match the FIPS 180-4 and RFC 4231 vectors
+ */
+TEST(test_hmac_sha256_vectors) {
+    unsigned char out[SHA256_BYTES];
+    char hex[SHA256_BYTES * 2 + 1];
+    Sha256 ctx;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, "abc", 3);
+    sha256_final(&ctx, out);
+    for (int i = 0; i < SHA256_BYTES; i++) sprintf(hex + i * 2, "%02x", out[i]);
+    ASSERT_STR_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hex);
+
+    /* Two blocks, fed in uneven pieces */
+    const char *msg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha256_init(&ctx);
+    sha256_update(&ctx, msg, 5);
+    sha256_update(&ctx, msg + 5, strlen(msg) - 5);
+    sha256_final(&ctx, out);
+    for (int i = 0; i < SHA256_BYTES; i++) sprintf(hex + i * 2, "%02x", out[i]);
+    ASSERT_STR_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", hex);
+
+    HmacKey key;
+    unsigned char secret[20];
+    memset(secret, 0x0b, sizeof(secret));
+    hmac_sha256_key(&key, secret, sizeof(secret));
+    hmac_sha256(&key, "Hi There", 8, out);
+    for (int i = 0; i < SHA256_BYTES; i++) sprintf(hex + i * 2, "%02x", out[i]);
+    ASSERT_STR_EQ("b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7", hex);
+
+    hmac_sha256_key(&key, "Jefe", 4);
+    hmac_sha256(&key, "what do ya want for nothing?", 28, out);
+    for (int i = 0; i < SHA256_BYTES; i++) sprintf(hex + i * 2, "%02x", out[i]);
+    ASSERT_STR_EQ("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", hex);
+
+    return 1;
+}
+
+#define KEY_A "1:000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+#define KEY_B "2:f0f1f2f3f4f5f6f7f8f9fafbfcfdfefff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+
+/*
+ * Test: With keys set, logins get signed sessions that survive a key
+ * rotation and fail once tampered with or their key is dropped
+ */
+TEST(test_signed_session) {
+    char token[65], code[AUTH_CODE_LEN + 1], session[SESSION_TOKEN_MAX];
+    char rotated[SESSION_TOKEN_MAX];
+    int64_t user_id, signed_user;
+    long expires;
+    User user;
+
+    ASSERT_INT_EQ(-1, auth_configure_session_keys("1:abcd"));
+    ASSERT_INT_EQ(-1, auth_configure_session_keys(KEY_A "," KEY_A));
+    ASSERT_INT_EQ(-1, auth_configure_session_keys("x" KEY_A));
+    ASSERT_INT_EQ(0, auth_configure_session_keys(KEY_A));
+
+    ASSERT_INT_EQ(0, auth_create_magic_link("signed@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
+    ASSERT(strncmp(session, "s1.1.", 5) == 0);
+    ASSERT_INT_EQ(0, auth_verify_signed_session(session, &signed_user, &expires));
+    ASSERT_INT_EQ((int)user_id, (int)signed_user);
+    ASSERT(expires > get_current_time());
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_STR_EQ("signed@example.com", user.email);
+
+    /* Another user id, or a flipped MAC digit, breaks the signature */
+    char forged[SESSION_TOKEN_MAX];
+    snprintf(forged, sizeof(forged), "s1.1.%lld%s", (long long)user_id + 1,
+             strchr(session + 5, '.'));
+    ASSERT_INT_EQ(-1, auth_verify_signed_session(forged, &signed_user, &expires));
+    snprintf(forged, sizeof(forged), "%s", session);
+    forged[strlen(forged) - 1] ^= 1;
+    ASSERT_INT_EQ(-1, auth_verify_signed_session(forged, &signed_user, &expires));
+
+    /* Rotation: B signs, A still verifies */
+    ASSERT_INT_EQ(0, auth_configure_session_keys(KEY_B "," KEY_A));
+    ASSERT_INT_EQ(0, auth_verify_signed_session(session, &signed_user, &expires));
+    ASSERT_INT_EQ(0, auth_create_magic_link("signed@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_code("signed@example.com", code, rotated, &user_id));
+    ASSERT(strncmp(rotated, "s1.2.", 5) == 0);
+
+    /* Once A is retired its sessions are refused */
+    ASSERT_INT_EQ(0, auth_configure_session_keys(KEY_B));
+    ASSERT_INT_EQ(-1, auth_verify_signed_session(session, &signed_user, &expires));
+    ASSERT_INT_EQ(0, auth_verify_signed_session(rotated, &signed_user, &expires));
+
+    /* Cleanup */
+    ASSERT_INT_EQ(0, auth_configure_session_keys(NULL));
+    auth_session_cache_flush();
+    sqlite3 *db = db_get();
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'signed@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'signed@example.com'",
+                 NULL, NULL, NULL);
+
+    return 1;
+}
+
+/*
+ * Test: Logging out a signed session revokes it, and the revocation is
+ * read back from the database
+ */
+TEST(test_signed_session_logout) {
+    char token[65], code[AUTH_CODE_LEN + 1], session[SESSION_TOKEN_MAX], other[SESSION_TOKEN_MAX];
+    int64_t user_id, signed_user;
+    long expires;
+    User user;
+    SessionCacheStats st;
+
+    ASSERT_INT_EQ(0, auth_configure_session_keys(KEY_A));
+    ASSERT_INT_EQ(0, auth_create_magic_link("revoke@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
+    ASSERT_INT_EQ(0, auth_create_magic_link("revoke@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, other, &user_id));
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+
+    ASSERT_INT_EQ(0, auth_logout(session));
+    ASSERT_INT_EQ(-1, auth_get_user_from_session(session, &user));
+    auth_session_cache_stats(&st);
+    ASSERT(st.revoked >= 1);
+
+    /* Reloaded from revoked_sessions, as after a restart */
+    auth_cleanup_expired();
+    ASSERT_INT_EQ(-1, auth_verify_signed_session(session, &signed_user, &expires));
+    ASSERT_INT_EQ(0, auth_verify_signed_session(other, &signed_user, &expires));
+
+    /* Cleanup */
+    ASSERT_INT_EQ(0, auth_configure_session_keys(NULL));
+    auth_session_cache_flush();
+    sqlite3 *db = db_get();
+    sqlite3_exec(db, "DELETE FROM revoked_sessions", NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'revoke@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'revoke@example.com'",
+                 NULL, NULL, NULL);
+
+    return 1;
+}
+
+/*
+ * Test: Revocations written by another server are picked up by the tick
+ */
+TEST(test_signed_session_remote_revoke) {
+    char token[65], code[AUTH_CODE_LEN + 1], session[SESSION_TOKEN_MAX], sql[256];
+    int64_t user_id, signed_user;
+    long expires;
+    User user;
+
+    ASSERT_INT_EQ(0, auth_configure_session_keys(KEY_A));
+    ASSERT_INT_EQ(0, auth_create_magic_link("remote@example.com", token, code));
+    ASSERT_INT_EQ(0, auth_validate_magic_link(token, session, &user_id));
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+    ASSERT_INT_EQ(0, auth_verify_signed_session(session, &signed_user, &expires));
+
+    /* Settle the tick's clock: a cleanup runs and reloads once */
+    long now = get_current_time() + 10 * AUTH_CLEANUP_SECS;
+    auth_tick(now);
+
+    /* What another server's logout leaves: the MAC's first 8 bytes */
+    char fp_hex[17];
+    memcpy(fp_hex, strrchr(session, '.') + 1, 16);
+    fp_hex[16] = '\0';
+    snprintf(sql, sizeof(sql),
+             "INSERT INTO revoked_sessions (fingerprint, expires_at) VALUES (%lld, %ld)",
+             (long long)strtoull(fp_hex, NULL, 16), expires);
+    sqlite3_exec(db_get(), sql, NULL, NULL, NULL);
+
+    auth_tick(now + REVOKED_RELOAD_SECS - 1);
+    ASSERT_INT_EQ(0, auth_get_user_from_session(session, &user));
+
+    /* After the reload neither the cached copy nor the cookie passes */
+    auth_tick(now + REVOKED_RELOAD_SECS);
+    ASSERT_INT_EQ(-1, auth_get_user_from_session(session, &user));
+    ASSERT_INT_EQ(-1, auth_verify_signed_session(session, &signed_user, &expires));
+
+    /* Cleanup */
+    ASSERT_INT_EQ(0, auth_configure_session_keys(NULL));
+    auth_session_cache_flush();
+    sqlite3 *db = db_get();
+    sqlite3_exec(db, "DELETE FROM revoked_sessions", NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM auth_tokens WHERE email = 'remote@example.com'",
+                 NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM users WHERE email = 'remote@example.com'",
+                 NULL, NULL, NULL);
+
+    return 1;
+}
+
 int main(void) {
     printf("Authentication Tests\n");
     printf("====================\n\n");
@@ -429,9 +897,11 @@ int main(void) {
 
     /* Utility tests */
     RUN_TEST(test_random_bytes);
+    RUN_TEST(test_random_bytes_fork);
     RUN_TEST(test_token_generation);
     RUN_TEST(test_token_uniqueness);
     RUN_TEST(test_token_buffer_too_small);
+    RUN_TEST(test_cookie_value);
 
     /* Magic link tests */
     RUN_TEST(test_create_magic_link);
@@ -452,6 +922,14 @@ int main(void) {
     RUN_TEST(test_invalid_session_rejected);
     RUN_TEST(test_logout);
     RUN_TEST(test_existing_user_login);
+    RUN_TEST(test_session_cache_hits);
+    RUN_TEST(test_session_cache_lru);
+    RUN_TEST(test_session_sliding_expiry);
+    RUN_TEST(test_cleanup_tick);
+    RUN_TEST(test_hmac_sha256_vectors);
+    RUN_TEST(test_signed_session);
+    RUN_TEST(test_signed_session_logout);
+    RUN_TEST(test_signed_session_remote_revoke);
 
     int result = test_summary();
 
@@ -0,0 +1,167 @@
+/*
+ * test_compress.c - Response Compression Tests
+ *
+ * Tests for the reusable gzip stream and per-route statistics.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include "test.h"
+#include "compress.h"
+
+static unsigned char out_buf[65536];
+static size_t out_len;
+
+static void collect(const void *data, size_t len, void *arg) {
+    (void)arg;
+    if (out_len + len <= sizeof(out_buf)) {
+        memcpy(out_buf + out_len, data, len);
+    }
+    out_len += len;
+}
+
+/* Inflates out_buf into dst, returns the decompressed length or -1 */
+static long gunzip(unsigned char *dst, size_t dst_size) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK)
+        return -1;
+
+    zs.next_in = out_buf;
+    zs.avail_in = (uInt)out_len;
+    zs.next_out = dst;
+    zs.avail_out = (uInt)dst_size;
+    int rc = inflate(&zs, Z_FINISH);
+    long n = (long)zs.total_out;
+    inflateEnd(&zs);
+
+    return rc == Z_STREAM_END ? n : -1;
+}
+
+static const CompressStats *find_stats(CompressStats *all, int n, const char *route) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(all[i].route, route) == 0)
+            return &all[i];
+    }
+    return NULL;
+}
+
+/*
+ * Test: Written pieces round-trip through gzip
+ */
+TEST(test_gzip_roundtrip) {
+    compress_configure(6, 0);
+    out_len = 0;
+
+    const char *parts[] = {
+        "<table>\n",
+        "<tr><td>alice</td><td>120</td></tr>\n",
+        "<tr><td>bob</td><td>95</td></tr>\n",
+        "</table>\n",
+    };
+    char expected[512] = {0};
+
+    ASSERT_INT_EQ(0, gzip_stream_begin());
+    for (int i = 0; i < 4; i++) {
+        ASSERT_INT_EQ(0, gzip_stream_write(parts[i], strlen(parts[i]), collect, NULL));
+        strcat(expected, parts[i]);
+    }
+    ASSERT_INT_EQ(0, gzip_stream_finish(collect, NULL));
+    gzip_stream_end("/test");
+
+    ASSERT(out_len > 10);
+    ASSERT(out_buf[0] == 0x1f && out_buf[1] == 0x8b);
+
+    unsigned char plain[1024];
+    long n = gunzip(plain, sizeof(plain));
+    ASSERT(n == (long)strlen(expected));
+    ASSERT(memcmp(plain, expected, (size_t)n) == 0);
+    return 1;
+}
+
+/*
+ * Test: Stream is reusable and repetitive markup compresses well
+ */
+TEST(test_gzip_reuse_and_ratio) {
+    compress_configure(6, 0);
+
+    for (int round = 0; round < 3; round++) {
+        out_len = 0;
+        ASSERT_INT_EQ(0, gzip_stream_begin());
+        for (int i = 0; i < 200; i++) {
+            const char *row = "<div class=\"list-row\"><span class=\"gt\">&gt;</span> row</div>\n";
+            gzip_stream_write(row, strlen(row), collect, NULL);
+        }
+        gzip_stream_finish(collect, NULL);
+        gzip_stream_end("/ratio");
+
+        unsigned char plain[32768];
+        long n = gunzip(plain, sizeof(plain));
+        ASSERT(n > 0);
+        ASSERT(out_len * 10 < (size_t)n);
+    }
+    return 1;
+}
+
+/*
+ * Test: Level 0 disables compression
+ */
+TEST(test_level_zero_disables) {
+    compress_configure(0, 100);
+    ASSERT_INT_EQ(0, compress_level());
+    ASSERT(compress_min_size() == 100);
+    ASSERT_INT_EQ(-1, gzip_stream_begin());
+
+    compress_configure(42, 100);
+    ASSERT_INT_EQ(9, compress_level());
+    return 1;
+}
+
+/*
+ * Test: Stats are kept per route
+ */
+TEST(test_stats_per_route) {
+    compress_configure(6, 0);
+
+    compress_record_plain("/plain");
+    compress_record_plain("/plain");
+
+    out_len = 0;
+    gzip_stream_begin();
+    gzip_stream_write("hello hello hello hello", 23, collect, NULL);
+    gzip_stream_finish(collect, NULL);
+    gzip_stream_end("/plain");
+
+    CompressStats all[COMPRESS_MAX_ROUTES];
+    int n = compress_get_stats(all, COMPRESS_MAX_ROUTES);
+
+    const CompressStats *s = find_stats(all, n, "/plain");
+    ASSERT_NOT_NULL(s);
+    ASSERT(s->responses == 3);
+    ASSERT(s->compressed == 1);
+    ASSERT(s->bytes_in == 23);
+    ASSERT(s->bytes_out == out_len);
+
+    s = find_stats(all, n, "/ratio");
+    ASSERT_NOT_NULL(s);
+    ASSERT(s->compressed == 3);
+    return 1;
+}
+
+/*
+ * Main: Run all compression tests
+ */
+int main(void) {
+    printf("Compression Tests\n");
+    printf("=================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_gzip_roundtrip);
+    RUN_TEST(test_gzip_reuse_and_ratio);
+    RUN_TEST(test_level_zero_disables);
+    RUN_TEST(test_stats_per_route);
+
+    return test_summary();
+}
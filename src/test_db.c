@@ -214,6 +214,27 @@ TEST(test_indexes_exist) {
     return 1;
 }
 
+/*
+ * Test: Data version counters only move forward, per kind and per user
+ */
+TEST(test_data_versions) {
+    unsigned long puzzles = db_data_version(DATA_PUZZLES);
+    unsigned long leagues = db_data_version(DATA_LEAGUES);
+
+    db_bump_version(DATA_PUZZLES);
+    ASSERT(db_data_version(DATA_PUZZLES) == puzzles + 1);
+    ASSERT(db_data_version(DATA_LEAGUES) == leagues);
+
+    unsigned long u1 = db_user_version(1);
+    unsigned long u2 = db_user_version(2);
+    db_bump_user_version(1);
+    ASSERT(db_user_version(1) == u1 + 1);
+    ASSERT(db_user_version(2) == u2);
+
+    ASSERT(db_boot_id() != 0);
+    return 1;
+}
+
 /*
  * Main: Run all database tests
  */
@@ -241,6 +262,7 @@ int main(void) {
     RUN_TEST(test_puzzle_insert);
     RUN_TEST(test_puzzle_date_unique);
     RUN_TEST(test_indexes_exist);
+    RUN_TEST(test_data_versions);
 
     int result = test_summary();
 
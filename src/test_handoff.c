@@ -0,0 +1,154 @@
+/*
+ * test_handoff.c - Restart Handoff Tests
+ *
+ * Tests for passing the listening socket and warm state between processes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "test.h"
+#include "handoff.h"
+
+static int counters[8];
+static char names[4][16];
+
+static int open_listener(unsigned short *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 8) != 0)
+        return -1;
+
+    socklen_t len = sizeof(sa);
+    getsockname(fd, (struct sockaddr *)&sa, &len);
+    *port = ntohs(sa.sin_port);
+    return fd;
+}
+
+/*
+ * Test: Listener and registered regions arrive intact
+ */
+TEST(test_listener_and_state) {
+    unsigned short port = 0, got_port = 0;
+    int lsn = open_listener(&port);
+    ASSERT(lsn >= 0);
+
+    int sv[2];
+    ASSERT_INT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+    handoff_register("counters", counters, sizeof(counters));
+    handoff_register("names", names, sizeof(names));
+    for (int i = 0; i < 8; i++)
+        counters[i] = i * 10;
+    strcpy(names[2], "alice");
+
+    ASSERT_INT_EQ(0, handoff_send(sv[0], lsn, 1000));
+
+    /* What a freshly started process would have */
+    memset(counters, 0, sizeof(counters));
+    memset(names, 0, sizeof(names));
+
+    int fd = -1;
+    ASSERT_INT_EQ(2, handoff_recv(sv[1], &fd));
+    ASSERT(fd >= 0 && fd != lsn);
+    ASSERT_INT_EQ(70, counters[7]);
+    ASSERT_STR_EQ("alice", names[2]);
+
+    /* Same socket: bound to the same port and still listening */
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+    getsockname(fd, (struct sockaddr *)&sa, &len);
+    got_port = ntohs(sa.sin_port);
+    ASSERT_INT_EQ(port, got_port);
+
+    int listening = 0;
+    len = sizeof(listening);
+    getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len);
+    ASSERT(listening);
+
+    close(fd);
+    close(lsn);
+    close(sv[0]);
+    close(sv[1]);
+    return 1;
+}
+
+/*
+ * Test: Receiving fails cleanly when the old process sent nothing
+ */
+TEST(test_recv_without_fd) {
+    int sv[2];
+    ASSERT_INT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    close(sv[0]);
+
+    int fd = -1;
+    ASSERT_INT_EQ(-1, handoff_recv(sv[1], &fd));
+    close(sv[1]);
+    return 1;
+}
+
+/*
+ * Test: Old process waits for the new one's ack, with a timeout
+ */
+TEST(test_ack) {
+    int sv[2];
+    ASSERT_INT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+    ASSERT_INT_EQ(-1, handoff_wait_ack(sv[0], 50));
+    ASSERT_INT_EQ(0, handoff_ack(sv[1]));
+    ASSERT_INT_EQ(0, handoff_wait_ack(sv[0], 1000));
+
+    close(sv[0]);
+    close(sv[1]);
+    return 1;
+}
+
+/*
+ * Test: Sending gives up at the timeout when the new process stops reading
+ */
+TEST(test_send_timeout) {
+    static char big[4 << 20];
+    unsigned short port = 0;
+    int lsn = open_listener(&port);
+    ASSERT(lsn >= 0);
+
+    int sv[2];
+    ASSERT_INT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    handoff_register("big", big, sizeof(big));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ASSERT_INT_EQ(-1, handoff_send(sv[0], lsn, 100));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double)(end.tv_sec - start.tv_sec) +
+                     (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    ASSERT(elapsed >= 0.09 && elapsed < 1.0);
+
+    close(lsn);
+    close(sv[0]);
+    close(sv[1]);
+    return 1;
+}
+
+/*
+ * Main: Run all handoff tests
+ */
+int main(void) {
+    printf("Restart Handoff Tests\n");
+    printf("=====================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_listener_and_state);
+    RUN_TEST(test_recv_without_fd);
+    RUN_TEST(test_ack);
+    RUN_TEST(test_send_timeout);
+
+    return test_summary();
+}
@@ -0,0 +1,138 @@
+/*
+ * test_json.c - JSON Writer Tests
+ *
+ * Tests for the JSON writer behind /api/v1: separators, escaping,
+ * integers and the sticky overflow.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "json.h"
+
+/*
+ * Test: Nested objects and arrays get their commas
+ */
+TEST(test_nesting) {
+    char buf[256];
+    JsonWriter w;
+    json_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_int(&w, "id", 7);
+    json_array_begin(&w, "steps");
+    json_object_begin(&w, NULL);
+    json_string(&w, "word", "Dawn");
+    json_bool(&w, "blank", 0);
+    json_object_end(&w);
+    json_object_begin(&w, NULL);
+    json_null(&w, "word");
+    json_bool(&w, "blank", 1);
+    json_object_end(&w);
+    json_array_end(&w);
+    json_array_begin(&w, "empty");
+    json_array_end(&w);
+    json_object_end(&w);
+
+    size_t len;
+    ASSERT_INT_EQ(0, json_finish(&w, &len));
+    ASSERT_STR_EQ("{\"id\":7,\"steps\":[{\"word\":\"Dawn\",\"blank\":false},"
+                  "{\"word\":null,\"blank\":true}],\"empty\":[]}", buf);
+    ASSERT(len == strlen(buf));
+    return 1;
+}
+
+/*
+ * Test: String values are escaped, integers cover the full range
+ */
+TEST(test_values) {
+    char buf[256];
+    JsonWriter w;
+    json_init(&w, buf, sizeof(buf));
+    json_array_begin(&w, NULL);
+    json_string(&w, NULL, "say \"hi\"\\\n");
+    json_string(&w, NULL, "");
+    json_int(&w, NULL, 0);
+    json_int(&w, NULL, -42);
+    json_int(&w, NULL, -9223372036854775807LL - 1);
+    json_array_end(&w);
+
+    ASSERT_INT_EQ(0, json_finish(&w, NULL));
+    ASSERT_STR_EQ("[\"say \\\"hi\\\"\\\\\\u000a\",\"\",0,-42,-9223372036854775808]", buf);
+    return 1;
+}
+
+/*
+ * Test: A document that does not fit fails instead of truncating
+ */
+TEST(test_overflow) {
+    char buf[16];
+    JsonWriter w;
+    json_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_string(&w, "name", "far too long for the buffer");
+    json_object_end(&w);
+    ASSERT_INT_EQ(-1, json_finish(&w, NULL));
+
+    /* Exactly full, with room for the NUL */
+    json_init(&w, buf, 8);
+    json_array_begin(&w, NULL);
+    json_int(&w, NULL, 12345);
+    json_array_end(&w);
+    ASSERT_INT_EQ(0, json_finish(&w, NULL));
+    ASSERT_STR_EQ("[12345]", buf);
+    return 1;
+}
+
+/*
+ * Test: An escape that does not fit fails the document at every size
+ */
+TEST(test_escape_overflow) {
+    const char *want = "[\"abcdefgh\\u000aij\"]";
+    char buf[32];
+    JsonWriter w;
+
+    for (size_t size = 1; size <= strlen(want) + 1; size++) {
+        json_init(&w, buf, size);
+        json_array_begin(&w, NULL);
+        json_string(&w, NULL, "abcdefgh\nij");
+        json_array_end(&w);
+        if (size <= strlen(want)) {
+            ASSERT_INT_EQ(-1, json_finish(&w, NULL));
+        } else {
+            ASSERT_INT_EQ(0, json_finish(&w, NULL));
+            ASSERT_STR_EQ(want, buf);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Test: Unbalanced containers are reported
+ */
+TEST(test_unbalanced) {
+    char buf[64];
+    JsonWriter w;
+    json_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    ASSERT_INT_EQ(-1, json_finish(&w, NULL));
+
+    json_init(&w, buf, sizeof(buf));
+    json_array_end(&w);
+    ASSERT_INT_EQ(-1, json_finish(&w, NULL));
+    return 1;
+}
+
+int main(void) {
+    printf("JSON Writer Tests\n");
+    printf("=================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_nesting);
+    RUN_TEST(test_values);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_escape_overflow);
+    RUN_TEST(test_unbalanced);
+
+    return test_summary();
+}
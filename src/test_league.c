@@ -495,6 +495,76 @@ TEST(test_leaderboard_alltime) {
     return 1;
 }
 
+/*
+ * Test: Batched standings agree with each league's leaderboards
+ */
+TEST(test_league_standings) {
+    int64_t user1 = create_test_user("stand1@test.com");
+    int64_t user2 = create_test_user("stand2@test.com");
+    int64_t user3 = create_test_user("stand3@test.com");
+
+    char invite_code[8];
+    int64_t league_a = league_create(user1, "Standings A", invite_code);
+    league_join(league_a, user2);
+    league_join(league_a, user3);
+    int64_t league_b = league_create(user2, "Standings B", invite_code);
+    league_join(league_b, user1);
+    int64_t league_c = league_create(user3, "Standings C", invite_code);
+
+    int64_t today = create_today_puzzle();
+    int64_t old = create_puzzle_on_date("2020-01-01");
+
+    /* User1 is behind on the day but ahead all-time; user3 never solves */
+    record_attempt(user1, today, 60);
+    record_attempt(user1, old, 100);
+    record_attempt(user2, today, 90);
+
+    int64_t ids[] = { league_a, league_b, league_c, league_a };
+    LeagueStanding st[4];
+    ASSERT_INT_EQ(0, league_get_standings(user1, ids, 4, st));
+
+    ASSERT_INT_EQ(3, st[0].member_count);
+    ASSERT_INT_EQ(2, st[0].rank[LEAGUE_DAILY]);
+    ASSERT_INT_EQ(60, st[0].score[LEAGUE_DAILY]);
+    ASSERT_INT_EQ(1, st[0].rank[LEAGUE_ALLTIME]);
+    ASSERT_INT_EQ(160, st[0].score[LEAGUE_ALLTIME]);
+
+    LeaderboardEntry entries[10];
+    int count;
+    league_get_leaderboard_weekly(league_b, entries, 10, &count);
+    for (int i = 0; i < count; i++) {
+        if (entries[i].user_id == user1) {
+            ASSERT_INT_EQ(entries[i].rank, st[1].rank[LEAGUE_WEEKLY]);
+            ASSERT_INT_EQ(entries[i].score, st[1].score[LEAGUE_WEEKLY]);
+        }
+    }
+
+    /* Not a member of C; a repeated id gets the same answer */
+    ASSERT_INT_EQ(0, st[2].rank[LEAGUE_DAILY]);
+    ASSERT_INT_EQ(0, st[2].member_count);
+    ASSERT_INT_EQ(st[0].rank[LEAGUE_WEEKLY], st[3].rank[LEAGUE_WEEKLY]);
+
+    /* Unsolved today: last, sharing the rank */
+    ASSERT_INT_EQ(0, league_get_standings(user3, ids, 1, st));
+    ASSERT_INT_EQ(3, st[0].rank[LEAGUE_DAILY]);
+    ASSERT_INT_EQ(-1, st[0].score[LEAGUE_DAILY]);
+
+    ASSERT_INT_EQ(-1, league_get_standings(user1, ids, LEAGUE_MAX_BATCH + 1, st));
+
+    /* Cleanup */
+    sqlite3 *db = db_get();
+    sqlite3_exec(db, "DELETE FROM attempts", NULL, NULL, NULL);
+    sqlite3_exec(db, "DELETE FROM puzzles", NULL, NULL, NULL);
+    league_delete(league_a, user1);
+    league_delete(league_b, user2);
+    league_delete(league_c, user3);
+    delete_test_user(user1);
+    delete_test_user(user2);
+    delete_test_user(user3);
+
+    return 1;
+}
+
 /*
  * Test: Tied scores get same rank
  */
@@ -675,6 +745,7 @@ int main(void) {
     RUN_TEST(test_leaderboard_today);
     RUN_TEST(test_leaderboard_alltime);
     RUN_TEST(test_leaderboard_ties);
+    RUN_TEST(test_league_standings);
 
     /* Tag tests */
     RUN_TEST(test_league_tags);
@@ -0,0 +1,257 @@
+/*
+ * test_live.c - Live Leaderboard Tests
+ *
+ * Tests for the Server-Sent Events behind league pages: only changed
+ * rows are pushed, a departed member resets the page, slow subscribers
+ * are dropped, and subscriber slots are reused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "db.h"
+#include "league.h"
+#include "live.h"
+#include "sqlite3.h"
+
+#define TEST_DB "test_live.db"
+
+static struct mg_connection conns[3];
+static int64_t users[3];
+static int64_t league_id;
+static int64_t puzzle_id;
+
+static int64_t create_user(const char *email) {
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db_get(), "INSERT INTO users (email) VALUES (?)", -1, &stmt, NULL);
+    sqlite3_bind_text(stmt, 1, email, -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    return sqlite3_last_insert_rowid(db_get());
+}
+
+static void record_attempt(int64_t user_id, int score) {
+    sqlite3_stmt *stmt;
+    sqlite3_prepare_v2(db_get(),
+        "INSERT INTO attempts (user_id, puzzle_id, solved, score, completed_at) "
+        "VALUES (?, ?, 1, ?, datetime('now'))",
+        -1, &stmt, NULL);
+    sqlite3_bind_int64(stmt, 1, user_id);
+    sqlite3_bind_int64(stmt, 2, puzzle_id);
+    sqlite3_bind_int(stmt, 3, score);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+static void setup(void) {
+    char code[8];
+    remove(TEST_DB);
+    db_init(TEST_DB);
+    users[0] = create_user("ada@example.com");
+    users[1] = create_user("bob@example.com");
+    users[2] = create_user("cy@example.com");
+    league_id = league_create(users[0], "Live", code);
+    league_join(league_id, users[1]);
+    league_join(league_id, users[2]);
+    sqlite3_exec(db_get(),
+        "INSERT INTO puzzles (puzzle_date, puzzle_type, question, answer) "
+        "VALUES (date('now'), 'word', 'Q', 'a')",
+        NULL, NULL, NULL);
+    puzzle_id = sqlite3_last_insert_rowid(db_get());
+}
+
+static void reset_conns(void) {
+    for (int i = 0; i < 3; i++) {
+        live_unsubscribe(&conns[i]);
+        mg_iobuf_free(&conns[i].send);
+        memset(&conns[i], 0, sizeof(conns[i]));
+    }
+}
+
+/* Copies what is queued for c and empties its send buffer */
+static void take_sent(struct mg_connection *c, char *out, size_t size) {
+    size_t len = c->send.len < size - 1 ? c->send.len : size - 1;
+    memcpy(out, c->send.buf, len);
+    out[len] = '\0';
+    c->send.len = 0;
+}
+
+/* Flushes once the channel may refresh again */
+static void flush_later(void) {
+    usleep(LIVE_MIN_INTERVAL_MS * 1000 + 20000);
+    live_flush();
+}
+
+static int has_row(const char *sent, int64_t user_id) {
+    char needle[32];
+    snprintf(needle, sizeof(needle), "{\"id\":%lld,", (long long)user_id);
+    return strstr(sent, needle) != NULL;
+}
+
+/*
+ * Test: A solve pushes only the rows whose rank or score moved
+ */
+TEST(test_changed_rows_only) {
+    char sent[4096];
+    LiveStats st;
+    reset_conns();
+    record_attempt(users[0], 100);
+
+    ASSERT_INT_EQ(0, live_subscribe(&conns[0], league_id, LIVE_DAILY));
+    ASSERT_INT_EQ(0, live_subscribe(&conns[1], league_id, LIVE_DAILY));
+    live_get_stats(&st);
+    ASSERT_INT_EQ(2, (int)st.subscribers);
+    ASSERT_INT_EQ(1, (int)st.channels);
+
+    /* The full table on subscribe, from the channel's snapshot */
+    take_sent(&conns[0], sent, sizeof(sent));
+    ASSERT(strstr(sent, "text/event-stream") != NULL);
+    ASSERT(has_row(sent, users[0]) && has_row(sent, users[1]) && has_row(sent, users[2]));
+    conns[1].send.len = 0;
+
+    /* Cy overtakes no one at the top, so Ada's row stays out */
+    record_attempt(users[2], 50);
+    live_user_solved(users[2]);
+    flush_later();
+    take_sent(&conns[0], sent, sizeof(sent));
+    ASSERT(strstr(sent, "event: rows") != NULL);
+    ASSERT(has_row(sent, users[2]));
+    ASSERT(!has_row(sent, users[0]));
+
+    /* One query served both subscribers the same event */
+    char other[4096];
+    take_sent(&conns[1], other, sizeof(other));
+    ASSERT_STR_EQ(sent, other);
+
+    /* Nothing changed: no refresh, nothing sent but a heartbeat */
+    live_get_stats(&st);
+    unsigned long refreshes = st.refreshes;
+    flush_later();
+    live_get_stats(&st);
+    ASSERT(st.refreshes == refreshes);
+    take_sent(&conns[0], sent, sizeof(sent));
+    ASSERT(strstr(sent, "event:") == NULL);
+    return 1;
+}
+
+/*
+ * Test: A member leaving cannot be a row update, so pages reset
+ */
+TEST(test_reset_on_leave) {
+    char sent[4096];
+    reset_conns();
+    ASSERT_INT_EQ(0, live_subscribe(&conns[0], league_id, LIVE_DAILY));
+    conns[0].send.len = 0;
+
+    ASSERT_INT_EQ(0, league_leave(league_id, users[1]));
+    live_league_changed(league_id);
+    flush_later();
+    take_sent(&conns[0], sent, sizeof(sent));
+    ASSERT(strstr(sent, "event: reset") != NULL);
+    ASSERT(strstr(sent, "event: rows") == NULL);
+
+    league_join(league_id, users[1]);
+    return 1;
+}
+
+/*
+ * Test: A subscriber past the backlog is closed, the others still get events
+ */
+TEST(test_backlog_overflow) {
+    char sent[4096];
+    static char junk[LIVE_MAX_BACKLOG + 1];
+    LiveStats before, after;
+    reset_conns();
+    ASSERT_INT_EQ(0, live_subscribe(&conns[0], league_id, LIVE_DAILY));
+    ASSERT_INT_EQ(0, live_subscribe(&conns[1], league_id, LIVE_DAILY));
+    conns[0].send.len = 0;
+    conns[1].send.len = 0;
+    mg_iobuf_add(&conns[1].send, 0, junk, sizeof(junk));
+
+    live_get_stats(&before);
+    ASSERT_INT_EQ(0, league_leave(league_id, users[1]));
+    live_league_changed(league_id);
+    flush_later();
+    live_get_stats(&after);
+
+    ASSERT(conns[1].is_closing);
+    ASSERT(conns[1].send.len == sizeof(junk));
+    ASSERT(after.overflows - before.overflows == 1);
+    ASSERT(!conns[0].is_closing);
+    take_sent(&conns[0], sent, sizeof(sent));
+    ASSERT(strstr(sent, "event: reset") != NULL);
+
+    league_join(league_id, users[1]);
+    return 1;
+}
+
+/*
+ * Test: Unsubscribing frees the slot and channel for the next stream
+ */
+TEST(test_unsubscribe_reuse) {
+    LiveStats st;
+    reset_conns();
+    ASSERT_INT_EQ(0, live_subscribe(&conns[0], league_id, LIVE_DAILY));
+    ASSERT_INT_EQ(0, live_subscribe(&conns[1], league_id, LIVE_WEEKLY));
+    live_get_stats(&st);
+    ASSERT_INT_EQ(2, (int)st.channels);
+
+    live_unsubscribe(&conns[0]);
+    live_unsubscribe(&conns[0]);
+    live_get_stats(&st);
+    ASSERT_INT_EQ(1, (int)st.subscribers);
+    ASSERT_INT_EQ(1, (int)st.channels);
+
+    /* A closed stream gets nothing more; its slot serves the next one */
+    conns[0].send.len = 0;
+    ASSERT_INT_EQ(0, live_subscribe(&conns[2], league_id, LIVE_DAILY));
+    conns[2].send.len = 0;
+    record_attempt(users[1], 70);
+    live_user_solved(users[1]);
+    flush_later();
+    ASSERT(conns[0].send.len == 0);
+    ASSERT(conns[2].send.len > 0);
+
+    live_unsubscribe(&conns[1]);
+    live_unsubscribe(&conns[2]);
+    live_get_stats(&st);
+    ASSERT_INT_EQ(0, (int)st.subscribers);
+    ASSERT_INT_EQ(0, (int)st.channels);
+
+    /* Every slot can be taken, and the one after fails */
+    static struct mg_connection many[LIVE_MAX_SUBSCRIBERS + 1];
+    for (int i = 0; i < LIVE_MAX_SUBSCRIBERS; i++)
+        ASSERT_INT_EQ(0, live_subscribe(&many[i], league_id, LIVE_DAILY));
+    ASSERT_INT_EQ(-1, live_subscribe(&many[LIVE_MAX_SUBSCRIBERS], league_id, LIVE_DAILY));
+    live_unsubscribe(&many[7]);
+    ASSERT_INT_EQ(0, live_subscribe(&many[LIVE_MAX_SUBSCRIBERS], league_id, LIVE_DAILY));
+    for (int i = 0; i <= LIVE_MAX_SUBSCRIBERS; i++) {
+        live_unsubscribe(&many[i]);
+        mg_iobuf_free(&many[i].send);
+    }
+    live_get_stats(&st);
+    ASSERT_INT_EQ(0, (int)st.subscribers);
+    return 1;
+}
+
+/*
+ * Main entry point
+ */
+int main(void) {
+    printf("Live Leaderboard Tests\n");
+    printf("======================\n\n");
+
+    test_init();
+    setup();
+
+    RUN_TEST(test_changed_rows_only);
+    RUN_TEST(test_reset_on_leave);
+    RUN_TEST(test_backlog_overflow);
+    RUN_TEST(test_unsubscribe_reuse);
+
+    reset_conns();
+    db_close();
+    remove(TEST_DB);
+    return test_summary();
+}
@@ -0,0 +1,125 @@
+/*
+ * test_metrics.c - Metrics Tests
+ *
+ * Tests for request counters, histograms and the text exposition format.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "metrics.h"
+
+static char text[65536];
+static size_t text_len;
+
+static void collect(const char *data, size_t len, void *arg) {
+    (void)arg;
+    if (text_len + len < sizeof(text)) {
+        memcpy(text + text_len, data, len);
+        text_len += len;
+        text[text_len] = '\0';
+    }
+}
+
+static void render(void) {
+    text_len = 0;
+    text[0] = '\0';
+    metrics_render(collect, NULL);
+}
+
+/*
+ * Test: Requests are counted per route and status code
+ */
+TEST(test_requests_by_status) {
+    metrics_observe("/puzzle", 200, 0.002, 1000);
+    metrics_observe("/puzzle", 200, 0.004, 1000);
+    metrics_observe("/puzzle", 304, 0.0001, 100);
+    metrics_observe("/puzzle", 418, 0.0001, 0);
+    metrics_observe(NULL, 404, 0.0001, 50);
+    render();
+
+    ASSERT_NOT_NULL(strstr(text, "puzzle_http_requests_total{route=\"/puzzle\",code=\"200\"} 2\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_http_requests_total{route=\"/puzzle\",code=\"304\"} 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_http_requests_total{route=\"/puzzle\",code=\"other\"} 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_http_requests_total{route=\"unmatched\",code=\"404\"} 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_http_response_bytes_total{route=\"/puzzle\"} 2100\n"));
+    ASSERT_NULL(strstr(text, "code=\"302\""));
+    return 1;
+}
+
+/*
+ * Test: Latency buckets are cumulative and end with +Inf
+ */
+TEST(test_latency_histogram) {
+    metrics_observe("/archive", 200, 0.0005, 10);
+    metrics_observe("/archive", 200, 0.03, 10);
+    metrics_observe("/archive", 200, 7.0, 10);
+    render();
+
+    const char *h = "puzzle_http_request_duration_seconds";
+    char line[256];
+    snprintf(line, sizeof(line), "%s_bucket{route=\"/archive\",le=\"0.001\"} 1\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    snprintf(line, sizeof(line), "%s_bucket{route=\"/archive\",le=\"0.025\"} 1\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    snprintf(line, sizeof(line), "%s_bucket{route=\"/archive\",le=\"0.05\"} 2\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    snprintf(line, sizeof(line), "%s_bucket{route=\"/archive\",le=\"2.5\"} 2\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    snprintf(line, sizeof(line), "%s_bucket{route=\"/archive\",le=\"+Inf\"} 3\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    snprintf(line, sizeof(line), "%s_count{route=\"/archive\"} 3\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    snprintf(line, sizeof(line), "%s_sum{route=\"/archive\"} 7.030500\n", h);
+    ASSERT_NOT_NULL(strstr(text, line));
+    return 1;
+}
+
+/*
+ * Test: Loop iterations include the request time observed since the last one
+ */
+TEST(test_loop_iterations) {
+    metrics_loop_iteration(0);
+    metrics_observe("/health", 200, 0.02, 3);
+    metrics_loop_iteration(0.01);
+    render();
+
+    ASSERT_NOT_NULL(strstr(text, "puzzle_loop_iteration_seconds_count 2\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_loop_iteration_seconds_bucket{le=\"0.025\"} 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_loop_iteration_seconds_bucket{le=\"0.05\"} 2\n"));
+    return 1;
+}
+
+/*
+ * Test: Business counters and SQLite gauges are exported
+ */
+TEST(test_counters_and_gauges) {
+    metrics_inc(METRIC_GUESSES);
+    metrics_inc(METRIC_GUESSES);
+    metrics_inc(METRIC_SOLVES);
+    metrics_inc(METRIC_COUNT);              /* ignored */
+    render();
+
+    ASSERT_NOT_NULL(strstr(text, "# TYPE puzzle_guesses_total counter\npuzzle_guesses_total 2\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_solves_total 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "puzzle_logins_total 0\n"));
+    ASSERT_NOT_NULL(strstr(text, "\npuzzle_sqlite_memory_bytes "));
+    return 1;
+}
+
+/*
+ * Main: Run all metrics tests
+ */
+int main(void) {
+    printf("Metrics Tests\n");
+    printf("=============\n\n");
+
+    test_init();
+
+    RUN_TEST(test_loop_iterations);
+    RUN_TEST(test_requests_by_status);
+    RUN_TEST(test_latency_histogram);
+    RUN_TEST(test_counters_and_gauges);
+
+    return test_summary();
+}
@@ -0,0 +1,254 @@
+/*
+ * test_outbox.c - Email Outbox Tests
+ *
+ * Tests for the persistent email queue and its sender thread, against a
+ * local stand-in for the provider's batch endpoint.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "test.h"
+#include "db.h"
+#include "outbox.h"
+#include "sqlite3.h"
+
+#define TEST_DB "test_outbox.db"
+
+/* Stand-in provider: records requests, answers with reply_status, or
+   422 to any request naming reject_recipient */
+static int stub_fd = -1;
+static unsigned short stub_port = 0;
+static volatile int reply_status = 200;
+static const char *volatile reject_recipient = NULL;
+static volatile int stub_connections = 0;
+static volatile int stub_requests = 0;
+static volatile int stub_accepted = 0;
+static char last_body[8192];
+static char last_auth[256];
+
+static void *stub_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        int fd = accept(stub_fd, NULL, NULL);
+        if (fd < 0)
+            return NULL;
+        stub_connections++;
+
+        char buf[16384];
+        size_t len = 0;
+        for (;;) {
+            ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+            if (n <= 0)
+                break;
+            len += (size_t)n;
+            buf[len] = '\0';
+
+            char *end = strstr(buf, "\r\n\r\n");
+            char *cl = strstr(buf, "Content-Length: ");
+            if (end == NULL || cl == NULL)
+                continue;
+            size_t body_len = (size_t)atoi(cl + 16);
+            size_t head_len = (size_t)(end + 4 - buf);
+            if (len < head_len + body_len)
+                continue;
+
+            char *auth = strstr(buf, "Authorization: ");
+            if (auth != NULL)
+                sscanf(auth + 15, "%255[^\r]", last_auth);
+            snprintf(last_body, sizeof(last_body), "%.*s", (int)body_len, end + 4);
+            stub_requests++;
+
+            int status = reply_status;
+            if (reject_recipient != NULL && strstr(last_body, reject_recipient) != NULL)
+                status = 422;
+            else if (status >= 200 && status < 300)
+                stub_accepted++;
+
+            char reply[128];
+            int rlen = snprintf(reply, sizeof(reply),
+                "HTTP/1.1 %d X\r\nContent-Length: 2\r\n\r\n{}", status);
+            if (write(fd, reply, (size_t)rlen) != rlen)
+                break;
+
+            memmove(buf, buf + head_len + body_len, len - head_len - body_len);
+            len -= head_len + body_len;
+        }
+        close(fd);
+    }
+}
+
+static void start_stub(void) {
+    stub_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(stub_fd, (struct sockaddr *)&sa, sizeof(sa));
+    listen(stub_fd, 8);
+
+    socklen_t len = sizeof(sa);
+    getsockname(stub_fd, (struct sockaddr *)&sa, &len);
+    stub_port = ntohs(sa.sin_port);
+
+    pthread_t t;
+    pthread_create(&t, NULL, stub_main, NULL);
+    pthread_detach(t);
+}
+
+static int query_int(const char *sql) {
+    sqlite3_stmt *stmt;
+    int value = -1;
+    if (sqlite3_prepare_v2(db_get(), sql, -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+/* Polls until the query returns want, for up to five seconds */
+static int wait_for(const char *sql, int want) {
+    for (int i = 0; i < 500; i++) {
+        if (query_int(sql) == want)
+            return 1;
+        usleep(10000);
+    }
+    return 0;
+}
+
+static void setup(void) {
+    remove(TEST_DB);
+    db_init(TEST_DB);
+}
+
+/*
+ * Test: Enqueued messages are stored and due immediately
+ */
+TEST(test_enqueue) {
+    ASSERT_INT_EQ(0, outbox_enqueue("a@example.com", "Code", "<p>111</p>"));
+    ASSERT_INT_EQ(0, outbox_enqueue("b@example.com", "Code", "<p>\"222\"</p>"));
+    ASSERT_INT_EQ(0, outbox_enqueue("c@example.com", "Code", "<p>333</p>"));
+
+    ASSERT_INT_EQ(3, query_int("SELECT COUNT(*) FROM outbox"));
+    ASSERT_INT_EQ(0, query_int("SELECT COUNT(*) FROM outbox "
+                               "WHERE next_attempt_at > strftime('%s','now')"));
+    return 1;
+}
+
+/*
+ * Test: Queued messages go out in one batch and are deleted
+ */
+TEST(test_batch_send) {
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/emails/batch", stub_port);
+    OutboxConfig cfg = {0};
+    cfg.url = url;
+    cfg.api_key = "test-key";
+    cfg.from = "Puzzle Pause <noreply@example.com>";
+    ASSERT_INT_EQ(0, outbox_start(TEST_DB, &cfg));
+
+    ASSERT(wait_for("SELECT COUNT(*) FROM outbox", 0));
+    ASSERT_INT_EQ(1, stub_requests);
+    ASSERT_STR_EQ("Bearer test-key", last_auth);
+    ASSERT(last_body[0] == '[');
+    ASSERT_NOT_NULL(strstr(last_body, "\"to\":[\"c@example.com\"]"));
+    ASSERT_NOT_NULL(strstr(last_body, "<p>\\\"222\\\"</p>"));
+
+    OutboxStats st;
+    outbox_get_stats(&st);
+    ASSERT(st.sent == 3);
+    ASSERT(st.requests == 1);
+    return 1;
+}
+
+/*
+ * Test: Later sends reuse the same connection
+ */
+TEST(test_connection_reuse) {
+    ASSERT_INT_EQ(0, outbox_enqueue("d@example.com", "Code", "<p>444</p>"));
+    ASSERT(wait_for("SELECT COUNT(*) FROM outbox", 0));
+
+    ASSERT_INT_EQ(2, stub_requests);
+    ASSERT_INT_EQ(1, stub_connections);
+    return 1;
+}
+
+/*
+ * Test: A failed send is kept and rescheduled with backoff
+ */
+TEST(test_retry_backoff) {
+    reply_status = 503;
+    ASSERT_INT_EQ(0, outbox_enqueue("e@example.com", "Code", "<p>555</p>"));
+    ASSERT(wait_for("SELECT attempts FROM outbox", 1));
+
+    ASSERT_INT_EQ(1, query_int("SELECT COUNT(*) FROM outbox "
+                               "WHERE next_attempt_at > strftime('%s','now') "
+                               "AND last_error = 'HTTP 503'"));
+
+    OutboxStats st;
+    outbox_get_stats(&st);
+    ASSERT(st.retried == 1);
+    ASSERT(st.dropped == 0);
+    return 1;
+}
+
+/*
+ * Test: A rejected address is dropped, the rest of its batch is delivered
+ */
+TEST(test_reject_one) {
+    OutboxStats before, after;
+    sqlite3_exec(db_get(), "DELETE FROM outbox", NULL, NULL, NULL);
+    outbox_get_stats(&before);
+    int requests = stub_requests;
+    int accepted = stub_accepted;
+    reply_status = 200;
+    reject_recipient = "bad@example.com";
+
+    /* One transaction, so the sender claims all three together */
+    sqlite3_exec(db_get(), "BEGIN", NULL, NULL, NULL);
+    ASSERT_INT_EQ(0, outbox_enqueue("f@example.com", "Code", "<p>666</p>"));
+    ASSERT_INT_EQ(0, outbox_enqueue("bad@example.com", "Code", "<p>777</p>"));
+    ASSERT_INT_EQ(0, outbox_enqueue("g@example.com", "Code", "<p>888</p>"));
+    sqlite3_exec(db_get(), "COMMIT", NULL, NULL, NULL);
+    ASSERT(wait_for("SELECT COUNT(*) FROM outbox", 0));
+
+    /* The batch, then each message on its own; the 422 is not retried */
+    ASSERT_INT_EQ(4, stub_requests - requests);
+    ASSERT_INT_EQ(2, stub_accepted - accepted);
+    outbox_get_stats(&after);
+    ASSERT(after.sent - before.sent == 2);
+    ASSERT(after.dropped - before.dropped == 1);
+    ASSERT(after.retried == before.retried);
+    ASSERT(after.requests - before.requests == 4);
+
+    reject_recipient = NULL;
+    outbox_stop();
+    return 1;
+}
+
+/*
+ * Main: Run all outbox tests
+ */
+int main(void) {
+    printf("Email Outbox Tests\n");
+    printf("==================\n\n");
+
+    test_init();
+    setup();
+    start_stub();
+
+    RUN_TEST(test_enqueue);
+    RUN_TEST(test_batch_send);
+    RUN_TEST(test_connection_reuse);
+    RUN_TEST(test_retry_backoff);
+    RUN_TEST(test_reject_one);
+
+    db_close();
+    remove(TEST_DB);
+    return test_summary();
+}
@@ -0,0 +1,118 @@
+/*
+ * test_pagecache.c - Page Cache Tests
+ *
+ * Tests for the logged-out response cache: hits, generations and the
+ * entry and byte limits.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "pagecache.h"
+
+static const char *RESPONSE = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nhi";
+
+/*
+ * Test: A stored response is returned byte for byte
+ */
+TEST(test_store_and_hit) {
+    pagecache_generation("gen-1");
+    const void *data;
+    size_t len;
+    ASSERT(pagecache_lookup("/puzzle|w0|h0|gzip", &data, &len) == 0);
+
+    ASSERT_INT_EQ(0, pagecache_store("/puzzle|w0|h0|gzip", RESPONSE, strlen(RESPONSE)));
+    ASSERT(pagecache_lookup("/puzzle|w0|h0|gzip", &data, &len) == 1);
+    ASSERT(len == strlen(RESPONSE));
+    ASSERT(memcmp(data, RESPONSE, len) == 0);
+
+    /* Other variants are separate entries */
+    ASSERT(pagecache_lookup("/puzzle|w0|h0|identity", &data, &len) == 0);
+    ASSERT(pagecache_lookup("/puzzle|w1|h0|gzip", &data, &len) == 0);
+    return 1;
+}
+
+/*
+ * Test: A new generation drops every entry; the same one keeps them
+ */
+TEST(test_generation_flush) {
+    pagecache_generation("gen-1");
+    pagecache_store("/archive|w0|h0|gzip", RESPONSE, strlen(RESPONSE));
+
+    const void *data;
+    size_t len;
+    pagecache_generation("gen-1");
+    ASSERT(pagecache_lookup("/archive|w0|h0|gzip", &data, &len) == 1);
+
+    PageCacheStats before, after;
+    pagecache_get_stats(&before);
+    pagecache_generation("gen-2");
+    pagecache_get_stats(&after);
+    ASSERT(after.flushes == before.flushes + 1);
+    ASSERT(after.entries == 0);
+    ASSERT(after.bytes == 0);
+    ASSERT(pagecache_lookup("/archive|w0|h0|gzip", &data, &len) == 0);
+    return 1;
+}
+
+/*
+ * Test: Storing the same key again replaces the entry
+ */
+TEST(test_replace) {
+    pagecache_generation("gen-3");
+    pagecache_store("/", "first", 5);
+    pagecache_store("/", "second!", 7);
+
+    PageCacheStats st;
+    pagecache_get_stats(&st);
+    ASSERT(st.entries == 1);
+    ASSERT(st.bytes == 7);
+
+    const void *data;
+    size_t len;
+    ASSERT(pagecache_lookup("/", &data, &len) == 1);
+    ASSERT(len == 7 && memcmp(data, "second!", 7) == 0);
+    return 1;
+}
+
+/*
+ * Test: The oldest entries make room; oversized responses are refused
+ */
+TEST(test_limits) {
+    pagecache_generation("gen-4");
+    char key[32];
+    for (int i = 0; i < PAGECACHE_MAX_ENTRIES + 3; i++) {
+        snprintf(key, sizeof(key), "/archive/%d", i);
+        ASSERT_INT_EQ(0, pagecache_store(key, RESPONSE, strlen(RESPONSE)));
+    }
+
+    PageCacheStats st;
+    pagecache_get_stats(&st);
+    ASSERT(st.entries == PAGECACHE_MAX_ENTRIES);
+
+    const void *data;
+    size_t len;
+    ASSERT(pagecache_lookup("/archive/0", &data, &len) == 0);
+    ASSERT(pagecache_lookup("/archive/2", &data, &len) == 0);
+    ASSERT(pagecache_lookup("/archive/3", &data, &len) == 1);
+
+    static char big[PAGECACHE_MAX_RESPONSE + 1];
+    ASSERT_INT_EQ(-1, pagecache_store("/big", big, sizeof(big)));
+    ASSERT(pagecache_lookup("/big", &data, &len) == 0);
+    return 1;
+}
+
+int main(void) {
+    printf("Page Cache Tests\n");
+    printf("================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_store_and_hit);
+    RUN_TEST(test_generation_flush);
+    RUN_TEST(test_replace);
+    RUN_TEST(test_limits);
+
+    pagecache_flush();
+    return test_summary();
+}
@@ -379,11 +379,16 @@ TEST(test_submit_incorrect_guess) {
     /* Create another test user */
     sqlite3_exec(db, "INSERT OR IGNORE INTO users (id, email) VALUES (998, 'test2@test.com')", NULL, NULL, NULL);
 
+    unsigned long user_version = db_user_version(998);
+
     /* Submit wrong guess */
     int result = puzzle_submit_guess(998, puzzle_id, "wronganswer", NULL);
 
     ASSERT_INT_EQ(0, result);  /* 0 = incorrect */
 
+    /* Pages validated against this user's attempts must change */
+    ASSERT(db_user_version(998) != user_version);
+
     /* Verify attempt tracks incorrect guess */
     Attempt attempt;
     ASSERT_INT_EQ(0, puzzle_get_attempt(998, puzzle_id, &attempt));
@@ -0,0 +1,205 @@
+/*
+ * test_race.c - League Race Tests
+ *
+ * Tests for WebSocket races: the lobby, the simultaneous start, guesses
+ * and solves, and dropping a racer that stops reading.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "race.h"
+
+static const char *PUZZLE = "{\"id\":7,\"type\":\"text\",\"question\":\"Capital of France?\"}";
+
+static struct mg_connection conns[3];
+
+static void reset_conns(void) {
+    for (int i = 0; i < 3; i++) {
+        if (conns[i].is_websocket)
+            race_leave(&conns[i]);
+        mg_iobuf_free(&conns[i].send);
+        memset(&conns[i], 0, sizeof(conns[i]));
+        conns[i].is_websocket = 1;
+    }
+}
+
+/* Copies the payload of the text frame at *pos in c's send queue */
+static int next_frame(struct mg_connection *c, size_t *pos, char *out, size_t size) {
+    const unsigned char *p = c->send.buf + *pos;
+    while (*pos + 2 <= c->send.len && (p[0] & 0x0f) != WEBSOCKET_OP_TEXT) {
+        *pos += 2 + p[1];
+        p = c->send.buf + *pos;
+    }
+    if (*pos + 2 > c->send.len)
+        return 0;
+
+    size_t len = p[1], hdr = 2;
+    if (len == 126) {
+        len = (size_t)p[2] << 8 | p[3];
+        hdr = 4;
+    }
+    if (len >= size)
+        return 0;
+    memcpy(out, p + hdr, len);
+    out[len] = '\0';
+    *pos += hdr + len;
+    return 1;
+}
+
+/* The last text frame queued for c */
+static int last_frame(struct mg_connection *c, char *out, size_t size) {
+    size_t pos = 0;
+    int found = 0;
+    while (next_frame(c, &pos, out, size))
+        found = 1;
+    return found;
+}
+
+/*
+ * Test: A newcomer gets the lobby, everyone else a join event
+ */
+TEST(test_join_lobby) {
+    reset_conns();
+    ASSERT_INT_EQ(0, race_join(&conns[0], 1, 100, "Ada"));
+    ASSERT_INT_EQ(0, race_join(&conns[1], 1, 200, "Bob \"B\""));
+
+    char frame[1024];
+    size_t pos = 0;
+    ASSERT(next_frame(&conns[1], &pos, frame, sizeof(frame)));
+    ASSERT(strstr(frame, "\"type\":\"lobby\"") != NULL);
+    ASSERT(strstr(frame, "\"state\":\"lobby\"") != NULL);
+    ASSERT(strstr(frame, "\"name\":\"Ada\"") != NULL);
+    ASSERT(strstr(frame, "\"name\":\"Bob \\\"B\\\"\"") != NULL);
+
+    /* Join events are held until the flush */
+    size_t before = conns[0].send.len;
+    race_flush(1000);
+    ASSERT(conns[0].send.len > before);
+    ASSERT(last_frame(&conns[0], frame, sizeof(frame)));
+    ASSERT_STR_EQ("{\"type\":\"join\",\"id\":200,\"name\":\"Bob \\\"B\\\"\"}", frame);
+
+    RaceStats st;
+    race_get_stats(&st);
+    ASSERT(st.racers == 2);
+    ASSERT(st.races == 1);
+    return 1;
+}
+
+/*
+ * Test: After the countdown every racer is sent the same puzzle frame in
+ * one flush
+ */
+TEST(test_simultaneous_start) {
+    reset_conns();
+    race_join(&conns[0], 2, 100, "Ada");
+    race_join(&conns[1], 2, 200, "Bob");
+    race_join(&conns[2], 3, 300, "Cy");
+    race_flush(1000);
+
+    ASSERT_INT_EQ(0, race_start(&conns[0], 7, "paris", PUZZLE, 1000));
+    ASSERT_INT_EQ(-1, race_start(&conns[1], 7, "paris", PUZZLE, 1000));
+    ASSERT_INT_EQ(1000, race_poll_ms(1000, 1000));
+    ASSERT_INT_EQ(500, race_poll_ms(1000, 1000 + RACE_COUNTDOWN_MS - 500));
+
+    char frame[1024];
+    race_flush(1000);
+    ASSERT(last_frame(&conns[1], frame, sizeof(frame)));
+    ASSERT(strstr(frame, "\"type\":\"countdown\"") != NULL);
+    ASSERT_INT_EQ(-1, race_guess(&conns[0], "paris", 1500));
+
+    /* Nothing goes out until the countdown is over */
+    size_t len0 = conns[0].send.len, len1 = conns[1].send.len, len2 = conns[2].send.len;
+    race_flush(1000 + RACE_COUNTDOWN_MS - 1);
+    ASSERT(conns[0].send.len == len0);
+
+    race_flush(1000 + RACE_COUNTDOWN_MS);
+    size_t sent = conns[0].send.len - len0;
+    ASSERT(sent > 0);
+    ASSERT(conns[1].send.len - len1 == sent);
+    ASSERT(memcmp(conns[0].send.buf + len0, conns[1].send.buf + len1, sent) == 0);
+    ASSERT(conns[2].send.len == len2);
+
+    ASSERT(last_frame(&conns[0], frame, sizeof(frame)));
+    ASSERT(strncmp(frame, "{\"type\":\"start\",\"puzzle\":{\"id\":7,", 32) == 0);
+    ASSERT(strstr(frame, "paris") == NULL);
+    return 1;
+}
+
+/*
+ * Test: Wrong guesses and solves are broadcast; the last solve finishes
+ */
+TEST(test_guesses_and_finish) {
+    reset_conns();
+    race_join(&conns[0], 4, 100, "Ada");
+    race_join(&conns[1], 4, 200, "Bob");
+    race_start(&conns[0], 7, "paris", PUZZLE, 0);
+    race_flush(RACE_COUNTDOWN_MS);
+
+    char frame[1024];
+    ASSERT_INT_EQ(0, race_guess(&conns[1], "lyon", RACE_COUNTDOWN_MS + 2000));
+    race_flush(RACE_COUNTDOWN_MS + 2000);
+    ASSERT(last_frame(&conns[0], frame, sizeof(frame)));
+    ASSERT_STR_EQ("{\"type\":\"guess\",\"id\":200,\"guess\":\"lyon\",\"guesses\":1}", frame);
+
+    ASSERT_INT_EQ(1, race_guess(&conns[0], " Paris ", RACE_COUNTDOWN_MS + 5000));
+    ASSERT_INT_EQ(-1, race_guess(&conns[0], "paris", RACE_COUNTDOWN_MS + 5000));
+    race_flush(RACE_COUNTDOWN_MS + 5000);
+    ASSERT(last_frame(&conns[1], frame, sizeof(frame)));
+    ASSERT_STR_EQ("{\"type\":\"solve\",\"id\":100,\"place\":1,\"guesses\":0,\"ms\":5000}", frame);
+
+    ASSERT_INT_EQ(1, race_guess(&conns[1], "paris", RACE_COUNTDOWN_MS + 9000));
+    race_flush(RACE_COUNTDOWN_MS + 9000);
+    ASSERT(last_frame(&conns[0], frame, sizeof(frame)));
+    ASSERT(strncmp(frame, "{\"type\":\"finish\",\"puzzle_id\":7,\"answer\":\"paris\"", 47) == 0);
+    ASSERT(strstr(frame, "{\"id\":200,\"name\":\"Bob\",\"guesses\":1,\"place\":2}") != NULL);
+
+    /* Back in the lobby, ready for another */
+    ASSERT_INT_EQ(0, race_start(&conns[1], 8, "rome", PUZZLE, RACE_COUNTDOWN_MS + 9000));
+    return 1;
+}
+
+/*
+ * Test: A racer with too much unsent is dropped; leaving frees the race
+ */
+TEST(test_backlog_and_leave) {
+    reset_conns();
+    race_join(&conns[0], 5, 100, "Ada");
+    race_join(&conns[1], 5, 200, "Bob");
+
+    char pad[RACE_MAX_BACKLOG + 1] = {0};
+    mg_send(&conns[1], pad, sizeof(pad));
+    race_flush(1000);
+    ASSERT(conns[1].is_closing);
+    ASSERT(!conns[0].is_closing);
+
+    RaceStats st;
+    race_get_stats(&st);
+    ASSERT(st.overflows >= 1);
+
+    race_leave(&conns[1]);
+    race_leave(&conns[1]);
+    race_get_stats(&st);
+    ASSERT(st.racers == 1);
+
+    race_leave(&conns[0]);
+    race_get_stats(&st);
+    ASSERT(st.racers == 0);
+    ASSERT(st.races == 0);
+    return 1;
+}
+
+int main(void) {
+    printf("League Race Tests\n");
+    printf("=================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_join_lobby);
+    RUN_TEST(test_simultaneous_start);
+    RUN_TEST(test_guesses_and_finish);
+    RUN_TEST(test_backlog_and_leave);
+
+    reset_conns();
+    return test_summary();
+}
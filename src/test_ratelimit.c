@@ -0,0 +1,138 @@
+/*
+ * test_ratelimit.c - Rate Limiter Tests
+ *
+ * Tests for the token buckets: burst and refill, per-policy keys,
+ * eviction under a flood and restoring a handed-over table.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "ratelimit.h"
+
+/*
+ * Test: A burst is allowed, then one request per refill interval
+ */
+TEST(test_burst_and_refill) {
+    ratelimit_reset();
+    RateLimitRule rule;
+    ratelimit_get_rule(RATELIMIT_LOGIN, &rule);
+
+    uint64_t now = 1000000;
+    unsigned retry = 0;
+    for (unsigned i = 0; i < rule.burst; i++)
+        ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now, &retry));
+    ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now, &retry));
+    ASSERT(retry == (rule.refill_ms + 999) / 1000);
+
+    /* One token back after refill_ms, not before */
+    ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now + rule.refill_ms - 1, &retry));
+    ASSERT(retry == 1);
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now + rule.refill_ms, &retry));
+    ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now + rule.refill_ms, &retry));
+
+    /* A long pause refills to the burst and no further */
+    now += 100 * (uint64_t)rule.refill_ms;
+    for (unsigned i = 0; i < rule.burst; i++)
+        ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now, &retry));
+    ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_LOGIN, "10.0.0.1", now, &retry));
+    return 1;
+}
+
+/*
+ * Test: Buckets are separate per key and per policy
+ */
+TEST(test_keys_and_policies) {
+    ratelimit_reset();
+    RateLimitRule rule = { 1, 60000 };
+    RateLimitRule saved;
+    ratelimit_get_rule(RATELIMIT_JOIN, &saved);
+    ratelimit_configure(RATELIMIT_JOIN, &rule);
+
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_JOIN, "u:1", 5000, NULL));
+    ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_JOIN, "u:1", 5000, NULL));
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_JOIN, "u:2", 5000, NULL));
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_GUESS, "u:1", 5000, NULL));
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_NONE, "u:1", 5000, NULL));
+
+    RateLimitStats st;
+    ratelimit_get_stats(&st);
+    ASSERT(st.buckets == 3);
+
+    ratelimit_configure(RATELIMIT_JOIN, &saved);
+    return 1;
+}
+
+/*
+ * Test: A flood of new clients stays within the table and does not push
+ * out a client that keeps coming back
+ */
+TEST(test_flood_eviction) {
+    ratelimit_reset();
+    RateLimitRule rule;
+    ratelimit_get_rule(RATELIMIT_LOGIN, &rule);
+
+    uint64_t now = 1000000;
+    for (unsigned i = 0; i < rule.burst; i++)
+        ratelimit_take(RATELIMIT_LOGIN, "attacker", now, NULL);
+
+    RateLimitStats before;
+    ratelimit_get_stats(&before);
+
+    char ip[32];
+    for (int i = 0; i < 100000; i++) {
+        snprintf(ip, sizeof(ip), "10.%d.%d.%d", i >> 16, (i >> 8) & 255, i & 255);
+        ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_LOGIN, ip, now, NULL));
+        if (i % 1000 == 0)
+            ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_LOGIN, "attacker", now, NULL));
+    }
+
+    RateLimitStats after;
+    ratelimit_get_stats(&after);
+    ASSERT(after.buckets == RATELIMIT_MAX_BUCKETS);
+    ASSERT(after.evictions - before.evictions == 100001 - RATELIMIT_MAX_BUCKETS);
+    ASSERT_INT_EQ(0, ratelimit_take(RATELIMIT_LOGIN, "attacker", now, NULL));
+
+    /* The most recent newcomers were kept */
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_LOGIN, ip, now, NULL));
+    ratelimit_get_stats(&after);
+    ASSERT(after.buckets == RATELIMIT_MAX_BUCKETS);
+    return 1;
+}
+
+/*
+ * Test: A handed-over table keeps its buckets; a damaged one is reset
+ */
+TEST(test_restored_state) {
+    ratelimit_reset();
+    ASSERT_INT_EQ(1, ratelimit_take(RATELIMIT_JOIN, "u:9", 0, NULL));
+
+    size_t size;
+    unsigned char *state = ratelimit_state(&size);
+    ASSERT(size > RATELIMIT_MAX_BUCKETS * RATELIMIT_KEY_MAX);
+
+    ratelimit_restored();
+    RateLimitStats st;
+    ratelimit_get_stats(&st);
+    ASSERT(st.buckets == 1);
+
+    memset(state, 0xff, 16);
+    ratelimit_restored();
+    ratelimit_get_stats(&st);
+    ASSERT(st.buckets == 0);
+    return 1;
+}
+
+int main(void) {
+    printf("Rate Limiter Tests\n");
+    printf("==================\n\n");
+
+    test_init();
+
+    RUN_TEST(test_burst_and_refill);
+    RUN_TEST(test_keys_and_policies);
+    RUN_TEST(test_flood_eviction);
+    RUN_TEST(test_restored_state);
+
+    return test_summary();
+}
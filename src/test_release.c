@@ -0,0 +1,148 @@
+/*
+ * test_release.c - Release Tests
+ *
+ * Tests for the daily puzzle snapshot: rendering, preparing the next day
+ * before 09:00 UTC and switching to it at the boundary.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "test.h"
+#include "db.h"
+#include "puzzle.h"
+#include "release.h"
+
+#define TEST_DB "test_release.db"
+
+static time_t utc(int year, int month, int day, int hour, int min, int sec) {
+    struct tm tm = {0};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    return timegm(&tm);
+}
+
+static int add_puzzle(const char *date, const char *type, const char *name,
+                      const char *question) {
+    Puzzle p = {0};
+    snprintf(p.puzzle_date, sizeof(p.puzzle_date), "%s", date);
+    snprintf(p.puzzle_type, sizeof(p.puzzle_type), "%s", type);
+    snprintf(p.puzzle_name, sizeof(p.puzzle_name), "%s", name);
+    snprintf(p.question, sizeof(p.question), "%s", question);
+    snprintf(p.answer, sizeof(p.answer), "answer");
+    return puzzle_create(&p);
+}
+
+/*
+ * Test: The day rolls over at exactly 09:00 UTC
+ */
+TEST(test_next_release) {
+    char date[16];
+    puzzle_date_at(utc(2030, 5, 2, 8, 59, 59), date, sizeof(date));
+    ASSERT_STR_EQ("2030-05-01", date);
+    puzzle_date_at(utc(2030, 5, 2, 9, 0, 0), date, sizeof(date));
+    ASSERT_STR_EQ("2030-05-02", date);
+
+    ASSERT(puzzle_next_release(utc(2030, 5, 2, 8, 0, 0)) == utc(2030, 5, 2, 9, 0, 0));
+    ASSERT(puzzle_next_release(utc(2030, 5, 2, 9, 0, 0)) == utc(2030, 5, 3, 9, 0, 0));
+    return 1;
+}
+
+/*
+ * Test: Today's puzzle is rendered once, with escaping
+ */
+TEST(test_today_renders) {
+    release_invalidate();
+    const ReleaseDay *day = release_today(utc(2030, 5, 1, 12, 0, 0));
+    ASSERT(day->found);
+    ASSERT_STR_EQ("2030-05-01", day->date);
+    ASSERT_STR_EQ("Ladder", day->puzzle.puzzle_name);
+    ASSERT(day->number == 1);
+    ASSERT(strstr(day->question_html, "1. &lt;b&gt;") != NULL);
+    ASSERT(strstr(day->question_html, "2. ____") != NULL);
+    ASSERT(strstr(day->inputs_html, "name=\"step_0\"") != NULL);
+
+    ReleaseStats before, after;
+    release_get_stats(&before);
+    ASSERT(release_today(utc(2030, 5, 1, 13, 0, 0)) == day);
+    release_get_stats(&after);
+    ASSERT(after.cold_loads == before.cold_loads);
+    return 1;
+}
+
+/*
+ * Test: The next day is prepared shortly before 09:00 and served from 09:00
+ */
+TEST(test_prepared_switch) {
+    release_invalidate();
+    ReleaseStats before, after;
+    release_get_stats(&before);
+
+    release_tick(utc(2030, 5, 2, 8, 30, 0));
+    release_get_stats(&after);
+    ASSERT(after.prepared == before.prepared);
+
+    release_tick(utc(2030, 5, 2, 9, 0, 0) - RELEASE_PREPARE_SECS);
+    release_tick(utc(2030, 5, 2, 8, 59, 58));
+    release_get_stats(&after);
+    ASSERT(after.prepared == before.prepared + 1);
+
+    /* Still the old day until the boundary */
+    ASSERT_STR_EQ("2030-05-01", release_today(utc(2030, 5, 2, 8, 59, 59))->date);
+
+    const ReleaseDay *day = release_today(utc(2030, 5, 2, 9, 0, 0));
+    ASSERT_STR_EQ("2030-05-02", day->date);
+    ASSERT(day->found);
+    ASSERT(strstr(day->inputs_html, "value=\"b\"") != NULL);
+
+    release_get_stats(&after);
+    ASSERT(after.switches == before.switches + 1);
+    ASSERT(after.cold_loads == before.cold_loads + 1);  /* the 05-01 load */
+    return 1;
+}
+
+/*
+ * Test: A missing puzzle is served as such until invalidated
+ */
+TEST(test_missing_then_added) {
+    release_invalidate();
+    time_t now = utc(2030, 6, 1, 10, 0, 0);
+    ASSERT(release_today(now)->found == 0);
+
+    ASSERT_INT_EQ(0, add_puzzle("2030-06-01", "riddle", "Late", "What is late?"));
+    ASSERT(release_today(now + 1)->found == 0);
+
+    release_invalidate();
+    const ReleaseDay *day = release_today(now + 2);
+    ASSERT(day->found);
+    ASSERT_STR_EQ("Late", day->puzzle.puzzle_name);
+    return 1;
+}
+
+int main(void) {
+    printf("Release Tests\n");
+    printf("=============\n\n");
+
+    remove(TEST_DB);
+    if (db_init(TEST_DB) != 0) {
+        fprintf(stderr, "Failed to initialize test database\n");
+        return 1;
+    }
+    add_puzzle("2030-05-01", "ladder", "Ladder", "<b>, ____, Dark");
+    add_puzzle("2030-05-02", "choice", "Choice", "Pick one|a|b|c");
+
+    test_init();
+
+    RUN_TEST(test_next_release);
+    RUN_TEST(test_today_renders);
+    RUN_TEST(test_prepared_switch);
+    RUN_TEST(test_missing_then_added);
+
+    db_close();
+    remove(TEST_DB);
+    return test_summary();
+}
@@ -0,0 +1,152 @@
+/*
+ * test_template.c - Template Tests
+ *
+ * Tests for rendering compiled templates into iovec lists.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "template.h"
+#include "templates_data.h"
+
+enum { SLOT_NAME, SLOT_COUNT, SLOT_BODY, SLOTS };
+
+static const TemplatePart parts[] = {
+    { TPL_PART_TEXT, "<h1>", 4, 0 },
+    { TPL_PART_HTML, NULL, 0, SLOT_NAME },
+    { TPL_PART_TEXT, "</h1><p>", 8, 0 },
+    { TPL_PART_INT, NULL, 0, SLOT_COUNT },
+    { TPL_PART_TEXT, " left</p>", 9, 0 },
+    { TPL_PART_RAW, NULL, 0, SLOT_BODY },
+};
+static const Template TEST_TPL = { "test", parts, 6, SLOTS };
+
+static TemplateRender r;
+
+/* Joins the iovec list into out */
+static size_t gather(const TemplateRender *tr, char *out, size_t size) {
+    size_t len = 0;
+    for (int i = 0; i < tr->iovcnt && len + tr->iov[i].iov_len < size; i++) {
+        memcpy(out + len, tr->iov[i].iov_base, tr->iov[i].iov_len);
+        len += tr->iov[i].iov_len;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/*
+ * Test: Holes are filled by type
+ */
+TEST(test_render_types) {
+    tpl_begin(&r, &TEST_TPL);
+    tpl_set_str(&r, SLOT_NAME, "Tom & Jerry");
+    tpl_set_int(&r, SLOT_COUNT, -42);
+    tpl_set_str(&r, SLOT_BODY, "<b>raw</b>");
+    ASSERT_INT_EQ(0, tpl_render(&r));
+
+    char out[256];
+    size_t len = gather(&r, out, sizeof(out));
+    ASSERT_STR_EQ("<h1>Tom &amp; Jerry</h1><p>-42 left</p><b>raw</b>", out);
+    ASSERT(len == r.total);
+    return 1;
+}
+
+/*
+ * Test: Constant segments are referenced, not copied
+ */
+TEST(test_constants_not_copied) {
+    tpl_begin(&r, &TEST_TPL);
+    tpl_set_str(&r, SLOT_NAME, "x");
+    tpl_set_int(&r, SLOT_COUNT, 1);
+    tpl_set_str(&r, SLOT_BODY, "");
+    ASSERT_INT_EQ(0, tpl_render(&r));
+
+    /* The empty raw hole adds no entry */
+    ASSERT_INT_EQ(5, r.iovcnt);
+    ASSERT(r.iov[0].iov_base == (void *)parts[0].text);
+    ASSERT(r.iov[2].iov_base == (void *)parts[2].text);
+    return 1;
+}
+
+/*
+ * Test: Unset and mistyped holes fail the render
+ */
+TEST(test_render_errors) {
+    tpl_begin(&r, &TEST_TPL);
+    tpl_set_str(&r, SLOT_NAME, "x");
+    tpl_set_str(&r, SLOT_BODY, "");
+    ASSERT_INT_EQ(-1, tpl_render(&r));
+
+    tpl_set_str(&r, SLOT_COUNT, "1");
+    ASSERT_INT_EQ(-1, tpl_render(&r));
+
+    tpl_begin(&r, &TEST_TPL);
+    tpl_set_int(&r, SLOT_NAME, 1);
+    tpl_set_int(&r, SLOT_COUNT, 1);
+    tpl_set_str(&r, SLOT_BODY, "");
+    ASSERT_INT_EQ(-1, tpl_render(&r));
+    return 1;
+}
+
+/*
+ * Test: A template from templates/ compiles and renders
+ */
+TEST(test_compiled_template) {
+    tpl_begin(&r, &TPL_HOME);
+    tpl_set_str(&r, TPL_HOME_CSS, "<link rel=\"stylesheet\" href=\"/x.css\">");
+    ASSERT_INT_EQ(0, tpl_render(&r));
+
+    char out[4096];
+    gather(&r, out, sizeof(out));
+    const char *head = "<!DOCTYPE html>\n<html><head><title>Puzzle Pause</title>"
+                       "<link rel=\"stylesheet\" href=\"/x.css\"></head>";
+    ASSERT(strncmp(out, head, strlen(head)) == 0);
+    ASSERT(strstr(out, "every day at 09:00 UTC.") != NULL);
+    ASSERT(strcmp(out + strlen(out) - 15, "</body></html>\n") == 0);
+    return 1;
+}
+
+/*
+ * Test: An escaped hole that does not fit fails instead of rendering cut short
+ */
+TEST(test_escape_overflow) {
+    static const TemplatePart hole[] = { { TPL_PART_HTML, NULL, 0, 0 } };
+    static const Template NAME_TPL = { "name", hole, 1, 1 };
+    static char name[TPL_SCRATCH];
+
+    /* "&amp;" lands exactly at the end, leaving room for the NUL */
+    memset(name, 'a', TPL_SCRATCH - 6);
+    strcpy(name + TPL_SCRATCH - 6, "&");
+    tpl_begin(&r, &NAME_TPL);
+    tpl_set_str(&r, 0, name);
+    ASSERT_INT_EQ(0, tpl_render(&r));
+    ASSERT(r.total == TPL_SCRATCH - 1);
+    ASSERT(memcmp(r.scratch + TPL_SCRATCH - 6, "&amp;", 5) == 0);
+
+    /* One more byte and the entity no longer fits */
+    memset(name, 'a', TPL_SCRATCH - 5);
+    strcpy(name + TPL_SCRATCH - 5, "&");
+    ASSERT_INT_EQ(-1, tpl_render(&r));
+
+    /* Nor does the NUL after a plain string that fills the scratch */
+    memset(name, 'a', TPL_SCRATCH - 1);
+    name[TPL_SCRATCH - 1] = '\0';
+    ASSERT_INT_EQ(-1, tpl_render(&r));
+    return 1;
+}
+
+int main(void) {
+    printf("Template Tests\n");
+    printf("==============\n\n");
+
+    test_init();
+
+    RUN_TEST(test_render_types);
+    RUN_TEST(test_constants_not_copied);
+    RUN_TEST(test_render_errors);
+    RUN_TEST(test_compiled_template);
+    RUN_TEST(test_escape_overflow);
+
+    return test_summary();
+}
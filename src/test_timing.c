@@ -0,0 +1,141 @@
+/*
+ * test_timing.c - Request Timing Tests
+ *
+ * Tests for the per-request phase timers and the Server-Timing header.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "test.h"
+#include "timing.h"
+
+static sqlite3 *db;
+
+static void spin(double seconds) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 < seconds);
+}
+
+/* A query slow enough to measure: sums 0..n-1 */
+static void run_query(void) {
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_prepare_v2(db,
+        "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n WHERE i < 200000) "
+        "SELECT SUM(i) FROM n", -1, &stmt, NULL);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        ;
+    sqlite3_finalize(stmt);
+}
+
+/*
+ * Test: Phases add up to the total and CPU time is measured
+ */
+TEST(test_phases_sum_to_total) {
+    RequestTiming t;
+    timing_begin();
+    spin(0.002);
+    TimingPhase prev = timing_enter(TIMING_WRITE);
+    spin(0.002);
+    timing_enter(prev);
+    timing_end(&t);
+
+    ASSERT_INT_EQ(TIMING_RENDER, prev);
+    ASSERT(t.phase[TIMING_RENDER] >= 0.002);
+    ASSERT(t.phase[TIMING_WRITE] >= 0.002);
+    ASSERT(t.phase[TIMING_AUTH] == 0 && t.phase[TIMING_DB] == 0);
+
+    double sum = 0;
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++)
+        sum += t.phase[i];
+    ASSERT(sum > t.total - 1e-9 && sum < t.total + 1e-9);
+    ASSERT(t.cpu > 0.003);      /* spinning burns CPU */
+    return 1;
+}
+
+/*
+ * Test: Statements run by the handler are counted as db
+ */
+TEST(test_statements_count_as_db) {
+    RequestTiming t;
+    timing_begin();
+    run_query();
+    timing_end(&t);
+
+    ASSERT(t.phase[TIMING_DB] > 0);
+    ASSERT(t.phase[TIMING_DB] > t.phase[TIMING_RENDER]);
+    return 1;
+}
+
+/*
+ * Test: Queries during the session lookup stay in auth
+ */
+TEST(test_auth_keeps_its_queries) {
+    RequestTiming t;
+    timing_begin();
+    TimingPhase prev = timing_enter(TIMING_AUTH);
+    run_query();
+    timing_enter(prev);
+    timing_end(&t);
+
+    ASSERT(t.phase[TIMING_AUTH] > 0);
+    ASSERT(t.phase[TIMING_DB] == 0);
+    return 1;
+}
+
+/*
+ * Test: Statements outside a request are ignored
+ */
+TEST(test_outside_request) {
+    RequestTiming t;
+    run_query();
+    timing_begin();
+    timing_end(&t);
+
+    ASSERT(t.phase[TIMING_DB] == 0);
+    ASSERT_INT_EQ(TIMING_RENDER, timing_enter(TIMING_DB));
+    return 1;
+}
+
+/*
+ * Test: Server-Timing header lists every phase in milliseconds
+ */
+TEST(test_header) {
+    RequestTiming t = { { 0.0001, 0.0025, 0.001, 0.0005 }, 0.0041, 0.003 };
+    char buf[256];
+    int n = timing_header(&t, buf, sizeof(buf));
+
+    ASSERT_STR_EQ("Server-Timing: auth;dur=0.100, db;dur=2.500, render;dur=1.000, "
+                  "write;dur=0.500, cpu;dur=3.000, total;dur=4.100\r\n", buf);
+    ASSERT_INT_EQ((int)strlen(buf), n);
+    ASSERT_INT_EQ(-1, timing_header(&t, buf, 40));
+    return 1;
+}
+
+/*
+ * Main: Run all timing tests
+ */
+int main(void) {
+    printf("Request Timing Tests\n");
+    printf("====================\n\n");
+
+    test_init();
+
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+        printf("Failed to open database\n");
+        return 1;
+    }
+    timing_attach(db);
+
+    RUN_TEST(test_phases_sum_to_total);
+    RUN_TEST(test_statements_count_as_db);
+    RUN_TEST(test_auth_keeps_its_queries);
+    RUN_TEST(test_outside_request);
+    RUN_TEST(test_header);
+
+    sqlite3_close(db);
+    return test_summary();
+}
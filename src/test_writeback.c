@@ -0,0 +1,154 @@
+/*
+ * test_writeback.c - Write-Behind Tests
+ *
+ * Tests for deferred writes: coalescing per key, one transaction per
+ * flush, the flush interval, and flushing early when the queue fills.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "db.h"
+#include "writeback.h"
+#include "sqlite3.h"
+
+#define TEST_DB "test_writeback.db"
+
+static int query_int(const char *sql) {
+    sqlite3_stmt *stmt;
+    int value = -1;
+    if (sqlite3_prepare_v2(db_get(), sql, -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+/* Unix time of the session's expiry, as stored */
+static int stored_expiry(const char *token) {
+    char sql[256];
+    snprintf(sql, sizeof(sql),
+             "SELECT CAST(strftime('%%s', expires_at) AS INTEGER) FROM sessions WHERE token = '%s'",
+             token);
+    return query_int(sql);
+}
+
+static void setup(void) {
+    remove(TEST_DB);
+    db_init(TEST_DB);
+    sqlite3_exec(db_get(),
+        "INSERT INTO users (id, email) VALUES (1, 'a@example.com');"
+        "INSERT INTO sessions (user_id, token, expires_at) VALUES "
+        "(1, 'tok-a', datetime(1000000000, 'unixepoch')),"
+        "(1, 'tok-b', datetime(1000000000, 'unixepoch'));",
+        NULL, NULL, NULL);
+}
+
+/*
+ * Test: Repeated values for a key coalesce, the last one wins
+ */
+TEST(test_coalesce) {
+    WritebackStats st;
+    int64_t value = 0;
+
+    ASSERT_INT_EQ(0, writeback_pending(WRITEBACK_SESSION_EXPIRY, "tok-a", &value));
+    ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, "tok-a", 1100000000));
+    ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, "tok-a", 1200000000));
+    ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, "tok-a", 1300000000));
+
+    ASSERT_INT_EQ(1, writeback_pending(WRITEBACK_SESSION_EXPIRY, "tok-a", &value));
+    ASSERT(value == 1300000000);
+    writeback_get_stats(&st);
+    ASSERT_INT_EQ(1, (int)st.pending);
+    ASSERT_INT_EQ(2, (int)st.coalesced);
+
+    /* Nothing reaches the database until a flush */
+    ASSERT_INT_EQ(1000000000, stored_expiry("tok-a"));
+    return 1;
+}
+
+/*
+ * Test: A flush writes every pending value and empties the queue
+ */
+TEST(test_flush) {
+    WritebackStats st;
+    int64_t value;
+
+    ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, "tok-b", 1400000000));
+    ASSERT_INT_EQ(2, writeback_flush());
+
+    ASSERT_INT_EQ(1300000000, stored_expiry("tok-a"));
+    ASSERT_INT_EQ(1400000000, stored_expiry("tok-b"));
+    ASSERT_INT_EQ(0, writeback_pending(WRITEBACK_SESSION_EXPIRY, "tok-a", &value));
+    writeback_get_stats(&st);
+    ASSERT_INT_EQ(0, (int)st.pending);
+    ASSERT_INT_EQ(2, (int)st.written);
+    ASSERT_INT_EQ(1, (int)st.flushes);
+
+    /* An empty queue costs no transaction */
+    ASSERT_INT_EQ(0, writeback_flush());
+    writeback_get_stats(&st);
+    ASSERT_INT_EQ(1, (int)st.flushes);
+    return 1;
+}
+
+/*
+ * Test: Ticks flush only once the interval has passed
+ */
+TEST(test_tick_interval) {
+    long now = 2000000000;
+    writeback_tick(now);
+
+    ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, "tok-a", 1500000000));
+    writeback_tick(now + WRITEBACK_INTERVAL_SECS - 1);
+    ASSERT_INT_EQ(1300000000, stored_expiry("tok-a"));
+
+    writeback_tick(now + WRITEBACK_INTERVAL_SECS);
+    ASSERT_INT_EQ(1500000000, stored_expiry("tok-a"));
+    return 1;
+}
+
+/*
+ * Test: A full queue flushes early instead of dropping values
+ */
+TEST(test_full_queue) {
+    WritebackStats before, after;
+    char key[32];
+
+    writeback_get_stats(&before);
+    for (int i = 0; i < WRITEBACK_MAX_PENDING; i++) {
+        snprintf(key, sizeof(key), "tok-%d", i);
+        ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, key, i));
+    }
+    ASSERT_INT_EQ(0, writeback_set(WRITEBACK_SESSION_EXPIRY, "tok-b", 1600000000));
+
+    writeback_get_stats(&after);
+    ASSERT_INT_EQ(1, (int)after.pending);
+    ASSERT_INT_EQ(1, (int)(after.flushes - before.flushes));
+    ASSERT_INT_EQ(0, (int)after.dropped);
+
+    ASSERT_INT_EQ(1, writeback_flush());
+    ASSERT_INT_EQ(1600000000, stored_expiry("tok-b"));
+    return 1;
+}
+
+/*
+ * Main entry point
+ */
+int main(void) {
+    printf("Write-Behind Tests\n");
+    printf("==================\n\n");
+
+    test_init();
+    setup();
+
+    RUN_TEST(test_coalesce);
+    RUN_TEST(test_flush);
+    RUN_TEST(test_tick_interval);
+    RUN_TEST(test_full_queue);
+
+    db_close();
+    remove(TEST_DB);
+    return test_summary();
+}
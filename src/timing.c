@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <time.h>
+#include "timing.h"
+
+static const char *PHASE_NAMES[TIMING_PHASE_COUNT] = { "auth", "db", "render", "write" };
+
+static struct {
+    int active;
+    TimingPhase phase;
+    double entered;         /* when the current phase began */
+    double started;
+    double cpu_started;
+    int statements;         /* running statements */
+    double acc[TIMING_PHASE_COUNT];
+} req;
+
+static double clock_seconds(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* A statement runs from its first step until it returns SQLITE_DONE, an
+   error, or is reset. Queries inside the session lookup stay in auth. */
+static int on_trace(unsigned type, void *ctx, void *p, void *x) {
+    const char *sql = (const char *)x;
+    (void)ctx;
+    (void)p;
+    if (!req.active)
+        return 0;
+
+    if (type == SQLITE_TRACE_STMT) {
+        /* Trigger bodies are reported as comments and never finish */
+        if (sql != NULL && sql[0] == '-' && sql[1] == '-')
+            return 0;
+        if (req.statements++ == 0 && req.phase == TIMING_RENDER)
+            timing_enter(TIMING_DB);
+    } else if (type == SQLITE_TRACE_PROFILE && req.statements > 0) {
+        if (--req.statements == 0 && req.phase == TIMING_DB)
+            timing_enter(TIMING_RENDER);
+    }
+    return 0;
+}
+
+void timing_attach(sqlite3 *db) {
+    sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, on_trace, NULL);
+}
+
+void timing_begin(void) {
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++)
+        req.acc[i] = 0;
+    req.active = 1;
+    req.phase = TIMING_RENDER;
+    req.statements = 0;
+    req.started = req.entered = clock_seconds(CLOCK_MONOTONIC);
+    req.cpu_started = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+}
+
+TimingPhase timing_enter(TimingPhase phase) {
+    TimingPhase prev = req.phase;
+    if (!req.active || phase == prev)
+        return prev;
+
+    double now = clock_seconds(CLOCK_MONOTONIC);
+    req.acc[prev] += now - req.entered;
+    req.entered = now;
+    req.phase = phase;
+    return prev;
+}
+
+void timing_end(RequestTiming *out) {
+    double now = clock_seconds(CLOCK_MONOTONIC);
+    req.acc[req.phase] += now - req.entered;
+    req.active = 0;
+
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++)
+        out->phase[i] = req.acc[i];
+    out->total = now - req.started;
+    out->cpu = clock_seconds(CLOCK_THREAD_CPUTIME_ID) - req.cpu_started;
+}
+
+const char *timing_phase_name(TimingPhase phase) {
+    return (unsigned)phase < TIMING_PHASE_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
+
+int timing_header(const RequestTiming *t, char *buf, size_t size) {
+    int n = snprintf(buf, size, "Server-Timing: ");
+    for (int i = 0; i < TIMING_PHASE_COUNT && n >= 0 && (size_t)n < size; i++)
+        n += snprintf(buf + n, size - n, "%s;dur=%.3f, ", PHASE_NAMES[i], t->phase[i] * 1e3);
+    if (n >= 0 && (size_t)n < size)
+        n += snprintf(buf + n, size - n, "cpu;dur=%.3f, total;dur=%.3f\r\n",
+                      t->cpu * 1e3, t->total * 1e3);
+    return n >= 0 && (size_t)n < size ? n : -1;
+}
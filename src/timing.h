@@ -0,0 +1,44 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stddef.h>
+#include "sqlite3.h"
+
+/* Per-request phase timers. A request is in exactly one phase at a time,
+   so a switch costs one clock read and the phases add up to the total.
+   Statements the handler runs are moved into TIMING_DB automatically;
+   the rest of its work counts as rendering. */
+
+typedef enum {
+    TIMING_AUTH,        /* session lookup, its query included */
+    TIMING_DB,
+    TIMING_RENDER,
+    TIMING_WRITE,       /* compressing and queueing the response */
+    TIMING_PHASE_COUNT
+} TimingPhase;
+
+typedef struct {
+    double phase[TIMING_PHASE_COUNT];   /* seconds */
+    double total;
+    double cpu;                         /* thread CPU time */
+} RequestTiming;
+
+/* Attributes statements on db to TIMING_DB. Only for the event loop's
+   connection: the timers are not thread safe. */
+void timing_attach(sqlite3 *db);
+
+/* Starts a request in TIMING_RENDER */
+void timing_begin(void);
+
+/* Switches phase and returns the previous one, for the caller to restore */
+TimingPhase timing_enter(TimingPhase phase);
+
+void timing_end(RequestTiming *out);
+
+const char *timing_phase_name(TimingPhase phase);
+
+/* Formats a Server-Timing header, CRLF included, durations in ms.
+   Returns its length, or -1 if buf is too small. */
+int timing_header(const RequestTiming *t, char *buf, size_t size);
+
+#endif /* TIMING_H */
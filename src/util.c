@@ -1,23 +1,135 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
+#include <sys/random.h>
 #include "util.h"
 
-int generate_random_bytes(unsigned char *buf, size_t len) {
-    if (buf == NULL || len == 0)
-        return -1;
+/* Random bytes come from a ChaCha20 keystream per thread, keyed from
+   getrandom(2). Each refill makes RANDOM_BLOCKS blocks, takes the first
+   32 bytes as the next key and hands out the rest, wiping what it hands
+   out, so a later memory read cannot recover earlier output. A fork gets
+   a new key before its first read. */
+#define RANDOM_BLOCKS 16
+
+typedef struct {
+    uint32_t key[8];
+    unsigned char buf[RANDOM_BLOCKS * 64];
+    size_t left;                /* unread bytes at the end of buf */
+    unsigned generation;        /* fork_generation when keyed, 0: never */
+} RandomPool;
+
+static __thread RandomPool pool;
+static unsigned fork_generation = 1;
+static pthread_once_t fork_hook_once = PTHREAD_ONCE_INIT;
+
+static void on_fork_child(void) {
+    fork_generation++;
+}
+
+static void install_fork_hook(void) {
+    pthread_atfork(NULL, NULL, on_fork_child);
+}
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define QR(a, b, c, d) \
+    a += b; d ^= a; d = ROTL(d, 16); c += d; b ^= c; b = ROTL(b, 12); \
+    a += b; d ^= a; d = ROTL(d, 8);  c += d; b ^= c; b = ROTL(b, 7)
+
+/* RFC 8439 block function, little-endian output */
+static void chacha20_block(const uint32_t key[8], uint32_t counter, unsigned char out[64]) {
+    uint32_t in[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        counter, 0, 0, 0,
+    };
+    uint32_t x[16];
+    memcpy(x, in, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QR(x[0], x[4], x[8], x[12]);
+        QR(x[1], x[5], x[9], x[13]);
+        QR(x[2], x[6], x[10], x[14]);
+        QR(x[3], x[7], x[11], x[15]);
+        QR(x[0], x[5], x[10], x[15]);
+        QR(x[1], x[6], x[11], x[12]);
+        QR(x[2], x[7], x[8], x[13]);
+        QR(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++) {
+        uint32_t v = x[i] + in[i];
+        out[i * 4] = (unsigned char)v;
+        out[i * 4 + 1] = (unsigned char)(v >> 8);
+        out[i * 4 + 2] = (unsigned char)(v >> 16);
+        out[i * 4 + 3] = (unsigned char)(v >> 24);
+    }
+}
+
+/* getrandom(2), or /dev/urandom on a kernel without it */
+static int os_random(void *buf, size_t len) {
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        p += n;
+        len -= (size_t)n;
+    }
+    if (len == 0)
+        return 0;
 
     FILE *f = fopen("/dev/urandom", "rb");
     if (f == NULL)
         return -1;
-
-    size_t read = fread(buf, 1, len, f);
+    size_t read = fread(p, 1, len, f);
     fclose(f);
-
     return (read == len) ? 0 : -1;
 }
 
+static int pool_refill(void) {
+    if (pool.generation != fork_generation) {
+        pthread_once(&fork_hook_once, install_fork_hook);
+        if (os_random(pool.key, sizeof(pool.key)) != 0)
+            return -1;
+        pool.generation = fork_generation;
+    }
+    for (uint32_t i = 0; i < RANDOM_BLOCKS; i++)
+        chacha20_block(pool.key, i, pool.buf + i * 64);
+    memcpy(pool.key, pool.buf, sizeof(pool.key));
+    memset(pool.buf, 0, sizeof(pool.key));
+    pool.left = sizeof(pool.buf) - sizeof(pool.key);
+    return 0;
+}
+
+int generate_random_bytes(unsigned char *buf, size_t len) {
+    if (buf == NULL || len == 0)
+        return -1;
+
+    /* A fork leaves the parent's bytes behind; they are not used */
+    if (pool.generation != fork_generation)
+        pool.left = 0;
+
+    while (len > 0) {
+        if (pool.left == 0 && pool_refill() != 0)
+            return -1;
+        size_t n = len < pool.left ? len : pool.left;
+        unsigned char *src = pool.buf + sizeof(pool.buf) - pool.left;
+        memcpy(buf, src, n);
+        memset(src, 0, n);
+        pool.left -= n;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
 int generate_token_hex(char *out, size_t out_size, size_t byte_len) {
+    static const char HEX[] = "0123456789abcdef";
+
     if (out == NULL || out_size < byte_len * 2 + 1)
         return -1;
 
@@ -28,10 +140,12 @@ int generate_token_hex(char *out, size_t out_size, size_t byte_len) {
     if (generate_random_bytes(bytes, byte_len) != 0)
         return -1;
 
-    for (size_t i = 0; i < byte_len; i++)
-        sprintf(out + (i * 2), "%02x", bytes[i]);
-
+    for (size_t i = 0; i < byte_len; i++) {
+        out[i * 2] = HEX[bytes[i] >> 4];
+        out[i * 2 + 1] = HEX[bytes[i] & 15];
+    }
     out[byte_len * 2] = '\0';
+    memset(bytes, 0, byte_len);
     return 0;
 }
 
@@ -49,11 +163,12 @@ void format_datetime(char *out, size_t out_size, long timestamp) {
 }
 
 size_t html_escape(const char *src, char *dst, size_t dst_size) {
-    if (!dst || dst_size == 0) return 0;
-    if (!src) { dst[0] = '\0'; return 0; }
+    if (!dst) dst_size = 0;
 
-    size_t j = 0;
-    for (size_t i = 0; src[i] && j < dst_size - 1; i++) {
+    /* Once an entity does not fit nothing more is written, but the
+       length keeps counting */
+    size_t j = 0, need = 0;
+    for (size_t i = 0; src && src[i]; i++) {
         const char *esc;
         size_t elen;
         switch (src[i]) {
@@ -62,38 +177,155 @@ size_t html_escape(const char *src, char *dst, size_t dst_size) {
             case '>': esc = "&gt;";   elen = 4; break;
             case '"': esc = "&quot;"; elen = 6; break;
             case '\'': esc = "&#39;"; elen = 5; break;
-            default: esc = NULL; elen = 0; break;
+            default: esc = &src[i]; elen = 1; break;
         }
-        if (esc) {
-            if (j + elen >= dst_size) break;
+        if (j == need && need + elen < dst_size) {
             memcpy(dst + j, esc, elen);
             j += elen;
-        } else {
-            dst[j++] = src[i];
         }
+        need += elen;
     }
-    dst[j] = '\0';
-    return j;
+    if (dst_size > 0)
+        dst[j] = '\0';
+    return need;
 }
 
 size_t json_escape(const char *src, char *dst, size_t dst_size) {
-    if (!dst || dst_size == 0) return 0;
-    if (!src) { dst[0] = '\0'; return 0; }
+    static const char HEX[] = "0123456789abcdef";
+    if (!dst) dst_size = 0;
 
-    size_t j = 0;
-    for (size_t i = 0; src[i] && j < dst_size - 1; i++) {
+    size_t j = 0, need = 0;
+    for (size_t i = 0; src && src[i]; i++) {
         unsigned char ch = (unsigned char)src[i];
+        char esc[6];
+        size_t elen;
         if (ch == '"' || ch == '\\') {
-            if (j + 2 >= dst_size) break;
-            dst[j++] = '\\';
-            dst[j++] = (char)ch;
+            esc[0] = '\\';
+            esc[1] = (char)ch;
+            elen = 2;
         } else if (ch < 0x20) {
-            if (j + 6 >= dst_size) break;
-            j += (size_t)snprintf(dst + j, dst_size - j, "\\u%04x", ch);
+            memcpy(esc, "\\u00", 4);
+            esc[4] = HEX[ch >> 4];
+            esc[5] = HEX[ch & 0xf];
+            elen = 6;
         } else {
-            dst[j++] = (char)ch;
+            esc[0] = (char)ch;
+            elen = 1;
         }
+        if (j == need && need + elen < dst_size) {
+            memcpy(dst + j, esc, elen);
+            j += elen;
+        }
+        need += elen;
+    }
+    if (dst_size > 0)
+        dst[j] = '\0';
+    return need;
+}
+
+int accepts_encoding(const char *header, size_t header_len, const char *coding) {
+    if (header == NULL || coding == NULL)
+        return 0;
+
+    size_t coding_len = strlen(coding);
+    const char *p = header;
+    const char *end = header + header_len;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ',')) p++;
+
+        const char *tok = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ') p++;
+        size_t tok_len = (size_t)(p - tok);
+
+        /* Parameters: only an explicit q=0 matters */
+        int refused = 0;
+        while (p < end && *p != ',') {
+            if (*p == 'q' && p + 1 < end && p[1] == '=') {
+                const char *q = p + 2;
+                refused = 1;
+                while (q < end && *q != ',' && *q != ';') {
+                    if (*q >= '1' && *q <= '9') refused = 0;
+                    q++;
+                }
+            }
+            p++;
+        }
+
+        if (tok_len == coding_len && strncasecmp(tok, coding, coding_len) == 0)
+            return !refused;
     }
-    dst[j] = '\0';
-    return j;
+
+    return 0;
+}
+
+int etag_matches(const char *header, size_t header_len, const char *etag) {
+    if (header == NULL || etag == NULL)
+        return 0;
+
+    size_t etag_len = strlen(etag);
+    const char *p = header;
+    const char *end = header + header_len;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ',')) p++;
+        if (p >= end)
+            break;
+
+        if (*p == '*')
+            return 1;
+
+        /* If-None-Match uses weak comparison */
+        if (end - p > 2 && p[0] == 'W' && p[1] == '/')
+            p += 2;
+
+        const char *tok = p;
+        while (p < end && *p != ',' && *p != ' ') p++;
+
+        if ((size_t)(p - tok) == etag_len && memcmp(tok, etag, etag_len) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+int cookie_value(const char *header, size_t header_len, const char *name,
+                 char *out, size_t out_size) {
+    if (header == NULL || name == NULL || out_size == 0)
+        return 0;
+
+    size_t name_len = strlen(name);
+    const char *p = header;
+    const char *end = header + header_len;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ';')) p++;
+
+        if ((size_t)(end - p) > name_len && memcmp(p, name, name_len) == 0 &&
+            p[name_len] == '=') {
+            p += name_len + 1;
+            const char *value_start = p;
+            while (p < end && *p != ';' && *p != ' ') p++;
+            size_t value_len = (size_t)(p - value_start);
+
+            if (value_len >= out_size)
+                value_len = out_size - 1;
+
+            memcpy(out, value_start, value_len);
+            out[value_len] = '\0';
+            return 1;
+        }
+
+        while (p < end && *p != ';') p++;
+    }
+
+    return 0;
+}
+
+int secret_equal(const void *given, size_t given_len, const void *secret, size_t secret_len) {
+    const unsigned char *a = given, *b = secret;
+    unsigned diff = given_len != secret_len;
+    for (size_t i = 0; i < secret_len; i++)
+        diff |= (i < given_len ? a[i] : 0u) ^ b[i];
+    return diff == 0;
 }
@@ -7,7 +7,26 @@ int generate_random_bytes(unsigned char *buf, size_t len);
 int generate_token_hex(char *out, size_t out_size, size_t byte_len);
 long get_current_time(void);
 void format_datetime(char *out, size_t out_size, long timestamp);
+
+/* Both escape src into dst like snprintf: always terminated, never
+   splitting an escape, and returning the length the whole result needs,
+   so a return of dst_size or more means dst holds a cut-short prefix */
 size_t html_escape(const char *src, char *dst, size_t dst_size);
 size_t json_escape(const char *src, char *dst, size_t dst_size);
 
+/* Returns 1 if an Accept-Encoding header value allows coding (q=0 refuses) */
+int accepts_encoding(const char *header, size_t header_len, const char *coding);
+
+/* Returns 1 if an If-None-Match header value lists etag (quotes included) or * */
+int etag_matches(const char *header, size_t header_len, const char *etag);
+
+/* Returns 1 if a Cookie header value has a cookie called name, copying
+   its value (truncated to fit) into out */
+int cookie_value(const char *header, size_t header_len, const char *name,
+                 char *out, size_t out_size);
+
+/* Returns 1 if given matches secret. Every byte of the secret is
+   compared whatever differs, so the time says nothing about a guess. */
+int secret_equal(const void *given, size_t given_len, const void *secret, size_t secret_len);
+
 #endif /* UTIL_H */
@@ -0,0 +1,144 @@
+#include <string.h>
+#include "writeback.h"
+#include "db.h"
+#include "sqlite3.h"
+
+#define INDEX_SLOTS (WRITEBACK_MAX_PENDING * 2)    /* power of two */
+
+/* ?1 is the key, ?2 the value */
+static const char *KIND_SQL[WRITEBACK_KIND_COUNT] = {
+    [WRITEBACK_SESSION_EXPIRY] =
+        "UPDATE sessions SET expires_at = datetime(?2, 'unixepoch') WHERE token = ?1",
+};
+
+typedef struct {
+    uint64_t hash;
+    char key[WRITEBACK_KEY_MAX];
+    int64_t value;
+    uint8_t kind;
+} Pending;
+
+/* Pending values in arrival order, found through the index (entry + 1,
+   0: free). A flush empties both, so nothing is ever removed singly. */
+static Pending pending[WRITEBACK_MAX_PENDING];
+static uint32_t pending_index[INDEX_SLOTS];
+static unsigned pending_count = 0;
+static long last_flush = 0;
+static WritebackStats stats;
+
+static uint64_t key_hash(WritebackKind kind, const char *key) {
+    uint64_t h = 14695981039346656037ULL;
+    h = (h ^ (uint64_t)kind) * 1099511628211ULL;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint32_t *find_slot(WritebackKind kind, const char *key, uint64_t hash) {
+    unsigned i = (unsigned)hash & (INDEX_SLOTS - 1);
+    while (pending_index[i] != 0) {
+        Pending *p = &pending[pending_index[i] - 1];
+        if (p->hash == hash && p->kind == kind && strcmp(p->key, key) == 0)
+            break;
+        i = (i + 1) & (INDEX_SLOTS - 1);
+    }
+    return &pending_index[i];
+}
+
+int writeback_set(WritebackKind kind, const char *key, int64_t value) {
+    if (kind >= WRITEBACK_KIND_COUNT || strlen(key) >= WRITEBACK_KEY_MAX)
+        return -1;
+    stats.queued++;
+
+    uint64_t hash = key_hash(kind, key);
+    uint32_t *slot = find_slot(kind, key, hash);
+    if (*slot != 0) {
+        pending[*slot - 1].value = value;
+        stats.coalesced++;
+        return 0;
+    }
+
+    if (pending_count == WRITEBACK_MAX_PENDING) {
+        if (writeback_flush() < 0) {
+            stats.dropped++;
+            return -1;
+        }
+        slot = find_slot(kind, key, hash);
+    }
+
+    Pending *p = &pending[pending_count];
+    p->hash = hash;
+    strcpy(p->key, key);
+    p->value = value;
+    p->kind = (uint8_t)kind;
+    *slot = ++pending_count;
+    return 0;
+}
+
+int writeback_pending(WritebackKind kind, const char *key, int64_t *value) {
+    if (pending_count == 0 || kind >= WRITEBACK_KIND_COUNT)
+        return 0;
+    uint32_t *slot = find_slot(kind, key, key_hash(kind, key));
+    if (*slot == 0)
+        return 0;
+    *value = pending[*slot - 1].value;
+    return 1;
+}
+
+void writeback_tick(long now) {
+    if (last_flush == 0)
+        last_flush = now;
+    if (now - last_flush < WRITEBACK_INTERVAL_SECS)
+        return;
+    last_flush = now;
+    if (pending_count > 0)
+        writeback_flush();
+}
+
+int writeback_flush(void) {
+    sqlite3 *db = db_get();
+    if (pending_count == 0)
+        return 0;
+    if (db == NULL || sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        stats.failures++;
+        return -1;
+    }
+
+    /* One statement per kind, reset between rows */
+    sqlite3_stmt *stmts[WRITEBACK_KIND_COUNT] = {0};
+    int ok = 1;
+    for (unsigned i = 0; i < pending_count && ok; i++) {
+        Pending *p = &pending[i];
+        sqlite3_stmt **stmt = &stmts[p->kind];
+        if (*stmt == NULL && sqlite3_prepare_v2(db, KIND_SQL[p->kind], -1, stmt, NULL) != SQLITE_OK) {
+            ok = 0;
+            break;
+        }
+        sqlite3_bind_text(*stmt, 1, p->key, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(*stmt, 2, p->value);
+        ok = sqlite3_step(*stmt) == SQLITE_DONE;
+        sqlite3_reset(*stmt);
+    }
+    for (int k = 0; k < WRITEBACK_KIND_COUNT; k++)
+        sqlite3_finalize(stmts[k]);
+
+    if (!ok || sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        stats.failures++;
+        return -1;
+    }
+
+    int written = (int)pending_count;
+    stats.written += pending_count;
+    stats.flushes++;
+    pending_count = 0;
+    memset(pending_index, 0, sizeof(pending_index));
+    return written;
+}
+
+void writeback_get_stats(WritebackStats *out) {
+    *out = stats;
+    out->pending = pending_count;
+}
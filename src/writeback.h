@@ -0,0 +1,48 @@
+#ifndef WRITEBACK_H
+#define WRITEBACK_H
+
+#include <stdint.h>
+
+/* Writes that can wait: the latest value per key is held in memory and
+   written with the others in one transaction every
+   WRITEBACK_INTERVAL_SECS, so a key touched on every request costs one
+   UPDATE per interval. A crash loses at most one interval of them, which
+   is why only values that are cheap to lose belong here. Event loop
+   thread only. */
+
+typedef enum {
+    WRITEBACK_SESSION_EXPIRY,       /* key: session token, value: unix time */
+    WRITEBACK_KIND_COUNT
+} WritebackKind;
+
+#define WRITEBACK_INTERVAL_SECS 300
+#define WRITEBACK_MAX_PENDING 8192      /* then a flush happens early */
+#define WRITEBACK_KEY_MAX 128
+
+typedef struct {
+    unsigned pending;
+    unsigned long queued;           /* writeback_set calls */
+    unsigned long coalesced;        /* of those, replacing a pending value */
+    unsigned long written;          /* values written by flushes */
+    unsigned long flushes;
+    unsigned long failures;         /* flushes rolled back, values kept */
+    unsigned long dropped;          /* values lost to a full, failing queue */
+} WritebackStats;
+
+/* Records value for key, replacing any pending one. Returns 0, or -1 if
+   the queue was full and could not be flushed. */
+int writeback_set(WritebackKind kind, const char *key, int64_t value);
+
+/* Returns 1 and sets *value if key has a value not yet written */
+int writeback_pending(WritebackKind kind, const char *key, int64_t *value);
+
+/* Call once per event loop iteration; flushes once the interval is up */
+void writeback_tick(long now);
+
+/* Writes everything pending in one transaction. Returns the number of
+   values written, or -1 if the transaction failed. */
+int writeback_flush(void);
+
+void writeback_get_stats(WritebackStats *out);
+
+#endif /* WRITEBACK_H */